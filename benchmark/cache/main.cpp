@@ -0,0 +1,117 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "CLI/CLI.hpp"
+#include "polarphp/global/Global.h"
+#include "polarphp/basic/Cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// A value which owns as many bytes as it costs, like a code completion
+/// result owns its allocator.
+struct Payload
+{
+   std::string bytes;
+};
+
+} // anonymous namespace
+
+namespace polar::sys {
+template <>
+struct CacheValueCostInfo<Payload>
+{
+   static size_t getCost(const Payload &value)
+   {
+      return value.bytes.size();
+   }
+};
+} // polar::sys
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+using PayloadCache = polar::sys::Cache<unsigned, Payload>;
+
+/// Every thread looks keys up in its own pseudo random order, a miss stores
+/// the value. A tenth of the keys is hot and takes half of the lookups.
+void run_worker(PayloadCache &cache, unsigned seed, size_t numOps, unsigned numKeys,
+                size_t valueBytes)
+{
+   std::uint32_t state = seed * 2654435761u + 1;
+   for (size_t i = 0; i < numOps; ++i) {
+      state = state * 1664525u + 1013904223u;
+      unsigned key = state >> 8;
+      key = (state & 1) ? key % std::max(numKeys / 10, 1u) : key % numKeys;
+      if (!cache.get(key)) {
+         cache.set(key, Payload{std::string(valueBytes, 'x')});
+      }
+   }
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+   CLI::App benchmarkApp;
+   unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+   size_t numOps = 1000000;
+   unsigned numKeys = 100000;
+   size_t valueBytes = 1024;
+   size_t costLimitMiB = 32;
+   benchmarkApp.name("polar-cache-benchmark");
+   benchmarkApp.footer("\nCopyright (c) 2019-2020 polar software foundation");
+   benchmarkApp.add_option("--threads", maxThreads, "run with 1, 2, 4, ... up to this many threads (default the number of cores)");
+   benchmarkApp.add_option("--ops", numOps, "lookups of every thread (default 1000000)");
+   benchmarkApp.add_option("--keys", numKeys, "number of distinct keys (default 100000)");
+   benchmarkApp.add_option("--value-size", valueBytes, "cost of every value in bytes (default 1024)");
+   benchmarkApp.add_option("--cost-limit", costLimitMiB, "cost limit of the cache in MiB (default 32)");
+   POLAR_CLI11_PARSE(benchmarkApp, argc, argv);
+
+   std::cout << std::left << std::setw(10) << "threads"
+             << std::right << std::setw(14) << "Mops/s"
+             << std::setw(12) << "hit rate"
+             << std::setw(14) << "evictions"
+             << std::setw(12) << "entries"
+             << std::setw(14) << "cost MiB" << std::endl;
+   for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      PayloadCache cache("polar.benchmark.cache");
+      cache.setCostLimit(costLimitMiB * 1024 * 1024);
+      std::vector<std::thread> workers;
+      auto startTime = Clock::now();
+      for (unsigned i = 0; i < numThreads; ++i) {
+         workers.emplace_back(run_worker, std::ref(cache), i, numOps, numKeys, valueBytes);
+      }
+      for (std::thread &worker : workers) {
+         worker.join();
+      }
+      double seconds = Seconds(Clock::now() - startTime).count();
+      polar::sys::CacheStatistics stats = cache.getStatistics();
+      uint64_t lookups = stats.hits + stats.misses;
+      std::cout << std::left << std::setw(10) << numThreads
+                << std::right << std::fixed << std::setprecision(2)
+                << std::setw(14) << lookups / seconds / 1e6
+                << std::setw(12) << (lookups > 0 ? double(stats.hits) / lookups : 0)
+                << std::setw(14) << stats.evictions
+                << std::setw(12) << stats.entries
+                << std::setprecision(1)
+                << std::setw(14) << stats.totalCost / (1024.0 * 1024.0) << std::endl;
+   }
+   return 0;
+}
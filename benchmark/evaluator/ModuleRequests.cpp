@@ -0,0 +1,84 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "ModuleRequests.h"
+
+namespace polar {
+
+#define POLAR_TYPEID_ZONE ArithmeticEvaluator
+#define POLAR_TYPEID_HEADER "ModuleRequestsTypeIdZone.def"
+#include "polarphp/basic/ImplementTypeIdZone.h"
+#undef POLAR_TYPEID_ZONE
+#undef POLAR_TYPEID_HEADER
+
+ModuleShape sg_moduleShape;
+
+namespace {
+
+unsigned long long evaluate_or_zero(Evaluator &evaluator, unsigned declIndex)
+{
+   return evaluateOrDefault(evaluator, CheckDeclRequest(declIndex), 0ull);
+}
+
+} // anonymous namespace
+
+llvm::Expected<unsigned long long>
+CheckDeclRequest::evaluate(Evaluator &evaluator, unsigned declIndex) const
+{
+   unsigned declsPerFile = sg_moduleShape.declsPerFile;
+   unsigned fileIndex = declIndex / declsPerFile;
+   unsigned long long result = declIndex + 1;
+   for (unsigned i = 0; i < sg_moduleShape.workPerDecl; ++i) {
+      result = result * 6364136223846793005ull + 1442695040888963407ull;
+   }
+   unsigned localIndex = declIndex % declsPerFile;
+   if (localIndex > 0) {
+      result ^= evaluate_or_zero(evaluator, declIndex - 1);
+   }
+   if (localIndex > 1) {
+      result ^= evaluate_or_zero(evaluator, declIndex - 2);
+   }
+   if (fileIndex > 0) {
+      unsigned otherFile = (declIndex * 31) % fileIndex;
+      result ^= evaluate_or_zero(evaluator, otherFile * declsPerFile + (declIndex * 17) % declsPerFile);
+   }
+   return result;
+}
+
+llvm::Expected<unsigned long long>
+CheckFileRequest::evaluate(Evaluator &evaluator, unsigned fileIndex) const
+{
+   unsigned long long result = 0;
+   unsigned firstDecl = fileIndex * sg_moduleShape.declsPerFile;
+   for (unsigned i = 0; i < sg_moduleShape.declsPerFile; ++i) {
+      result += evaluate_or_zero(evaluator, firstDecl + i);
+   }
+   return result;
+}
+
+namespace {
+
+AbstractRequestFunction *sg_moduleRequestFunctions[] = {
+#define POLAR_REQUEST(Zone, Name, Sig, Caching, LocOptions)                    \
+  reinterpret_cast<AbstractRequestFunction *>(&Name::evaluateRequest),
+#include "ModuleRequestsTypeIdZone.def"
+#undef POLAR_REQUEST
+};
+
+} // anonymous namespace
+
+void register_module_request_functions(Evaluator &evaluator)
+{
+   evaluator.registerRequestFunctions(Zone::ArithmeticEvaluator,
+                                      sg_moduleRequestFunctions);
+}
+
+} // polar
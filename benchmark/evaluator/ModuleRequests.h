@@ -0,0 +1,83 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#ifndef POLARPHP_BENCHMARK_EVALUATOR_MODULE_REQUESTS_H
+#define POLARPHP_BENCHMARK_EVALUATOR_MODULE_REQUESTS_H
+
+#include "polarphp/ast/Evaluator.h"
+#include "polarphp/ast/SimpleRequest.h"
+
+namespace polar {
+
+/// The shape of the synthetic module, set before the first request is
+/// evaluated.
+struct ModuleShape
+{
+   unsigned numFiles = 64;
+   unsigned declsPerFile = 200;
+   /// rounds of busy work per declaration, stands in for type checking it
+   unsigned workPerDecl = 2000;
+};
+
+extern ModuleShape sg_moduleShape;
+
+/// Checks one declaration of the module. It depends on the two declarations
+/// before it in its file and on one declaration of an earlier file, like a
+/// declaration using a type declared elsewhere, so the dependencies never
+/// form a cycle.
+class CheckDeclRequest :
+      public SimpleRequest<CheckDeclRequest,
+                           unsigned long long(unsigned),
+                           CacheKind::Cached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned long long> evaluate(Evaluator &evaluator, unsigned declIndex) const;
+
+public:
+   bool isCached() const { return true; }
+};
+
+/// Checks every declaration of one file, the primary file request of the
+/// benchmark.
+class CheckFileRequest :
+      public SimpleRequest<CheckFileRequest,
+                           unsigned long long(unsigned),
+                           CacheKind::Uncached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned long long> evaluate(Evaluator &evaluator, unsigned fileIndex) const;
+};
+
+#define POLAR_TYPEID_ZONE ArithmeticEvaluator
+#define POLAR_TYPEID_HEADER "ModuleRequestsTypeIdZone.def"
+#include "polarphp/basic/DefineTypeIdZone.h"
+#undef POLAR_TYPEID_ZONE
+#undef POLAR_TYPEID_HEADER
+
+void register_module_request_functions(Evaluator &evaluator);
+
+} // polar
+
+#endif // POLARPHP_BENCHMARK_EVALUATOR_MODULE_REQUESTS_H
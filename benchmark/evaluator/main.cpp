@@ -0,0 +1,155 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "CLI/CLI.hpp"
+#include "polarphp/global/Global.h"
+#include "polarphp/ast/DiagnosticEngine.h"
+#include "polarphp/ast/Evaluator.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "HeapAllocationCounter.h"
+#include "ModuleRequests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define CHECKSUM_MISMATCH_ERROR 1
+
+using polar::CheckFileRequest;
+using polar::DependencyRecording;
+using polar::DiagnosticEngine;
+using polar::Evaluator;
+using polar::SourceManager;
+using polar::evaluateOrDefault;
+using polar::register_module_request_functions;
+using polar::sg_moduleShape;
+using polar::benchmark::get_heap_allocation_count;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+struct RunResult
+{
+   double seconds = 0;
+   unsigned long long checksum = 0;
+   size_t allocations = 0;
+   size_t dependencyGraphBytes = 0;
+};
+
+/// Check every file of the module with \p numThreads threads taking the
+/// next unchecked file, 0 threads checks them on this thread with a serial
+/// evaluator.
+RunResult check_module(DiagnosticEngine &diags, unsigned numThreads, DependencyRecording recording)
+{
+   Evaluator evaluator(diags);
+   register_module_request_functions(evaluator);
+   evaluator.setDependencyRecording(recording);
+   if (numThreads > 0) {
+      evaluator.enableConcurrentEvaluation();
+   }
+   std::atomic<unsigned> nextFile{0};
+   std::atomic<unsigned long long> checksum{0};
+   auto checkFiles = [&]() {
+      unsigned long long sum = 0;
+      for (unsigned file = nextFile++; file < sg_moduleShape.numFiles; file = nextFile++) {
+         sum += evaluateOrDefault(evaluator, CheckFileRequest(file), 0ull);
+      }
+      checksum += sum;
+   };
+   RunResult result;
+   size_t startAllocations = get_heap_allocation_count();
+   auto startTime = Clock::now();
+   if (numThreads == 0) {
+      checkFiles();
+   } else {
+      std::vector<std::thread> workers;
+      for (unsigned i = 0; i < numThreads; ++i) {
+         workers.emplace_back(checkFiles);
+      }
+      for (std::thread &worker : workers) {
+         worker.join();
+      }
+   }
+   result.seconds = Seconds(Clock::now() - startTime).count();
+   result.allocations = get_heap_allocation_count() - startAllocations;
+   result.checksum = checksum;
+   result.dependencyGraphBytes = evaluator.getDependencyGraphMemorySize();
+   return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+   CLI::App benchmarkApp;
+   unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+   benchmarkApp.name("polar-evaluator-benchmark");
+   benchmarkApp.footer("\nCopyright (c) 2019-2020 polar software foundation");
+   benchmarkApp.add_option("--threads", maxThreads, "run with 1, 2, 4, ... up to this many threads (default the number of cores)");
+   benchmarkApp.add_option("--files", sg_moduleShape.numFiles, "files of the module (default 64)");
+   benchmarkApp.add_option("--decls", sg_moduleShape.declsPerFile, "declarations per file (default 200)");
+   benchmarkApp.add_option("--work", sg_moduleShape.workPerDecl, "rounds of busy work per declaration (default 2000)");
+   POLAR_CLI11_PARSE(benchmarkApp, argc, argv);
+
+   SourceManager sourceMgr;
+   DiagnosticEngine diags(sourceMgr);
+   // the cost of recording the dependency graph, the busy work of the
+   // declarations hides it unless --work is small
+   std::cout << std::left << std::setw(12) << "graph"
+             << std::right << std::setw(12) << "ms"
+             << std::setw(14) << "allocations"
+             << std::setw(14) << "graph KiB" << std::endl;
+   const std::pair<const char *, DependencyRecording> recordings[] = {
+      {"none", DependencyRecording::None},
+      {"compact", DependencyRecording::Compact},
+      {"full", DependencyRecording::Full}
+   };
+   for (const auto &[name, recording] : recordings) {
+      RunResult result = check_module(diags, 0, recording);
+      std::cout << std::left << std::setw(12) << name
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << result.seconds * 1e3
+                << std::setw(14) << result.allocations
+                << std::setw(14) << result.dependencyGraphBytes / 1024.0 << std::endl;
+   }
+   std::cout << std::endl;
+
+   RunResult serial = check_module(diags, 0, DependencyRecording::None);
+   std::cout << std::left << std::setw(12) << "threads"
+             << std::right << std::setw(12) << "ms"
+             << std::setw(12) << "files/s"
+             << std::setw(12) << "speedup" << std::endl;
+   auto printRow = [&](const std::string &name, const RunResult &result) {
+      std::cout << std::left << std::setw(12) << name
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << result.seconds * 1e3
+                << std::setw(12) << sg_moduleShape.numFiles / result.seconds
+                << std::setprecision(2)
+                << std::setw(12) << serial.seconds / result.seconds << std::endl;
+   };
+   printRow("serial", serial);
+   for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      RunResult result = check_module(diags, numThreads, DependencyRecording::None);
+      if (result.checksum != serial.checksum) {
+         std::cerr << "the concurrent evaluation with " << numThreads
+                   << " threads computed another result" << std::endl;
+         return CHECKSUM_MISMATCH_ERROR;
+      }
+      printRow(std::to_string(numThreads), result);
+   }
+   return 0;
+}
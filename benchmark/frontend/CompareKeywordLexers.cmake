@@ -0,0 +1,37 @@
+# This source file is part of the polarphp.org open source project
+#
+# Copyright (c) 2017 - 2019 polarphp software foundation
+# Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+# Licensed under Apache License v2.0 with Runtime Library Exception
+#
+# See https://polarphp.org/LICENSE.txt for license information
+# See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+#
+# Created by polarboy on 2019/12/05.
+
+# Report the DFA states, generated source size and object size of every
+# generated lexer, run by the compare-keyword-lexers target with the lists
+# LEXER_NAMES, LEXER_SOURCES and LEXER_OBJECTS.
+
+function(get_file_size path outputVar)
+   # file(SIZE) needs cmake 3.14
+   file(READ ${path} content HEX)
+   string(LENGTH "${content}" hexLength)
+   math(EXPR size "${hexLength} / 2")
+   set(${outputVar} ${size} PARENT_SCOPE)
+endfunction()
+
+list(LENGTH LEXER_NAMES numLexers)
+math(EXPR lastIndex "${numLexers} - 1")
+message(STATUS "lexer      DFA states   source bytes   object bytes")
+foreach(index RANGE ${lastIndex})
+   list(GET LEXER_NAMES ${index} name)
+   list(GET LEXER_SOURCES ${index} source)
+   list(GET LEXER_OBJECTS ${index} object)
+   # every DFA state of re2c starts with a yy<N>: label
+   file(STRINGS ${source} stateLabels REGEX "^yy[0-9]+:")
+   list(LENGTH stateLabels numStates)
+   get_file_size(${source} sourceSize)
+   get_file_size(${object} objectSize)
+   message(STATUS "${name}      ${numStates}   ${sourceSize}   ${objectSize}")
+endforeach()
@@ -0,0 +1,249 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/04.
+
+#include "CorpusGenerator.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iterator>
+
+namespace polar::benchmark {
+
+namespace {
+
+/// Nesting depth of one generated expression, far below the depth limit of
+/// the parser stack.
+constexpr unsigned EXPR_DEPTH = 64;
+
+const char *const sg_binaryOperators[] = {
+   "+", "-", "*", ".", "&&", "||", "??", "<=>", "&", "|", "<<", "%"
+};
+
+void generate_heredoc(llvm::raw_ostream &out, unsigned index)
+{
+   out << "$message" << index << " = <<<EOT\n"
+       << "    Dear $name" << index << ",\n"
+       << "    your order {$order->id} with {$items[" << index % 7 << "]} items ships on $date.\n"
+       << "    The total is {$totals['gross']} plus $tax->rate percent, see ${link}.\n"
+       << "    a plain line without any interpolation that only has to be scanned for the label\n"
+       << "      indented line \\t with \\x41 escapes \\u{1F418} and a \\$ sign\n"
+       << "    EOT;\n";
+   out << "$template" << index << " = <<<'EOT'\n"
+       << "    nowdoc lines are never interpolated: $name {$order->id} \\n\n"
+       << "    <div class=\"row\">{{ placeholder }}</div>\n"
+       << "    EOT;\n";
+   out << "echo <<<\"HTML\"\n"
+       << "<li>$name" << index << "</li>\n"
+       << "HTML;\n\n";
+}
+
+void generate_interpolation(llvm::raw_ostream &out, unsigned index)
+{
+   out << "$line" << index << " = \"user {$user->name} has $count items in $cart["
+       << index % 5 << "] and $order->total euro\\n\";\n"
+       << "$path" << index << " = \"{$base}/{$dirs[$i]}/file_" << index << ".php\\t\\\"quoted\\\"\";\n"
+       << "$label" << index << " = 'single ' . $line" << index << " . \"tail ${suffix} \\x7f \\101\";\n"
+       << "$plain" << index << " = \"a double quoted string without any variable or escape at all\";\n";
+}
+
+void generate_deep_expression(llvm::raw_ostream &out, unsigned index)
+{
+   out << "$value" << index << " = ";
+   for (unsigned depth = 0; depth < EXPR_DEPTH; ++depth) {
+      out << '(';
+   }
+   out << "$a" << index;
+   for (unsigned depth = 0; depth < EXPR_DEPTH; ++depth) {
+      const char *op = sg_binaryOperators[(index + depth) % std::size(sg_binaryOperators)];
+      out << ' ' << op << ' ';
+      if (depth % 3 == 0) {
+         out << "$b" << depth;
+      } else {
+         out << "f(" << depth << ')';
+      }
+      out << ')';
+   }
+   out << ";\n";
+   out << "$chain" << index << " = $builder";
+   for (unsigned depth = 0; depth < EXPR_DEPTH / 4; ++depth) {
+      out << "->step" << depth << "($x[" << depth << "], map" << depth << "($y))";
+   }
+   out << ";\n";
+   out << "$call" << index << " = ";
+   for (unsigned depth = 0; depth < EXPR_DEPTH / 2; ++depth) {
+      out << "wrap" << depth << '(';
+   }
+   out << index;
+   for (unsigned depth = 0; depth < EXPR_DEPTH / 2; ++depth) {
+      out << ')';
+   }
+   out << ";\n";
+}
+
+void generate_array_element(llvm::raw_ostream &out, unsigned index)
+{
+   out << "   'key" << index << "' => [" << index << ", " << index << ".5, \"v" << index
+       << "\", " << (index % 2 ? "true" : "false") << ", null, ['nested' => [" << index % 13
+       << ", 'x']]],\n";
+}
+
+void generate_mixed(llvm::raw_ostream &out, unsigned index)
+{
+   out << "function compute_" << index << "(array $items, int $limit = " << index % 100 << "): int\n"
+       << "{\n"
+       << "   $total = 0;\n"
+       << "   foreach ($items as $key => $value) {\n"
+       << "      if ($value > $limit) {\n"
+       << "         $total += $value * 2;\n"
+       << "      } elseif ($value === null) {\n"
+       << "         continue;\n"
+       << "      } else {\n"
+       << "         $total -= $key;\n"
+       << "      }\n"
+       << "   }\n"
+       << "   while ($total > 1000) {\n"
+       << "      $total = intdiv($total, 3);\n"
+       << "   }\n"
+       << "   // the result is never negative\n"
+       << "   return $total < 0 ? 0 : $total;\n"
+       << "}\n\n"
+       << "/**\n"
+       << " * Generated service " << index << ".\n"
+       << " */\n"
+       << "class Service" << index << " extends BaseService implements Countable\n"
+       << "{\n"
+       << "   const LIMIT = " << index << ";\n"
+       << "   private $cache = [];\n"
+       << "   protected static $instances = 0;\n\n"
+       << "   public function count(): int\n"
+       << "   {\n"
+       << "      return count($this->cache);\n"
+       << "   }\n\n"
+       << "   public static function create(string $name, ...$args): self\n"
+       << "   {\n"
+       << "      try {\n"
+       << "         return new static($name, ...$args);\n"
+       << "      } catch (InvalidArgumentException $e) {\n"
+       << "         throw new RuntimeException($e->getMessage(), 0, $e);\n"
+       << "      } finally {\n"
+       << "         self::$instances++;\n"
+       << "      }\n"
+       << "   }\n"
+       << "}\n\n";
+}
+
+void generate_keywords(llvm::raw_ostream &out, unsigned index)
+{
+   out << "abstract class Repository" << index << " extends Base implements Countable, Serializable\n"
+       << "{\n"
+       << "   use Logging, Caching;\n"
+       << "   private static $instance = null;\n"
+       << "   protected $items = array();\n\n"
+       << "   public static function instance(): self\n"
+       << "   {\n"
+       << "      if (static::$instance === NULL AND isset($this->items) OR empty($this->items)) {\n"
+       << "         static::$instance = new static();\n"
+       << "      }\n"
+       << "      return static::$instance;\n"
+       << "   }\n\n"
+       << "   Public Function convert($value)\n"
+       << "   {\n"
+       << "      $count = (int) $value + (integer)$this->items[0];\n"
+       << "      $ratio = ( float ) $count / (double) " << index + 1 << ";\n"
+       << "      $name = (string) $ratio . (STRING) $this->returnValue . (binary) $classes;\n"
+       << "      $flags = (bool) $count XOR (boolean) $ratio;\n"
+       << "      $list = (array) $this->functions;\n"
+       << "      $object = (object) $list;\n"
+       << "      $call = (format)($value);\n"
+       << "      foreach ($list as $key => $item) {\n"
+       << "         switch ($item) {\n"
+       << "         case " << index % 10 << ":\n"
+       << "            break;\n"
+       << "         default:\n"
+       << "            continue 2;\n"
+       << "         }\n"
+       << "      }\n"
+       << "      while (false) {\n"
+       << "         echo __CLASS__, __FUNCTION__, __LINE__;\n"
+       << "      }\n"
+       << "      Return $item instanceof Repository" << index << " ? TRUE : FALSE;\n"
+       << "   }\n"
+       << "}\n\n";
+}
+
+} // anonymous namespace
+
+llvm::ArrayRef<CorpusKind> get_all_corpus_kinds()
+{
+   static const CorpusKind kinds[] = {
+      CorpusKind::Heredoc, CorpusKind::Interpolation, CorpusKind::DeepExpression,
+      CorpusKind::HugeArray, CorpusKind::Mixed, CorpusKind::Keywords
+   };
+   return kinds;
+}
+
+const char *get_corpus_name(CorpusKind kind)
+{
+   switch (kind) {
+   case CorpusKind::Heredoc:
+      return "heredoc";
+   case CorpusKind::Interpolation:
+      return "interpolation";
+   case CorpusKind::DeepExpression:
+      return "deep-expression";
+   case CorpusKind::HugeArray:
+      return "huge-array";
+   case CorpusKind::Mixed:
+      return "mixed";
+   case CorpusKind::Keywords:
+      return "keywords";
+   }
+   llvm_unreachable("unknown corpus kind");
+}
+
+std::string generate_corpus(CorpusKind kind, size_t targetBytes)
+{
+   std::string source;
+   source.reserve(targetBytes + 4096);
+   llvm::raw_string_ostream out(source);
+   if (kind == CorpusKind::HugeArray) {
+      out << "$table = [\n";
+   }
+   for (unsigned index = 0; out.tell() < targetBytes; ++index) {
+      switch (kind) {
+      case CorpusKind::Heredoc:
+         generate_heredoc(out, index);
+         break;
+      case CorpusKind::Interpolation:
+         generate_interpolation(out, index);
+         break;
+      case CorpusKind::DeepExpression:
+         generate_deep_expression(out, index);
+         break;
+      case CorpusKind::HugeArray:
+         generate_array_element(out, index);
+         break;
+      case CorpusKind::Mixed:
+         generate_mixed(out, index);
+         break;
+      case CorpusKind::Keywords:
+         generate_keywords(out, index);
+         break;
+      }
+   }
+   if (kind == CorpusKind::HugeArray) {
+      out << "];\n";
+   }
+   out.flush();
+   return source;
+}
+
+} // polar::benchmark
@@ -0,0 +1,51 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/04.
+
+#ifndef POLARPHP_BENCHMARK_FRONTEND_CORPUS_GENERATOR_H
+#define POLARPHP_BENCHMARK_FRONTEND_CORPUS_GENERATOR_H
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cstddef>
+#include <string>
+
+namespace polar::benchmark {
+
+/// The kinds of generated source, each stresses one part of the lexer rules
+/// or the grammar.
+enum class CorpusKind
+{
+   /// heredoc and nowdoc bodies with and without interpolation
+   Heredoc,
+   /// double quoted strings with simple and complex interpolation and escapes
+   Interpolation,
+   /// deeply parenthesized expressions and long call chains
+   DeepExpression,
+   /// one array literal with a huge number of nested elements
+   HugeArray,
+   /// functions and classes with the usual control flow
+   Mixed,
+   /// keywords in any letter case, casts and identifiers that start like
+   /// keywords
+   Keywords
+};
+
+llvm::ArrayRef<CorpusKind> get_all_corpus_kinds();
+
+const char *get_corpus_name(CorpusKind kind);
+
+/// Generate about \p targetBytes of valid source of \p kind. The output only
+/// depends on the arguments, so numbers of different runs compare.
+std::string generate_corpus(CorpusKind kind, size_t targetBytes);
+
+} // polar::benchmark
+
+#endif // POLARPHP_BENCHMARK_FRONTEND_CORPUS_GENERATOR_H
@@ -0,0 +1,413 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/04.
+
+#include "CLI/CLI.hpp"
+#include "polarphp/global/Global.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "polarphp/parser/Lexer.h"
+#include "polarphp/parser/Parser.h"
+#include "polarphp/parser/Token.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "nlohmann/json.hpp"
+#include "CorpusGenerator.h"
+#include "HeapAllocationCounter.h"
+
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#define WRITE_CORPUS_ERROR 1
+#define OPEN_OUTPUT_FILE_ERROR 2
+#define UNKNOWN_OUTPUT_FORMAT_ERROR 3
+#define PARSE_CORPUS_ERROR 4
+#define READ_SOURCE_FILE_ERROR 5
+
+using polar::LangOptions;
+using polar::basic::SourceManager;
+using polar::parser::Lexer;
+using polar::parser::Parser;
+using polar::parser::Token;
+using polar::parser::TokenKindType;
+using polar::parser::CommentRetentionMode;
+using polar::parser::TriviaRetentionMode;
+using polar::benchmark::CorpusKind;
+using polar::benchmark::generate_corpus;
+using polar::benchmark::get_all_corpus_kinds;
+using polar::benchmark::get_corpus_name;
+using polar::benchmark::get_heap_allocation_count;
+using nlohmann::json;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+struct Corpus
+{
+   CorpusKind kind;
+   unsigned bufferId;
+   size_t size;
+};
+
+struct BenchmarkResult
+{
+   std::string name;
+   size_t iterations = 0;
+   double seconds = 0;
+   size_t bytesPerIteration = 0;
+   /// tokens for the lexer benchmarks, 0 when there is no item to count
+   size_t itemsPerIteration = 0;
+   size_t allocations = 0;
+   size_t peakResidentBytes = 0;
+};
+
+size_t get_peak_resident_bytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+      return usage.ru_maxrss;
+#else
+      return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+   }
+#endif
+   return 0;
+}
+
+/// Run \p body once to warm up, then repeatedly until \p minSeconds passed,
+/// \p body returns the number of items it processed.
+template <typename BodyType>
+BenchmarkResult run_benchmark(std::string name, size_t bytes, double minSeconds, BodyType body)
+{
+   BenchmarkResult result;
+   result.name = std::move(name);
+   result.bytesPerIteration = bytes;
+   body();
+   size_t startAllocations = get_heap_allocation_count();
+   auto startTime = Clock::now();
+   do {
+      result.itemsPerIteration = body();
+      ++result.iterations;
+      result.seconds = Seconds(Clock::now() - startTime).count();
+   } while (result.seconds < minSeconds);
+   result.allocations = get_heap_allocation_count() - startAllocations;
+   result.peakResidentBytes = get_peak_resident_bytes();
+   return result;
+}
+
+size_t lex_buffer(const LangOptions &langOpts, const SourceManager &sourceMgr, unsigned bufferId)
+{
+   Lexer lexer(langOpts, sourceMgr, bufferId, nullptr, CommentRetentionMode::None,
+               TriviaRetentionMode::WithTrivia);
+   Token currentToken;
+   size_t numTokens = 0;
+   do {
+      lexer.lex(currentToken);
+      ++numTokens;
+   } while (currentToken.isNot(TokenKindType::END));
+   return numTokens;
+}
+
+bool parse_buffer(const LangOptions &langOpts, SourceManager &sourceMgr, unsigned bufferId)
+{
+   Parser parser(langOpts, bufferId, sourceMgr, nullptr);
+   return !parser.parse();
+}
+
+llvm::ErrorOr<unsigned> add_source_file_copy(SourceManager &sourceMgr, const std::string &filePath)
+{
+   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFile(filePath);
+   if (!buffer) {
+      return buffer.getError();
+   }
+   return sourceMgr.addNewSourceBuffer(std::move(buffer.get()));
+}
+
+/// Write \p numFiles small sources of every corpus kind into \p dir and
+/// lex each once through one source manager, like a pass over a whole
+/// repository does. The peak RSS is the point of this benchmark, so it runs
+/// once and alone.
+int run_source_files_benchmark(const LangOptions &langOpts, std::string dir, size_t numFiles,
+                               bool mapped, unsigned maxResident, BenchmarkResult &result)
+{
+   llvm::SmallString<128> dirPath(dir);
+   std::error_code errorCode = dir.empty()
+         ? llvm::sys::fs::createUniqueDirectory("polar-sources", dirPath)
+         : llvm::sys::fs::create_directories(dir);
+   std::vector<std::string> filePaths;
+   llvm::ArrayRef<CorpusKind> kinds = get_all_corpus_kinds();
+   std::vector<std::string> sources;
+   for (CorpusKind kind : kinds) {
+      sources.push_back(generate_corpus(kind, 2048));
+   }
+   for (size_t i = 0; i < numFiles && !errorCode; ++i) {
+      llvm::SmallString<128> path(dirPath);
+      llvm::sys::path::append(path, "source" + std::to_string(i) + ".php");
+      llvm::raw_fd_ostream sourceFile(path, errorCode, llvm::sys::fs::OF_None);
+      sourceFile << sources[i % sources.size()];
+      filePaths.push_back(path.str().str());
+   }
+   if (errorCode) {
+      std::cerr << "write source files error: " << dirPath.str().str() << ": " << errorCode.message() << std::endl;
+      return WRITE_CORPUS_ERROR;
+   }
+   result.name = mapped ? "sources/mapped" : "sources/copied";
+   result.iterations = 1;
+   size_t startAllocations = get_heap_allocation_count();
+   auto startTime = Clock::now();
+   SourceManager sourceMgr;
+   sourceMgr.setMaxResidentMappedFiles(maxResident);
+   for (const std::string &filePath : filePaths) {
+      llvm::ErrorOr<unsigned> bufferId = mapped
+            ? sourceMgr.addMappedSourceFile(filePath)
+            : add_source_file_copy(sourceMgr, filePath);
+      if (!bufferId) {
+         std::cerr << "read source file error: " << filePath << ": " << bufferId.getError().message() << std::endl;
+         return READ_SOURCE_FILE_ERROR;
+      }
+      result.bytesPerIteration += sourceMgr.getRangeForBuffer(bufferId.get()).getByteLength();
+      result.itemsPerIteration += lex_buffer(langOpts, sourceMgr, bufferId.get());
+   }
+   result.seconds = Seconds(Clock::now() - startTime).count();
+   result.allocations = get_heap_allocation_count() - startAllocations;
+   result.peakResidentBytes = get_peak_resident_bytes();
+   if (dir.empty()) {
+      for (const std::string &filePath : filePaths) {
+         llvm::sys::fs::remove(filePath);
+      }
+      llvm::sys::fs::remove(dirPath);
+   }
+   return 0;
+}
+
+/// Look up the buffers of locations spread over \p numBuffers small
+/// buffers, like diagnostics and the dependency trackers do.
+BenchmarkResult run_find_buffer_benchmark(size_t numBuffers, double minSeconds)
+{
+   SourceManager sourceMgr;
+   std::vector<polar::SourceLoc> locs;
+   for (size_t i = 0; i < numBuffers; ++i) {
+      std::string source = "$value" + std::to_string(i) + " = " + std::to_string(i * 7) + ";\n";
+      unsigned bufferId = sourceMgr.addMemBufferCopy(source, "buffer" + std::to_string(i) + ".php");
+      locs.push_back(sourceMgr.getLocForOffset(bufferId, i % source.size()));
+   }
+   // visit the buffers in a fixed pseudo random order, so no lookup profits
+   // from the previous one
+   std::uint32_t state = 1;
+   for (size_t i = locs.size(); i > 1; --i) {
+      state = state * 1664525u + 1013904223u;
+      std::swap(locs[i - 1], locs[state % i]);
+   }
+   return run_benchmark("find-buffer/" + std::to_string(numBuffers), 0, minSeconds, [&]() {
+      size_t checksum = 0;
+      for (polar::SourceLoc loc : locs) {
+         checksum += sourceMgr.findBufferContainingLoc(loc);
+      }
+      return checksum > 0 ? locs.size() : 0;
+   });
+}
+
+double per_second(double value, const BenchmarkResult &result)
+{
+   return result.seconds > 0 ? value * result.iterations / result.seconds : 0;
+}
+
+void print_console(const std::vector<BenchmarkResult> &results, std::ostream &out)
+{
+   out << std::left << std::setw(26) << "benchmark"
+       << std::right << std::setw(12) << "iterations"
+       << std::setw(14) << "ms/iter"
+       << std::setw(10) << "MB/s"
+       << std::setw(14) << "tokens/s"
+       << std::setw(14) << "allocs/iter"
+       << std::setw(14) << "peak RSS MB" << std::endl;
+   for (const BenchmarkResult &result : results) {
+      out << std::left << std::setw(26) << result.name
+          << std::right << std::setw(12) << result.iterations
+          << std::fixed << std::setprecision(3)
+          << std::setw(14) << result.seconds * 1e3 / result.iterations
+          << std::setprecision(2)
+          << std::setw(10) << per_second(result.bytesPerIteration, result) / (1024 * 1024)
+          << std::setprecision(0)
+          << std::setw(14) << per_second(result.itemsPerIteration, result)
+          << std::setw(14) << double(result.allocations) / result.iterations
+          << std::setprecision(1)
+          << std::setw(14) << result.peakResidentBytes / (1024.0 * 1024.0) << std::endl;
+   }
+}
+
+/// Same keys as the JSON reporter of Google Benchmark, so its compare
+/// scripts work on the output.
+void print_json(const std::vector<BenchmarkResult> &results, size_t corpusBytes, std::ostream &out)
+{
+   json benchmarks = json::array();
+   for (const BenchmarkResult &result : results) {
+      benchmarks.push_back({
+         {"name", result.name},
+         {"iterations", result.iterations},
+         {"real_time", result.seconds * 1e9 / result.iterations},
+         {"time_unit", "ns"},
+         {"bytes_per_second", per_second(result.bytesPerIteration, result)},
+         {"items_per_second", per_second(result.itemsPerIteration, result)},
+         {"allocations_per_iteration", double(result.allocations) / result.iterations},
+         {"peak_rss_bytes", result.peakResidentBytes}
+      });
+   }
+#ifdef POLAR_LEXER_KEYWORD_HASH
+   const char *keywordLookup = "perfect-hash";
+#else
+   const char *keywordLookup = "dfa";
+#endif
+   json report = {
+      {"context", {
+          {"executable", "polar-frontend-benchmark"},
+          {"corpus_bytes", corpusBytes},
+          {"lexer_keywords", keywordLookup}
+       }},
+      {"benchmarks", benchmarks}
+   };
+   out << report.dump(3) << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+   CLI::App benchmarkApp;
+   std::string filter;
+   std::string outputFilePath;
+   std::string outputFormat = "console";
+   std::string corpusDir;
+   size_t corpusKiloBytes = 512;
+   double minSeconds = 0.5;
+   size_t numSourceFiles = 0;
+   bool mappedSources = false;
+   unsigned maxResidentSources = 64;
+   size_t numLookupBuffers = 10000;
+   benchmarkApp.name("polar-frontend-benchmark");
+   benchmarkApp.footer("\nCopyright (c) 2019-2020 polar software foundation");
+   benchmarkApp.add_option("--filter", filter, "only run the benchmarks whose name contains this text, e.g. lex/ or heredoc");
+   benchmarkApp.add_option("--corpus-size", corpusKiloBytes, "size of every generated corpus in KiB (default 512)");
+   benchmarkApp.add_option("--min-time", minSeconds, "run every benchmark at least this many seconds (default 0.5)");
+   benchmarkApp.add_option("--format", outputFormat, "output format: console (default) or json");
+   benchmarkApp.add_option("-o,--output", outputFilePath, "write the results into file path");
+   benchmarkApp.add_option("--write-corpus", corpusDir, "also write the generated corpora into this directory");
+   benchmarkApp.add_option("--source-files", numSourceFiles, "instead of the corpus benchmarks lex this many small files through one source manager and report the peak RSS");
+   benchmarkApp.add_flag("--mapped-sources", mappedSources, "map the files of --source-files instead of reading them into memory");
+   benchmarkApp.add_option("--max-resident-sources", maxResidentSources, "how many mapped files stay resident (default 64)");
+   benchmarkApp.add_option("--lookup-buffers", numLookupBuffers, "number of buffers of the find-buffer benchmark (default 10000)");
+   POLAR_CLI11_PARSE(benchmarkApp, argc, argv);
+   if (outputFormat != "console" && outputFormat != "json") {
+      std::cerr << "unknown output format: " << outputFormat << std::endl;
+      return UNKNOWN_OUTPUT_FORMAT_ERROR;
+   }
+   std::ostream *output = &std::cout;
+   std::unique_ptr<std::ofstream> foutstream;
+   if (!outputFilePath.empty()) {
+      foutstream = std::make_unique<std::ofstream>(outputFilePath, std::ios_base::out | std::ios_base::trunc);
+      if (foutstream->fail()) {
+         std::cerr << "open output file error: " << strerror(errno) << std::endl;
+         return OPEN_OUTPUT_FILE_ERROR;
+      }
+      output = foutstream.get();
+   }
+
+   LangOptions langOpts{};
+   if (numSourceFiles > 0) {
+      std::vector<BenchmarkResult> results(1);
+      if (int errorCode = run_source_files_benchmark(langOpts, corpusDir, numSourceFiles, mappedSources,
+                                                     std::max(maxResidentSources, 1u), results.front())) {
+         return errorCode;
+      }
+      if (outputFormat == "json") {
+         print_json(results, results.front().bytesPerIteration, *output);
+      } else {
+         print_console(results, *output);
+      }
+      output->flush();
+      return 0;
+   }
+   SourceManager sourceMgr;
+   std::vector<Corpus> corpora;
+   size_t corpusBytes = 0;
+   for (CorpusKind kind : get_all_corpus_kinds()) {
+      std::string source = generate_corpus(kind, corpusKiloBytes * 1024);
+      std::string fileName = std::string(get_corpus_name(kind)) + ".php";
+      if (!corpusDir.empty()) {
+         llvm::SmallString<128> path(corpusDir);
+         llvm::sys::path::append(path, fileName);
+         std::error_code errorCode = llvm::sys::fs::create_directories(corpusDir);
+         if (!errorCode) {
+            llvm::raw_fd_ostream corpusFile(path, errorCode, llvm::sys::fs::OF_None);
+            corpusFile << source;
+         }
+         if (errorCode) {
+            std::cerr << "write corpus error: " << path.str().str() << ": " << errorCode.message() << std::endl;
+            return WRITE_CORPUS_ERROR;
+         }
+      }
+      corpora.push_back({kind, sourceMgr.addMemBufferCopy(source, fileName), source.size()});
+      corpusBytes += source.size();
+   }
+
+   std::vector<BenchmarkResult> results;
+   bool corpusRejected = false;
+   for (const Corpus &corpus : corpora) {
+      std::string lexName = std::string("lex/") + get_corpus_name(corpus.kind);
+      if (lexName.find(filter) != std::string::npos) {
+         results.push_back(run_benchmark(lexName, corpus.size, minSeconds, [&]() {
+            return lex_buffer(langOpts, sourceMgr, corpus.bufferId);
+         }));
+      }
+      std::string parseName = std::string("parse/") + get_corpus_name(corpus.kind);
+      if (parseName.find(filter) == std::string::npos) {
+         continue;
+      }
+      // a corpus the grammar rejects would time the error recovery
+      if (!parse_buffer(langOpts, sourceMgr, corpus.bufferId)) {
+         std::cerr << "the parser rejects the " << get_corpus_name(corpus.kind) << " corpus" << std::endl;
+         corpusRejected = true;
+         continue;
+      }
+      results.push_back(run_benchmark(parseName, corpus.size, minSeconds, [&]() -> size_t {
+         parse_buffer(langOpts, sourceMgr, corpus.bufferId);
+         return 0;
+      }));
+   }
+   if (std::string("find-buffer/").find(filter) != std::string::npos) {
+      results.push_back(run_find_buffer_benchmark(numLookupBuffers, minSeconds));
+   }
+   if (outputFormat == "json") {
+      print_json(results, corpusBytes, *output);
+   } else {
+      print_console(results, *output);
+   }
+   output->flush();
+   return corpusRejected ? PARSE_CORPUS_ERROR : 0;
+}
@@ -0,0 +1,155 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "CLI/CLI.hpp"
+#include "polarphp/global/Global.h"
+#include "polarphp/ast/ConcurrentIdentifierTable.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define IDENTITY_MISMATCH_ERROR 1
+
+using polar::ConcurrentIdentifierTable;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+/// The identifier table of the AstContext before it was concurrent, behind
+/// the global lock every thread would need to intern into it.
+class LockedIdentifierTable
+{
+public:
+   const char *intern(llvm::StringRef str)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_table.insert(std::make_pair(str, Aligner())).first->getKeyData();
+   }
+
+private:
+   struct alignas(std::uint32_t) Aligner {};
+
+   std::mutex m_mutex;
+   llvm::BumpPtrAllocator m_allocator;
+   llvm::StringMap<Aligner, llvm::BumpPtrAllocator &> m_table{m_allocator};
+};
+
+/// Names shaped like the ones of a module, a few short keywords and a long
+/// tail of longer declaration names.
+std::vector<std::string> make_names(unsigned numNames)
+{
+   static const char *const prefixes[] = {"get", "set", "is", "make", "with", "to", "from", "has"};
+   std::vector<std::string> names;
+   names.reserve(numNames);
+   for (unsigned i = 0; i < numNames; ++i) {
+      names.push_back(std::string(prefixes[i % 8]) + "Declaration" + std::to_string(i));
+   }
+   return names;
+}
+
+/// Every thread interns all names starting at a name of its own, \p interned
+/// gets the pointer of each name.
+template <typename TableType>
+void run_worker(TableType &table, const std::vector<std::string> &names, unsigned seed,
+                unsigned rounds, std::vector<const char *> &interned)
+{
+   size_t numNames = names.size();
+   interned.assign(numNames, nullptr);
+   size_t start = seed * 104729 % numNames;
+   for (unsigned round = 0; round < rounds; ++round) {
+      for (size_t i = 0; i < numNames; ++i) {
+         size_t index = start + i < numNames ? start + i : start + i - numNames;
+         interned[index] = table.intern(names[index]);
+      }
+   }
+}
+
+struct RunResult
+{
+   double seconds = 0;
+   bool sameIdentity = true;
+};
+
+template <typename TableType>
+RunResult run_threads(const std::vector<std::string> &names, unsigned numThreads, unsigned rounds)
+{
+   TableType table;
+   std::vector<std::vector<const char *>> interned(numThreads);
+   std::vector<std::thread> workers;
+   auto startTime = Clock::now();
+   for (unsigned i = 0; i < numThreads; ++i) {
+      workers.emplace_back([&, i]() {
+         run_worker(table, names, i, rounds, interned[i]);
+      });
+   }
+   for (std::thread &worker : workers) {
+      worker.join();
+   }
+   RunResult result;
+   result.seconds = Seconds(Clock::now() - startTime).count();
+   for (unsigned i = 0; i < numThreads; ++i) {
+      for (size_t j = 0; j < names.size(); ++j) {
+         if (!interned[i][j] || interned[i][j] != interned[0][j] || names[j] != interned[i][j]) {
+            result.sameIdentity = false;
+         }
+      }
+   }
+   return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+   CLI::App benchmarkApp;
+   unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+   unsigned numNames = 200000;
+   unsigned rounds = 4;
+   benchmarkApp.name("polar-identifier-benchmark");
+   benchmarkApp.footer("\nCopyright (c) 2019-2020 polar software foundation");
+   benchmarkApp.add_option("--threads", maxThreads, "run with 1, 2, 4, ... up to this many threads (default the number of cores)");
+   benchmarkApp.add_option("--names", numNames, "distinct names every thread interns (default 200000)");
+   benchmarkApp.add_option("--rounds", rounds, "times every thread interns all names (default 4)");
+   POLAR_CLI11_PARSE(benchmarkApp, argc, argv);
+   std::vector<std::string> names = make_names(std::max(numNames, 1u));
+
+   std::cout << std::left << std::setw(10) << "threads"
+             << std::right << std::setw(16) << "locked Mops/s"
+             << std::setw(18) << "lock-free Mops/s"
+             << std::setw(12) << "speedup" << std::endl;
+   for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      RunResult locked = run_threads<LockedIdentifierTable>(names, numThreads, rounds);
+      RunResult lockFree = run_threads<ConcurrentIdentifierTable>(names, numThreads, rounds);
+      if (!locked.sameIdentity || !lockFree.sameIdentity) {
+         std::cerr << "the threads got different pointers for a name with "
+                   << numThreads << " threads" << std::endl;
+         return IDENTITY_MISMATCH_ERROR;
+      }
+      double numOps = double(names.size()) * rounds * numThreads;
+      std::cout << std::left << std::setw(10) << numThreads
+                << std::right << std::fixed << std::setprecision(2)
+                << std::setw(16) << numOps / locked.seconds / 1e6
+                << std::setw(18) << numOps / lockFree.seconds / 1e6
+                << std::setw(12) << locked.seconds / lockFree.seconds << std::endl;
+   }
+   return 0;
+}
@@ -0,0 +1,77 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/20.
+
+#include "HeapAllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace polar::benchmark {
+
+namespace {
+std::atomic<std::size_t> sg_heapAllocationCount{0};
+
+void *counted_allocate(std::size_t size)
+{
+   sg_heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+   if (size == 0) {
+      size = 1;
+   }
+   while (true) {
+      if (void *ptr = std::malloc(size)) {
+         return ptr;
+      }
+      std::new_handler handler = std::get_new_handler();
+      if (!handler) {
+         throw std::bad_alloc();
+      }
+      handler();
+   }
+}
+} // anonymous namespace
+
+std::size_t get_heap_allocation_count()
+{
+   return sg_heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+} // polar::benchmark
+
+void *operator new(std::size_t size)
+{
+   return polar::benchmark::counted_allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+   return polar::benchmark::counted_allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+   std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+   std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+   std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+   std::free(ptr);
+}
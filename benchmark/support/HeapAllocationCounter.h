@@ -0,0 +1,26 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/20.
+
+#ifndef POLARPHP_BENCHMARK_SUPPORT_HEAP_ALLOCATION_COUNTER_H
+#define POLARPHP_BENCHMARK_SUPPORT_HEAP_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace polar::benchmark {
+
+/// Number of global operator new calls made by the process so far. Linking
+/// this library replaces the global allocation functions of the program, the
+/// tools and benchmarks use it to report the allocations of a run.
+std::size_t get_heap_allocation_count();
+
+} // polar::benchmark
+
+#endif // POLARPHP_BENCHMARK_SUPPORT_HEAP_ALLOCATION_COUNTER_H
@@ -56,8 +56,10 @@ class AnyRequest {
     return hash_combine(typeID, requestHash);
   }
 
-  /// Abstract base class used to hold the specific request kind.
-  class HolderBase : public llvm::RefCountedBase<HolderBase> {
+  /// Abstract base class used to hold the specific request kind. The
+  /// reference count is atomic because a concurrent evaluator shares
+  /// requests between threads.
+  class HolderBase : public llvm::ThreadSafeRefCountedBase<HolderBase> {
   public:
     /// The type ID of the request being stored.
     const uint64_t typeID;
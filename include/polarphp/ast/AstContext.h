@@ -72,6 +72,7 @@ class ConstructorDecl;
 class Decl;
 class DeclContext;
 class DefaultArgumentInitializer;
+class Expr;
 class ExtensionDecl;
 class ForeignRepresentationInfo;
 class FuncDecl;
@@ -187,6 +188,34 @@ public:
    ~ConstraintCheckerArenaRAII();
 };
 
+/// Attributes the bytes allocated in the arenas of an AstContext to a
+/// phase and a source file while it lives, if arena accounting is enabled.
+///
+/// \sa AstContext::enableArenaAccounting
+class ArenaAccountingRAII {
+   AstContext &Self;
+   Identifier PreviousPhase;
+   const SourceFile *PreviousFile = nullptr;
+
+public:
+   /// \param phase The phase, like "parse" or "type-check".
+   ///
+   /// \param file The source file the phase works on, if any.
+   ArenaAccountingRAII(AstContext &self, StringRef phase,
+                       const SourceFile *file = nullptr);
+
+   ArenaAccountingRAII(const ArenaAccountingRAII &) = delete;
+   ArenaAccountingRAII(ArenaAccountingRAII &&) = delete;
+
+   ArenaAccountingRAII &
+   operator=(const ArenaAccountingRAII &) = delete;
+
+   ArenaAccountingRAII &
+   operator=(ArenaAccountingRAII &&) = delete;
+
+   ~ArenaAccountingRAII();
+};
+
 class PILLayout; // From PIL
 
 /// AstContext - This object creates and owns the AST objects.
@@ -215,6 +244,7 @@ public:
    Implementation &getImpl() const;
 
    friend ConstraintCheckerArenaRAII;
+   friend ArenaAccountingRAII;
 
    void operator delete(void *Data) throw();
 
@@ -319,8 +349,12 @@ public:
       if (LangOpts.UseMalloc)
          return aligned_alloc(bytes, alignment);
 
-      if (arena == AllocationArena::Permanent && Stats)
-         Stats->getFrontendCounters().NumAstBytesAllocated += bytes;
+      if (Stats) {
+         if (arena == AllocationArena::Permanent)
+            Stats->getFrontendCounters().NumAstBytesAllocated += bytes;
+         else
+            Stats->getFrontendCounters().NumConstraintSolverBytesAllocated += bytes;
+      }
       return getAllocator(arena).Allocate(bytes, alignment);
    }
 
@@ -431,7 +465,7 @@ public:
    TypeChecker *getLegacyGlobalTypeChecker() const;
 
    /// getIdentifier - Return the uniqued and AST-Context-owned version of the
-   /// specified string.
+   /// specified string. Threads may intern at the same time.
    Identifier getIdentifier(StringRef Str) const;
 
    /// Decide how to interpret two precedence groups.
@@ -827,6 +861,26 @@ public:
    /// Returns memory used exclusively by constraint solver.
    size_t getSolverMemory() const;
 
+   /// Start attributing the bytes allocated in the arenas to the phases and
+   /// source files of \c ArenaAccountingRAII scopes, for -print-arena-stats.
+   ///
+   /// The bytes of the permanent arena go to the scope they were allocated
+   /// in, the bytes of a constraint solver arena to the scope it is released
+   /// in. If \p trackSolvedExprs is set, the size of the constraint solver
+   /// arena after each solved expression is kept as well.
+   void enableArenaAccounting(bool trackSolvedExprs);
+
+   /// Whether enableArenaAccounting() was called.
+   bool isArenaAccountingEnabled() const;
+
+   /// Note that the constraint solver arena holds \p bytes after \p expr
+   /// was solved.
+   void noteSolvedExprArenaBytes(const Expr *expr, size_t bytes);
+
+   /// Print the bytes allocated in each arena by phase and source file, then
+   /// the tracked expressions with the largest constraint solver arena first.
+   void printArenaStatistics(raw_ostream &out) const;
+
    // @todo
 //   /// Retrieve the Swift name for the given Foundation entity, where
 //    /// "NS" prefix stripping will apply under omit-needless-words.
@@ -0,0 +1,85 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#ifndef POLARPHP_AST_CONCURRENT_IDENTIFIER_TABLE_H
+#define POLARPHP_AST_CONCURRENT_IDENTIFIER_TABLE_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace polar {
+
+/// The uniqued strings of the identifiers of an \c AstContext, which any
+/// number of threads may intern into at the same time without a lock.
+///
+/// The table is an open addressed hash table of atomic pointers, an insert
+/// claims an empty slot with a compare and swap. A table which is three
+/// quarters full is moved into one twice its size, every thread which runs
+/// into the move helps to finish it before it goes on in the new table, so
+/// a string is in one slot only and interning it returns the same pointer
+/// on every thread. The tables which were moved from are freed with the
+/// table only.
+///
+/// The strings are allocated by a bump allocator of the interning thread,
+/// they are null terminated, aligned to 4 bytes and live as long as the
+/// table.
+class ConcurrentIdentifierTable
+{
+public:
+   ConcurrentIdentifierTable();
+   ~ConcurrentIdentifierTable();
+
+   ConcurrentIdentifierTable(const ConcurrentIdentifierTable &) = delete;
+   ConcurrentIdentifierTable &operator=(const ConcurrentIdentifierTable &) = delete;
+
+   /// Returns the uniqued copy of \p str.
+   const char *intern(llvm::StringRef str);
+
+   /// The number of uniqued strings.
+   size_t size() const
+   {
+      return m_numEntries.load(std::memory_order_relaxed);
+   }
+
+   /// The memory of the slots and the strings, not to be called while
+   /// another thread interns.
+   size_t getMemorySize() const;
+
+private:
+   struct Table;
+   struct ThreadArena;
+
+   /// Looks \p str up in \p table and puts \p entry, allocated first if it
+   /// is null, into the first empty slot if it is not there. Returns null if
+   /// \p table is moved into another one.
+   const char *findOrInsert(Table &table, llvm::StringRef str, std::uint32_t hash,
+                            const char *&entry);
+
+   /// Moves \p table into its successor unless that is done already and
+   /// returns the successor.
+   Table *moveTable(Table &table);
+
+   ThreadArena &getThreadArena();
+
+private:
+   /// the table inserts go to, the tables moved from are linked from it
+   std::atomic<Table *> m_current;
+   std::atomic<ThreadArena *> m_arenas{nullptr};
+   std::atomic<size_t> m_numEntries{0};
+   /// tells apart tables of the thread local arena cache, never reused
+   std::uint64_t m_tableId;
+};
+
+} // polar
+
+#endif // POLARPHP_AST_CONCURRENT_IDENTIFIER_TABLE_H
@@ -637,6 +637,9 @@ private:
    /// been emitted due to an open transaction.
    SmallVector<Diagnostic, 4> TentativeDiagnostics;
 
+   /// The number of diagnostics flushed so far.
+   unsigned NumFlushedDiagnostics = 0;
+
    /// The set of declarations for which we have pretty-printed
    /// results that we can point to on the command line.
    llvm::DenseMap<const Decl *, SourceLoc> PrettyPrintedDeclarations;
@@ -678,6 +681,10 @@ public:
    /// hadAnyError - return true if any *error* diagnostics have been emitted.
    bool hadAnyError() const { return state.hadAnyError(); }
 
+   /// The number of diagnostics flushed so far, including the ones an open
+   /// transaction may still drop.
+   unsigned getNumFlushedDiagnostics() const { return NumFlushedDiagnostics; }
+
    bool hasFatalErrorOccurred() const {
       return state.hasFatalErrorOccurred();
    }
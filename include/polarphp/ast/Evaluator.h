@@ -19,6 +19,7 @@
 #define POLARPHP_AST_EVALUATOR_H
 
 #include "polarphp/ast/AnyRequest.h"
+#include "polarphp/ast/PersistentRequestCache.h"
 #include "polarphp/basic/AnyValue.h"
 #include "polarphp/basic/Debug.h"
 #include "polarphp/basic/Defer.h"
@@ -30,6 +31,8 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/PrettyStackTrace.h"
+#include <memory>
+#include <mutex>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -54,6 +57,18 @@ class DiagnosticEngine;
 class Evaluator;
 
 
+/// How the evaluator records the dependencies between requests. Only the
+/// dependency dumps and the GraphViz output read them.
+enum class DependencyRecording : uint8_t {
+   /// Record no dependencies at all.
+   None,
+   /// Intern the requests and store the dependencies of each one as a range
+   /// of request IDs in one array.
+   Compact,
+   /// Store a vector of the requests each request depends on.
+   Full,
+};
+
 /// An "abstract" request function pointer, which is the storage type
 /// used for each of the
 using AbstractRequestFunction = void(void);
@@ -125,6 +140,23 @@ template<typename Request>
 void reportEvaluatedRequest(UnifiedStatsReporter &stats,
                             const Request &request) { }
 
+/// Whether the results of a request are kept across frontend invocations
+/// by a \c PersistentRequestCache, see PersistentRequestsDef.h. Such a
+/// request provides
+///
+///   const Decl *getPersistentDecl() const;
+///
+/// which returns the declaration whose file determines the result, or null
+/// if the result of this instance must not be kept.
+template<typename Request>
+struct IsPersistentRequest : std::false_type { };
+
+/// Report a lookup of a request in the persistent request cache, so its hit
+/// rate can be recorded by the stats reporter.
+template<typename Request>
+void reportPersistentCacheLookup(UnifiedStatsReporter &stats,
+                                 const Request &request, bool hit) { }
+
 /// Evaluation engine that evaluates and caches "requests", checking for cyclic
 /// dependencies along the way.
 ///
@@ -198,6 +230,10 @@ class Evaluator {
    /// non-null.
    UnifiedStatsReporter *stats = nullptr;
 
+   /// The results of requests kept across frontend invocations, if
+   /// non-null.
+   PersistentRequestCache *persistentCache = nullptr;
+
    /// A vector containing the abstract request functions that can compute
    /// the result of a particular request within a given zone. The
    /// \c uint8_t is the zone number of the request, and the array is
@@ -211,7 +247,8 @@ class Evaluator {
       requestFunctionsByZone;
 
    /// A vector containing all of the active evaluation requests, which
-   /// is treated as a stack and is used to detect cycles.
+   /// is treated as a stack and is used to detect cycles. In concurrent mode
+   /// every thread has its own stack, see \c getActiveRequests().
    llvm::SetVector<AnyRequest> activeRequests;
 
    /// A cache that stores the results of requests.
@@ -228,6 +265,88 @@ class Evaluator {
    /// so all clients must cope with cycles.
    llvm::DenseMap<AnyRequest, std::vector<AnyRequest>> dependencies;
 
+   /// How the dependencies are recorded, see \c setDependencyRecording().
+#ifdef NDEBUG
+   DependencyRecording recording = DependencyRecording::None;
+#else
+   DependencyRecording recording = DependencyRecording::Compact;
+#endif
+
+   /// The IDs of the requests interned for the compact dependency graph.
+   llvm::DenseMap<AnyRequest, unsigned> compactRequestIDs;
+
+   /// The interned requests, indexed by ID.
+   std::vector<AnyRequest> compactRequests;
+
+   /// The compact dependency graph, a compressed sparse row array. The
+   /// dependencies of the request with ID \c i are the
+   /// \c compactEdgeRanges[i].second IDs of \c compactEdges starting at
+   /// \c compactEdgeRanges[i].first. A row is appended when its request
+   /// finishes, so the rows are not sorted by ID.
+   std::vector<std::pair<unsigned, unsigned>> compactEdgeRanges;
+   std::vector<unsigned> compactEdges;
+
+   /// The dependencies of the active requests, which are moved to
+   /// \c compactEdges once the evaluation of their request ends.
+   std::vector<unsigned> pendingEdges;
+
+   /// The ID and the first pending edge of each active request.
+   std::vector<std::pair<unsigned, unsigned>> compactFrames;
+
+   /// The cache and the dependencies of the requests with the same shard
+   /// index in concurrent mode, where \c cache and \c dependencies stay
+   /// empty.
+   struct ConcurrentShard {
+      std::mutex mutex;
+      llvm::DenseMap<AnyRequest, AnyValue> cache;
+      llvm::DenseMap<AnyRequest, std::vector<AnyRequest>> dependencies;
+   };
+
+   /// The shards in concurrent mode, null otherwise.
+   std::unique_ptr<ConcurrentShard[]> shards;
+   unsigned numShards = 0;
+
+   /// Serializes the cycle diagnostics in concurrent mode.
+   std::mutex diagsMutex;
+
+   template<typename Request>
+   ConcurrentShard &getShard(const Request &request) const {
+      unsigned hash = llvm::DenseMapInfo<AnyRequest>::getHashValue(request);
+      return shards[hash % numShards];
+   }
+
+   /// The active requests of this evaluator on the current thread.
+   llvm::SetVector<AnyRequest> &getThreadActiveRequests() const;
+
+   llvm::SetVector<AnyRequest> &getActiveRequests() {
+      return shards ? getThreadActiveRequests() : activeRequests;
+   }
+
+   const llvm::SetVector<AnyRequest> &getActiveRequests() const {
+      return shards ? getThreadActiveRequests() : activeRequests;
+   }
+
+   /// The cached value of \p request as a string, for printing.
+   Optional<std::string> getCachedValueAsString(const AnyRequest &request) const;
+
+   /// The dependencies of \p request, \c None if it was not evaluated.
+   Optional<std::vector<AnyRequest>>
+   getDependencies(const AnyRequest &request) const;
+
+   /// The IDs of the requests the request with ID \p requestID depends on
+   /// in the compact dependency graph.
+   ArrayRef<unsigned> getCompactDependencies(unsigned requestID) const;
+
+   /// Add \p request to the compact dependency graph.
+   const AnyRequest &internRequest(AnyRequest &&request);
+
+   /// Move the pending dependencies of the request on top of the active
+   /// requests to the compact dependency graph.
+   void commitCompactDependencies();
+
+   /// Remove the request on top of the active requests.
+   void popActiveRequest();
+
    /// Retrieve the request function for the given zone and request IDs.
    AbstractRequestFunction *getAbstractRequestFunction(uint8_t zoneID,
                                                        uint8_t requestID) const;
@@ -253,6 +372,43 @@ public:
    /// statistics will be recorded.
    void setStatsReporter(UnifiedStatsReporter *stats) { this->stats = stats; }
 
+   /// Set the cache through which the results of the requests listed in
+   /// PersistentRequestsDef.h are reused across frontend invocations. Only
+   /// a serial evaluator uses it.
+   void setPersistentCache(PersistentRequestCache *cache) {
+      persistentCache = cache;
+   }
+
+   /// Let several threads evaluate requests at the same time, e.g. the
+   /// requests of independent primary files driven from a thread pool.
+   ///
+   /// The cache and the dependency graph are split into \p numShards shards
+   /// with a lock each, and every thread detects cycles on its own stack of
+   /// active requests. A request evaluated by two threads at once is
+   /// computed twice and the first result is kept. Request functions and
+   /// external caches must be safe to call from several threads, cycle
+   /// diagnostics are serialized. The stats reporter is not used in this
+   /// mode.
+   ///
+   /// Must be called before the first request is evaluated.
+   void enableConcurrentEvaluation(unsigned numShards = 64);
+
+   bool isConcurrent() const { return shards != nullptr; }
+
+   /// Choose how the dependencies between requests are recorded. Builds
+   /// with assertions default to \c Compact and others to \c None, which
+   /// leaves the dependency dumps and the GraphViz output empty. Concurrent
+   /// evaluation records \c Compact dependencies as \c Full ones.
+   ///
+   /// Must be called before the first request is evaluated.
+   void setDependencyRecording(DependencyRecording recording);
+
+   DependencyRecording getDependencyRecording() const { return recording; }
+
+   /// The memory used by the recorded dependencies, not counting the
+   /// requests themselves.
+   size_t getDependencyGraphMemorySize() const;
+
    /// Register the set of request functions for the given zone.
    ///
    /// These functions will be called to evaluate any requests within that
@@ -265,8 +421,12 @@ public:
    template<typename Request>
    llvm::Expected<typename Request::OutputType>
    operator()(const Request &request) {
-      // Check for a cycle.
-      if (checkDependency(getCanonicalRequest(request))) {
+      // Check for a cycle. Concurrent evaluation has no canonical requests,
+      // they live in the dependency map which other threads change.
+      bool isCycle = shards || recording == DependencyRecording::None
+                        ? checkDependency(AnyRequest(request))
+                        : checkDependency(getCanonicalRequest(request));
+      if (isCycle) {
          return llvm::Error(
             std::make_unique<CyclicalRequestError<Request>>(request, *this));
       }
@@ -274,8 +434,8 @@ public:
       // Make sure we remove this from the set of active requests once we're
       // done.
       POLAR_DEFER {
-                     assert(activeRequests.back().castTo<Request>() == request);
-                     activeRequests.pop_back();
+                     assert(getActiveRequests().back().castTo<Request>() == request);
+                     popActiveRequest();
                   };
 
       // Get the result.
@@ -308,24 +468,42 @@ public:
       typename std::enable_if<!Request::hasExternalCache>::type* = nullptr>
    void cacheOutput(const Request &request,
                     typename Request::OutputType &&output) {
-      cache.insert({getCanonicalRequest(request), std::move(output)});
+      if (shards) {
+         ConcurrentShard &shard = getShard(request);
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         shard.cache.insert({AnyRequest(request), std::move(output)});
+         return;
+      }
+      if (recording == DependencyRecording::None)
+         cache.insert({AnyRequest(request), std::move(output)});
+      else
+         cache.insert({getCanonicalRequest(request), std::move(output)});
    }
 
    /// Clear the cache stored within this evaluator.
    ///
    /// Note that this does not clear the caches of requests that use external
    /// caching.
-   void clearCache() { cache.clear(); }
+   void clearCache();
 
    /// Is the given request, or an equivalent, currently being evaluated?
+   ///
+   /// In concurrent mode only the requests of the current thread count.
    template <typename Request>
    bool hasActiveRequest(const Request &request) const {
-      return activeRequests.count(AnyRequest(request));
+      return getActiveRequests().count(AnyRequest(request));
    }
 
 private:
    template <typename Request>
    const AnyRequest &getCanonicalRequest(const Request &request) {
+      if (recording == DependencyRecording::Compact) {
+         auto known = compactRequestIDs.find_as(request);
+         if (known != compactRequestIDs.end())
+            return known->first;
+         return internRequest(AnyRequest(request));
+      }
+
       // FIXME: DenseMap ought to let us do this with one hash lookup.
       auto iter = dependencies.find_as(request);
       if (iter != dependencies.end())
@@ -347,6 +525,50 @@ private:
    /// request to the \c activeRequests stack.
    bool checkDependency(const AnyRequest &request);
 
+   /// The number of diagnostics flushed by the diagnostics engine.
+   unsigned getNumFlushedDiagnostics() const;
+
+   /// Produce the result of a request whose results are not kept across
+   /// frontend invocations.
+   template<typename Request,
+      typename std::enable_if<!IsPersistentRequest<Request>::value>::type * = nullptr>
+   llvm::Expected<typename Request::OutputType>
+   getResultPersistentlyCached(const Request &request) {
+      return getResultUncached(request);
+   }
+
+   /// Get the result of a request from an earlier frontend invocation, or
+   /// produce it and keep it for later ones.
+   template<typename Request,
+      typename std::enable_if<IsPersistentRequest<Request>::value>::type * = nullptr>
+   llvm::Expected<typename Request::OutputType>
+   getResultPersistentlyCached(const Request &request) {
+      using OutputType = typename Request::OutputType;
+      static_assert(std::is_integral<OutputType>::value ||
+                    std::is_enum<OutputType>::value,
+                    "persistent requests produce integers, booleans or enums");
+      Optional<PersistentRequestKey> key;
+      if (persistentCache && !shards)
+         key = persistentCache->getKey(TypeId<Request>::getName(),
+                                       request.getPersistentDecl());
+      if (!key)
+         return getResultUncached(request);
+
+      if (auto value = persistentCache->lookUp(*key)) {
+         if (stats) reportPersistentCacheLookup(*stats, request, /*hit=*/true);
+         return static_cast<OutputType>(*value);
+      }
+      if (stats) reportPersistentCacheLookup(*stats, request, /*hit=*/false);
+
+      // A result which came with diagnostics is not kept, they would be
+      // missing when it is reused.
+      unsigned numDiagnostics = getNumFlushedDiagnostics();
+      auto result = getResultUncached(request);
+      if (result && getNumFlushedDiagnostics() == numDiagnostics)
+         persistentCache->insert(*key, static_cast<uint64_t>(*result));
+      return result;
+   }
+
    /// Retrieve the result produced by evaluating a request that can
    /// be cached.
    template<typename Request,
@@ -376,16 +598,33 @@ private:
    llvm::Expected<typename Request::OutputType>
    getResultUncached(const Request &request) {
       // Clear out the dependencies on this request; we're going to recompute
-      // them now anyway.
-      dependencies.find_as(request)->second.clear();
+      // them now anyway. Compact dependencies are replaced once the request
+      // is evaluated.
+      if (recording == DependencyRecording::Full) {
+         if (shards) {
+            ConcurrentShard &shard = getShard(request);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto known = shard.dependencies.find_as(request);
+            if (known != shard.dependencies.end())
+               known->second.clear();
+            else
+               shard.dependencies.insert({AnyRequest(request), {}});
+         } else {
+            dependencies.find_as(request)->second.clear();
+         }
+      }
 
       PrettyStackTraceRequest<Request> prettyStackTrace(request);
 
-      // Trace and/or count statistics.
+      // Trace and/or count statistics, the reporter is not thread safe.
+      UnifiedStatsReporter *stats = shards ? nullptr : this->stats;
       FrontendStatsTracer statsTracer = make_tracer(stats, request);
       if (stats) reportEvaluatedRequest(*stats, request);
 
-      return getRequestFunction<Request>()(request, *this);
+      auto result = getRequestFunction<Request>()(request, *this);
+      if (recording == DependencyRecording::Compact)
+         commitCompactDependencies();
+      return result;
    }
 
    /// Get the result of a request, consulting an external cache
@@ -400,7 +639,7 @@ private:
          return *cached;
 
       // Compute the result.
-      auto result = getResultUncached(request);
+      auto result = getResultPersistentlyCached(request);
 
       // Cache the result if applicable.
       if (!result)
@@ -419,6 +658,9 @@ private:
       typename std::enable_if<!Request::hasExternalCache>::type * = nullptr>
    llvm::Expected<typename Request::OutputType>
    getResultCached(const Request &request) {
+      if (shards)
+         return getResultCachedConcurrently(request);
+
       // If we already have an entry for this request in the cache, return it.
       auto known = cache.find_as(request);
       if (known != cache.end()) {
@@ -426,12 +668,44 @@ private:
       }
 
       // Compute the result.
-      auto result = getResultUncached(request);
+      auto result = getResultPersistentlyCached(request);
       if (!result)
          return result;
 
       // Cache the result.
-      cache.insert({getCanonicalRequest(request), *result});
+      if (recording == DependencyRecording::None)
+         cache.insert({AnyRequest(request), *result});
+      else
+         cache.insert({getCanonicalRequest(request), *result});
+      return result;
+   }
+
+   /// Get the result of a request, consulting the shard of the request to
+   /// retrieve previously-computed results. The shard is not locked while
+   /// the request is evaluated.
+   template<typename Request>
+   llvm::Expected<typename Request::OutputType>
+   getResultCachedConcurrently(const Request &request) {
+      using OutputType = typename Request::OutputType;
+      ConcurrentShard &shard = getShard(request);
+      {
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         auto known = shard.cache.find_as(request);
+         if (known != shard.cache.end())
+            return known->second.template castTo<OutputType>();
+      }
+
+      // Compute the result.
+      auto result = getResultPersistentlyCached(request);
+      if (!result)
+         return result;
+
+      // Cache the result, unless another thread was faster. Then return
+      // its result, so all threads see the same one.
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto inserted = shard.cache.insert({AnyRequest(request), *result});
+      if (!inserted.second)
+         return inserted.first->second.template castTo<OutputType>();
       return result;
    }
 
@@ -0,0 +1,116 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#ifndef POLARPHP_AST_PERSISTENT_REQUEST_CACHE_H
+#define POLARPHP_AST_PERSISTENT_REQUEST_CACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+namespace polar {
+
+class Decl;
+class LangOptions;
+class SourceManager;
+
+/// Where the result of a request on one declaration is kept, see
+/// \c PersistentRequestCache::getKey().
+struct PersistentRequestKey
+{
+   /// the results of the request for the file of the declaration
+   llvm::DenseMap<std::uint64_t, std::uint64_t> *results;
+   /// the offset of the declaration in its file and its kind
+   std::uint64_t declId;
+};
+
+/// Results of requests on declarations which survive the frontend
+/// invocation, so an incremental build does not compute them again for the
+/// files which did not change.
+///
+/// A result is keyed by the name of the request, the file of the
+/// declaration, the xxHash64 and the length of that file and the offset
+/// and kind of the declaration. Only requests listed in
+/// PersistentRequestsDef.h are kept, their results depend on nothing but
+/// the file of their declaration and are integers, booleans or enums.
+///
+/// The results of all files live in one file written atomically by
+/// \c save(). A file of another compiler, format version or language
+/// version is ignored by \c load(), like a damaged one, and the results of
+/// a file whose contents changed are dropped on the first lookup into it.
+/// The cache is not thread safe.
+class PersistentRequestCache
+{
+public:
+   PersistentRequestCache(SourceManager &sourceMgr, const LangOptions &langOpts);
+
+   /// Read the results saved to \p path by an earlier invocation, returns
+   /// false if there were none or they were not usable.
+   bool load(llvm::StringRef path);
+
+   /// Write all results to \p path, including the ones of files this
+   /// invocation did not look at, except files which no longer exist.
+   std::error_code save(llvm::StringRef path) const;
+
+   /// The key of the result of the request named \p requestName on
+   /// \p decl, \c None if the result of \p decl can not be kept, e.g. for
+   /// implicit declarations or declarations outside of source files.
+   llvm::Optional<PersistentRequestKey> getKey(llvm::StringRef requestName, const Decl *decl);
+
+   /// The key of the result of the request named \p requestName on the
+   /// declaration \p declId of the file of buffer \p bufferId. The results
+   /// of the file are dropped if its contents changed since they were saved.
+   PersistentRequestKey getKey(llvm::StringRef requestName, unsigned bufferId,
+                               std::uint64_t declId);
+
+   llvm::Optional<std::uint64_t> lookUp(const PersistentRequestKey &key) const
+   {
+      auto iter = key.results->find(key.declId);
+      if (iter == key.results->end()) {
+         return llvm::None;
+      }
+      return iter->second;
+   }
+
+   void insert(const PersistentRequestKey &key, std::uint64_t value)
+   {
+      (*key.results)[key.declId] = value;
+   }
+
+   size_t getNumResults() const;
+
+private:
+   struct FileResults
+   {
+      std::uint64_t contentHash = 0;
+      std::uint64_t contentSize = 0;
+      /// the results by request name, then by declaration
+      llvm::StringMap<llvm::DenseMap<std::uint64_t, std::uint64_t>> requests;
+   };
+
+   FileResults &getFileResults(unsigned bufferId);
+
+private:
+   SourceManager &m_sourceMgr;
+   std::uint64_t m_fingerprint;
+   llvm::StringMap<FileResults> m_files;
+   /// the files validated against the contents of their buffer
+   llvm::DenseMap<unsigned, FileResults *> m_filesByBuffer;
+};
+
+} // polar
+
+#endif // POLARPHP_AST_PERSISTENT_REQUEST_CACHE_H
@@ -0,0 +1,22 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+//===----------------------------------------------------------------------===//
+//
+//  This definition file lists the requests whose results the
+//  PersistentRequestCache keeps across frontend invocations. The result of
+//  such a request is an integer, a boolean or an enum, and it only depends
+//  on the source file of the declaration its getPersistentDecl() returns.
+//
+//===----------------------------------------------------------------------===//
+
+POLAR_PERSISTENT_REQUEST(IsFinalRequest)
+POLAR_PERSISTENT_REQUEST(IsStaticRequest)
+POLAR_PERSISTENT_REQUEST(SelfAccessKindRequest)
@@ -300,6 +300,9 @@ public:
   bool isCached() const { return true; }
   Optional<bool> getCachedResult() const;
   void cacheResult(bool value) const;
+
+  // Persistent caching.
+  const Decl *getPersistentDecl() const;
 };
 
 /// Determine whether the given declaration is 'dynamic''.
@@ -741,6 +744,9 @@ public:
   bool isCached() const { return true; }
   Optional<SelfAccessKind> getCachedResult() const;
   void cacheResult(SelfAccessKind value) const;
+
+  // Persistent caching.
+  const Decl *getPersistentDecl() const;
 };
 
 /// Request whether the storage has a mutating getter.
@@ -1319,6 +1325,9 @@ public:
   bool isCached() const { return true; }
   Optional<bool> getCachedResult() const;
   void cacheResult(bool value) const;
+
+  // Persistent caching.
+  const Decl *getPersistentDecl() const;
 };
 
 /// Determines if a method override should introduce a new vtable entry,
@@ -2012,6 +2021,22 @@ void simple_display(llvm::raw_ostream &out, FunctionBuilderClosurePreCheck pck);
 #include "polarphp/ast/TypeCheckerTypeIDZoneDef.h"
 #undef POLAR_REQUEST
 
+// Set up the requests whose results are kept across frontend invocations.
+#define POLAR_PERSISTENT_REQUEST(RequestType)                                  \
+  template<>                                                                   \
+  struct IsPersistentRequest<RequestType> : std::true_type { };                \
+  template<>                                                                   \
+  inline void reportPersistentCacheLookup(UnifiedStatsReporter &stats,         \
+                                          const RequestType &request,          \
+                                          bool hit) {                          \
+    if (hit)                                                                   \
+      ++stats.getFrontendCounters().RequestType##PersistentCacheHit;           \
+    else                                                                       \
+      ++stats.getFrontendCounters().RequestType##PersistentCacheMiss;          \
+  }
+#include "polarphp/ast/PersistentRequestsDef.h"
+#undef POLAR_PERSISTENT_REQUEST
+
 } // end namespace polar
 
 #endif // POLARPHP_TYPE_CHECK_REQUESTS_H
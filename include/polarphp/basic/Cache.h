@@ -98,6 +98,19 @@ struct CacheValueInfo : public CacheValueCostInfo<T>
    }
 };
 
+/// Counters of a cache since its creation, the backends which can not
+/// count leave them at zero.
+struct CacheStatistics
+{
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   /// entries dropped to stay within the cost limit
+   uint64_t evictions = 0;
+   size_t entries = 0;
+   /// the sum of the costs of the entries
+   size_t totalCost = 0;
+};
+
 /// The underlying implementation of the caching mechanism.
 /// It should be inherently thread-safe.
 class CacheImpl
@@ -176,6 +189,13 @@ protected:
 
    /// Destroys cache.
    void destroy();
+
+   /// Sets the sum of the costs of the entries above which the least
+   /// recently used entries are evicted. Backends which evict under memory
+   /// pressure instead ignore it.
+   void setCostLimit(size_t limit);
+
+   CacheStatistics getStatistics() const;
 };
 
 /// Caching mechanism, that is thread-safe and can evict its entries when there
@@ -245,6 +265,9 @@ public:
       removeAll();
    }
 
+   using CacheImpl::setCostLimit;
+   using CacheImpl::getStatistics;
+
 private:
    static uintptr_t keyHash(void *key, void *userData)
    {
@@ -30,10 +30,13 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/VirtualFileSystem.h"
 #include "llvm/Support/SourceMgr.h"
 #include "polarphp/basic/SourceLoc.h"
+#include <list>
+#include <vector>
 #include <map>
 
 namespace llvm {
@@ -79,6 +82,35 @@ class SourceManager
    std::map<const char *, VirtualFile> VirtualFiles;
    mutable std::pair<const char *, const VirtualFile*> CachedVFile = {nullptr, nullptr};
 
+   /// A file added by \c addMappedSourceFile(). The address range of the
+   /// buffer stays reserved while the file is not resident.
+   struct MappedFile {
+      size_t ReservedSize;
+      bool Resident;
+      /// Position in \c ResidentMappedFiles while resident.
+      std::list<unsigned>::iterator ResidentPos;
+   };
+   mutable llvm::DenseMap<unsigned, MappedFile> MappedFiles;
+   /// The resident mapped files, the most recently used one first.
+   mutable std::list<unsigned> ResidentMappedFiles;
+   unsigned MaxResidentMappedFiles = 64;
+
+   /// The address range of a buffer, the end includes the null terminator.
+   struct BufferRange {
+      const char *Start;
+      const char *End;
+      unsigned ID;
+   };
+   /// The ranges of the buffers sorted by start and end address. Of buffers
+   /// with the same range only the last added one is kept, so alias buffers
+   /// win like in a back-to-front scan.
+   mutable std::vector<BufferRange> SortedBufferRanges;
+   mutable unsigned NumIndexedBuffers = 0;
+   /// Set when a buffer overlaps another one without having the same range,
+   /// then lookups scan every buffer.
+   mutable bool HasOverlappingBuffers = false;
+
+   void indexNewBuffers() const;
    Optional<unsigned> findBufferContainingLocInternal(SourceLoc Loc) const;
 public:
    SourceManager(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS =
@@ -154,6 +186,28 @@ public:
    /// Adds a memory buffer to the SourceManager, taking ownership of it.
    unsigned addNewSourceBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer);
 
+   /// Maps the file at \p Path read-only and adds it as a source buffer.
+   ///
+   /// At most \c getMaxResidentMappedFiles() mapped files are resident, the
+   /// least recently used one is unmapped when another one is needed. Its
+   /// address range stays reserved, so \c SourceLoc s into it stay valid and
+   /// the file is mapped again at the same address as soon as the source
+   /// manager reads from it. Text taken out of a mapped buffer stays readable
+   /// until that many other mapped buffers have been read. The file must not
+   /// change while the source manager lives.
+   llvm::ErrorOr<unsigned> addMappedSourceFile(StringRef Path);
+
+   /// Sets the number of mapped files kept resident, at least one.
+   void setMaxResidentMappedFiles(unsigned Max);
+
+   unsigned getMaxResidentMappedFiles() const {
+      return MaxResidentMappedFiles;
+   }
+
+   unsigned getNumResidentMappedFiles() const {
+      return ResidentMappedFiles.size();
+   }
+
    /// Add a \c #sourceLocation-defined virtual file region.
    ///
    /// By default, this region continues to the end of the buffer.
@@ -235,6 +289,7 @@ public:
    std::pair<unsigned, unsigned>
    getLineAndColumn(SourceLoc Loc, unsigned BufferID = 0) const {
       assert(Loc.isValid());
+      touchBuffer(Loc, BufferID);
       int LineOffset = getLineOffset(Loc);
       int l, c;
       std::tie(l, c) = LLVMSourceMgr.getLineAndColumn(Loc.m_value, BufferID);
@@ -249,6 +304,7 @@ public:
    /// This does not respect \c #sourceLocation directives.
    unsigned getLineNumber(SourceLoc Loc, unsigned BufferID = 0) const {
       assert(Loc.isValid());
+      touchBuffer(Loc, BufferID);
       return LLVMSourceMgr.FindLineNumber(Loc.m_value, BufferID);
    }
 
@@ -282,6 +338,22 @@ public:
 
    SourceLoc getLocFromExternalSource(StringRef Path, unsigned Line, unsigned Col);
 private:
+   /// Makes a mapped file resident again if needed and marks it as the most
+   /// recently used one, a no-op for the other buffers.
+   void touchBuffer(unsigned BufferID) const;
+
+   /// Same as above for the buffer containing \p Loc, which is
+   /// \p BufferID unless that is 0.
+   void touchBuffer(SourceLoc Loc, unsigned BufferID) const {
+      if (MappedFiles.empty())
+         return;
+      touchBuffer(BufferID ? BufferID : findBufferContainingLoc(Loc));
+   }
+
+   /// Unmaps the least recently used mapped files until at most \p Max are
+   /// resident.
+   void evictMappedFiles(unsigned Max) const;
+
    const VirtualFile *getVirtualFile(SourceLoc Loc) const;
    unsigned getExternalSourceBufferId(StringRef Path);
    int getLineOffset(SourceLoc Loc) const {
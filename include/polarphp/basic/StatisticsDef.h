@@ -111,6 +111,15 @@ FRONTEND_STATISTIC(AST, NumTotalClangImportedEntities)
 /// Number of bytes allocated in the AST's local arenas.
 FRONTEND_STATISTIC(AST, NumAstBytesAllocated)
 
+/// Number of bytes allocated in the AST's constraint solver arenas.
+FRONTEND_STATISTIC(AST, NumConstraintSolverBytesAllocated)
+
+/// Number of constraint solver arenas released.
+FRONTEND_STATISTIC(AST, NumConstraintSolverArenas)
+
+/// Largest number of bytes one constraint solver arena grew to.
+FRONTEND_STATISTIC(AST, MaxConstraintSolverArenaBytes)
+
 /// Number of file-level dependencies of this frontend job, as tracked in the
 /// AST context's dependency collector.
 FRONTEND_STATISTIC(AST, NumDependencies)
@@ -281,6 +290,14 @@ FRONTEND_STATISTIC(Sema, NumUnloadedLazyIterableDeclContexts)
 #include "polarphp/ide/IDERequestIDZoneDef.h"
 #undef POLAR_REQUEST
 
+/// Lookups of the persistent request cache which found a result of an
+/// earlier frontend invocation, and the ones which did not.
+#define POLAR_PERSISTENT_REQUEST(NAME)                  \
+   FRONTEND_STATISTIC(Sema, NAME##PersistentCacheHit)   \
+   FRONTEND_STATISTIC(Sema, NAME##PersistentCacheMiss)
+#include "polarphp/ast/PersistentRequestsDef.h"
+#undef POLAR_PERSISTENT_REQUEST
+
 /// The next 10 statistics count 5 kinds of PIL entities present
 /// after the PILGen and PILOpt phases. The entities are functions,
 /// vtables, witness tables, default witness tables and global
@@ -105,6 +105,11 @@ protected:
 
       const char *computeFrontendModeForCompile() const;
 
+      /// The directory of the output file map of an incremental build, in
+      /// which the frontend keeps the results of requests for the next build,
+      /// or null if the build is not incremental.
+      const char *computeRequestCacheDir() const;
+
       void addFrontendInputAndOutputArguments(
          llvm::opt::ArgStringList &Arguments,
          std::vector<FilelistInfo> &FilelistInfos) const;
@@ -75,6 +75,12 @@ public:
    /// binary module has already been built for use by the compiler.
    std::string PrebuiltModuleCachePath;
 
+   /// The directory in which the results of the requests listed in
+   /// PersistentRequestsDef.h are kept for later invocations, if not empty.
+   /// The driver passes the directory of the output file map of an
+   /// incremental build.
+   std::string RequestCacheDir;
+
    /// For these modules, we should prefer using Swift interface when importing them.
    std::vector<std::string> PreferInterfaceForModules;
 
@@ -226,6 +232,14 @@ public:
    /// termination.
    bool PrintClangStats = false;
 
+   /// Indicates whether the bytes allocated in the AST arenas should be
+   /// printed upon termination.
+   bool PrintArenaStats = false;
+
+   /// Indicates whether the AST arena statistics should include the
+   /// constraint solver arena size of every solved expression.
+   bool PrintArenaStatsPerExpr = false;
+
    /// Indicates whether the playground transformation should be applied.
    bool PlaygroundTransform = false;
 
@@ -29,10 +29,9 @@
 namespace polar::parser {
 
 namespace internal {
-bool strip_multiline_string_indentation(Lexer &lexer, std::string &str, int indentation, bool usingSpaces,
+bool check_multiline_string_indentation(Lexer &lexer, StringRef str, int indentation, bool usingSpaces,
                                         bool newlineAtStart, bool newlineAtEnd);
-bool convert_double_quote_str_escape_sequences(std::string &filteredStr, char quoteType, const char *iter,
-                                               const char *endMark, Lexer &lexer);
+bool check_double_quote_str_escape_sequences(Lexer &lexer, StringRef str);
 }
 
 using polar::Diagnostic;
@@ -117,11 +116,39 @@ public:
       lexImpl();
    }
 
+   /// The byte offset of the lexing position from the start of the buffer,
+   /// the next token including its leading trivia starts here.
+   size_t getCurrentOffset() const
+   {
+      return m_yyCursor - m_bufferStart;
+   }
+
+   /// Move the lexing position \p length bytes forward without producing any
+   /// token, the parser uses it to step over a statement it reuses from a
+   /// previous syntax tree.
+   void skipBytes(size_t length)
+   {
+      assert(m_yyCursor + length <= m_artificialEof && "skip past the end of the buffer");
+      m_yyCursor += length;
+   }
+
+   /// Create a lexer in its initial state that scans the same range of the
+   /// buffer as this one.
+   std::unique_ptr<Lexer> makeRestartedLexer() const;
+
    bool isKeepingComments() const
    {
       return m_commentRetention == CommentRetentionMode::ReturnAsTokens;
    }
 
+   /// Neither trivia nor comments are kept, whitespace and comments between
+   /// tokens are skipped by the block scanners instead of being classified.
+   bool isTriviaFree() const
+   {
+      return m_triviaRetention == TriviaRetentionMode::WithoutTrivia &&
+            m_commentRetention == CommentRetentionMode::None;
+   }
+
    static bool isIdentifier(StringRef name);
 
    const LexerFlags &getFlags() const
@@ -478,6 +505,10 @@ private:
    }
    void formIdentifierToken(const unsigned char *tokenStart);
 
+   /// Form the keyword token of the label in yytext or an identifier token
+   /// when it is no keyword, used by KeywordHashRules.l.
+   void formKeywordOrIdentifierToken();
+
    void formStringVariableToken()
    {
       formStringVariableToken(getYYText());
@@ -500,6 +531,7 @@ private:
    void skipSlashStarComment();
    void skipHashbang(bool eatNewline);
    void lexIdentifier();
+   void lexCastToken();
    void lexBinaryNumber();
    void lexHexNumber();
    void lexLongNumber();
@@ -512,6 +544,8 @@ private:
    void lexNowdocBody();
    void lexHereAndNowDocEnd();
    void lexTrivia(ParsedTrivia &trivia, bool isForTrailingTrivia);
+   /// Trivia free counterpart of lexTrivia(), only moves the cursor.
+   void skipTrivia();
    /// Returns it should be tokenize.
    bool lexUnknown(bool emitDiagnosticsIfToken);
    void lexEscapedIdentifier();
@@ -541,10 +575,9 @@ private:
 
 private:
    friend void internal::yy_token_lex(Lexer &lexer);
-   friend bool internal::strip_multiline_string_indentation(Lexer &lexer, std::string &str, int indentation, bool usingSpaces,
+   friend bool internal::check_multiline_string_indentation(Lexer &lexer, StringRef str, int indentation, bool usingSpaces,
                                                             bool newlineAtStart, bool newlineAtEnd);
-   friend bool internal::convert_double_quote_str_escape_sequences(std::string &filteredStr, char quoteType, std::string::iterator iter,
-                                                                   std::string::iterator endMark, Lexer &lexer);
+   friend bool internal::check_double_quote_str_escape_sequences(Lexer &lexer, StringRef str);
 private:
    LexerFlags m_flags;
    const LangOptions &m_langOpts;
@@ -557,6 +590,9 @@ private:
    /// scans a subrange of the buffer.
    const unsigned char *m_bufferStart;
 
+   /// The offset this lexer started scanning at.
+   unsigned m_initialOffset = 0;
+
    /// Pointer to one past the end character of the buffer, even in a lexer
    /// that scans a subrange of the buffer.  Because the buffer is always
    /// NUL-terminated, this points to the NUL terminator.
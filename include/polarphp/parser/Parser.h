@@ -15,24 +15,26 @@
 #include <list>
 #include <string>
 #include <memory>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "polarphp/parser/CommonDefs.h"
 #include "polarphp/parser/Token.h"
 #include "polarphp/parser/ParsedTrivia.h"
+#include "polarphp/syntax/SyntaxArena.h"
+#include "polarphp/syntax/SyntaxKind.h"
 
 namespace polar {
 class SourceManager;
+class LangOptions;
 }
 
 namespace polar::ast {
 class DiagnosticEngine;
 } // polar::ast
 
-namespace polar::kernel {
-class LangOptions;
-} // polar::kernel
-
 namespace polar::syntax {
 class Syntax;
 } // polar::syntax
@@ -48,14 +50,29 @@ int token_lex_wrapper(ParserSemantic *value, YYLocation *loc,
 
 using polar::StringRef;
 using polar::ast::DiagnosticEngine;
-using polar::kernel::LangOptions;
+using polar::LangOptions;
 using polar::syntax::Syntax;
+using polar::syntax::SyntaxArena;
+using polar::syntax::SyntaxKind;
+using llvm::SmallVector;
+using llvm::ArrayRef;
 using polar::SourceManager;
 
 class Lexer;
+class SyntaxParsingCache;
+struct StmtSourceRange;
+class PersistentParseCache;
 
 void parse_error(StringRef msg);
 
+/// A syntax error the grammar ran into, \c loc is the start of the token it
+/// did not expect.
+struct ParseError
+{
+   SourceLoc loc;
+   std::string message;
+};
+
 class Parser
 {
 public:
@@ -69,6 +86,90 @@ public:
       return sm_emptyTrivia;
    }
 
+   /// The arena every syntax node of this parse is allocated in, the tree
+   /// of a file is carved from one bump allocator and freed in one shot once
+   /// the last node referencing the arena goes away.
+   const RefCountPtr<SyntaxArena> &getArena() const
+   {
+      return m_arena;
+   }
+
+   /// Replace the arena the syntax nodes are allocated in, passing \c nullptr
+   /// allocates every node on the heap. Must be called before \c parse().
+   void setArena(RefCountPtr<SyntaxArena> arena)
+   {
+      assert(!m_inCompilation && "can not change arena while parsing");
+      m_arena = std::move(arena);
+   }
+
+   /// Parse incrementally: \p cache holds the syntax tree of the previous
+   /// parse and the edits made to the source since, statements at
+   /// \c TopStmt and \c InnerStmt boundaries that are not affected by the
+   /// edits are taken over from the old tree instead of being reparsed.
+   /// Must be called before \c parse().
+   void setSyntaxParsingCache(SyntaxParsingCache *cache)
+   {
+      assert(!m_inCompilation && "can not change syntax parsing cache while parsing");
+      m_syntaxParsingCache = cache;
+   }
+
+   SyntaxParsingCache *getSyntaxParsingCache() const
+   {
+      return m_syntaxParsingCache;
+   }
+
+   /// Record the source range of every statement appended to a statement
+   /// list, an incremental parse of the next version of the source looks
+   /// the statements up by them, see \c SyntaxParsingCache::setOldStmtRanges().
+   /// Must be called before \c parse().
+   void setRecordingStmtRanges(bool enabled)
+   {
+      assert(!m_inCompilation && "can not change statement range recording while parsing");
+      m_recordingStmtRanges = enabled;
+   }
+
+   /// The statement ranges of the last \c parse(), empty when its tree came
+   /// from the persistent parse cache.
+   std::vector<StmtSourceRange> getStmtRanges() const;
+
+   /// Look the source up in \p cache before parsing, on a hit the stored
+   /// tree is rehydrated and neither the lexer nor the grammar run. Trees of
+   /// successful parses are stored into \p cache. Ignored when a
+   /// \c SyntaxParsingCache is set. Must be called before \c parse().
+   void setPersistentParseCache(PersistentParseCache *cache)
+   {
+      assert(!m_inCompilation && "can not change persistent parse cache while parsing");
+      m_persistentParseCache = cache;
+   }
+
+   PersistentParseCache *getPersistentParseCache() const
+   {
+      return m_persistentParseCache;
+   }
+
+   /// Keep parsing after a syntax error: the tokens from the start of the
+   /// broken statement or class member up to the next ";" become an unknown
+   /// node of the tree, so \c parse() always yields a complete tree and the
+   /// errors are collected in \c getParseErrors(). Must be called before
+   /// \c parse().
+   void setErrorRecovery(bool enabled)
+   {
+      assert(!m_inCompilation && "can not change error recovery while parsing");
+      m_errorRecovery = enabled;
+   }
+
+   bool isErrorRecoveryEnabled() const
+   {
+      return m_errorRecovery;
+   }
+
+   /// The syntax errors of the last \c parse() in source order. Without
+   /// error recovery the parse stops at the first one.
+   ArrayRef<ParseError> getParseErrors() const
+   {
+      return m_parseErrors;
+   }
+
    bool parse();
    RefCountPtr<RawSyntax> getSyntaxTree();
 
@@ -85,6 +186,67 @@ protected:
 protected:
    void setParsedAst(RefCountPtr<RawSyntax> ast);
 
+   /// Whether statements of the previous syntax tree are currently offered
+   /// to the grammar, errors of such a parse are not reported because the
+   /// file is parsed again from scratch if it fails.
+   bool isReusingSyntax() const
+   {
+      return m_reuseSyntax;
+   }
+
+private:
+   /// Return the statement of the previous syntax tree which can be reused at
+   /// the current lexer position and step the lexer over it, \p kind is set
+   /// to \c TopStmt or \c InnerStmt. Return \c nullptr if nothing can be
+   /// reused here.
+   RefCountPtr<RawSyntax> consumeReusableStmt(SyntaxKind &kind);
+
+   /// Keep track of the brackets and statement terminators of the lexed
+   /// tokens, statements are only looked up in the parsing cache right after
+   /// a statement has ended.
+   void trackStmtBoundary(TokenKindType kind);
+
+   /// Throw away the lexer and grammar state and start again at the
+   /// beginning of the buffer.
+   void restartParse();
+
+   /// Give the token handed to the grammar its ordinal in \p loc, the
+   /// grammar delimits broken regions by token ordinals. In error recovery
+   /// mode \p token is also kept until it can no longer be part of a broken
+   /// region. \p token is \c nullptr for a reused statement.
+   void recordToken(const Token *token, internal::YYLocation &loc);
+
+   /// Keep the source range of the token \c recordToken() gave the last
+   /// ordinal to, the reused statement included.
+   void recordTokenRange(size_t start, size_t end)
+   {
+      if (m_recordingStmtRanges) {
+         m_tokenRanges.emplace_back(start, end);
+      }
+   }
+
+   /// Keep \p stmt with the tokens \p loc spans, the offsets are looked up
+   /// once the token following it is lexed too.
+   void recordStmtRange(RefCountPtr<RawSyntax> stmt, const internal::YYLocation &loc);
+
+   /// Append the broken region that starts at the token \p firstOrdinal to
+   /// \p list, a \c TopStmtList, \c InnerStmtList or \c MemberDeclList.
+   /// The region ends before the lookahead token if the grammar has read
+   /// one. A region right behind the one appended last is merged into it.
+   /// Return \c nullptr when errors must stop the parse.
+   RefCountPtr<RawSyntax> appendErrorRegion(RefCountPtr<RawSyntax> list, unsigned firstOrdinal,
+                                            bool hasLookahead);
+
+   /// Remember the outermost top statement list parsed so far and forget
+   /// the kept tokens before the current position, a broken region never
+   /// reaches back over a finished top statement.
+   void updateTopStmtList(RefCountPtr<RawSyntax> list, bool hasLookahead);
+
+   /// Make a tree of the parse that stopped at the end of the file within a
+   /// broken construct: the top statements parsed so far and one unknown
+   /// statement of the rest of the tokens.
+   void recoverSyntaxTree();
+
 private:
    friend int internal::token_lex_wrapper(ParserSemantic *value, internal::YYLocation *loc,
                                           Lexer *lexer, Parser *parser);
@@ -112,6 +274,42 @@ private:
 
    std::string m_docComment;
    RefCountPtr<RawSyntax> m_ast;
+   RefCountPtr<SyntaxArena> m_arena;
+
+   /// incremental parsing state
+   SyntaxParsingCache *m_syntaxParsingCache = nullptr;
+   bool m_reuseSyntax = false;
+   bool m_atStmtBoundary = true;
+   SmallVector<TokenKindType, 16> m_openBrackets;
+   struct RecordedStmt
+   {
+      RefCountPtr<RawSyntax> stmt;
+      unsigned firstOrdinal;
+      unsigned endOrdinal;
+   };
+   bool m_recordingStmtRanges = false;
+   /// the start and end offset of the tokens by ordinal
+   std::vector<std::pair<size_t, size_t>> m_tokenRanges;
+   std::vector<RecordedStmt> m_recordedStmts;
+   PersistentParseCache *m_persistentParseCache = nullptr;
+
+   /// error recovery state
+   struct RecordedToken
+   {
+      TokenKindType kind;
+      StringRef text;
+   };
+   bool m_errorRecovery = false;
+   std::vector<ParseError> m_parseErrors;
+   /// the kept tokens, the first one has the ordinal m_firstRecordedOrdinal
+   std::vector<RecordedToken> m_recordedTokens;
+   unsigned m_firstRecordedOrdinal = 1;
+   unsigned m_lastTokenOrdinal = 0;
+   TokenKindType m_lastTokenKind = TokenKindType::T_UNKNOWN_MARK;
+   RefCountPtr<RawSyntax> m_topStmtList;
+   const RawSyntax *m_lastErrorRegion = nullptr;
+   unsigned m_lastErrorRegionEnd = 0;
+
    std::shared_ptr<DiagnosticEngine> m_diags;
    std::list<std::string> m_openFiles;
 
@@ -0,0 +1,116 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/25.
+
+#ifndef POLARPHP_PARSER_PERSISTENT_PARSE_CACHE_H
+#define POLARPHP_PARSER_PERSISTENT_PARSE_CACHE_H
+
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/SyntaxArena.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace polar {
+class LangOptions;
+} // polar
+
+namespace polar::parser {
+
+using polar::LangOptions;
+using polar::StringRef;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxArena;
+
+/// Counters of a \c PersistentParseCache, all durations are in seconds.
+struct PersistentParseCacheStats
+{
+   size_t numHits = 0;
+   size_t numMisses = 0;
+   size_t numStores = 0;
+   size_t numStoreFailures = 0;
+   /// Time spent to map and rehydrate the trees of the hits.
+   double loadSeconds = 0;
+   /// Time the hits took when they were parsed and stored.
+   double parseSecondsOfHits = 0;
+
+   double getHitRate() const
+   {
+      size_t lookups = numHits + numMisses;
+      return lookups > 0 ? static_cast<double>(numHits) / lookups : 0;
+   }
+
+   double getSavedSeconds() const
+   {
+      return parseSecondsOfHits - loadSeconds;
+   }
+};
+
+/// Syntax trees of previous parses stored under a cache directory, so
+/// unchanged files (typically vendor code) are not lexed and parsed again on
+/// every run.
+///
+/// An entry is keyed by the xxHash64 of the source text and its length, the
+/// entries live in a subdirectory named after a fingerprint of the compiler
+/// version, the binary syntax format version and the \c LangOptions which
+/// influence the syntax tree, so switching compilers or options never reuses
+/// a stale tree. Entries are the binary syntax format of
+/// SyntaxBinarySerialization.h behind a small header, they are written to a
+/// temporary file and renamed into place, concurrent writers never expose a
+/// partial entry.
+///
+/// Only successful parses are stored and diagnostics are not replayed on a
+/// hit. Lookups and stores are thread safe.
+class PersistentParseCache
+{
+public:
+   using Clock = std::chrono::steady_clock;
+
+   PersistentParseCache(StringRef cacheDir, const LangOptions &langOpts);
+
+   /// Return the tree stored for \p sourceText, rehydrated into \p arena,
+   /// or \c nullptr if there is no valid entry. The entry is mapped, copied
+   /// into \p arena in one piece and the token text of the tree points into
+   /// that copy.
+   RefCountPtr<RawSyntax> lookUp(StringRef sourceText, const RefCountPtr<SyntaxArena> &arena);
+
+   /// Store \p syntaxTree as the tree of \p sourceText, \p parseDuration is
+   /// the time the parse took, it is reported as saved time by later hits.
+   /// Failures are counted but not fatal, the cache is only an accelerator.
+   bool store(StringRef sourceText, const RefCountPtr<RawSyntax> &syntaxTree,
+              Clock::duration parseDuration);
+
+   /// The directory holding the entries of this compiler and options.
+   StringRef getEntryDir() const
+   {
+      return m_entryDir;
+   }
+
+   PersistentParseCacheStats getStats() const;
+
+   /// Fingerprint of everything except the source text an entry depends on.
+   static std::string computeFingerprint(const LangOptions &langOpts);
+
+private:
+   std::string getEntryPath(std::uint64_t contentHash, size_t contentSize) const;
+
+private:
+   std::string m_entryDir;
+   mutable std::mutex m_statsMutex;
+   PersistentParseCacheStats m_stats;
+};
+
+} // polar::parser
+
+#endif // POLARPHP_PARSER_PERSISTENT_PARSE_CACHE_H
@@ -25,8 +25,11 @@ using polar::syntax::Syntax;
 using polar::syntax::SyntaxKind;
 using polar::syntax::SourceFileSyntax;
 using polar::syntax::SyntaxNodeId;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
 using polar::SmallVector;
 using polar::ArrayRef;
+using polar::StringRef;
 
 /// A single edit to the original source file in which a continuous range of
 /// characters have been replaced by a new string
@@ -67,10 +70,46 @@ struct SyntaxReuseRegion
    AbsolutePosition end;
 };
 
+/// Where a statement of a syntax tree was in the source it was parsed from.
+/// The tokens the grammar builds carry no trivia and the open tag is no node
+/// of the tree, so the parser records the ranges from the token locations,
+/// see \c Parser::setRecordingStmtRanges().
+struct StmtSourceRange
+{
+   /// a \c TopStmt, \c InnerStmt or another node of a statement list
+   RefCountPtr<RawSyntax> stmt;
+
+   /// The offset of the leading trivia of the first token.
+   size_t start;
+
+   /// The offset behind the trailing trivia of the last token.
+   size_t end;
+
+   /// The offset behind the token following the statement, an edit up to
+   /// here may make the statement parse differently, e.g. an added "else".
+   size_t followingEnd;
+};
+
+/// How much of the new source file an incremental parse took over from the
+/// previous syntax tree.
+struct SyntaxReuseStats
+{
+   size_t numReusedNodes = 0;
+   size_t numReusedBytes = 0;
+   size_t sourceLength = 0;
+
+   double getReuseRatio() const
+   {
+      return sourceLength > 0 ? double(numReusedBytes) / sourceLength : 0;
+   }
+};
+
 class SyntaxParsingCache
 {
 public:
-   SyntaxParsingCache(SourceFileSyntax oldSyntaxTree)
+   /// \p oldSyntaxTree is the root of the previous parse, normally a
+   /// \c SourceFileSyntax.
+   SyntaxParsingCache(Syntax oldSyntaxTree)
       : m_oldSyntaxTree(oldSyntaxTree)
    {}
 
@@ -86,19 +125,59 @@ public:
    /// edits should be: { 1, 4, 1 } and { 6, 9, 4 }.
    void addEdit(size_t start, size_t end, size_t replacementLength);
 
+   /// Set the text of the source file that is now being parsed. Once set, a
+   /// node is only reused if it spells exactly the text found at its new
+   /// position.
+   void setNewSourceText(StringRef text)
+   {
+      m_newSourceText = text;
+   }
+
+   /// Look statements up by the source ranges the parser of the previous
+   /// tree recorded in \p oldSourceText instead of by the text lengths of
+   /// the tree, which lack the trivia. Both must outlive the cache.
+   void setOldStmtRanges(std::vector<StmtSourceRange> ranges, StringRef oldSourceText);
+
+   bool hasOldStmtRanges() const
+   {
+      return m_oldSourceText.has_value();
+   }
+
    /// Check if a syntax node of the given kind at the given position can be
    /// reused for a new syntax tree.
    std::optional<Syntax> lookUp(size_t newPosition, SyntaxKind kind);
 
+   /// Like \c lookUp() but by the ranges of \c setOldStmtRanges(), \p sourceLength
+   /// is set to the number of source bytes the statement spans with its
+   /// trivia. Return \c nullptr if nothing can be reused at \p newPosition.
+   RefCountPtr<RawSyntax> lookUpStmt(size_t newPosition, SyntaxKind kind, size_t &sourceLength);
+
    const std::unordered_set<SyntaxNodeId> &getReusedNodeIds() const
    {
       return m_reusedNodeIds;
    }
 
+   /// Forget the nodes handed out so far, used when the parser throws away
+   /// an incremental parse and starts over.
+   void resetReusedNodes()
+   {
+      m_reusedNodeIds.clear();
+      m_reusedBytes = 0;
+   }
+
+   SyntaxReuseStats getReuseStats() const
+   {
+      SyntaxReuseStats stats;
+      stats.numReusedNodes = m_reusedNodeIds.size();
+      stats.numReusedBytes = m_reusedBytes;
+      stats.sourceLength = m_newSourceText.has_value() ? m_newSourceText->size() : 0;
+      return stats;
+   }
+
    /// Get the source regions of the new source file, represented by
    /// \p syntaxTree that have been reused as part of the incremental parse.
    std::vector<SyntaxReuseRegion>
-   getReusedRegions(const SourceFileSyntax &syntaxTree) const;
+   getReusedRegions(const Syntax &syntaxTree) const;
 
    /// Translates a post-edit position to a pre-edit position by undoing the
    /// specified edits. Returns \c None if no pre-edit position exists because
@@ -115,9 +194,19 @@ private:
 
    bool nodeCanBeReused(const Syntax &node, size_t position, size_t nodeStart,
                         SyntaxKind kind) const;
+
+   bool nodeSpellsNewSource(const Syntax &node, size_t newPosition) const;
 private:
    /// The syntax tree prior to the edit
-   SourceFileSyntax m_oldSyntaxTree;
+   Syntax m_oldSyntaxTree;
+
+   /// The source text being parsed incrementally, if known
+   std::optional<StringRef> m_newSourceText;
+
+   /// The statements of the old tree sorted by start, and the source they
+   /// were parsed from
+   std::vector<StmtSourceRange> m_oldStmtRanges;
+   std::optional<StringRef> m_oldSourceText;
 
    /// The edits that were made from the source file that created this cache to
    /// the source file that is now parsed incrementally
@@ -125,6 +214,9 @@ private:
 
    /// The IDs of all syntax nodes that got reused are collected in this vector.
    std::unordered_set<SyntaxNodeId> m_reusedNodeIds;
+
+   /// The number of source bytes covered by the reused nodes.
+   size_t m_reusedBytes = 0;
 };
 
 } // polar::parser
@@ -24,7 +24,9 @@
 #include "polarphp/syntax/TokenKinds.h"
 #include "polarphp/parser/internal/YYParserDefs.h"
 
-#include <any>
+#include <cstdint>
+#include <string>
+#include <variant>
 
 /// forward declare class with namespace
 namespace llvm {
@@ -51,7 +53,8 @@ public:
       NeedCorrectLNumberOverflow,
       AtStartOfLine,
       EscapedIdentifier,
-      InvalidLexValue
+      InvalidLexValue,
+      HasEscapes
    };
 
 public:
@@ -65,9 +68,39 @@ public:
    FLAGSET_DEFINE_FLAG_ACCESSORS(AtStartOfLine, isAtStartOfLine, setAtStartOfLine)
    FLAGSET_DEFINE_FLAG_ACCESSORS(EscapedIdentifier, isEscapedIdentifier, setEscapedIdentifier)
    FLAGSET_DEFINE_FLAG_ACCESSORS(InvalidLexValue, isInvalidLexValue, setInvalidLexValue)
+   FLAGSET_DEFINE_FLAG_ACCESSORS(HasEscapes, hasEscapes, setHasEscapes)
    FLAGSET_DEFINE_EQUALITY(TokenFlags)
 };
 
+/// A multi line string value spelled in the source buffer whose lines lose
+/// \c indentation leading spaces or tabs, the value of heredoc and nowdoc
+/// bodies with an indented closing label. The lexer validates the
+/// indentation, the text without it is only built when it is read.
+struct IndentedStringRef
+{
+   StringRef text;
+   std::uint32_t indentation;
+   /// Whether the first line starts a line of the source, otherwise only the
+   /// lines behind a '\n' are indented.
+   bool stripFirstLine;
+
+   /// Append the text without indentation to \p result.
+   void appendTo(std::string &result) const;
+};
+
+/// A double quoted, backquoted or heredoc string value spelled in the source
+/// buffer with escape sequences. The lexer validates the sequences, they are
+/// only decoded when the value is read.
+struct EscapedStringRef
+{
+   StringRef text;
+   /// The quote that \" or \` escapes, 0 for heredoc bodies.
+   char quoteType;
+
+   /// Append the decoded text to \p result.
+   void appendTo(std::string &result) const;
+};
+
 /// Token - This structure provides full information about a lexed token.
 /// It is not intended to be space efficient, it is intended to return as much
 /// information as possible about each returned token.  This is expected to be
@@ -214,6 +247,12 @@ public:
       return *this;
    }
 
+   /// True if the string value is spelled with escape sequences.
+   bool hasEscapes() const
+   {
+      return m_flags.hasEscapes();
+   }
+
    Token &setNeedCorrectLNumberOverflow(bool value)
    {
       m_flags.setNeedCorrectLNumberOverflow(value);
@@ -262,7 +301,7 @@ public:
 
    bool hasValue() const
    {
-      return !isInvalidLexValue() && m_value.has_value();
+      return !isInvalidLexValue() && !std::holds_alternative<std::monostate>(m_value);
    }
 
    /// getLoc - Return a source location identifier for the specified
@@ -341,6 +380,8 @@ public:
       return *this;
    }
 
+   /// Set a string value owned by the token, used for text that escape
+   /// processing produced and that is not spelled in the source buffer.
    Token &setValue(StringRef value)
    {
       m_valueType = ValueType::String;
@@ -348,6 +389,47 @@ public:
       return *this;
    }
 
+   Token &setValue(std::string &&value)
+   {
+      m_valueType = ValueType::String;
+      m_value.emplace<std::string>(std::move(value));
+      return *this;
+   }
+
+   /// Set a string value that references \p value without copying it, the
+   /// referenced bytes must outlive the token, normally they are a slice of
+   /// the source buffer.
+   Token &setValueRef(StringRef value)
+   {
+      m_valueType = ValueType::String;
+      m_value.emplace<StringRef>(value);
+      return *this;
+   }
+
+   /// Set a string value that references the multi line \p text of the
+   /// source buffer, the indentation of its lines is removed when the value is
+   /// read.
+   Token &setIndentedValueRef(StringRef text, std::size_t indentation, bool stripFirstLine)
+   {
+      if (indentation == 0) {
+         return setValueRef(text);
+      }
+      m_valueType = ValueType::String;
+      m_value.emplace<IndentedStringRef>(
+               IndentedStringRef{text, static_cast<std::uint32_t>(indentation), stripFirstLine});
+      return *this;
+   }
+
+   /// Set a string value that references \p text of the source buffer, its
+   /// escape sequences are decoded when the value is read.
+   Token &setEscapedValueRef(StringRef text, char quoteType)
+   {
+      m_valueType = ValueType::String;
+      m_value.emplace<EscapedStringRef>(EscapedStringRef{text, quoteType});
+      m_flags.setHasEscapes(true);
+      return *this;
+   }
+
    template <typename T,
              typename std::enable_if<std::is_integral<T>::value, void *>::type = nullptr>
    Token &setValue(T value)
@@ -365,13 +447,48 @@ public:
    }
 
    template <typename T,
-             typename std::enable_if<std::is_same<T, std::string>::value ||
-                                     std::is_same<T, double>::value ||
+             typename std::enable_if<std::is_same<T, double>::value ||
                                      std::is_same<T, std::int64_t>::value, void *>::type = nullptr>
    const T &getValue() const
    {
-      assert(m_value.has_value());
-      return std::any_cast<const T &>(m_value);
+      assert(!std::holds_alternative<std::monostate>(m_value));
+      return std::get<T>(m_value);
+   }
+
+   /// Returns a copy of the string value, prefer getStringValue() which does
+   /// not allocate.
+   template <typename T,
+             typename std::enable_if<std::is_same<T, std::string>::value, int *>::type = nullptr>
+   std::string getValue() const
+   {
+      std::string value;
+      if (buildStringValue(value)) {
+         return value;
+      }
+      return getStringValue().str();
+   }
+
+   /// Returns the string value no matter whether the token owns it or
+   /// references the source buffer. An indented or escaped value is built
+   /// and kept by the token on the first call.
+   StringRef getStringValue() const
+   {
+      assert(m_valueType == ValueType::String && "not a string value");
+      if (auto ref = std::get_if<StringRef>(&m_value)) {
+         return *ref;
+      }
+      std::string value;
+      if (buildStringValue(value)) {
+         m_value.emplace<std::string>(std::move(value));
+      }
+      return std::get<std::string>(m_value);
+   }
+
+   /// Returns true if the string value had to be copied out of the source
+   /// buffer.
+   bool isStringValueOwned() const
+   {
+      return std::holds_alternative<std::string>(m_value);
    }
 
    ValueType getValueType() const
@@ -382,14 +499,14 @@ public:
    Token &setValueType(ValueType type)
    {
       m_valueType = type;
-      m_value.reset();
+      m_value.emplace<std::monostate>();
       return *this;
    }
 
    Token &resetValueType()
    {
       m_valueType = ValueType::Unknown;
-      m_value.reset();
+      m_value.emplace<std::monostate>();
       return *this;
    }
 
@@ -400,6 +517,7 @@ public:
       m_lexicalText = text;
       m_commentLength = commentLength;
       m_flags.setEscapedIdentifier(false);
+      m_flags.setHasEscapes(false);
       return *this;
    }
 
@@ -409,6 +527,21 @@ public:
    void dump(raw_ostream &outStream) const;
 
 private:
+   /// Build a value that the token does not hold verbatim into \p value,
+   /// returns false for the other values.
+   bool buildStringValue(std::string &value) const
+   {
+      if (auto indented = std::get_if<IndentedStringRef>(&m_value)) {
+         indented->appendTo(value);
+         return true;
+      }
+      if (auto escaped = std::get_if<EscapedStringRef>(&m_value)) {
+         escaped->appendTo(value);
+         return true;
+      }
+      return false;
+   }
+
    StringRef trimComment() const
    {
       assert(hasComment() && "Has no comment to trim.");
@@ -430,8 +563,11 @@ private:
    /// Text - The actual string covered by the token in the source buffer.
    StringRef m_lexicalText;
 
-   /// The token value
-   std::any m_value;
+   /// The token value, string values either reference the source buffer or
+   /// own the bytes escape processing produced, mutable for building indented
+   /// and escaped values on demand
+   mutable std::variant<std::monostate, std::int64_t, double, std::string, StringRef,
+                        IndentedStringRef, EscapedStringRef> m_value;
 };
 
 } // polar::syntax
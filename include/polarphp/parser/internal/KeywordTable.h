@@ -0,0 +1,35 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/05.
+
+#ifndef POLARPHP_PARSER_INTERNAL_KEYWORD_TABLE_H
+#define POLARPHP_PARSER_INTERNAL_KEYWORD_TABLE_H
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace polar::parser::internal {
+
+using polar::syntax::internal::TokenKindType;
+using llvm::StringRef;
+
+/// Returns the kind of the keyword \p label in any letter case, or
+/// T_IDENTIFIER_STRING when the label is no keyword. The keywords are found
+/// through a perfect hash table that is built at compile time, a label
+/// costs one hash and at most one comparison.
+TokenKindType lookup_keyword(StringRef label);
+
+/// Returns the kind of the cast to \p typeName in any letter case, e.g.
+/// T_INT_CAST for "integer", or T_UNKNOWN_MARK when it names no cast type.
+TokenKindType lookup_cast_type(StringRef typeName);
+
+} // polar::parser::internal
+
+#endif // POLARPHP_PARSER_INTERNAL_KEYWORD_TABLE_H
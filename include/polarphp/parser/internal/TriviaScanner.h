@@ -0,0 +1,52 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/07/02.
+
+#ifndef POLARPHP_PARSER_INTERNAL_TRIVIA_SCANNER_H
+#define POLARPHP_PARSER_INTERNAL_TRIVIA_SCANNER_H
+
+/// Block scanners used by the lexer to skip trivia and the bodies of heredoc
+/// and nowdoc strings without walking the buffer byte by byte. The widest
+/// implementation available at compile time is selected (AVX2, SSE2, or 64
+/// bit SWAR words), every implementation finishes the last partial block
+/// with a scalar loop, so none of them reads past \p end.
+///
+/// \p end must point at the buffer terminator, all functions return \p end
+/// if nothing interesting was found.
+
+namespace polar::parser::internal {
+
+/// Skip a run of ' ', '\t', '\n', '\v', '\f' and '\r'. \p sawNewline is set
+/// when the skipped run contains '\n' or '\r', it is never cleared.
+const unsigned char *skip_whitespace_run(const unsigned char *ptr, const unsigned char *end,
+                                         bool &sawNewline);
+
+/// Find the first '\n', '\r' or nul character. Used by the body of //
+/// comments.
+const unsigned char *find_line_end(const unsigned char *ptr, const unsigned char *end);
+
+/// Find the first '*', '/', '\n', '\r' or nul character. Used by the body of
+/// /* */ comments, the caller decides about nesting and terminators.
+const unsigned char *find_block_comment_delimiter(const unsigned char *ptr, const unsigned char *end);
+
+/// Find the first '\n' or '\r'. Used by nowdoc bodies, only the start of
+/// a line can hold the closing label.
+const unsigned char *find_newline(const unsigned char *ptr, const unsigned char *end);
+
+/// Find the first '\n', '\r', '$', '{' or '\\'. Used by heredoc bodies, the
+/// caller decides whether a '$' or '{' starts an interpolation.
+const unsigned char *find_heredoc_delimiter(const unsigned char *ptr, const unsigned char *end);
+
+/// Name of the implementation compiled in, "avx2", "sse2" or "swar".
+const char *get_trivia_scanner_name();
+
+} // polar::parser::internal
+
+#endif // POLARPHP_PARSER_INTERNAL_TRIVIA_SCANNER_H
@@ -44,8 +44,12 @@ bool is_start_of_utf8_character(unsigned char c);
 void strip_underscores(unsigned char *str, int &length);
 TokenKindType get_token_kind_by_char(unsigned char c);
 long convert_single_quote_str_escape_sequences(std::string::iterator iter, std::string::iterator endMark, Lexer &lexer);
-bool convert_double_quote_str_escape_sequences(std::string &filteredStr, char quoteType, std::string::iterator iter,
-                                               std::string::iterator endMark, Lexer &lexer);
+/// Report the invalid escape sequences of a double quoted, backquoted or
+/// heredoc string \p str, returns false when the string is rejected.
+bool check_double_quote_str_escape_sequences(Lexer &lexer, StringRef str);
+/// Append \p str with its escape sequences decoded to \p result, \p quoteType
+/// is the escapable quote, '"', '`' or 0 for heredoc bodies.
+void decode_double_quote_str_escape_sequences(StringRef str, char quoteType, std::string &result);
 void diagnose_embedded_null(DiagnosticEngine *diags, const unsigned char *ptr);
 bool advance_to_end_of_line(const unsigned char *&yyCursor, const unsigned char *bufferEnd,
                             const unsigned char *codeCompletionPtr = nullptr,
@@ -65,8 +69,10 @@ bool skip_to_end_of_slash_star_comment(const unsigned char *&m_yyCursor,
                                        const unsigned char *codeCompletionPtr = nullptr,
                                        DiagnosticEngine *diags = nullptr);
 
-const char *next_newline(const char *str, const char *end, size_t &newlineLen);
-bool strip_multiline_string_indentation(Lexer &lexer, std::string &str, int indentation, bool usingSpaces,
+/// Check that every line of the heredoc or nowdoc body \p str starts with
+/// \p indentation spaces or tabs as the closing label does, the caller
+/// removes them with \c IndentedStringRef.
+bool check_multiline_string_indentation(Lexer &lexer, StringRef str, int indentation, bool usingSpaces,
                                         bool newlineAtStart, bool newlineAtEnd);
 void strip_underscores(std::string &str, size_t &len);
 
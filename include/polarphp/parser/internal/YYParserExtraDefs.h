@@ -13,17 +13,26 @@
 #define POLARPHP_PARSER_INTERNAL_YYPARSER_EXTRAS_DEFS_H
 
 #define empty_triva() parser->getEmptyTrivia()
-#define make_token(name) SyntaxNodeFactory::make##name(parser->getEmptyTrivia(), parser->getEmptyTrivia())
+/// every node made by the grammar actions is allocated in the arena owned by the parser
+#define make_token(name) SyntaxNodeFactory::make##name(parser->getEmptyTrivia(), parser->getEmptyTrivia(), parser->getArena())
 #define make_token_with_text(name, text) \
-   SyntaxNodeFactory::make##name(OwnedString::makeRefCounted(text), parser->getEmptyTrivia(), parser->getEmptyTrivia())
-#define make_lnumber_token(value) SyntaxNodeFactory::makeLNumberToken(value, parser->getEmptyTrivia(), parser->getEmptyTrivia())
-#define make_dnumber_token(value) SyntaxNodeFactory::makeDNumberToken(value, parser->getEmptyTrivia(), parser->getEmptyTrivia())
+   SyntaxNodeFactory::make##name(OwnedString::makeRefCounted(text), parser->getEmptyTrivia(), parser->getEmptyTrivia(), \
+                                 parser->getArena())
+#define make_lnumber_token(value) \
+   SyntaxNodeFactory::makeLNumberToken(value, parser->getEmptyTrivia(), parser->getEmptyTrivia(), parser->getArena())
+#define make_dnumber_token(value) \
+   SyntaxNodeFactory::makeDNumberToken(value, parser->getEmptyTrivia(), parser->getEmptyTrivia(), parser->getArena())
 
-#define make_syntax_node(name, ...) SyntaxNodeFactory::make##name(__VA_ARGS__)
-#define make_blank_syntax_node(name) SyntaxNodeFactory::makeBlank##name()
+#define make_syntax_node(name, ...) SyntaxNodeFactory::make##name(__VA_ARGS__, parser->getArena())
+#define make_blank_syntax_node(name) SyntaxNodeFactory::makeBlank##name(parser->getArena())
 
 #define make_reserved_keyword(name) make_token(name##Keyword).getRaw()
 
 #define RESET_DOC_COMMENT() (void)0
 
+/// the locations of the grammar hold token ordinals, see Parser::recordToken
+#define token_ordinal(loc) (loc).begin.column
+/// whether the grammar has read a token it did not shift yet
+#define has_lookahead() (!yyla.empty())
+
 #endif // POLARPHP_PARSER_INTERNAL_YYPARSER_EXTRAS_DEFS_H
@@ -0,0 +1,92 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/21.
+
+#ifndef POLARPHP_PARSER_SERIALIZATION_TOKEN_BINARY_SERIALIZATION_H
+#define POLARPHP_PARSER_SERIALIZATION_TOKEN_BINARY_SERIALIZATION_H
+
+#include "polarphp/parser/Token.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+
+/// forward declare class
+namespace llvm {
+class raw_ostream;
+} // llvm
+
+namespace polar::parser {
+
+/// A token stream starts with the magic "PTOK" and a version, then holds one
+/// record per token, all integers are little endian:
+///
+///   u16 kind, u32 offset, u32 length, u8 flags, u8 value type, value
+///
+/// the value is an i64 for LongLong, the IEEE bits as u64 for Double, a u32
+/// byte count followed by the bytes for String and empty otherwise.
+constexpr char TOKEN_BINARY_MAGIC[4] = {'P', 'T', 'O', 'K'};
+constexpr std::uint16_t TOKEN_BINARY_VERSION = 1;
+
+/// One token read back from a binary token stream, string values reference
+/// the stream data.
+struct TokenRecord
+{
+   TokenKindType kind = TokenKindType::T_UNKNOWN_MARK;
+   unsigned offset = 0;
+   unsigned length = 0;
+   TokenFlags flags;
+   Token::ValueType valueType = Token::ValueType::Unknown;
+   std::int64_t intValue = 0;
+   double doubleValue = 0;
+   StringRef stringValue;
+};
+
+void write_token_binary_header(raw_ostream &out);
+/// Append the record of \p token, \p offset is the offset of the token text
+/// in its source buffer.
+void write_token_binary_record(raw_ostream &out, const Token &token, unsigned offset);
+
+/// Sequential reader over a binary token stream held in memory.
+class TokenBinaryReader
+{
+public:
+   explicit TokenBinaryReader(StringRef data);
+
+   /// Returns false if the data does not start with a supported header.
+   bool isValid() const
+   {
+      return m_valid;
+   }
+
+   /// Read the next record, returns false at the end of the data or if the
+   /// record is truncated, hasError() tells the two apart.
+   bool next(TokenRecord &record);
+
+   bool hasError() const
+   {
+      return m_error;
+   }
+
+private:
+   bool canRead(size_t size) const
+   {
+      return m_data.size() - m_position >= size;
+   }
+
+private:
+   StringRef m_data;
+   size_t m_position = 0;
+   bool m_valid = false;
+   bool m_error = false;
+};
+
+} // polar::parser
+
+#endif // POLARPHP_PARSER_SERIALIZATION_TOKEN_BINARY_SERIALIZATION_H
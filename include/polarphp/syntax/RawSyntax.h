@@ -558,6 +558,13 @@ public:
 
    /// @}
 
+   /// The arena this node was allocated in, \c nullptr if the node owns
+   /// its memory.
+   const RefCountPtr<SyntaxArena> &getArena() const
+   {
+      return arena;
+   }
+
    /// \name Transform routines for "layout" nodes.
    /// @{
 
@@ -599,9 +606,23 @@ public:
 private:
    friend class TrailingObjects;
 
-   /// The id that shall be used for the next node that is created and does not
-   /// have a manually specified id
-   static SyntaxNodeId sm_nextFreeNodeId;
+   /// The id that shall be used for the next range of node ids handed out to a
+   /// thread. Threads carve node ids from their own range, so parsers running
+   /// on different threads never contend on this counter per node.
+   static std::atomic<SyntaxNodeId> sm_nextFreeNodeId;
+
+   /// Return the next free node id of the calling thread, reserving a new
+   /// range from \c sm_nextFreeNodeId when the current one is exhausted.
+   static SyntaxNodeId allocateNodeId();
+
+   /// Make sure that ids handed out from now on never collide with the
+   /// manually specified \p nodeId.
+   ///
+   /// This holds for the calling thread only. Another thread may still own
+   /// a range containing \p nodeId and hand it out again, so nodes with
+   /// explicit ids, e.g. deserialized ones, must not be created while other
+   /// threads allocate nodes.
+   static void reserveNodeId(SyntaxNodeId nodeId);
 
    /// An id of this node that is stable across incremental parses
    SyntaxNodeId m_nodeId;
@@ -0,0 +1,108 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/03.
+
+#ifndef POLARPHP_SYNTAX_RAW_SYNTAX_WALKER_H
+#define POLARPHP_SYNTAX_RAW_SYNTAX_WALKER_H
+
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/Syntax.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <cstdint>
+
+namespace polar::syntax {
+
+/// Pre and post order walk over a \c RawSyntax tree, missing nodes
+/// included, so the text of the visited tokens spells out the source.
+///
+/// Unlike \c SyntaxNodeVisitor the walk does not recurse and does not create
+/// \c SyntaxData for the nodes it passes, the path from the root to the
+/// current node is kept on an explicit stack. Deeply nested trees therefore
+/// cost heap memory proportional to their depth instead of native stack.
+/// Subclasses that need the full \c Syntax API for a node call
+/// \c getCurrentSyntax(), which realizes the path to it on demand.
+class RawSyntaxWalker
+{
+public:
+   enum class Action
+   {
+      /// Walk into the children of the node.
+      Continue,
+      /// Do not walk into the children of the node, \c walkPost() is still
+      /// called for it. Same as \c Continue in \c walkPost().
+      SkipChildren,
+      /// End the walk, no other callback is called.
+      Stop
+   };
+
+   virtual ~RawSyntaxWalker();
+
+   /// Walk the tree of \p root, returns false when a callback stopped the
+   /// walk.
+   bool walk(const RefCountPtr<RawSyntax> &root);
+
+   virtual Action walkPre(const RawSyntax &node)
+   {
+      return Action::Continue;
+   }
+
+   virtual Action walkPost(const RawSyntax &node)
+   {
+      return Action::Continue;
+   }
+
+protected:
+   /// Number of nodes above the current node, 0 for the root.
+   unsigned getDepth() const
+   {
+      assert(!m_stack.empty() && "not walking");
+      return m_stack.size() - 1;
+   }
+
+   /// Parent of the current node, nullptr for the root.
+   const RawSyntax *getParent() const
+   {
+      assert(!m_stack.empty() && "not walking");
+      return m_stack.size() > 1 ? m_stack[m_stack.size() - 2].node : nullptr;
+   }
+
+   /// Layout slot of the current node in its parent.
+   CursorIndex getIndexInParent() const
+   {
+      assert(!m_stack.empty() && "not walking");
+      return m_stack.back().indexInParent;
+   }
+
+   /// The current node with its parent chain. Realizes the \c SyntaxData of
+   /// every node on the path that has not been realized during this walk
+   /// yet, they live until the walk ends.
+   Syntax getCurrentSyntax();
+
+private:
+   struct Frame
+   {
+      const RawSyntax *node;
+      std::uint32_t indexInParent;
+      std::uint32_t nextChild;
+      /// Realized by getCurrentSyntax().
+      RefCountPtr<SyntaxData> data;
+   };
+
+   bool enterNode(const RawSyntax *node, std::uint32_t indexInParent);
+
+private:
+   RefCountPtr<RawSyntax> m_root;
+   SmallVector<Frame, 64> m_stack;
+};
+
+} // polar::syntax
+
+#endif // POLARPHP_SYNTAX_RAW_SYNTAX_WALKER_H
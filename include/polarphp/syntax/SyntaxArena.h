@@ -32,17 +32,26 @@
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/Support/Allocator.h"
 
+#include <memory>
+
+namespace llvm {
+class FoldingSetNodeID;
+} // llvm
+
 namespace polar::syntax {
 
 using llvm::BumpPtrAllocator;
 using llvm::ThreadSafeRefCountedBase;
+using llvm::FoldingSetNodeID;
+
+class RawSyntax;
 
 /// Memory manager for Syntax nodes.
 class SyntaxArena : public ThreadSafeRefCountedBase<SyntaxArena>
 {
 public:
-   SyntaxArena()
-   {}
+   SyntaxArena();
+   ~SyntaxArena();
 
    BumpPtrAllocator &getAllocator()
    {
@@ -51,13 +60,86 @@ public:
 
    void *allocate(size_t size, size_t alignment)
    {
+      ++m_numAllocations;
       return m_allocator.Allocate(size, alignment);
    }
 
+   /// The number of objects carved from this arena, without an arena every
+   /// one of them would have been a separate heap allocation.
+   size_t getNumAllocations() const
+   {
+      return m_numAllocations;
+   }
+
+   /// The number of bytes handed out by \c allocate().
+   size_t getBytesAllocated() const
+   {
+      return m_allocator.getBytesAllocated();
+   }
+
+   /// The number of bytes the arena requested from the system, including
+   /// the unused tail of the current slab.
+   size_t getTotalMemory() const
+   {
+      return m_allocator.getTotalMemory();
+   }
+
+   /// The number of slabs (heap allocations) backing this arena.
+   size_t getNumSlabs() const
+   {
+      return m_allocator.GetNumSlabs();
+   }
+
+   /// \name Token uniquing
+   ///
+   /// When enabled, \c RawSyntax::make() hands out one shared node for all
+   /// tokens of this arena with the same kind, text, trivia and presence
+   /// instead of allocating a node per occurrence, so every ";" or
+   /// "function" of a file exists once. Raw nodes are immutable and have no
+   /// parent pointer, sharing them is invisible except that the shared
+   /// tokens also share their node id. Tokens with a literal value and tokens
+   /// made with an explicit node id are never uniqued.
+   ///
+   /// The table retains its tokens and the tokens retain the arena, call
+   /// \c clearUniquedTokens() once no more nodes are made (\c Parser does so
+   /// at the end of \c parse()) to release the table. Like the allocator
+   /// the table is not thread safe.
+   /// @{
+   void setTokenUniquing(bool enabled)
+   {
+      m_tokenUniquing = enabled;
+   }
+
+   bool isTokenUniquingEnabled() const
+   {
+      return m_tokenUniquing;
+   }
+
+   /// Return the token profiled as \p id, or \c nullptr and the position
+   /// to pass to \c addUniquedToken().
+   RawSyntax *lookUpUniquedToken(const FoldingSetNodeID &id, void *&insertPos);
+
+   void addUniquedToken(RawSyntax *token, const FoldingSetNodeID &id, void *insertPos);
+
+   void clearUniquedTokens();
+
+   /// The number of tokens made which were served from the table.
+   size_t getNumUniquedTokenHits() const
+   {
+      return m_numUniquedTokenHits;
+   }
+   /// @}
+
 private:
    SyntaxArena(const SyntaxArena &) = delete;
    void operator=(const SyntaxArena &) = delete;
+   class UniquedTokenTable;
+
    BumpPtrAllocator m_allocator;
+   size_t m_numAllocations = 0;
+   bool m_tokenUniquing = false;
+   size_t m_numUniquedTokenHits = 0;
+   std::unique_ptr<UniquedTokenTable> m_uniquedTokens;
 };
 
 } // polar::syntax
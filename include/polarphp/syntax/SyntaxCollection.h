@@ -143,7 +143,8 @@ public:
       newLayout.reserve(oldLayout.size() + 1);
       std::copy(oldLayout.begin(), oldLayout.end(), std::back_inserter(newLayout));
       newLayout.push_back(element.getRaw());
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
@@ -154,7 +155,8 @@ public:
    {
       assert(!empty());
       auto newLayout = getRaw()->getLayout().drop_back();
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
@@ -166,7 +168,8 @@ public:
       std::vector<RefCountPtr<RawSyntax>> newLayout = { element.getRaw() };
       std::copy(oldLayout.begin(), oldLayout.end(),
                 std::back_inserter(newLayout));
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
@@ -177,7 +180,8 @@ public:
    {
       assert(!empty());
       auto newLayout = getRaw()->getLayout().drop_front();
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
@@ -197,7 +201,8 @@ public:
       newLayout.push_back(element.getRaw());
       std::copy(oldLayout.begin() + i, oldLayout.end(),
                 std::back_inserter(newLayout));
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
@@ -209,14 +214,16 @@ public:
       auto iterator = newLayout.begin();
       std::advance(iterator, i);
       newLayout.erase(iterator);
-      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, newLayout, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
    /// Return an empty syntax collection of this type.
    SyntaxCollection<collectionKind, Element> cleared() const
    {
-      auto raw = RawSyntax::make(collectionKind, {}, getRaw()->getPresence());
+      auto raw = RawSyntax::make(collectionKind, {}, getRaw()->getPresence(),
+                                 getRaw()->getArena());
       return m_data->replaceSelf<SyntaxCollection<collectionKind, Element>>(raw);
    }
 
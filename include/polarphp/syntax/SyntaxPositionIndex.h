@@ -0,0 +1,150 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/02.
+
+#ifndef POLARPHP_SYNTAX_SYNTAX_POSITION_INDEX_H
+#define POLARPHP_SYNTAX_SYNTAX_POSITION_INDEX_H
+
+#include "polarphp/syntax/RawSyntax.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace polar::syntax {
+
+class SyntaxData;
+
+/// Position index of one syntax tree, built in a single pass over the tree.
+///
+/// \c SyntaxData::getAbsolutePosition() finds the position of a node by
+/// walking to its previous node, which is linear in the number of nodes in
+/// front of it. The index instead numbers the nodes in pre-order and keeps
+/// for every node its offset (the prefix sum of the text lengths in front of
+/// it), its parent and its child slots, plus the start offsets of the
+/// present tokens and of the lines. That answers
+///
+///   - offset -> deepest node: binary search over the token offsets
+///   - node -> offset: one step per level from the root to the node
+///   - offset -> line and column: binary search over the line starts
+///
+/// Nodes are identified by their pre-order number, raw nodes can not serve
+/// as identity because equal subtrees may be shared. Lines and columns count
+/// from 1 like \c AbsolutePosition, "\r\n" is a single newline.
+class SyntaxPositionIndex
+{
+public:
+   using NodeIndex = std::uint32_t;
+   static constexpr NodeIndex INVALID_NODE = UINT32_MAX;
+
+   explicit SyntaxPositionIndex(const RefCountPtr<RawSyntax> &root);
+
+   NodeIndex getRoot() const
+   {
+      return 0;
+   }
+
+   size_t getNumNodes() const
+   {
+      return m_nodes.size();
+   }
+
+   size_t getNumLines() const
+   {
+      return m_lineStarts.size();
+   }
+
+   /// Length of the text of the whole tree.
+   std::uint32_t getTextLength() const
+   {
+      return m_nodes.front().length;
+   }
+
+   const RawSyntax *getRaw(NodeIndex node) const
+   {
+      return m_nodes[node].raw;
+   }
+
+   NodeIndex getParent(NodeIndex node) const
+   {
+      return m_nodes[node].parent;
+   }
+
+   /// The node in layout slot \p childIndex of \p node, \c INVALID_NODE if
+   /// the slot is empty.
+   NodeIndex getChild(NodeIndex node, size_t childIndex) const
+   {
+      assert(childIndex < m_nodes[node].raw->getNumChildren() && "child index out of range");
+      return m_childSlots[m_nodes[node].firstChildSlot + childIndex];
+   }
+
+   /// Offset of \p node before its leading trivia, what
+   /// \c SyntaxData::getAbsolutePositionBeforeLeadingTrivia() reports.
+   std::uint32_t getOffset(NodeIndex node) const
+   {
+      return m_nodes[node].offset;
+   }
+
+   /// Offset of \p node after its leading trivia, what
+   /// \c SyntaxData::getAbsolutePosition() reports.
+   std::uint32_t getContentOffset(NodeIndex node) const
+   {
+      return m_nodes[node].contentOffset;
+   }
+
+   /// Offset behind the trailing trivia of \p node.
+   std::uint32_t getEndOffset(NodeIndex node) const
+   {
+      return m_nodes[node].offset + m_nodes[node].length;
+   }
+
+   /// The node \p data stands for, \p data must belong to the tree this
+   /// index was built for.
+   NodeIndex findNode(const SyntaxData &data) const;
+
+   /// The token whose text or trivia covers \p offset, \c INVALID_NODE if
+   /// \p offset is behind the end of the text. Walk \c getParent() for the
+   /// enclosing nodes.
+   NodeIndex findDeepestNode(std::uint32_t offset) const;
+
+   /// 1 based line and column of \p offset, \p offset may be the end of the
+   /// text.
+   std::pair<std::uint32_t, std::uint32_t> getLineAndColumn(std::uint32_t offset) const;
+
+private:
+   struct Node
+   {
+      const RawSyntax *raw;
+      NodeIndex parent;
+      std::uint32_t firstChildSlot;
+      std::uint32_t offset;
+      std::uint32_t length;
+      std::uint32_t contentOffset;
+   };
+
+   void addText(StringRef text);
+
+private:
+   RefCountPtr<RawSyntax> m_root;
+   std::vector<Node> m_nodes;
+   std::vector<NodeIndex> m_childSlots;
+   /// Present tokens with text, sorted by offset.
+   std::vector<NodeIndex> m_tokens;
+   std::vector<std::uint32_t> m_lineStarts;
+   /// Offset reached while building.
+   std::uint32_t m_currentOffset = 0;
+   /// Whether the text added last ended with '\r', a following '\n' belongs
+   /// to the same newline.
+   bool m_pendingCarriageReturn = false;
+};
+
+} // polar::syntax
+
+#endif // POLARPHP_SYNTAX_SYNTAX_POSITION_INDEX_H
@@ -0,0 +1,117 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/22.
+
+#ifndef POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_BINARY_SERIALIZATION_H
+#define POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_BINARY_SERIALIZATION_H
+
+#include "polarphp/syntax/RawSyntax.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+
+namespace polar::syntax {
+
+/// Layout of a binary syntax tree, all integers are little endian and all
+/// offsets are relative to the start of the data:
+///
+///   header: "PSYN", u16 version, u16 reserved, u32 node count,
+///           u32 root offset, u32 string table offset, u32 string table size
+///   layout record: u8 tag(0), u8 presence, u16 syntax kind, u32 child count,
+///                  u32 child offset * child count
+///   token record: u8 tag(1), u8 presence, u16 token kind, u32 text offset,
+///                 u32 text length, u16 leading count, u16 trailing count,
+///                 trivia piece * (leading count + trailing count)
+///   trivia piece: u8 kind, u8 * 3 padding, u32 text offset, u32 text length
+///   string table: token and trivia text, every distinct text stored once
+///
+/// Records are written children first, so a parent refers to its children
+/// by offset and any subtree can be read without touching the rest of the
+/// data, a mapped file only pages in what is materialised. Absent children
+/// use SYNTAX_BINARY_NULL_OFFSET. Node ids are not stored, materialised nodes
+/// get fresh ones.
+constexpr char SYNTAX_BINARY_MAGIC[4] = {'P', 'S', 'Y', 'N'};
+constexpr std::uint16_t SYNTAX_BINARY_VERSION = 1;
+constexpr std::uint32_t SYNTAX_BINARY_NULL_OFFSET = UINT32_MAX;
+
+/// Serialize the tree rooted at \p root.
+void write_syntax_binary(raw_ostream &out, const RefCountPtr<RawSyntax> &root);
+
+/// Reads trees written by write_syntax_binary() out of a memory region,
+/// typically a mapped file. Nothing is decoded up front, nodes are only
+/// materialised when asked for.
+class SyntaxBinaryReader
+{
+public:
+   /// \p data must outlive the reader. If \p referenceData is true the token
+   /// text of materialised nodes points into \p data instead of being copied,
+   /// so \p data must outlive those nodes as well.
+   SyntaxBinaryReader(StringRef data, const RefCountPtr<SyntaxArena> &arena = nullptr,
+                      bool referenceData = false);
+
+   /// Returns false if the header is missing, of another version or points
+   /// outside of the data.
+   bool isValid() const
+   {
+      return m_valid;
+   }
+
+   unsigned getNumNodes() const
+   {
+      return m_numNodes;
+   }
+
+   std::uint32_t getRootOffset() const
+   {
+      return m_rootOffset;
+   }
+
+   /// \name Navigation over records without materialising them. Every
+   /// \p offset must be the root offset or a child offset read from the data.
+   /// @{
+   bool isToken(std::uint32_t offset) const;
+   SyntaxKind getKind(std::uint32_t offset) const;
+   unsigned getNumChildren(std::uint32_t offset) const;
+   std::uint32_t getChildOffset(std::uint32_t offset, unsigned index) const;
+   /// @}
+
+   /// Materialise the subtree whose record starts at \p offset, returns
+   /// \c nullptr if the data is malformed.
+   RefCountPtr<RawSyntax> materialize(std::uint32_t offset) const;
+
+   RefCountPtr<RawSyntax> materializeRoot() const
+   {
+      return materialize(m_rootOffset);
+   }
+
+private:
+   bool isRecordInRange(std::uint32_t offset, std::uint32_t size) const
+   {
+      return offset <= m_data.size() && m_data.size() - offset >= size;
+   }
+   bool readString(std::uint32_t offset, std::uint32_t length, StringRef &result) const;
+   bool readTrivia(const char *ptr, unsigned count, std::vector<TriviaPiece> &pieces) const;
+   RefCountPtr<RawSyntax> materializeToken(std::uint32_t offset) const;
+   RefCountPtr<RawSyntax> materializeLayout(std::uint32_t offset) const;
+
+private:
+   StringRef m_data;
+   RefCountPtr<SyntaxArena> m_arena;
+   bool m_referenceData;
+   bool m_valid = false;
+   unsigned m_numNodes = 0;
+   std::uint32_t m_rootOffset = SYNTAX_BINARY_NULL_OFFSET;
+   std::uint32_t m_stringTableOffset = 0;
+   std::uint32_t m_stringTableSize = 0;
+};
+
+} // polar::syntax
+
+#endif // POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_BINARY_SERIALIZATION_H
@@ -0,0 +1,38 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/27.
+
+#ifndef POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_STREAM_WRITERS_H
+#define POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_STREAM_WRITERS_H
+
+#include "polarphp/syntax/RawSyntax.h"
+
+namespace polar::syntax {
+
+/// Writers which walk a raw tree depth first and write every node as soon
+/// as it is reached. No document is built and the walk keeps an explicit
+/// stack of the open layout nodes, so memory only grows with the depth of
+/// the tree, never with its size.
+
+/// Write the same document as to_json(json &, const RawSyntax &) in
+/// SyntaxJsonSerialization.h, without the intermediate json objects.
+void write_syntax_json(raw_ostream &out, const RawSyntax &root);
+
+/// Write a compact S-expression, one line for the whole tree:
+///
+///   (SourceFile (TopStmt (T_VARIABLE "$a" :leading "\n" :trailing " ")))
+///
+/// Missing nodes are marked with [missing], absent children are skipped and
+/// empty trivia is omitted.
+void write_syntax_sexpr(raw_ostream &out, const RawSyntax &root);
+
+} // polar::syntax
+
+#endif // POLARPHP_SYNTAX_SERIALIZATION_SYNTAX_STREAM_WRITERS_H
@@ -20,9 +20,11 @@
 #include "polarphp/ast/internal/SubstitutionMapStorage.h"
 #include "polarphp/ast/ClangModuleLoader.h"
 #include "polarphp/ast/ConcreteDeclRef.h"
+#include "polarphp/ast/ConcurrentIdentifierTable.h"
 #include "polarphp/ast/DiagnosticEngine.h"
 #include "polarphp/ast/DiagnosticsSema.h"
 #include "polarphp/ast/ExistentialLayout.h"
+#include "polarphp/ast/Expr.h"
 #include "polarphp/ast/FileUnit.h"
 #include "polarphp/ast/ForeignErrorConvention.h"
 #include "polarphp/ast/GenericEnvironment.h"
@@ -52,11 +54,13 @@
 #include "polarphp/global/NameStrings.h"
 #include "polarphp/global/Subsystems.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/Format.h"
 #include <algorithm>
 #include <memory>
 
@@ -171,10 +175,9 @@ struct AstContext::Implementation {
    /// A global type checker instance..
    TypeChecker *Checker = nullptr;
 
-   // FIXME: This is a StringMap rather than a StringSet because StringSet
-   // doesn't allow passing in a pre-existing allocator.
-   llvm::StringMap<Identifier::Aligner, llvm::BumpPtrAllocator &>
-      IdentifierTable;
+   /// The uniqued identifier strings, interned without a lock so that
+   /// parsing, deserialization and importing may run on several threads.
+   ConcurrentIdentifierTable IdentifierTable;
 
    /// The declaration of Swift.AssignmentPrecedence.
    PrecedenceGroupDecl *AssignmentPrecedence = nullptr;
@@ -461,6 +464,43 @@ struct AstContext::Implementation {
    /// The current constraint solver arena, if any.
    std::unique_ptr<ConstraintSolverArena> CurrentConstraintSolverArena;
 
+   /// The bytes allocated in the arenas by phase and source file.
+   struct ArenaAccounting {
+      struct Usage {
+         uint64_t PermanentBytes = 0;
+         uint64_t ConstraintSolverBytes = 0;
+         uint64_t ConstraintSolverPeakBytes = 0;
+         unsigned NumConstraintSolverArenas = 0;
+      };
+
+      using Scope = std::pair<Identifier, const SourceFile *>;
+
+      /// The usage of each scope, in the order they were first entered.
+      llvm::MapVector<Scope, Usage> Usages;
+
+      Scope CurrentScope;
+
+      /// The bytes of the permanent arena when the current scope was entered.
+      size_t PermanentBytesAtScopeEntry = 0;
+
+      bool TrackSolvedExprs = false;
+
+      /// The constraint solver arena size after each solved expression.
+      std::vector<std::pair<SourceLoc, size_t>> SolvedExprs;
+
+      /// Attribute the permanent arena bytes allocated since the current
+      /// scope was entered to it, then enter \p scope.
+      void enterScope(Scope scope, size_t permanentBytes) {
+         Usages[CurrentScope].PermanentBytes +=
+            permanentBytes - PermanentBytesAtScopeEntry;
+         CurrentScope = scope;
+         PermanentBytesAtScopeEntry = permanentBytes;
+      }
+   };
+
+   /// Set by enableArenaAccounting().
+   std::unique_ptr<ArenaAccounting> ArenaStats;
+
    Arena &getArena(AllocationArena arena) {
       switch (arena) {
          case AllocationArena::Permanent:
@@ -483,8 +523,7 @@ struct AstContext::Implementation {
 };
 
 AstContext::Implementation::Implementation()
-   : IdentifierTable(Allocator),
-     TheSyntaxArena(new SyntaxArena()) {}
+   : TheSyntaxArena(new SyntaxArena()) {}
 
 AstContext::Implementation::~Implementation() {
    for (auto &cleanup : Cleanups)
@@ -499,10 +538,49 @@ ConstraintCheckerArenaRAII(AstContext &self, llvm::BumpPtrAllocator &allocator)
 }
 
 ConstraintCheckerArenaRAII::~ConstraintCheckerArenaRAII() {
-   Self.getImpl().CurrentConstraintSolverArena.reset(
+   auto &Impl = Self.getImpl();
+   // Bump allocators never free, so this is the peak of the arena.
+   size_t Bytes = Impl.CurrentConstraintSolverArena->Allocator.getBytesAllocated();
+   if (Self.Stats) {
+      auto &C = Self.Stats->getFrontendCounters();
+      ++C.NumConstraintSolverArenas;
+      C.MaxConstraintSolverArenaBytes =
+         std::max<int64_t>(C.MaxConstraintSolverArenaBytes, Bytes);
+   }
+   if (auto *Accounting = Impl.ArenaStats.get()) {
+      auto &Usage = Accounting->Usages[Accounting->CurrentScope];
+      Usage.ConstraintSolverBytes += Bytes;
+      Usage.ConstraintSolverPeakBytes =
+         std::max<uint64_t>(Usage.ConstraintSolverPeakBytes, Bytes);
+      ++Usage.NumConstraintSolverArenas;
+   }
+
+   Impl.CurrentConstraintSolverArena.reset(
       (AstContext::Implementation::ConstraintSolverArena *) Data);
 }
 
+ArenaAccountingRAII::ArenaAccountingRAII(AstContext &self, StringRef phase,
+                                         const SourceFile *file)
+   : Self(self) {
+   auto &Impl = Self.getImpl();
+   if (!Impl.ArenaStats)
+      return;
+   // Interning the phase name may allocate, which belongs to the scope that
+   // is left.
+   Identifier Phase = Self.getIdentifier(phase);
+   std::tie(PreviousPhase, PreviousFile) = Impl.ArenaStats->CurrentScope;
+   Impl.ArenaStats->enterScope({Phase, file},
+                               Impl.Allocator.getBytesAllocated());
+}
+
+ArenaAccountingRAII::~ArenaAccountingRAII() {
+   auto &Impl = Self.getImpl();
+   if (!Impl.ArenaStats)
+      return;
+   Impl.ArenaStats->enterScope({PreviousPhase, PreviousFile},
+                               Impl.Allocator.getBytesAllocated());
+}
+
 static ModuleDecl *createBuiltinModule(AstContext &ctx) {
    auto M = ModuleDecl::create(ctx.getIdentifier(BUILTIN_NAME), ctx);
    M->addFile(*new(ctx) BuiltinUnit(*M));
@@ -593,6 +671,11 @@ AstContext::AstContext(LangOptions &langOpts, TypeCheckerOptions &typeckOpts,
    for (const auto &framepath : SearchPathOpts.FrameworkSearchPaths)
       getImpl().SearchPathsSet[framepath.Path] |= SearchPathKind::Framework;
 
+   // The request dependencies are only read by the cycle dumps and the
+   // GraphViz output, record them for those even without assertions.
+   if (langOpts.DebugDumpCycles || !langOpts.RequestEvaluatorGraphVizPath.empty())
+      evaluator.setDependencyRecording(DependencyRecording::Compact);
+
    // Register any request-evaluator functions available at the AST layer.
    registerAccessRequestFunctions(evaluator);
    registerNameLookupRequestFunctions(evaluator);
@@ -654,9 +737,9 @@ Identifier AstContext::getIdentifier(StringRef Str) const {
    if (Str.data() == nullptr)
       return Identifier(nullptr);
 
-   auto pair = std::make_pair(Str, Identifier::Aligner());
-   auto I = getImpl().IdentifierTable.insert(pair).first;
-   return Identifier(I->getKeyData());
+   static_assert(alignof(Identifier::Aligner) <= alignof(uint32_t),
+                 "interned strings are aligned to 4 bytes");
+   return Identifier(getImpl().IdentifierTable.intern(Str));
 }
 
 void AstContext::lookupInPolarphpModule(
@@ -2003,6 +2086,7 @@ size_t AstContext::getTotalMemory() const {
                  // RemappedTypes ?
                  sizeof(getImpl()) +
                  getImpl().Allocator.getTotalMemory() +
+                 getImpl().IdentifierTable.getMemorySize() +
                  getImpl().Cleanups.capacity() +
                  llvm::capacity_in_bytes(getImpl().ModuleLoaders) +
                  llvm::capacity_in_bytes(getImpl().RawComments) +
@@ -2036,6 +2120,94 @@ size_t AstContext::getSolverMemory() const {
    return Size;
 }
 
+void AstContext::enableArenaAccounting(bool trackSolvedExprs) {
+   auto &Impl = getImpl();
+   if (!Impl.ArenaStats) {
+      Impl.ArenaStats = std::make_unique<Implementation::ArenaAccounting>();
+      // What was allocated so far was allocated by setting up the context.
+      Identifier Frontend = getIdentifier("frontend");
+      Impl.ArenaStats->CurrentScope = {getIdentifier("setup"), nullptr};
+      Impl.ArenaStats->enterScope({Frontend, nullptr},
+                                  Impl.Allocator.getBytesAllocated());
+   }
+   Impl.ArenaStats->TrackSolvedExprs |= trackSolvedExprs;
+}
+
+bool AstContext::isArenaAccountingEnabled() const {
+   return getImpl().ArenaStats != nullptr;
+}
+
+void AstContext::noteSolvedExprArenaBytes(const Expr *expr, size_t bytes) {
+   auto *Accounting = getImpl().ArenaStats.get();
+   if (!Accounting || !Accounting->TrackSolvedExprs)
+      return;
+   Accounting->SolvedExprs.push_back({expr->getLoc(), bytes});
+}
+
+void AstContext::printArenaStatistics(raw_ostream &out) const {
+   auto *Accounting = getImpl().ArenaStats.get();
+   if (!Accounting)
+      return;
+
+   // Count the current scope up to now without leaving it.
+   auto Usages = Accounting->Usages;
+   Usages[Accounting->CurrentScope].PermanentBytes +=
+      getImpl().Allocator.getBytesAllocated() -
+      Accounting->PermanentBytesAtScopeEntry;
+
+   out << "*** AST arena statistics (bytes) ***\n";
+   out << llvm::left_justify("phase", 12) << ' '
+       << llvm::left_justify("file", 40)
+       << llvm::right_justify("permanent", 14)
+       << llvm::right_justify("solver", 14)
+       << llvm::right_justify("solver arenas", 15)
+       << llvm::right_justify("solver peak", 14) << '\n';
+   Implementation::ArenaAccounting::Usage Total;
+   for (const auto &Entry : Usages) {
+      const auto &Usage = Entry.second;
+      const SourceFile *File = Entry.first.second;
+      out << llvm::left_justify(Entry.first.first.str(), 12) << ' '
+          << llvm::left_justify(File ? File->getFilename() : "-", 40)
+          << llvm::format_decimal(Usage.PermanentBytes, 14)
+          << llvm::format_decimal(Usage.ConstraintSolverBytes, 14)
+          << llvm::format_decimal(Usage.NumConstraintSolverArenas, 15)
+          << llvm::format_decimal(Usage.ConstraintSolverPeakBytes, 14) << '\n';
+      Total.PermanentBytes += Usage.PermanentBytes;
+      Total.ConstraintSolverBytes += Usage.ConstraintSolverBytes;
+      Total.NumConstraintSolverArenas += Usage.NumConstraintSolverArenas;
+      Total.ConstraintSolverPeakBytes =
+         std::max(Total.ConstraintSolverPeakBytes, Usage.ConstraintSolverPeakBytes);
+   }
+   out << llvm::left_justify("total", 12) << ' '
+       << llvm::left_justify("", 40)
+       << llvm::format_decimal(Total.PermanentBytes, 14)
+       << llvm::format_decimal(Total.ConstraintSolverBytes, 14)
+       << llvm::format_decimal(Total.NumConstraintSolverArenas, 15)
+       << llvm::format_decimal(Total.ConstraintSolverPeakBytes, 14) << '\n';
+
+   if (!Accounting->TrackSolvedExprs)
+      return;
+
+   auto SolvedExprs = Accounting->SolvedExprs;
+   std::stable_sort(SolvedExprs.begin(), SolvedExprs.end(),
+                    [](const std::pair<SourceLoc, size_t> &lhs,
+                       const std::pair<SourceLoc, size_t> &rhs) {
+                       return lhs.second > rhs.second;
+                    });
+   out << "\n*** constraint solver arena by solved expression (bytes) ***\n";
+   for (const auto &Entry : SolvedExprs) {
+      out << llvm::format_decimal(Entry.second, 14) << "  ";
+      if (Entry.first.isValid()) {
+         auto LineAndCol = SourceMgr.getLineAndColumn(Entry.first);
+         out << SourceMgr.getDisplayNameForLoc(Entry.first) << ':'
+             << LineAndCol.first << ':' << LineAndCol.second;
+      } else {
+         out << "<unknown location>";
+      }
+      out << '\n';
+   }
+}
+
 size_t AstContext::Implementation::Arena::getTotalMemory() const {
    return sizeof(*this) +
           // TupleTypes ?
@@ -0,0 +1,267 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/ast/ConcurrentIdentifierTable.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/DJB.h"
+
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+namespace polar {
+
+namespace {
+
+/// Power of two, about the identifiers of a small module.
+constexpr size_t INITIAL_CAPACITY = 4096;
+
+/// Marks a slot whose entry was copied into the next table, entries are
+/// aligned to 4 bytes so this is no entry.
+const char *const MOVED_SLOT = reinterpret_cast<const char *>(std::uintptr_t(1));
+
+std::atomic<std::uint64_t> sg_nextTableId{1};
+
+/// Precedes the characters of an entry.
+struct EntryHeader
+{
+   std::uint32_t hash;
+   std::uint32_t length;
+};
+
+const EntryHeader &get_entry_header(const char *entry)
+{
+   return reinterpret_cast<const EntryHeader *>(entry)[-1];
+}
+
+bool entry_equals(const char *entry, std::uint32_t hash, llvm::StringRef str)
+{
+   const EntryHeader &header = get_entry_header(entry);
+   return header.hash == hash && header.length == str.size() &&
+         std::memcmp(entry, str.data(), str.size()) == 0;
+}
+
+} // anonymous namespace
+
+struct ConcurrentIdentifierTable::Table
+{
+   Table(size_t capacity, Table *previous)
+      : capacity(capacity),
+        previous(previous),
+        slots(new std::atomic<const char *>[capacity]()),
+        hashes(new std::atomic<std::uint32_t>[capacity]())
+   {
+      assert((capacity & (capacity - 1)) == 0 && "capacity must be a power of two");
+   }
+
+   ~Table()
+   {
+      delete[] slots;
+      delete[] hashes;
+   }
+
+   const size_t capacity;
+   Table *const previous;
+   std::atomic<const char *> *const slots;
+   /// the hashes of the entries of the slots, like the hash array of
+   /// StringMap it saves reading a colliding entry. Stored after the entry,
+   /// 0 until then.
+   std::atomic<std::uint32_t> *const hashes;
+   std::atomic<size_t> numEntries{0};
+   /// set when the table is three quarters full, no slot is claimed after
+   std::atomic<Table *> next{nullptr};
+   /// set when all slots are moved into next
+   std::atomic<bool> moved{false};
+};
+
+struct ConcurrentIdentifierTable::ThreadArena
+{
+   std::thread::id owner;
+   llvm::BumpPtrAllocator allocator;
+   ThreadArena *next = nullptr;
+};
+
+ConcurrentIdentifierTable::ConcurrentIdentifierTable()
+   : m_current(new Table(INITIAL_CAPACITY, nullptr)),
+     m_tableId(sg_nextTableId.fetch_add(1, std::memory_order_relaxed))
+{}
+
+ConcurrentIdentifierTable::~ConcurrentIdentifierTable()
+{
+   Table *table = m_current.load(std::memory_order_acquire);
+   while (Table *next = table->next.load(std::memory_order_acquire)) {
+      table = next;
+   }
+   while (table) {
+      Table *previous = table->previous;
+      delete table;
+      table = previous;
+   }
+   ThreadArena *arena = m_arenas.load(std::memory_order_acquire);
+   while (arena) {
+      ThreadArena *next = arena->next;
+      delete arena;
+      arena = next;
+   }
+}
+
+const char *ConcurrentIdentifierTable::intern(llvm::StringRef str)
+{
+   assert(str.size() <= UINT32_MAX && "identifier is too long");
+   // the hash of StringMap, cheaper than xxHash64 on short names
+   std::uint32_t hash = llvm::djbHash(str);
+   const char *entry = nullptr;
+   Table *table = m_current.load(std::memory_order_acquire);
+   while (true) {
+      if (const char *result = findOrInsert(*table, str, hash, entry)) {
+         if (result == entry) {
+            m_numEntries.fetch_add(1, std::memory_order_relaxed);
+         }
+         return result;
+      }
+      table = moveTable(*table);
+   }
+}
+
+const char *ConcurrentIdentifierTable::findOrInsert(Table &table, llvm::StringRef str,
+                                                    std::uint32_t hash, const char *&entry)
+{
+   if (table.next.load(std::memory_order_acquire)) {
+      return nullptr;
+   }
+   size_t mask = table.capacity - 1;
+   // triangular probing visits every slot of a power of two table
+   for (size_t probe = 0, index = hash & mask; probe < table.capacity;
+        ++probe, index = (index + probe) & mask) {
+      std::atomic<const char *> &slot = table.slots[index];
+      const char *current = slot.load(std::memory_order_acquire);
+      while (true) {
+         if (current == MOVED_SLOT) {
+            return nullptr;
+         }
+         if (current) {
+            std::uint32_t slotHash = table.hashes[index].load(std::memory_order_relaxed);
+            if (current == entry ||
+                ((slotHash == hash || slotHash == 0) && entry_equals(current, hash, str))) {
+               return current;
+            }
+            break;
+         }
+         if (!entry) {
+            void *memory = getThreadArena().allocator.Allocate(
+                     sizeof(EntryHeader) + str.size() + 1, alignof(EntryHeader));
+            auto *header = new (memory) EntryHeader{hash, static_cast<std::uint32_t>(str.size())};
+            char *chars = reinterpret_cast<char *>(header + 1);
+            std::memcpy(chars, str.data(), str.size());
+            chars[str.size()] = '\0';
+            entry = chars;
+         }
+         // fails if another thread took the slot or moved it, see which
+         if (slot.compare_exchange_strong(current, entry, std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+            table.hashes[index].store(hash, std::memory_order_relaxed);
+            size_t numEntries = table.numEntries.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (numEntries * 4 > table.capacity * 3) {
+               moveTable(table);
+            }
+            return entry;
+         }
+      }
+   }
+   // every slot is taken by inserts racing past the load limit
+   return nullptr;
+}
+
+ConcurrentIdentifierTable::Table *ConcurrentIdentifierTable::moveTable(Table &table)
+{
+   Table *next = table.next.load(std::memory_order_acquire);
+   if (!next) {
+      auto *created = new Table(table.capacity * 2, &table);
+      if (table.next.compare_exchange_strong(next, created, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+         next = created;
+      } else {
+         delete created;
+      }
+   }
+   if (table.moved.load(std::memory_order_acquire)) {
+      return next;
+   }
+   // Every thread which gets here copies all slots before it uses the next
+   // table. A slot is marked only after its entry was copied and no entry is
+   // put into a marked slot, so once the pass is over every entry of this
+   // table is in the next one and an insert there can not duplicate it.
+   // Copying an entry twice finds the first copy.
+   for (size_t index = 0; index < table.capacity; ++index) {
+      std::atomic<const char *> &slot = table.slots[index];
+      const char *current = slot.load(std::memory_order_acquire);
+      while (current != MOVED_SLOT) {
+         if (current) {
+            const EntryHeader &header = get_entry_header(current);
+            llvm::StringRef str(current, header.length);
+            const char *entry = current;
+            Table *target = next;
+            while (!findOrInsert(*target, str, header.hash, entry)) {
+               target = moveTable(*target);
+            }
+         }
+         if (slot.compare_exchange_weak(current, MOVED_SLOT, std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+            break;
+         }
+      }
+   }
+   table.moved.store(true, std::memory_order_release);
+   Table *expected = &table;
+   m_current.compare_exchange_strong(expected, next, std::memory_order_acq_rel,
+                                     std::memory_order_relaxed);
+   return next;
+}
+
+ConcurrentIdentifierTable::ThreadArena &ConcurrentIdentifierTable::getThreadArena()
+{
+   // the arena of the table this thread interned into last
+   static thread_local std::uint64_t cachedTableId = 0;
+   static thread_local ThreadArena *cachedArena = nullptr;
+   if (cachedTableId == m_tableId) {
+      return *cachedArena;
+   }
+   std::thread::id self = std::this_thread::get_id();
+   ThreadArena *arena = m_arenas.load(std::memory_order_acquire);
+   while (arena && arena->owner != self) {
+      arena = arena->next;
+   }
+   if (!arena) {
+      arena = new ThreadArena;
+      arena->owner = self;
+      arena->next = m_arenas.load(std::memory_order_relaxed);
+      while (!m_arenas.compare_exchange_weak(arena->next, arena, std::memory_order_release,
+                                             std::memory_order_relaxed)) {}
+   }
+   cachedTableId = m_tableId;
+   cachedArena = arena;
+   return *arena;
+}
+
+size_t ConcurrentIdentifierTable::getMemorySize() const
+{
+   size_t size = 0;
+   for (Table *table = m_current.load(std::memory_order_acquire); table; table = table->previous) {
+      size += sizeof(Table) + table->capacity * (sizeof(std::atomic<const char *>) +
+                                                 sizeof(std::atomic<std::uint32_t>));
+   }
+   for (ThreadArena *arena = m_arenas.load(std::memory_order_acquire); arena; arena = arena->next) {
+      size += sizeof(ThreadArena) + arena->allocator.getTotalMemory();
+   }
+   return size;
+}
+
+} // polar
@@ -840,6 +840,7 @@ DiagnosticState::Behavior DiagnosticState::determineBehavior(DiagID id) {
 
 void DiagnosticEngine::flushActiveDiagnostic() {
    assert(ActiveDiagnostic && "No active diagnostic to flush");
+   ++NumFlushedDiagnostics;
    if (TransactionCount == 0) {
       emitDiagnostic(*ActiveDiagnostic);
    } else {
@@ -24,6 +24,14 @@
 
 namespace polar {
 
+namespace {
+/// The stacks of active requests of the concurrent evaluators on this
+/// thread. A stack which is empty can be taken over by another evaluator.
+thread_local llvm::SmallVector<
+   std::pair<const Evaluator *, std::unique_ptr<llvm::SetVector<AnyRequest>>>, 1>
+   threadActiveRequests;
+} // end anonymous namespace
+
 AnyRequest::HolderBase::~HolderBase() { }
 
 std::string AnyRequest::getAsString() const {
@@ -65,6 +73,165 @@ void Evaluator::registerRequestFunctions(
 Evaluator::Evaluator(DiagnosticEngine &diags, bool debugDumpCycles)
    : diags(diags), debugDumpCycles(debugDumpCycles) { }
 
+void Evaluator::enableConcurrentEvaluation(unsigned numShards) {
+   assert(numShards > 0 && "a concurrent evaluator needs a shard");
+   assert(cache.empty() && dependencies.empty() && compactRequests.empty() &&
+          activeRequests.empty() && "requests were evaluated already");
+   shards = std::make_unique<ConcurrentShard[]>(numShards);
+   this->numShards = numShards;
+   if (recording == DependencyRecording::Compact)
+      recording = DependencyRecording::Full;
+}
+
+void Evaluator::setDependencyRecording(DependencyRecording recording) {
+   assert(cache.empty() && dependencies.empty() && compactRequests.empty() &&
+          activeRequests.empty() && "requests were evaluated already");
+   if (shards && recording == DependencyRecording::Compact)
+      recording = DependencyRecording::Full;
+   this->recording = recording;
+}
+
+size_t Evaluator::getDependencyGraphMemorySize() const {
+   size_t size = dependencies.getMemorySize();
+   for (const auto &entry : dependencies)
+      size += entry.second.capacity() * sizeof(AnyRequest);
+   for (unsigned i = 0; i < numShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      size += shards[i].dependencies.getMemorySize();
+      for (const auto &entry : shards[i].dependencies)
+         size += entry.second.capacity() * sizeof(AnyRequest);
+   }
+   size += compactRequestIDs.getMemorySize();
+   size += compactRequests.capacity() * sizeof(AnyRequest);
+   size += compactEdgeRanges.capacity() * sizeof(compactEdgeRanges[0]);
+   size += compactEdges.capacity() * sizeof(unsigned);
+   size += pendingEdges.capacity() * sizeof(unsigned);
+   size += compactFrames.capacity() * sizeof(compactFrames[0]);
+   return size;
+}
+
+const AnyRequest &Evaluator::internRequest(AnyRequest &&request) {
+   unsigned requestID = compactRequests.size();
+   compactRequests.push_back(request);
+   compactEdgeRanges.push_back({0, 0});
+   return compactRequestIDs.insert({std::move(request), requestID}).first->first;
+}
+
+ArrayRef<unsigned>
+Evaluator::getCompactDependencies(unsigned requestID) const {
+   // An active request has only pending dependencies, like a request whose
+   // dependencies were cleared for its evaluation.
+   for (unsigned i : indices(compactFrames)) {
+      if (compactFrames[i].first != requestID)
+         continue;
+      unsigned end = i + 1 < compactFrames.size() ? compactFrames[i + 1].second
+                                                  : pendingEdges.size();
+      return llvm::makeArrayRef(pendingEdges).slice(
+         compactFrames[i].second, end - compactFrames[i].second);
+   }
+   const auto &range = compactEdgeRanges[requestID];
+   return llvm::makeArrayRef(compactEdges).slice(range.first, range.second);
+}
+
+void Evaluator::commitCompactDependencies() {
+   unsigned requestID = compactFrames.back().first;
+   unsigned firstEdge = compactFrames.back().second;
+   unsigned numEdges = pendingEdges.size() - firstEdge;
+   auto &range = compactEdgeRanges[requestID];
+   // A request evaluated again, e.g. an uncached one, reuses its row when
+   // the new dependencies fit.
+   if (numEdges > range.second) {
+      range.first = compactEdges.size();
+      compactEdges.resize(range.first + numEdges);
+   }
+   range.second = numEdges;
+   std::copy(pendingEdges.begin() + firstEdge, pendingEdges.end(),
+             compactEdges.begin() + range.first);
+   pendingEdges.resize(firstEdge);
+}
+
+void Evaluator::popActiveRequest() {
+   getActiveRequests().pop_back();
+   if (recording == DependencyRecording::Compact) {
+      assert(pendingEdges.size() == compactFrames.back().second &&
+             "the dependencies of the request were not committed");
+      compactFrames.pop_back();
+   }
+}
+
+llvm::SetVector<AnyRequest> &Evaluator::getThreadActiveRequests() const {
+   decltype(threadActiveRequests)::value_type *unused = nullptr;
+   for (auto &entry : threadActiveRequests) {
+      if (entry.first == this)
+         return *entry.second;
+      if (!unused && entry.second->empty())
+         unused = &entry;
+   }
+   if (unused) {
+      unused->first = this;
+      return *unused->second;
+   }
+   threadActiveRequests.emplace_back(
+      this, std::make_unique<llvm::SetVector<AnyRequest>>());
+   return *threadActiveRequests.back().second;
+}
+
+void Evaluator::clearCache() {
+   if (!shards) {
+      cache.clear();
+      return;
+   }
+   for (unsigned i = 0; i < numShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      shards[i].cache.clear();
+   }
+}
+
+Optional<std::string>
+Evaluator::getCachedValueAsString(const AnyRequest &request) const {
+   if (!shards) {
+      auto cachedValue = cache.find(request);
+      if (cachedValue == cache.end())
+         return None;
+      return cachedValue->second.getAsString();
+   }
+   ConcurrentShard &shard = getShard(request);
+   std::lock_guard<std::mutex> lock(shard.mutex);
+   auto cachedValue = shard.cache.find(request);
+   if (cachedValue == shard.cache.end())
+      return None;
+   return cachedValue->second.getAsString();
+}
+
+Optional<std::vector<AnyRequest>>
+Evaluator::getDependencies(const AnyRequest &request) const {
+   if (recording == DependencyRecording::Compact) {
+      auto known = compactRequestIDs.find(request);
+      if (known == compactRequestIDs.end())
+         return None;
+      std::vector<AnyRequest> result;
+      for (unsigned requestID : getCompactDependencies(known->second))
+         result.push_back(compactRequests[requestID]);
+      return result;
+   }
+   if (!shards) {
+      auto known = dependencies.find(request);
+      if (known == dependencies.end())
+         return None;
+      return known->second;
+   }
+   ConcurrentShard &shard = getShard(request);
+   std::lock_guard<std::mutex> lock(shard.mutex);
+   auto known = shard.dependencies.find(request);
+   if (known == shard.dependencies.end())
+      return None;
+   return known->second;
+}
+
+unsigned Evaluator::getNumFlushedDiagnostics() const {
+   return diags.getNumFlushedDiagnostics();
+}
+
 void Evaluator::emitRequestEvaluatorGraphViz(llvm::StringRef graphVizPath) {
    std::error_code error;
    llvm::raw_fd_ostream out(graphVizPath, error, llvm::sys::fs::F_Text);
@@ -72,16 +239,38 @@ void Evaluator::emitRequestEvaluatorGraphViz(llvm::StringRef graphVizPath) {
 }
 
 bool Evaluator::checkDependency(const AnyRequest &request) {
+   auto &activeRequests = getActiveRequests();
+
+   // The compact graph has interned the request already.
+   unsigned requestID = 0;
+   if (recording == DependencyRecording::Compact)
+      requestID = compactRequestIDs.find(request)->second;
+
    // If there is an active request, record it's dependency on this request.
-   if (!activeRequests.empty())
-      dependencies[activeRequests.back()].push_back(request);
+   if (!activeRequests.empty() && recording != DependencyRecording::None) {
+      if (recording == DependencyRecording::Compact) {
+         pendingEdges.push_back(requestID);
+      } else if (shards) {
+         const AnyRequest &activeRequest = activeRequests.back();
+         ConcurrentShard &shard = getShard(activeRequest);
+         std::lock_guard<std::mutex> lock(shard.mutex);
+         shard.dependencies[activeRequest].push_back(request);
+      } else {
+         dependencies[activeRequests.back()].push_back(request);
+      }
+   }
 
    // Record this as an active request.
    if (activeRequests.insert(request)) {
+      if (recording == DependencyRecording::Compact)
+         compactFrames.push_back({requestID, pendingEdges.size()});
       return false;
    }
 
    // Diagnose cycle.
+   std::unique_lock<std::mutex> diagsLock(diagsMutex, std::defer_lock);
+   if (shards)
+      diagsLock.lock();
    diagnoseCycle(request);
 
    if (debugDumpCycles) {
@@ -99,7 +288,7 @@ bool Evaluator::checkDependency(const AnyRequest &request) {
 
 void Evaluator::diagnoseCycle(const AnyRequest &request) {
    request.diagnoseCycle(diags);
-   for (const auto &step : llvm::reverse(activeRequests)) {
+   for (const auto &step : llvm::reverse(getActiveRequests())) {
       if (step == request) return;
 
       step.noteCycleStep(diags);
@@ -135,12 +324,13 @@ void Evaluator::printDependencies(
    }
 
    // Print the cached value, if known.
-   auto cachedValue = cache.find(request);
-   if (cachedValue != cache.end()) {
+   if (auto cachedValue = getCachedValueAsString(request)) {
       out << " -> ";
-      printEscapedString(cachedValue->second.getAsString(), out);
+      printEscapedString(*cachedValue, out);
    }
 
+   auto dependsOn = getDependencies(request);
+
    if (!visitedAnywhere.insert(request).second) {
       // We've already seed this node. Check whether it's part of a cycle.
       if (std::find(visitedAlongPath.begin(), visitedAlongPath.end(), request)
@@ -155,7 +345,7 @@ void Evaluator::printDependencies(
       }
 
       out.resetColor();
-   } else if (dependencies.count(request) == 0) {
+   } else if (!dependsOn) {
       // We have not seen this node before, so we don't know its dependencies.
       out.changeColor(llvm::raw_ostream::GREEN);
       out << " (dependency not evaluated)\n";
@@ -176,10 +366,10 @@ void Evaluator::printDependencies(
       visitedAlongPath.push_back(request);
 
       // Print the children.
-      auto &dependsOn = dependencies.find(request)->second;
-      for (unsigned i : indices(dependsOn)) {
-         printDependencies(dependsOn[i], out, visitedAnywhere, visitedAlongPath,
-                           highlightPath, prefixStr, i == dependsOn.size()-1);
+      for (unsigned i : indices(*dependsOn)) {
+         printDependencies((*dependsOn)[i], out, visitedAnywhere,
+                           visitedAlongPath, highlightPath, prefixStr,
+                           i == dependsOn->size()-1);
       }
 
       // Drop our changes to the prefix.
@@ -202,6 +392,14 @@ void Evaluator::printDependenciesGraphviz(llvm::raw_ostream &out) const {
    for (const auto &knownRequest : dependencies) {
       allRequests.push_back(knownRequest.first);
    }
+   allRequests.insert(allRequests.end(), compactRequests.begin(),
+                      compactRequests.end());
+   for (unsigned i = 0; i < numShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards[i].mutex);
+      for (const auto &knownRequest : shards[i].dependencies) {
+         allRequests.push_back(knownRequest.first);
+      }
+   }
 
    // Sort the list of requests based on the display strings, so we get
    // deterministic output.
@@ -253,9 +451,9 @@ void Evaluator::printDependenciesGraphviz(llvm::raw_ostream &out) const {
    // Emit the edges.
    llvm::DenseMap<AnyRequest, unsigned> inDegree;
    for (const auto &source : allRequests) {
-      auto known = dependencies.find(source);
-      assert(known != dependencies.end());
-      for (const auto &target : known->second) {
+      auto known = getDependencies(source);
+      assert(known);
+      for (const auto &target : *known) {
          out << "  " << getNodeName(source) << " -> " << getNodeName(target)
              << ";\n";
          ++inDegree[target];
@@ -299,10 +497,9 @@ void Evaluator::printDependenciesGraphviz(llvm::raw_ostream &out) const {
       out << " [label=\"";
       printEscapedString(request.getAsString(), out);
 
-      auto cachedValue = cache.find(request);
-      if (cachedValue != cache.end()) {
+      if (auto cachedValue = getCachedValueAsString(request)) {
          out << " -> ";
-         printEscapedString(cachedValue->second.getAsString(), out);
+         printEscapedString(*cachedValue, out);
       }
       out << "\"";
 
@@ -0,0 +1,247 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/ast/PersistentRequestCache.h"
+#include "polarphp/ast/Decl.h"
+#include "polarphp/ast/SourceFile.h"
+#include "polarphp/basic/Filesystem.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "polarphp/basic/Version.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace polar {
+
+namespace endian = llvm::support::endian;
+
+namespace {
+
+/// File header: "PRQC", u32 version, u64 fingerprint, u32 number of files.
+/// A file is a u32 sized path, u64 content hash, u64 content size and u32
+/// number of requests, a request is a u32 sized name, u32 number of
+/// results and the results as u64 declaration id and u64 value.
+constexpr char CACHE_MAGIC[4] = {'P', 'R', 'Q', 'C'};
+constexpr std::uint32_t CACHE_VERSION = 1;
+
+/// Reads the cache file, any read past the end fails all later reads.
+class CacheReader
+{
+public:
+   explicit CacheReader(llvm::StringRef data)
+      : m_data(data)
+   {}
+
+   bool isValid() const
+   {
+      return m_valid;
+   }
+
+   bool atEnd() const
+   {
+      return m_data.empty();
+   }
+
+   llvm::StringRef readBytes(size_t size)
+   {
+      if (!m_valid || m_data.size() < size) {
+         m_valid = false;
+         return llvm::StringRef();
+      }
+      llvm::StringRef bytes = m_data.take_front(size);
+      m_data = m_data.drop_front(size);
+      return bytes;
+   }
+
+   std::uint32_t read32()
+   {
+      llvm::StringRef bytes = readBytes(4);
+      return m_valid ? endian::read32le(bytes.data()) : 0;
+   }
+
+   std::uint64_t read64()
+   {
+      llvm::StringRef bytes = readBytes(8);
+      return m_valid ? endian::read64le(bytes.data()) : 0;
+   }
+
+   llvm::StringRef readString()
+   {
+      return readBytes(read32());
+   }
+
+private:
+   llvm::StringRef m_data;
+   bool m_valid = true;
+};
+
+void write32(llvm::raw_ostream &out, std::uint32_t value)
+{
+   char bytes[4];
+   endian::write32le(bytes, value);
+   out.write(bytes, sizeof(bytes));
+}
+
+void write64(llvm::raw_ostream &out, std::uint64_t value)
+{
+   char bytes[8];
+   endian::write64le(bytes, value);
+   out.write(bytes, sizeof(bytes));
+}
+
+void write_string(llvm::raw_ostream &out, llvm::StringRef value)
+{
+   write32(out, value.size());
+   out << value;
+}
+
+} // anonymous namespace
+
+PersistentRequestCache::PersistentRequestCache(SourceManager &sourceMgr, const LangOptions &langOpts)
+   : m_sourceMgr(sourceMgr)
+{
+   std::string fingerprint;
+   llvm::raw_string_ostream stream(fingerprint);
+   stream << "cache-" << CACHE_VERSION
+          << ";" << version::retrieve_polarphp_full_version(langOpts.EffectiveLanguageVersion)
+          << ";" << version::retrieve_polarphp_revision();
+   m_fingerprint = llvm::xxHash64(stream.str());
+}
+
+bool PersistentRequestCache::load(llvm::StringRef path)
+{
+   assert(m_filesByBuffer.empty() && "results must be loaded before the first lookup");
+   m_files.clear();
+   auto bufferOrError = llvm::MemoryBuffer::getFile(path, /*FileSize=*/-1,
+                                                    /*RequiresNullTerminator=*/false);
+   if (!bufferOrError) {
+      return false;
+   }
+   CacheReader reader(bufferOrError.get()->getBuffer());
+   llvm::StringRef magic = reader.readBytes(sizeof(CACHE_MAGIC));
+   if (!reader.isValid() || std::memcmp(magic.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+       reader.read32() != CACHE_VERSION || reader.read64() != m_fingerprint) {
+      return false;
+   }
+   for (std::uint32_t numFiles = reader.read32(); numFiles > 0 && reader.isValid(); --numFiles) {
+      FileResults &file = m_files[reader.readString()];
+      file.contentHash = reader.read64();
+      file.contentSize = reader.read64();
+      for (std::uint32_t numRequests = reader.read32(); numRequests > 0 && reader.isValid(); --numRequests) {
+         auto &results = file.requests[reader.readString()];
+         for (std::uint32_t numResults = reader.read32(); numResults > 0 && reader.isValid(); --numResults) {
+            std::uint64_t declId = reader.read64();
+            results[declId] = reader.read64();
+         }
+      }
+   }
+   // a damaged file may hold wrong results, none of them is used
+   if (!reader.isValid() || !reader.atEnd()) {
+      m_files.clear();
+      return false;
+   }
+   return true;
+}
+
+std::error_code PersistentRequestCache::save(llvm::StringRef path) const
+{
+   std::vector<const llvm::StringMapEntry<FileResults> *> files;
+   for (const auto &file : m_files) {
+      if (llvm::sys::fs::exists(file.getKey())) {
+         files.push_back(&file);
+      }
+   }
+   return atomically_writing_to_file(path, [&](llvm::raw_pwrite_stream &out) {
+      out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+      write32(out, CACHE_VERSION);
+      write64(out, m_fingerprint);
+      write32(out, files.size());
+      for (const auto *file : files) {
+         write_string(out, file->getKey());
+         write64(out, file->getValue().contentHash);
+         write64(out, file->getValue().contentSize);
+         write32(out, file->getValue().requests.size());
+         for (const auto &request : file->getValue().requests) {
+            write_string(out, request.getKey());
+            write32(out, request.getValue().size());
+            for (const auto &result : request.getValue()) {
+               write64(out, result.first);
+               write64(out, result.second);
+            }
+         }
+      }
+   });
+}
+
+llvm::Optional<PersistentRequestKey>
+PersistentRequestCache::getKey(llvm::StringRef requestName, const Decl *decl)
+{
+   if (!decl || decl->isImplicit()) {
+      return llvm::None;
+   }
+   SourceLoc loc = decl->getLoc();
+   SourceFile *sourceFile = decl->getDeclContext()->getParentSourceFile();
+   if (loc.isInvalid() || !sourceFile) {
+      return llvm::None;
+   }
+   llvm::Optional<unsigned> bufferId = sourceFile->getBufferID();
+   if (!bufferId || m_sourceMgr.findBufferContainingLoc(loc) != *bufferId) {
+      return llvm::None;
+   }
+   std::uint64_t offset = m_sourceMgr.getLocOffsetInBuffer(loc, *bufferId);
+   return getKey(requestName, *bufferId,
+                 (offset << 8) | static_cast<std::uint64_t>(decl->getKind()));
+}
+
+PersistentRequestKey PersistentRequestCache::getKey(llvm::StringRef requestName, unsigned bufferId,
+                                                    std::uint64_t declId)
+{
+   FileResults &file = getFileResults(bufferId);
+   return PersistentRequestKey{&file.requests[requestName], declId};
+}
+
+size_t PersistentRequestCache::getNumResults() const
+{
+   size_t numResults = 0;
+   for (const auto &file : m_files) {
+      for (const auto &request : file.getValue().requests) {
+         numResults += request.getValue().size();
+      }
+   }
+   return numResults;
+}
+
+PersistentRequestCache::FileResults &PersistentRequestCache::getFileResults(unsigned bufferId)
+{
+   auto known = m_filesByBuffer.find(bufferId);
+   if (known != m_filesByBuffer.end()) {
+      return *known->second;
+   }
+   llvm::StringRef text = m_sourceMgr.getEntireTextForBuffer(bufferId);
+   std::uint64_t contentHash = llvm::xxHash64(text);
+   FileResults &file = m_files[m_sourceMgr.getIdentifierForBuffer(bufferId)];
+   if (file.contentHash != contentHash || file.contentSize != text.size()) {
+      file.requests.clear();
+      file.contentHash = contentHash;
+      file.contentSize = text.size();
+   }
+   m_filesByBuffer[bufferId] = &file;
+   return file;
+}
+
+} // polar
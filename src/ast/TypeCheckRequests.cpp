@@ -280,6 +280,15 @@ void IsFinalRequest::cacheResult(bool value) const {
       decl->getAttrs().add(new (decl->getAstContext()) FinalAttr(/*Implicit=*/true));
 }
 
+const Decl *IsFinalRequest::getPersistentDecl() const {
+   auto decl = std::get<0>(getStorage());
+   // The class of an extension member is found by looking up the extended
+   // type, which may live in another file.
+   if (isa<ExtensionDecl>(decl->getDeclContext()))
+      return nullptr;
+   return decl;
+}
+
 //----------------------------------------------------------------------------//
 // isDynamic computation.
 //----------------------------------------------------------------------------//
@@ -600,6 +609,19 @@ void SelfAccessKindRequest::cacheResult(SelfAccessKind value) const {
    funcDecl->setSelfAccessKind(value);
 }
 
+const Decl *SelfAccessKindRequest::getPersistentDecl() const {
+   auto *funcDecl = std::get<0>(getStorage());
+   // The value semantics of an extended type and the setter of the storage
+   // of an observer may depend on other files.
+   if (isa<ExtensionDecl>(funcDecl->getDeclContext()))
+      return nullptr;
+   if (auto *accessor = dyn_cast<AccessorDecl>(funcDecl)) {
+      if (accessor->isObservingAccessor())
+         return nullptr;
+   }
+   return funcDecl;
+}
+
 //----------------------------------------------------------------------------//
 // IsGetterMutatingRequest computation.
 //----------------------------------------------------------------------------//
@@ -881,6 +903,10 @@ void IsStaticRequest::cacheResult(bool result) const {
    FD->setStatic(result);
 }
 
+const Decl *IsStaticRequest::getPersistentDecl() const {
+   return std::get<0>(getStorage());
+}
+
 //----------------------------------------------------------------------------//
 // NeedsNewVTableEntryRequest computation.
 //----------------------------------------------------------------------------//
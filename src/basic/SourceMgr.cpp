@@ -27,17 +27,102 @@
 #include "polarphp/basic/SourceLoc.h"
 #include "polarphp/basic/SourceMgr.h"
 #include "polarphp/basic/Filesystem.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
 
+#include <algorithm>
 #include <optional>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace polar {
 
 using llvm::PrettyStackTraceString;
 using llvm::SMLoc;
 
+#if !defined(_WIN32)
+namespace {
+
+/// A read-only file mapping at a reserved address range. The range has room
+/// for the null terminator behind the file contents, so it is at least one
+/// byte larger than the file.
+class MappedSourceBuffer : public llvm::MemoryBuffer {
+  std::string Identifier;
+  size_t ReservedSize;
+
+public:
+  MappedSourceBuffer(StringRef Path, char *Start, size_t Size,
+                     size_t ReservedSize)
+      : Identifier(Path), ReservedSize(ReservedSize) {
+    init(Start, Start + Size, /*RequiresNullTerminator=*/true);
+  }
+
+  ~MappedSourceBuffer() override {
+    ::munmap(const_cast<char *>(getBufferStart()), ReservedSize);
+  }
+
+  StringRef getBufferIdentifier() const override { return Identifier; }
+
+  BufferKind getBufferKind() const override { return MemoryBuffer_MMap; }
+};
+
+size_t getReservedSize(size_t FileSize) {
+  size_t PageSize = llvm::sys::Process::getPageSizeEstimate();
+  return (FileSize + PageSize) / PageSize * PageSize;
+}
+
+/// Replaces whatever is mapped at \p Start by inaccessible pages, which
+/// hold the address range without using any memory.
+bool reserveAddressRange(char *Start, size_t Size) {
+  void *Result = ::mmap(Start, Size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                        -1, 0);
+  return Result != MAP_FAILED;
+}
+
+/// Maps the \p FileSize bytes of \p Path to \p Start, the rest of the
+/// reserved range is mapped to zero pages. Fails if the file does not have
+/// \p FileSize bytes any more.
+std::error_code mapFileAt(StringRef Path, char *Start, size_t FileSize,
+                          size_t ReservedSize) {
+  int FD = ::open(Path.str().c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD < 0)
+    return std::error_code(errno, std::generic_category());
+  struct stat Status;
+  std::error_code Error;
+  if (::fstat(FD, &Status) != 0) {
+    Error = std::error_code(errno, std::generic_category());
+  } else if (static_cast<size_t>(Status.st_size) != FileSize) {
+    Error = std::make_error_code(std::errc::file_exists);
+  } else {
+    size_t PageSize = llvm::sys::Process::getPageSizeEstimate();
+    size_t FilePages = (FileSize + PageSize - 1) / PageSize * PageSize;
+    // the file system zero fills the tail of the last file page, a file
+    // which ends at a page boundary gets its null terminator from the zero
+    // page behind it
+    if ((FilePages > 0 &&
+         ::mmap(Start, FilePages, PROT_READ, MAP_PRIVATE | MAP_FIXED, FD, 0) ==
+             MAP_FAILED) ||
+        (FilePages < ReservedSize &&
+         ::mmap(Start + FilePages, ReservedSize - FilePages, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED))
+      Error = std::error_code(errno, std::generic_category());
+  }
+  ::close(FD);
+  return Error;
+}
+
+} // end anonymous namespace
+#endif
+
 void SourceManager::verifyAllBuffers() const {
   llvm::PrettyStackTraceString backtrace{
     "Checking that all source buffers are still valid"
@@ -47,6 +132,7 @@ void SourceManager::verifyAllBuffers() const {
   LLVM_ATTRIBUTE_USED static char arbitraryTotal = 0;
   for (unsigned i = 1, e = LLVMSourceMgr.getNumBuffers(); i <= e; ++i) {
     auto *buffer = LLVMSourceMgr.getMemoryBuffer(i);
+    touchBuffer(i);
     if (buffer->getBufferSize() == 0)
       continue;
     arbitraryTotal += buffer->getBufferStart()[0];
@@ -89,7 +175,90 @@ SourceManager::addNewSourceBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer) {
   StringRef BufIdentifier = Buffer->getBufferIdentifier();
   auto ID = LLVMSourceMgr.AddNewSourceBuffer(std::move(Buffer), llvm::SMLoc());
   BufIdentIDMap[BufIdentifier] = ID;
+  indexNewBuffers();
+  return ID;
+}
+
+llvm::ErrorOr<unsigned> SourceManager::addMappedSourceFile(StringRef Path) {
+#if defined(_WIN32)
+  auto Buffer = llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer)
+    return Buffer.getError();
+  return addNewSourceBuffer(std::move(Buffer.get()));
+#else
+  struct stat Status;
+  if (::stat(Path.str().c_str(), &Status) != 0)
+    return std::error_code(errno, std::generic_category());
+  size_t FileSize = Status.st_size;
+  size_t ReservedSize = getReservedSize(FileSize);
+  void *Start = ::mmap(nullptr, ReservedSize, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (Start == MAP_FAILED)
+    return std::error_code(errno, std::generic_category());
+  // make room before the new file is mapped, a resident file counts
+  // against the limit of mappings of the process
+  evictMappedFiles(MaxResidentMappedFiles - 1);
+  if (std::error_code Error = mapFileAt(Path, static_cast<char *>(Start),
+                                        FileSize, ReservedSize)) {
+    ::munmap(Start, ReservedSize);
+    return Error;
+  }
+  unsigned ID = addNewSourceBuffer(std::make_unique<MappedSourceBuffer>(
+      Path, static_cast<char *>(Start), FileSize, ReservedSize));
+  ResidentMappedFiles.push_front(ID);
+  MappedFiles[ID] = {ReservedSize, true, ResidentMappedFiles.begin()};
   return ID;
+#endif
+}
+
+void SourceManager::setMaxResidentMappedFiles(unsigned Max) {
+  assert(Max > 0 && "the buffer in use must stay resident");
+  MaxResidentMappedFiles = Max;
+  evictMappedFiles(Max);
+}
+
+void SourceManager::touchBuffer(unsigned BufferID) const {
+  if (MappedFiles.empty())
+    return;
+  auto Found = MappedFiles.find(BufferID);
+  if (Found == MappedFiles.end())
+    return;
+  MappedFile &File = Found->second;
+  if (File.Resident) {
+    ResidentMappedFiles.splice(ResidentMappedFiles.begin(),
+                               ResidentMappedFiles, File.ResidentPos);
+    return;
+  }
+#if !defined(_WIN32)
+  evictMappedFiles(MaxResidentMappedFiles - 1);
+  auto *Buffer = LLVMSourceMgr.getMemoryBuffer(BufferID);
+  if (std::error_code Error = mapFileAt(
+          Buffer->getBufferIdentifier(),
+          const_cast<char *>(Buffer->getBufferStart()),
+          Buffer->getBufferSize(), File.ReservedSize))
+    llvm::report_fatal_error("can not map source file " +
+                             Buffer->getBufferIdentifier() + " again: " +
+                             Error.message());
+  ResidentMappedFiles.push_front(BufferID);
+  File.Resident = true;
+  File.ResidentPos = ResidentMappedFiles.begin();
+#endif
+}
+
+void SourceManager::evictMappedFiles(unsigned Max) const {
+#if !defined(_WIN32)
+  while (ResidentMappedFiles.size() > Max) {
+    unsigned ID = ResidentMappedFiles.back();
+    ResidentMappedFiles.pop_back();
+    MappedFile &File = MappedFiles.find(ID)->second;
+    auto *Buffer = LLVMSourceMgr.getMemoryBuffer(ID);
+    if (!reserveAddressRange(const_cast<char *>(Buffer->getBufferStart()),
+                             File.ReservedSize))
+      llvm::report_fatal_error("can not unmap source file " +
+                               Buffer->getBufferIdentifier());
+    File.Resident = false;
+  }
+#endif
 }
 
 unsigned SourceManager::addMemBufferCopy(llvm::MemoryBuffer *Buffer) {
@@ -219,6 +388,7 @@ unsigned SourceManager::getByteDistance(SourceLoc Start, SourceLoc End) const {
 }
 
 StringRef SourceManager::getEntireTextForBuffer(unsigned BufferID) const {
+  touchBuffer(BufferID);
   return LLVMSourceMgr.getMemoryBuffer(BufferID)->getBuffer();
 }
 
@@ -228,26 +398,83 @@ StringRef SourceManager::extractText(CharSourceRange Range,
 
   if (!BufferID)
     BufferID = findBufferContainingLoc(Range.getStart());
+  touchBuffer(*BufferID);
   StringRef Buffer = LLVMSourceMgr.getMemoryBuffer(*BufferID)->getBuffer();
   return Buffer.substr(getLocOffsetInBuffer(Range.getStart(), *BufferID),
                        Range.getByteLength());
 }
 
+void SourceManager::indexNewBuffers() const {
+  // Buffers added through the LLVM source manager directly are picked up
+  // by the next lookup.
+  auto less = std::less<const char *>();
+  auto rangeLess = [&](const BufferRange &LHS, const BufferRange &RHS) {
+    if (LHS.Start != RHS.Start)
+      return less(LHS.Start, RHS.Start);
+    return less(LHS.End, RHS.End);
+  };
+  for (unsigned e = LLVMSourceMgr.getNumBuffers(); NumIndexedBuffers < e;) {
+    unsigned ID = ++NumIndexedBuffers;
+    if (HasOverlappingBuffers)
+      continue;
+    auto Buf = LLVMSourceMgr.getMemoryBuffer(ID);
+    BufferRange Range = {Buf->getBufferStart(), Buf->getBufferEnd(), ID};
+    auto Pos = std::lower_bound(SortedBufferRanges.begin(),
+                                SortedBufferRanges.end(), Range, rangeLess);
+    if (Pos != SortedBufferRanges.end() && Pos->Start == Range.Start &&
+        Pos->End == Range.End) {
+      Pos->ID = ID;
+      continue;
+    }
+    // The ranges do not overlap, so their ends are sorted as well and only
+    // the neighbors have to be checked. Ranges which only share a boundary
+    // do not overlap.
+    if ((Pos != SortedBufferRanges.end() && less(Pos->Start, Range.End)) ||
+        (Pos != SortedBufferRanges.begin() &&
+         less(Range.Start, std::prev(Pos)->End))) {
+      HasOverlappingBuffers = true;
+      SortedBufferRanges.clear();
+      continue;
+    }
+    SortedBufferRanges.insert(Pos, Range);
+  }
+}
+
 Optional<unsigned>
 SourceManager::findBufferContainingLocInternal(SourceLoc Loc) const {
   assert(Loc.isValid());
-  // Search the buffers back-to front, so later alias buffers are
-  // visited first.
+  indexNewBuffers();
   auto less_equal = std::less_equal<const char *>();
-  for (unsigned i = LLVMSourceMgr.getNumBuffers(), e = 1; i >= e; --i) {
-    auto Buf = LLVMSourceMgr.getMemoryBuffer(i);
-    if (less_equal(Buf->getBufferStart(), Loc.m_value.getPointer()) &&
-        // Use <= here so that a pointer to the null at the end of the buffer
-        // is included as part of the buffer.
-        less_equal(Loc.m_value.getPointer(), Buf->getBufferEnd()))
-      return i;
+  const char *Ptr = Loc.m_value.getPointer();
+  if (HasOverlappingBuffers) {
+    // Search the buffers back-to front, so later alias buffers are
+    // visited first.
+    for (unsigned i = LLVMSourceMgr.getNumBuffers(), e = 1; i >= e; --i) {
+      auto Buf = LLVMSourceMgr.getMemoryBuffer(i);
+      if (less_equal(Buf->getBufferStart(), Ptr) &&
+          // Use <= here so that a pointer to the null at the end of the
+          // buffer is included as part of the buffer.
+          less_equal(Ptr, Buf->getBufferEnd()))
+        return i;
+    }
+    return None;
   }
-  return None;
+  // Find the last range starting at or before the location. A pointer to
+  // the null at the end of a buffer may also be the start of the next one,
+  // so walk back over the ranges ending there and pick the later buffer.
+  auto Pos = std::upper_bound(
+      SortedBufferRanges.begin(), SortedBufferRanges.end(), Ptr,
+      [&](const char *P, const BufferRange &Range) {
+        return !less_equal(Range.Start, P);
+      });
+  Optional<unsigned> Found;
+  while (Pos != SortedBufferRanges.begin() &&
+         less_equal(Ptr, std::prev(Pos)->End)) {
+    --Pos;
+    if (!Found || Pos->ID > *Found)
+      Found = Pos->ID;
+  }
+  return Found;
 }
 
 unsigned SourceManager::findBufferContainingLoc(SourceLoc Loc) const {
@@ -274,6 +501,7 @@ llvm::Optional<unsigned> SourceManager::resolveFromLineCol(unsigned BufferId,
     return None;
   }
   const bool LineEnd = Col == ~0u;
+  touchBuffer(BufferId);
   auto InputBuf = getLLVMSourceMgr().getMemoryBuffer(BufferId);
   const char *Ptr = InputBuf->getBufferStart();
   const char *End = InputBuf->getBufferEnd();
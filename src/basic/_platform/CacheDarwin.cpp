@@ -87,4 +87,15 @@ void CacheImpl::destroy()
    cache_destroy(static_cast<cache_t*>(impl));
 }
 
+void CacheImpl::setCostLimit(size_t limit)
+{
+   // libcache evicts under memory pressure
+}
+
+CacheStatistics CacheImpl::getStatistics() const
+{
+   // libcache does not count
+   return CacheStatistics();
+}
+
 } // polar::sys
@@ -46,6 +46,8 @@ struct DefaultCache
    llvm::sys::Mutex mutex;
    CacheImpl::CallBacks callbacks;
    llvm::DenseMap<DefaultCacheKey, void *> entries;
+   uint64_t hits = 0;
+   uint64_t misses = 0;
 
    explicit DefaultCache(CacheImpl::CallBacks callbacks)
       : callbacks(std::move(callbacks)) {}
@@ -133,8 +135,10 @@ bool CacheImpl::getAndRetain(const void *key, void **valueOut)
       // FIXME: Not thread-safe! It should avoid deleting the value until
       // 'releaseValue is called on it.
       *valueOut = entry->second;
+      ++defaultCache.hits;
       return true;
    }
+   ++defaultCache.misses;
    return false;
 }
 
@@ -177,4 +181,20 @@ void CacheImpl::destroy()
    delete static_cast<DefaultCache*>(impl);
 }
 
+void CacheImpl::setCostLimit(size_t limit)
+{
+   // never evicts
+}
+
+CacheStatistics CacheImpl::getStatistics() const
+{
+   DefaultCache &defaultCache = *static_cast<DefaultCache*>(impl);
+   llvm::sys::ScopedLock lock(defaultCache.mutex);
+   CacheStatistics stats;
+   stats.hits = defaultCache.hits;
+   stats.misses = defaultCache.misses;
+   stats.entries = defaultCache.entries.size();
+   return stats;
+}
+
 } // polar::sys
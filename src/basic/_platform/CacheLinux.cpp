@@ -0,0 +1,361 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+//  This file implements the caching mechanism on Linux. The entries are
+//  spread over segments with a lock each, a segment evicts its least
+//  recently used entries when the sum of their costs exceeds its share of
+//  the cost limit.
+
+#include "polarphp/basic/Cache.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <list>
+#include <mutex>
+
+namespace polar::sys {
+
+using llvm::StringRef;
+
+namespace {
+
+/// The cost of the values of the code completion cache is the memory they
+/// own, so this is about the memory a cache may hold.
+constexpr size_t DEFAULT_COST_LIMIT = 256 * 1024 * 1024;
+constexpr size_t NUM_SEGMENTS = 16;
+
+struct CacheEntry
+{
+   void *key;
+   void *value;
+   size_t cost;
+   uintptr_t hash;
+};
+
+/// The key of the lookup table of a segment, the key hash is computed once
+/// outside of the segment lock.
+struct SegmentKey
+{
+   void *key;
+   uintptr_t hash;
+   const CacheImpl::CallBacks *callbacks;
+};
+
+struct SegmentKeyInfo
+{
+   static SegmentKey getEmptyKey()
+   {
+      return {llvm::DenseMapInfo<void *>::getEmptyKey(), 0, nullptr};
+   }
+
+   static SegmentKey getTombstoneKey()
+   {
+      return {llvm::DenseMapInfo<void *>::getTombstoneKey(), 0, nullptr};
+   }
+
+   static unsigned getHashValue(const SegmentKey &value)
+   {
+      return llvm::DenseMapInfo<uintptr_t>::getHashValue(value.hash);
+   }
+
+   static bool isEqual(const SegmentKey &lhs, const SegmentKey &rhs)
+   {
+      if (lhs.key == rhs.key) {
+         return true;
+      }
+      if (!lhs.callbacks || !rhs.callbacks || lhs.hash != rhs.hash) {
+         return false;
+      }
+      return lhs.callbacks->keyIsEqualCB(lhs.key, rhs.key, lhs.callbacks->userData);
+   }
+};
+
+struct CacheSegment
+{
+   std::mutex mutex;
+   /// the most recently used entry first
+   std::list<CacheEntry> entries;
+   llvm::DenseMap<SegmentKey, std::list<CacheEntry>::iterator, SegmentKeyInfo> index;
+   size_t totalCost = 0;
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t evictions = 0;
+};
+
+/// A value handed out by setAndRetain() or getAndRetain() and not released
+/// yet. The entries of the value dropped in the meantime release it when
+/// the last user did.
+struct PinnedValue
+{
+   unsigned retainCount = 0;
+   unsigned pendingReleases = 0;
+};
+
+struct PinSegment
+{
+   std::mutex mutex;
+   llvm::DenseMap<void *, PinnedValue> values;
+};
+
+using DroppedEntries = llvm::SmallVector<CacheEntry, 4>;
+
+class SegmentedCache
+{
+public:
+   explicit SegmentedCache(const CacheImpl::CallBacks &callbacks)
+      : m_callbacks(callbacks)
+   {}
+
+   const CacheImpl::CallBacks &getCallBacks() const
+   {
+      return m_callbacks;
+   }
+
+   CacheSegment &getSegment(uintptr_t hash)
+   {
+      return m_segments[llvm::hash_value(hash) % NUM_SEGMENTS];
+   }
+
+   std::array<CacheSegment, NUM_SEGMENTS> &getSegments()
+   {
+      return m_segments;
+   }
+
+   size_t getSegmentCostLimit() const
+   {
+      return m_segmentCostLimit.load(std::memory_order_relaxed);
+   }
+
+   void setCostLimit(size_t limit)
+   {
+      m_segmentCostLimit.store(limit / NUM_SEGMENTS, std::memory_order_relaxed);
+   }
+
+   SegmentKey makeKey(void *key, uintptr_t hash) const
+   {
+      return {key, hash, &m_callbacks};
+   }
+
+   void pinValue(void *value)
+   {
+      PinSegment &segment = getPinSegment(value);
+      std::lock_guard<std::mutex> lock(segment.mutex);
+      ++segment.values[value].retainCount;
+   }
+
+   void unpinValue(void *value)
+   {
+      unsigned pendingReleases = 0;
+      {
+         PinSegment &segment = getPinSegment(value);
+         std::lock_guard<std::mutex> lock(segment.mutex);
+         auto iter = segment.values.find(value);
+         assert(iter != segment.values.end() && "release of a value which is not retained");
+         if (--iter->second.retainCount > 0) {
+            return;
+         }
+         pendingReleases = iter->second.pendingReleases;
+         segment.values.erase(iter);
+      }
+      while (pendingReleases-- > 0) {
+         m_callbacks.valueReleaseCB(value, m_callbacks.userData);
+      }
+   }
+
+   /// Takes \p entry out of \p segment, the caller drops it after the
+   /// segment is unlocked.
+   void unlinkEntry(CacheSegment &segment, std::list<CacheEntry>::iterator entry,
+                    DroppedEntries &dropped)
+   {
+      segment.index.erase(makeKey(entry->key, entry->hash));
+      segment.totalCost -= entry->cost;
+      dropped.push_back(*entry);
+      segment.entries.erase(entry);
+   }
+
+   /// Evicts the least recently used entries of \p segment but the most
+   /// recent one until its cost fits the limit.
+   void evictEntries(CacheSegment &segment, DroppedEntries &dropped)
+   {
+      size_t limit = getSegmentCostLimit();
+      while (segment.totalCost > limit && segment.entries.size() > 1) {
+         unlinkEntry(segment, std::prev(segment.entries.end()), dropped);
+         ++segment.evictions;
+      }
+   }
+
+   /// Destroys the keys of \p dropped and releases their values, a value
+   /// still retained by a user is released when the user releases it.
+   void dropEntries(const DroppedEntries &dropped)
+   {
+      for (const CacheEntry &entry : dropped) {
+         m_callbacks.keyDestroyCB(entry.key, m_callbacks.userData);
+         {
+            PinSegment &segment = getPinSegment(entry.value);
+            std::lock_guard<std::mutex> lock(segment.mutex);
+            auto iter = segment.values.find(entry.value);
+            if (iter != segment.values.end()) {
+               ++iter->second.pendingReleases;
+               continue;
+            }
+         }
+         m_callbacks.valueReleaseCB(entry.value, m_callbacks.userData);
+      }
+   }
+
+private:
+   PinSegment &getPinSegment(void *value)
+   {
+      return m_pinSegments[llvm::hash_value(value) % NUM_SEGMENTS];
+   }
+
+private:
+   CacheImpl::CallBacks m_callbacks;
+   std::atomic<size_t> m_segmentCostLimit{DEFAULT_COST_LIMIT / NUM_SEGMENTS};
+   std::array<CacheSegment, NUM_SEGMENTS> m_segments;
+   std::array<PinSegment, NUM_SEGMENTS> m_pinSegments;
+};
+
+} // anonymous namespace
+
+CacheImpl::ImplTy CacheImpl::create(StringRef name, const CallBacks &callbacks)
+{
+   // only the Darwin cache is labeled with the name
+   (void)name;
+   return new SegmentedCache(callbacks);
+}
+
+void CacheImpl::setAndRetain(void *key, void *value, size_t cost)
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   const CallBacks &callbacks = cache.getCallBacks();
+   // the reference of the entry, the retain of the caller is a pin
+   callbacks.valueRetainCB(value, callbacks.userData);
+   cache.pinValue(value);
+   uintptr_t hash = callbacks.keyHashCB(key, callbacks.userData);
+   CacheSegment &segment = cache.getSegment(hash);
+   DroppedEntries dropped;
+   {
+      std::lock_guard<std::mutex> lock(segment.mutex);
+      auto found = segment.index.find(cache.makeKey(key, hash));
+      if (found != segment.index.end()) {
+         cache.unlinkEntry(segment, found->second, dropped);
+      }
+      segment.entries.push_front({key, value, cost, hash});
+      segment.index[cache.makeKey(key, hash)] = segment.entries.begin();
+      segment.totalCost += cost;
+      cache.evictEntries(segment, dropped);
+   }
+   cache.dropEntries(dropped);
+}
+
+bool CacheImpl::getAndRetain(const void *key, void **valueOut)
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   const CallBacks &callbacks = cache.getCallBacks();
+   void *lookupKey = const_cast<void *>(key);
+   uintptr_t hash = callbacks.keyHashCB(lookupKey, callbacks.userData);
+   CacheSegment &segment = cache.getSegment(hash);
+   std::lock_guard<std::mutex> lock(segment.mutex);
+   auto found = segment.index.find(cache.makeKey(lookupKey, hash));
+   if (found == segment.index.end()) {
+      ++segment.misses;
+      return false;
+   }
+   ++segment.hits;
+   segment.entries.splice(segment.entries.begin(), segment.entries, found->second);
+   *valueOut = found->second->value;
+   // pinned under the segment lock, so the entry can not be dropped before
+   cache.pinValue(*valueOut);
+   return true;
+}
+
+void CacheImpl::releaseValue(void *value)
+{
+   static_cast<SegmentedCache *>(impl)->unpinValue(value);
+}
+
+bool CacheImpl::remove(const void *key)
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   const CallBacks &callbacks = cache.getCallBacks();
+   void *lookupKey = const_cast<void *>(key);
+   uintptr_t hash = callbacks.keyHashCB(lookupKey, callbacks.userData);
+   CacheSegment &segment = cache.getSegment(hash);
+   DroppedEntries dropped;
+   {
+      std::lock_guard<std::mutex> lock(segment.mutex);
+      auto found = segment.index.find(cache.makeKey(lookupKey, hash));
+      if (found == segment.index.end()) {
+         return false;
+      }
+      cache.unlinkEntry(segment, found->second, dropped);
+   }
+   cache.dropEntries(dropped);
+   return true;
+}
+
+void CacheImpl::removeAll()
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   for (CacheSegment &segment : cache.getSegments()) {
+      DroppedEntries dropped;
+      {
+         std::lock_guard<std::mutex> lock(segment.mutex);
+         dropped.append(segment.entries.begin(), segment.entries.end());
+         segment.entries.clear();
+         segment.index.clear();
+         segment.totalCost = 0;
+      }
+      cache.dropEntries(dropped);
+   }
+}
+
+void CacheImpl::destroy()
+{
+   removeAll();
+   delete static_cast<SegmentedCache *>(impl);
+}
+
+void CacheImpl::setCostLimit(size_t limit)
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   cache.setCostLimit(limit);
+   for (CacheSegment &segment : cache.getSegments()) {
+      DroppedEntries dropped;
+      {
+         std::lock_guard<std::mutex> lock(segment.mutex);
+         cache.evictEntries(segment, dropped);
+      }
+      cache.dropEntries(dropped);
+   }
+}
+
+CacheStatistics CacheImpl::getStatistics() const
+{
+   SegmentedCache &cache = *static_cast<SegmentedCache *>(impl);
+   CacheStatistics stats;
+   for (CacheSegment &segment : cache.getSegments()) {
+      std::lock_guard<std::mutex> lock(segment.mutex);
+      stats.hits += segment.hits;
+      stats.misses += segment.misses;
+      stats.evictions += segment.evictions;
+      stats.entries += segment.entries.size();
+      stats.totalCost += segment.totalCost;
+   }
+   return stats;
+}
+
+} // polar::sys
@@ -46,6 +46,18 @@ const char *ToolChain::JobContext::getAllSourcesPath() const {
    return C.getAllSourcesPath();
 }
 
+const char *ToolChain::JobContext::computeRequestCacheDir() const {
+   // Only an incremental build compiles the same files again, and it
+   // requires an output file map.
+   if (!C.getIncrementalBuildEnabled())
+      return nullptr;
+   const llvm::opt::Arg *A = Args.getLastArg(options::OPT_output_file_map);
+   if (!A)
+      return nullptr;
+   StringRef Dir = llvm::sys::path::parent_path(A->getValue());
+   return Args.MakeArgString(Dir.empty() ? "." : Dir);
+}
+
 const char *
 ToolChain::JobContext::getTemporaryFilePath(const llvm::Twine &name,
                                             StringRef suffix) const {
@@ -357,6 +357,11 @@ ToolChain::constructInvocation(const CompileJobAction &job,
                          Arguments);
    addRuntimeLibraryFlags(context.OI, Arguments);
 
+   if (const char *RequestCacheDir = context.computeRequestCacheDir()) {
+      Arguments.push_back("-request-cache-dir");
+      Arguments.push_back(RequestCacheDir);
+   }
+
    // Pass along an -import-objc-header arg, replacing the argument with the name
    // of any input PCH to the current action if one is present.
    if (context.Args.hasArgNoClaim(options::OPT_import_objc_header)) {
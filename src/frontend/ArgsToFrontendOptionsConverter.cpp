@@ -61,6 +61,9 @@ bool ArgsToFrontendOptionsConverter::convert(
    if (const Arg *A = Args.getLastArg(OPT_prebuilt_module_cache_path)) {
       Opts.PrebuiltModuleCachePath = A->getValue();
    }
+   if (const Arg *A = Args.getLastArg(OPT_request_cache_dir)) {
+      Opts.RequestCacheDir = A->getValue();
+   }
 
    Opts.IndexSystemModules |= Args.hasArg(OPT_index_system_modules);
 
@@ -203,6 +206,9 @@ void ArgsToFrontendOptionsConverter::computePrintStatsOptions() {
    using namespace options;
    Opts.PrintStats |= Args.hasArg(OPT_print_stats);
    Opts.PrintClangStats |= Args.hasArg(OPT_print_clang_stats);
+   Opts.PrintArenaStatsPerExpr |= Args.hasArg(OPT_print_arena_stats_per_expr);
+   Opts.PrintArenaStats |=
+      Args.hasArg(OPT_print_arena_stats) || Opts.PrintArenaStatsPerExpr;
 #if defined(NDEBUG) && !defined(LLVM_ENABLE_STATS)
    if (Opts.PrintStats || Opts.PrintClangStats)
     Diags.diagnose(SourceLoc(), diag::stats_disabled);
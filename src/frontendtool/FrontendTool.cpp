@@ -32,6 +32,7 @@
 #include "polarphp/ast/GenericSignatureBuilder.h"
 #include "polarphp/ast/IRGenOptions.h"
 #include "polarphp/ast/NameLookup.h"
+#include "polarphp/ast/PersistentRequestCache.h"
 #include "polarphp/ast/AstMangler.h"
 #include "polarphp/ast/ReferencedNameTracker.h"
 #include "polarphp/ast/TypeRefinementContext.h"
@@ -1206,6 +1207,7 @@ static bool performCompile(CompilerInstance &Instance,
       bool ParseDelayedDeclListsOnEnd =
          Action == FrontendOptions::ActionType::DumpParse ||
          Invocation.getDiagnosticOptions().VerifyMode != DiagnosticOptions::NoVerify;
+      ArenaAccountingRAII arenaScope(Instance.getAstContext(), "parse");
       Instance.performParseOnly(/*EvaluateConditionals*/
          Action == FrontendOptions::ActionType::EmitImportedModules,
          ParseDelayedDeclListsOnEnd);
@@ -1768,6 +1770,24 @@ computeStatsReporter(const CompilerInvocation &Invocation, CompilerInstance *Ins
       ProfileEvents, ProfileEntities);
 }
 
+/// Returns the file the persistent request cache of this frontend job is
+/// kept in, or an empty string if -request-cache-dir was not passed. Every
+/// primary file, or the whole module, gets a file of its own so that
+/// frontend jobs running in parallel never write the same file.
+static std::string
+computeRequestCachePath(const CompilerInvocation &Invocation) {
+   auto &FEOpts = Invocation.getFrontendOptions();
+   if (FEOpts.RequestCacheDir.empty())
+      return std::string();
+
+   SmallString<128> Path(FEOpts.RequestCacheDir);
+   llvm::sys::path::append(
+      Path, FEOpts.ModuleName + "-" +
+               FEOpts.InputsAndOutputs.getStatsFileMangledInputName() +
+               ".requestcache");
+   return Path.str().str();
+}
+
 /// Creates a diagnostic consumer that handles dispatching diagnostics to
 /// multiple output files, based on the supplementary output paths specified by
 /// \p inputsAndOutputs.
@@ -2049,6 +2069,20 @@ int polar::performFrontend(ArrayRef<const char *> Args,
       Instance->getAstContext().setStatsReporter(StatsReporter.get());
    }
 
+   if (Invocation.getFrontendOptions().PrintArenaStats) {
+      Instance->getAstContext().enableArenaAccounting(
+         Invocation.getFrontendOptions().PrintArenaStatsPerExpr);
+   }
+
+   std::string RequestCachePath = computeRequestCachePath(Invocation);
+   std::unique_ptr<PersistentRequestCache> RequestCache;
+   if (!RequestCachePath.empty()) {
+      RequestCache = std::make_unique<PersistentRequestCache>(
+         Instance->getSourceMgr(), Invocation.getLangOptions());
+      RequestCache->load(RequestCachePath);
+      Instance->getAstContext().evaluator.setPersistentCache(RequestCache.get());
+   }
+
    // The compiler instance has been configured; notify our observer.
    if (observer) {
       observer->configuredCompiler(*Instance);
@@ -2059,6 +2093,15 @@ int polar::performFrontend(ArrayRef<const char *> Args,
       performCompile(*Instance, Invocation, Args, ReturnValue, observer,
                      StatsReporter.get());
 
+   if (Invocation.getFrontendOptions().PrintArenaStats)
+      Instance->getAstContext().printArenaStatistics(llvm::errs());
+
+   if (RequestCache) {
+      // A cache that can not be written only costs the next build time.
+      Instance->getAstContext().evaluator.setPersistentCache(nullptr);
+      (void)RequestCache->save(RequestCachePath);
+   }
+
 //   if (!HadError) {
 //      mangle::printManglingStats();
 //   }
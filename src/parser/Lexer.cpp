@@ -14,6 +14,8 @@
 #include "polarphp/parser/CommonDefs.h"
 #include "polarphp/parser/internal/YYLexerDefs.h"
 #include "polarphp/parser/internal/YYLexerExtras.h"
+#include "polarphp/parser/internal/KeywordTable.h"
+#include "polarphp/parser/internal/TriviaScanner.h"
 #include "polarphp/parser/Confusables.h"
 #include "clang/Basic/CharInfo.h"
 #include "polarphp/syntax/Trivia.h"
@@ -115,10 +117,22 @@ void Lexer::initialize(unsigned offset, unsigned endOffset)
    }
    m_artificialEof = m_bufferStart + endOffset;
    m_yyCursor = m_bufferStart + offset;
+   m_initialOffset = offset;
 
    assert(m_nextToken.is(TokenKindType::T_UNKNOWN_MARK));
 }
 
+std::unique_ptr<Lexer> Lexer::makeRestartedLexer() const
+{
+   std::unique_ptr<Lexer> lexer(new Lexer(m_langOpts, m_sourceMgr, m_bufferId, m_diags,
+                                          m_commentRetention, m_triviaRetention,
+                                          m_initialOffset, m_artificialEof - m_bufferStart));
+   // only carry over the configuration, not the state of the finished scan
+   lexer->setCheckHeredocIndentation(m_flags.isCheckHeredocIndentation());
+   lexer->m_parser = m_parser;
+   return lexer;
+}
+
 void Lexer::lex(Token &result, ParsedTrivia &leadingTriviaResult, ParsedTrivia &trailingTrivialResult)
 {
    lexImpl();
@@ -203,19 +217,35 @@ void Lexer::formToken(syntax::TokenKindType kind, const unsigned char *tokenStar
 void Lexer::formVariableToken(const unsigned char *tokenStart)
 {
    formToken(TokenKindType::T_VARIABLE, tokenStart);
-   m_nextToken.setValue(StringRef(reinterpret_cast<const char *>(tokenStart + 1), m_yyLength - 1));
+   m_nextToken.setValueRef(StringRef(reinterpret_cast<const char *>(tokenStart + 1), m_yyLength - 1));
 }
 
 void Lexer::formIdentifierToken(const unsigned char *tokenStart)
 {
    formToken(TokenKindType::T_IDENTIFIER_STRING, tokenStart);
-   m_nextToken.setValue(StringRef(reinterpret_cast<const char *>(tokenStart), m_yyLength));
+   m_nextToken.setValueRef(StringRef(reinterpret_cast<const char *>(tokenStart), m_yyLength));
+}
+
+void Lexer::formKeywordOrIdentifierToken()
+{
+   const unsigned char *yytext = m_yyText;
+   TokenKindType kind = lookup_keyword(StringRef(reinterpret_cast<const char *>(yytext), m_yyLength));
+   if (kind == TokenKindType::T_IDENTIFIER_STRING) {
+      formIdentifierToken(yytext);
+      return;
+   }
+   /// the "static" / "::" rule of KeywordDfaRules.l
+   if (kind == TokenKindType::T_STATIC && m_artificialEof - m_yyCursor >= 2 &&
+       m_yyCursor[0] == ':' && m_yyCursor[1] == ':') {
+      kind = TokenKindType::T_CLASS_REF_STATIC;
+   }
+   formToken(kind, yytext);
 }
 
 void Lexer::formStringVariableToken(const unsigned char *tokenStart)
 {
    formToken(TokenKindType::T_STRING_VARNAME, tokenStart);
-   m_nextToken.setValue(StringRef(reinterpret_cast<const char *>(tokenStart), m_yyLength));
+   m_nextToken.setValueRef(StringRef(reinterpret_cast<const char *>(tokenStart), m_yyLength));
 }
 
 void Lexer::formErrorToken(const unsigned char *tokenStart)
@@ -351,6 +381,39 @@ restart:
    --m_yyCursor;
 }
 
+void Lexer::skipTrivia()
+{
+   bool sawNewline = false;
+   while (true) {
+      m_yyCursor = skip_whitespace_run(m_yyCursor, m_bufferEnd, sawNewline);
+      // m_yyCursor[0] is the nul terminator at m_bufferEnd, so m_yyCursor[1] is
+      // only read when there is one more byte
+      if (m_yyCursor[0] != '/') {
+         break;
+      }
+      if (m_yyCursor[1] == '/') {
+         ++m_yyCursor;
+         advance_to_end_of_line(m_yyCursor, m_bufferEnd);
+      } else if (m_yyCursor[1] == '*') {
+         ++m_yyCursor;
+         if (skip_to_end_of_slash_star_comment(m_yyCursor, m_bufferEnd)) {
+            sawNewline = true;
+         }
+      } else {
+         break;
+      }
+   }
+   if (sawNewline) {
+      m_nextToken.setAtStartOfLine(true);
+   }
+   // hashbang, nul characters, control and non-ASCII characters are rare,
+   // let lexTrivia() decide about them, the collected trivia is dropped anyway
+   unsigned char c = *m_yyCursor;
+   if (c <= ' ' || c >= 0x7F || c == '#') {
+      lexTrivia(m_leadingTrivia, /* IsForTrailingTrivia */ false);
+   }
+}
+
 bool Lexer::lexUnknown(bool emitDiagnosticsIfToken)
 {
    const unsigned char *temp = m_yyCursor - 1;
@@ -535,6 +598,29 @@ void Lexer::skipHashbang(bool eatNewline)
    skipToEndOfLine(eatNewline);
 }
 
+void Lexer::lexCastToken()
+{
+   /// yytext is "(" {TABS_AND_SPACES} {LABEL} {TABS_AND_SPACES} ")"
+   const char *iter = reinterpret_cast<const char *>(m_yyText) + 1;
+   const char *end = reinterpret_cast<const char *>(m_yyCursor) - 1;
+   while (*iter == ' ' || *iter == '\t') {
+      ++iter;
+   }
+   const char *typeEnd = iter;
+   while (typeEnd != end && *typeEnd != ' ' && *typeEnd != '\t') {
+      ++typeEnd;
+   }
+   TokenKindType kind = lookup_cast_type(StringRef(iter, typeEnd - iter));
+   if (kind != TokenKindType::T_UNKNOWN_MARK) {
+      formToken(kind);
+      return;
+   }
+   /// no cast, the label is lexed again as the next token
+   m_yyCursor = m_yyText + 1;
+   m_yyLength = 1;
+   formToken(get_token_kind_by_char('('));
+}
+
 void Lexer::lexBinaryNumber()
 {
    /// The +/- 2 skips "0b"
@@ -736,20 +822,18 @@ void Lexer::lexSingleQuoteString()
          return;
       }
    }
-   std::string strValue;
-   // '0b', '\'' and '\''
-   if (m_yyLength - bprefix - 2 <= 1) {
-      if (m_yyLength - bprefix - 2 == 1) {
-         unsigned char c = *(yytext + bprefix + 1);
-         strValue.push_back(c);
-      }
-   } else {
-      strValue.append(reinterpret_cast<const char *>(m_yyText + bprefix + 1), m_yyLength - bprefix - 2);
-      long filteredLength = convert_single_quote_str_escape_sequences(strValue.begin(), strValue.end(), *this);
-      strValue.resize(filteredLength);
-   }
+   // strip 'b' prefix and the quotes
+   StringRef content(reinterpret_cast<const char *>(yytext + bprefix + 1), m_yyLength - bprefix - 2);
    formToken(TokenKindType::T_CONSTANT_ENCAPSED_STRING);
-   m_nextToken.setValue(strValue);
+   if (content.find('\\') == StringRef::npos) {
+      // nothing to unescape, the value is spelled in the source buffer
+      m_nextToken.setValueRef(content);
+      return;
+   }
+   std::string strValue(content.str());
+   long filteredLength = convert_single_quote_str_escape_sequences(strValue.begin(), strValue.end(), *this);
+   strValue.resize(filteredLength);
+   m_nextToken.setValue(std::move(strValue));
    return;
 }
 
@@ -763,7 +847,8 @@ void Lexer::lexDoubleQuoteString()
       formToken(TokenKindType::T_ERROR);
       return;
    }
-   if (yytext[0] == '\\' && yycursor < yylimit) {
+   bool hasEscapes = yytext[0] == '\\';
+   if (hasEscapes && yycursor < yylimit) {
       ++yycursor;
    }
    while (yycursor < yylimit) {
@@ -781,6 +866,7 @@ void Lexer::lexDoubleQuoteString()
          }
          continue;
       case '\\':
+         hasEscapes = true;
          if (yycursor < yylimit) {
             ++yycursor;
          }
@@ -792,16 +878,20 @@ void Lexer::lexDoubleQuoteString()
       break;
    }
    m_yyLength = yycursor - yytext;
-   std::string filteredStr(reinterpret_cast<const char *>(yytext), m_yyLength);
-   if (convert_double_quote_str_escape_sequences(filteredStr, '"', filteredStr.begin(),
-                                                 filteredStr.end(), *this) ||
-       !isInParseMode()) {
+   StringRef content(reinterpret_cast<const char *>(yytext), m_yyLength);
+   if (!hasEscapes) {
       formToken(TokenKindType::T_CONSTANT_ENCAPSED_STRING);
-      m_nextToken.setValue(filteredStr);
+      m_nextToken.setValueRef(content);
+      return;
+   }
+   /// the sequences are only validated here, the value is decoded when the
+   /// token is read
+   if (check_double_quote_str_escape_sequences(*this, content) || !isInParseMode()) {
+      formToken(TokenKindType::T_CONSTANT_ENCAPSED_STRING);
+      m_nextToken.setEscapedValueRef(content, '"');
    } else {
       formToken(TokenKindType::T_ERROR);
    }
-   return;
 }
 
 void Lexer::lexBackquote()
@@ -817,7 +907,8 @@ void Lexer::lexBackquote()
       formToken(TokenKindType::END, yytext);
       return;
    }
-   if (yytext[0] == '\\' && yycursor < yylimit) {
+   bool hasEscapes = yytext[0] == '\\';
+   if (hasEscapes && yycursor < yylimit) {
       ++yycursor;
    }
    while (yycursor < yylimit) {
@@ -835,6 +926,7 @@ void Lexer::lexBackquote()
          }
          continue;
       case '\\':
+         hasEscapes = true;
          if (yycursor < yylimit) {
             ++yycursor;
          }
@@ -847,11 +939,15 @@ void Lexer::lexBackquote()
    }
 
    m_yyLength = yycursor - yytext;
-   std::string filteredStr(reinterpret_cast<const char *>(yytext), m_yyLength);
-   if (convert_double_quote_str_escape_sequences(filteredStr, '`', filteredStr.begin(), filteredStr.end(), *this) ||
-       !isInParseMode()) {
+   StringRef content(reinterpret_cast<const char *>(yytext), m_yyLength);
+   if (!hasEscapes) {
       formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE, yytext);
-      m_nextToken.setValue(filteredStr);
+      m_nextToken.setValueRef(content);
+      return;
+   }
+   if (check_double_quote_str_escape_sequences(*this, content) || !isInParseMode()) {
+      formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE, yytext);
+      m_nextToken.setEscapedValueRef(content, '`');
    } else {
       formToken(TokenKindType::T_ERROR, yytext);
    }
@@ -1023,6 +1119,7 @@ void Lexer::lexHeredocBody()
    std::size_t indentation = 0;
    int spacing = 0;
    bool foundEndMarker = false;
+   bool hasEscapes = false;
    /// lex until we meet end mark or '${' or '{$'
    if (yycursor > yylimit) {
       yycursor = yylimit;
@@ -1032,6 +1129,12 @@ void Lexer::lexHeredocBody()
    /// before control get here, re2c already increment yycursor
    --yycursor;
    while (yycursor < yylimit) {
+      /// jump over plain text, only newlines, escapes and the start of
+      /// interpolations need a look
+      yycursor = find_heredoc_delimiter(yycursor, yylimit);
+      if (yycursor == yylimit) {
+         break;
+      }
       switch (*yycursor++) {
       case '\r':
          if (*yycursor == '\n') {
@@ -1055,7 +1158,7 @@ void Lexer::lexHeredocBody()
             yylength = yycursor - yytext;
             formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE);
             /// save unclosed string into token
-            m_nextToken.setValue(StringRef(reinterpret_cast<const char *>(yytext), yylength));
+            m_nextToken.setValueRef(StringRef(reinterpret_cast<const char *>(yytext), yylength));
             return;
          }
          /// Check for ending label on the next line
@@ -1101,6 +1204,7 @@ void Lexer::lexHeredocBody()
          }
          continue;
       case '\\':
+         hasEscapes = true;
          if (yycursor < yylimit && *yycursor != '\n' && *yycursor != '\r') {
             ++yycursor;
          }
@@ -1115,24 +1219,44 @@ void Lexer::lexHeredocBody()
    }
    yylength = yycursor - yytext;
    /// scan ahead and normal mode both need exclude newline
-   std::string filteredStr(reinterpret_cast<const char *>(yytext), yylength - newlineLength);
+   StringRef body(reinterpret_cast<const char *>(yytext), yylength - newlineLength);
    if (!m_flags.isHeredocScanAhead() && !m_flags.isLexExceptionOccurred() && (isInParseMode() || m_flags.isCheckHeredocIndentation())) {
       /// TODO
       /// need review here
       bool newlineAtStart = *(yytext - 1) == '\n' || *(yytext - 1) == '\r';
-      if (!strip_multiline_string_indentation(*this, filteredStr, label->indentation, label->intentationUseSpaces,
+      if (!check_multiline_string_indentation(*this, body, label->indentation, label->intentationUseSpaces,
                                               newlineAtStart, newlineLength != 0)) {
          formErrorToken(yytext);
          return;
       }
-      if (!convert_double_quote_str_escape_sequences(filteredStr, 0, filteredStr.begin(),
-                                                     filteredStr.end(), *this)) {
-         formToken(TokenKindType::T_ERROR);
+      if (hasEscapes) {
+         /// the indentation holds no backslash, the sequences are checked on
+         /// the source text
+         if (!check_double_quote_str_escape_sequences(*this, body)) {
+            formToken(TokenKindType::T_ERROR);
+            return;
+         }
+         formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE);
+         if (label->indentation == 0) {
+            m_nextToken.setEscapedValueRef(body, 0);
+            return;
+         }
+         /// only escape sequences make the value differ from the source
+         /// beyond the indentation, the body is copied for them alone
+         std::string strippedStr;
+         IndentedStringRef{body, static_cast<std::uint32_t>(label->indentation), newlineAtStart}
+               .appendTo(strippedStr);
+         std::string filteredStr;
+         decode_double_quote_str_escape_sequences(strippedStr, 0, filteredStr);
+         m_nextToken.setValue(std::move(filteredStr));
          return;
       }
+      formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE);
+      m_nextToken.setIndentedValueRef(body, label->indentation, newlineAtStart);
+      return;
    }
    formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE);
-   m_nextToken.setValue(filteredStr);
+   m_nextToken.setValueRef(body);
 }
 
 void Lexer::lexNowdocBody()
@@ -1153,6 +1277,12 @@ void Lexer::lexNowdocBody()
    }
    --yycursor;
    while (yycursor < yylimit) {
+      /// nowdoc bodies have neither escapes nor interpolations, only the
+      /// start of a line can end them
+      yycursor = find_newline(yycursor, yylimit);
+      if (yycursor == yylimit) {
+         break;
+      }
       switch (*yycursor++) {
       case '\r':
          if (*yycursor == '\n') {
@@ -1173,7 +1303,7 @@ void Lexer::lexNowdocBody()
          if (yycursor == yylimit) {
             m_yyLength = yycursor - yytext;
             formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE);
-            m_nextToken.setValue(StringRef(reinterpret_cast<const char *>(yytext), yylength));
+            m_nextToken.setValueRef(StringRef(reinterpret_cast<const char *>(yytext), yylength));
             return;
          }
          /// Check for ending label on the next line
@@ -1209,17 +1339,20 @@ void Lexer::lexNowdocBody()
       }
    }
    yylength = yycursor - yytext;
-   std::string filteredStr(reinterpret_cast<const char *>(yytext), yylength - newlineLength);
+   StringRef body(reinterpret_cast<const char *>(yytext), yylength - newlineLength);
    if (!m_flags.isLexExceptionOccurred() && spacing != 0 && (isInParseMode() || m_flags.isCheckHeredocIndentation())) {
       bool newlineAtStart = *(yytext - 1) == '\n' || *(yytext - 1) == '\r';
-      if (!strip_multiline_string_indentation(*this, filteredStr, indentation, spacing == HEREDOC_USING_SPACES,
+      if (!check_multiline_string_indentation(*this, body, indentation, spacing == HEREDOC_USING_SPACES,
                                               newlineAtStart, newlineLength != 0)) {
          formErrorToken(yytext);
          return;
       }
+      formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE, yytext);
+      m_nextToken.setIndentedValueRef(body, indentation, newlineAtStart);
+      return;
    }
    formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE, yytext);
-   m_nextToken.setValue(filteredStr);
+   m_nextToken.setValueRef(body);
 }
 
 void Lexer::lexHereAndNowDocEnd()
@@ -1228,7 +1361,7 @@ void Lexer::lexHereAndNowDocEnd()
    if (m_nextToken.getKind() == TokenKindType::T_START_HEREDOC) {
       setYYLength(0);
       formToken(TokenKindType::T_ENCAPSED_AND_WHITESPACE, getYYText() - 1);
-      m_nextToken.setValue("");
+      m_nextToken.setValueRef(StringRef());
       setYYCursor(getYYText());
       return;
    }
@@ -1264,10 +1397,12 @@ void Lexer::lexImpl()
    m_nextToken.resetValueType();
 
    /// here we want keep comment for next token
-   if (!m_flags.isReserveHeredocSpaces()) {
-      lexTrivia(m_leadingTrivia, /* IsForTrailingTrivia */ false);
-   } else {
+   if (m_flags.isReserveHeredocSpaces()) {
       m_flags.setReserveHeredocSpaces(false);
+   } else if (isTriviaFree()) {
+      skipTrivia();
+   } else {
+      lexTrivia(m_leadingTrivia, /* IsForTrailingTrivia */ false);
    }
    m_yyText = m_yyCursor;
    internal::yy_token_lex(*this);
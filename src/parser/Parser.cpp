@@ -9,13 +9,43 @@
 //
 // Created by polarboy on 2019/05/09.
 
-#include "polarphp/kernel/LangOptions.h"
+#include "polarphp/basic/LangOptions.h"
 #include "polarphp/parser/Parser.h"
 #include "polarphp/parser/Lexer.h"
+#include "polarphp/parser/PersistentParseCache.h"
+#include "polarphp/parser/SyntaxParsingCache.h"
 #include "polarphp/syntax/Syntax.h"
+#include "polarphp/syntax/SyntaxNodeFactory.h"
+#include "polarphp/syntax/SyntaxNodes.h"
+
+#include <algorithm>
 
 namespace polar::parser {
 
+using polar::syntax::SyntaxNodeFactory;
+using polar::syntax::SourcePresence;
+
+namespace {
+
+const RawSyntax *get_last_present_token(const RawSyntax *node)
+{
+   if (node->isToken()) {
+      return node->isPresent() ? node : nullptr;
+   }
+   auto layout = node->getLayout();
+   for (auto iter = layout.rbegin(), end = layout.rend(); iter != end; ++iter) {
+      if (!*iter) {
+         continue;
+      }
+      if (const RawSyntax *token = get_last_present_token(iter->get())) {
+         return token;
+      }
+   }
+   return nullptr;
+}
+
+} // anonymous namespace
+
 const Trivia Parser::sm_emptyTrivia{};
 
 Parser::Parser(const LangOptions &langOpts, unsigned bufferId,
@@ -31,6 +61,7 @@ Parser::Parser(SourceManager &sourceMgr, std::shared_ptr<DiagnosticEngine> diags
                std::unique_ptr<Lexer> lexer)
    : m_sourceMgr(sourceMgr),
      m_lexer(lexer.release()),
+     m_arena(new SyntaxArena),
      m_diags(diags)
 {
    m_yyParser = std::make_unique<internal::YYParser>(this, m_lexer);
@@ -40,11 +71,277 @@ Parser::Parser(SourceManager &sourceMgr, std::shared_ptr<DiagnosticEngine> diags
 bool Parser::parse()
 {
    m_inCompilation = true;
+   m_parseErrors.clear();
+   PersistentParseCache *persistentCache = m_syntaxParsingCache ? nullptr : m_persistentParseCache;
+   StringRef sourceText;
+   if (persistentCache) {
+      sourceText = m_sourceMgr.extractText(m_sourceMgr.getRangeForBuffer(m_lexer->getBufferId()));
+      if (RefCountPtr<RawSyntax> syntaxTree = persistentCache->lookUp(sourceText, m_arena)) {
+         m_ast = syntaxTree;
+         m_token.setKind(TokenKindType::END);
+         m_inCompilation = false;
+         return false;
+      }
+   }
+   auto startTime = PersistentParseCache::Clock::now();
+   m_tokenRanges.clear();
+   m_recordedStmts.clear();
+   m_reuseSyntax = m_syntaxParsingCache != nullptr;
+   if (m_reuseSyntax) {
+      m_syntaxParsingCache->setNewSourceText(
+               m_sourceMgr.extractText(m_sourceMgr.getRangeForBuffer(m_lexer->getBufferId())));
+   }
    int status = m_yyParser->parse();
+   if (status != 0 && m_reuseSyntax) {
+      // either a reused statement was offered where the grammar does not
+      // accept it or the source is broken, parse again from scratch so the
+      // result and the diagnostics are those of a full parse
+      m_reuseSyntax = false;
+      m_syntaxParsingCache->resetReusedNodes();
+      restartParse();
+      status = m_yyParser->parse();
+   }
+   m_reuseSyntax = false;
+   if (m_errorRecovery) {
+      if (status != 0) {
+         recoverSyntaxTree();
+      }
+      status = m_parseErrors.empty() ? 0 : 1;
+      m_recordedTokens.clear();
+      m_topStmtList = nullptr;
+      m_lastErrorRegion = nullptr;
+   }
+   if (m_arena) {
+      // no more tokens are made, drop the uniqued token table's references
+      m_arena->clearUniquedTokens();
+   }
+   if (persistentCache && status == 0) {
+      persistentCache->store(sourceText, m_ast, PersistentParseCache::Clock::now() - startTime);
+   }
    m_inCompilation = false;
    return status;
 }
 
+void Parser::restartParse()
+{
+   std::unique_ptr<Lexer> lexer = m_lexer->makeRestartedLexer();
+   delete m_lexer;
+   m_lexer = lexer.release();
+   m_yyParser = std::make_unique<internal::YYParser>(this, m_lexer);
+   m_token = Token();
+   m_token.setKind(TokenKindType::T_UNKNOWN_MARK);
+   m_ast = nullptr;
+   m_atStmtBoundary = true;
+   m_openBrackets.clear();
+   m_recordedTokens.clear();
+   m_firstRecordedOrdinal = 1;
+   m_lastTokenOrdinal = 0;
+   m_lastTokenKind = TokenKindType::T_UNKNOWN_MARK;
+   m_topStmtList = nullptr;
+   m_lastErrorRegion = nullptr;
+   m_tokenRanges.clear();
+   m_recordedStmts.clear();
+}
+
+RefCountPtr<RawSyntax> Parser::consumeReusableStmt(SyntaxKind &kind)
+{
+   if (!m_reuseSyntax || !m_atStmtBoundary ||
+       m_lexer->getYYCondition() != COND_NAME(ST_IN_SCRIPTING)) {
+      return nullptr;
+   }
+   if (m_openBrackets.empty()) {
+      kind = SyntaxKind::TopStmt;
+   } else if (m_openBrackets.back() == TokenKindType::T_LEFT_BRACE) {
+      kind = SyntaxKind::InnerStmt;
+   } else {
+      return nullptr;
+   }
+   size_t offset = m_lexer->getCurrentOffset();
+   RefCountPtr<RawSyntax> raw;
+   size_t length = 0;
+   if (m_syntaxParsingCache->hasOldStmtRanges()) {
+      raw = m_syntaxParsingCache->lookUpStmt(offset, kind, length);
+   } else if (std::optional<Syntax> node = m_syntaxParsingCache->lookUp(offset, kind)) {
+      // only lines up with the source if the tokens of the old tree carry
+      // their trivia
+      raw = node->getRaw();
+      length = raw->getTextLength();
+   }
+   if (!raw) {
+      return nullptr;
+   }
+   // a statement closed by "?>" leaves the lexer outside of the script
+   // section, let the lexer scan it
+   const RawSyntax *lastToken = get_last_present_token(raw.get());
+   if (!lastToken || lastToken->getTokenKind() == TokenKindType::T_CLOSE_TAG) {
+      return nullptr;
+   }
+   m_lexer->skipBytes(length);
+   m_atStmtBoundary = true;
+   return raw;
+}
+
+void Parser::recordStmtRange(RefCountPtr<RawSyntax> stmt, const internal::YYLocation &loc)
+{
+   if (!m_recordingStmtRanges || !stmt) {
+      return;
+   }
+   m_recordedStmts.push_back({std::move(stmt), static_cast<unsigned>(loc.begin.column),
+                              static_cast<unsigned>(loc.end.column)});
+}
+
+std::vector<StmtSourceRange> Parser::getStmtRanges() const
+{
+   std::vector<StmtSourceRange> ranges;
+   ranges.reserve(m_recordedStmts.size());
+   size_t numTokens = m_tokenRanges.size();
+   for (const RecordedStmt &recorded : m_recordedStmts) {
+      // ordinals start at 1, the statement ends before endOrdinal
+      if (recorded.firstOrdinal == 0 || recorded.endOrdinal <= recorded.firstOrdinal ||
+          recorded.endOrdinal - 1 > numTokens) {
+         continue;
+      }
+      size_t start = m_tokenRanges[recorded.firstOrdinal - 1].first;
+      size_t end = m_tokenRanges[recorded.endOrdinal - 2].second;
+      size_t followingEnd = recorded.endOrdinal <= numTokens
+            ? m_tokenRanges[recorded.endOrdinal - 1].second
+            : end;
+      ranges.push_back({recorded.stmt, start, end, followingEnd});
+   }
+   return ranges;
+}
+
+void Parser::trackStmtBoundary(TokenKindType kind)
+{
+   switch (kind) {
+   case TokenKindType::T_LEFT_PAREN:
+   case TokenKindType::T_LEFT_SQUARE_BRACKET:
+   case TokenKindType::T_LEFT_BRACE:
+   case TokenKindType::T_CURLY_OPEN:
+   case TokenKindType::T_DOLLAR_OPEN_CURLY_BRACES:
+      m_openBrackets.push_back(kind);
+      break;
+   case TokenKindType::T_RIGHT_PAREN:
+   case TokenKindType::T_RIGHT_SQUARE_BRACKET:
+   case TokenKindType::T_RIGHT_BRACE:
+      if (!m_openBrackets.empty()) {
+         m_openBrackets.pop_back();
+      }
+      break;
+   default:
+      break;
+   }
+   m_atStmtBoundary = kind == TokenKindType::T_SEMICOLON ||
+         kind == TokenKindType::T_LEFT_BRACE ||
+         kind == TokenKindType::T_RIGHT_BRACE;
+}
+
+void Parser::recordToken(const Token *token, internal::YYLocation &loc)
+{
+   unsigned ordinal = ++m_lastTokenOrdinal;
+   loc.begin.column = ordinal;
+   loc.end.column = ordinal + 1;
+   if (!m_errorRecovery || m_reuseSyntax || !token || token->is(TokenKindType::END)) {
+      return;
+   }
+   m_lastTokenKind = token->getKind();
+   trackStmtBoundary(m_lastTokenKind);
+   if (m_recordedTokens.empty()) {
+      m_firstRecordedOrdinal = ordinal;
+   }
+   m_recordedTokens.push_back({m_lastTokenKind, token->getLexicalText()});
+}
+
+RefCountPtr<RawSyntax> Parser::appendErrorRegion(RefCountPtr<RawSyntax> list, unsigned firstOrdinal,
+                                                 bool hasLookahead)
+{
+   if (!m_errorRecovery || m_reuseSyntax) {
+      return nullptr;
+   }
+   SyntaxKind listKind = list->getKind();
+   SyntaxKind unknownKind = listKind == SyntaxKind::MemberDeclList
+         ? SyntaxKind::UnknownDecl
+         : SyntaxKind::UnknownStmt;
+   unsigned endOrdinal = std::min<size_t>(hasLookahead ? m_lastTokenOrdinal : m_lastTokenOrdinal + 1,
+                                          m_firstRecordedOrdinal + m_recordedTokens.size());
+   firstOrdinal = std::max(firstOrdinal, m_firstRecordedOrdinal);
+   if (firstOrdinal >= endOrdinal) {
+      // the grammar failed on the lookahead right at the start of a
+      // statement, the region begins with it the next time
+      return list;
+   }
+   std::vector<RefCountPtr<RawSyntax>> tokens;
+   ArrayRef<RefCountPtr<RawSyntax>> elements = list->getLayout();
+   bool merge = !elements.empty() && m_lastErrorRegionEnd == firstOrdinal &&
+         elements.back()->getChild(0).get() == m_lastErrorRegion;
+   if (merge) {
+      ArrayRef<RefCountPtr<RawSyntax>> previousTokens = m_lastErrorRegion->getLayout();
+      tokens.assign(previousTokens.begin(), previousTokens.end());
+   }
+   for (unsigned ordinal = firstOrdinal; ordinal < endOrdinal; ++ordinal) {
+      const RecordedToken &token = m_recordedTokens[ordinal - m_firstRecordedOrdinal];
+      tokens.push_back(RawSyntax::make(token.kind, OwnedString::makeRefCounted(token.text), {}, {},
+                                       SourcePresence::Present, m_arena));
+   }
+   RefCountPtr<RawSyntax> region = RawSyntax::make(unknownKind, tokens, SourcePresence::Present, m_arena);
+   RefCountPtr<RawSyntax> element;
+   if (listKind == SyntaxKind::TopStmtList) {
+      element = RawSyntax::make(SyntaxKind::TopStmt, {region}, SourcePresence::Present, m_arena);
+   } else if (listKind == SyntaxKind::InnerStmtList) {
+      element = RawSyntax::make(SyntaxKind::InnerStmt, {region}, SourcePresence::Present, m_arena);
+   } else {
+      assert(listKind == SyntaxKind::MemberDeclList && "unknown statement list");
+      element = RawSyntax::make(SyntaxKind::MemberDeclListItem, {region, nullptr},
+                                SourcePresence::Present, m_arena);
+   }
+   m_lastErrorRegion = region.get();
+   m_lastErrorRegionEnd = endOrdinal;
+   if (merge) {
+      return list->replaceChild(elements.size() - 1, element);
+   }
+   return list->append(element);
+}
+
+void Parser::updateTopStmtList(RefCountPtr<RawSyntax> list, bool hasLookahead)
+{
+   if (!m_errorRecovery || m_reuseSyntax) {
+      return;
+   }
+   // a list within braces, e.g. of a namespace block, is no top level
+   size_t openBrackets = m_openBrackets.size();
+   if (hasLookahead && openBrackets > 0 && m_openBrackets.back() == m_lastTokenKind) {
+      --openBrackets;
+   }
+   if (openBrackets > 0) {
+      return;
+   }
+   m_topStmtList = list;
+   unsigned nextOrdinal = hasLookahead ? m_lastTokenOrdinal : m_lastTokenOrdinal + 1;
+   size_t finished = std::min<size_t>(nextOrdinal - m_firstRecordedOrdinal, m_recordedTokens.size());
+   m_recordedTokens.erase(m_recordedTokens.begin(), m_recordedTokens.begin() + finished);
+   m_firstRecordedOrdinal += finished;
+}
+
+void Parser::recoverSyntaxTree()
+{
+   // the grammar gives up on a file that ends within a broken construct,
+   // also take the tokens it did not read
+   while (m_token.isNot(TokenKindType::END)) {
+      internal::YYLocation loc;
+      size_t tokenStart = m_lexer->getCurrentOffset();
+      m_lexer->lex(m_token);
+      recordToken(&m_token, loc);
+      recordTokenRange(tokenStart, m_lexer->getCurrentOffset());
+   }
+   RefCountPtr<RawSyntax> list = m_topStmtList;
+   if (!list) {
+      list = SyntaxNodeFactory::makeBlankTopStmtList().getRaw();
+   }
+   m_ast = m_recordedTokens.empty()
+         ? list
+         : appendErrorRegion(list, m_firstRecordedOrdinal, false);
+}
+
 void Parser::setParsedAst(RefCountPtr<RawSyntax> ast)
 {
    m_ast = ast;
@@ -0,0 +1,172 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/25.
+
+#include "polarphp/parser/PersistentParseCache.h"
+#include "polarphp/basic/Filesystem.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/Version.h"
+#include "polarphp/syntax/serialization/SyntaxBinarySerialization.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstring>
+
+namespace polar::parser {
+
+using polar::syntax::SyntaxBinaryReader;
+using polar::syntax::write_syntax_binary;
+using polar::syntax::SYNTAX_BINARY_VERSION;
+namespace endian = llvm::support::endian;
+
+namespace {
+
+/// Entry header: "PPCH", u32 version, u64 content hash, u64 content size,
+/// u64 parse duration in nanoseconds, followed by the binary syntax tree.
+constexpr char ENTRY_MAGIC[4] = {'P', 'P', 'C', 'H'};
+constexpr std::uint32_t ENTRY_VERSION = 1;
+constexpr size_t ENTRY_HEADER_SIZE = 32;
+
+std::string to_hex(std::uint64_t value)
+{
+   std::string result;
+   llvm::raw_string_ostream stream(result);
+   stream << llvm::format_hex_no_prefix(value, 16);
+   return stream.str();
+}
+
+} // anonymous namespace
+
+PersistentParseCache::PersistentParseCache(StringRef cacheDir, const LangOptions &langOpts)
+{
+   SmallString<128> entryDir(cacheDir);
+   llvm::sys::path::append(entryDir, computeFingerprint(langOpts));
+   m_entryDir = entryDir.str().str();
+}
+
+std::string PersistentParseCache::computeFingerprint(const LangOptions &langOpts)
+{
+   std::string fingerprint;
+   llvm::raw_string_ostream stream(fingerprint);
+   stream << "entry-" << ENTRY_VERSION
+          << ";syntax-" << SYNTAX_BINARY_VERSION
+          << ";" << polar::version::retrieve_polarphp_full_version(langOpts.EffectiveLanguageVersion)
+          << ";" << polar::version::retrieve_polarphp_revision()
+          // decides the comment retention mode of the lexer
+          << ";attach-comments-" << langOpts.AttachCommentsToDecls;
+   return to_hex(llvm::xxHash64(stream.str()));
+}
+
+std::string PersistentParseCache::getEntryPath(std::uint64_t contentHash, size_t contentSize) const
+{
+   SmallString<128> path(m_entryDir);
+   llvm::sys::path::append(path, to_hex(contentHash) + "-" + std::to_string(contentSize) + ".psyn");
+   return path.str().str();
+}
+
+RefCountPtr<RawSyntax> PersistentParseCache::lookUp(StringRef sourceText,
+                                                    const RefCountPtr<SyntaxArena> &arena)
+{
+   auto startTime = Clock::now();
+   std::uint64_t contentHash = llvm::xxHash64(sourceText);
+   auto countMiss = [this]() -> RefCountPtr<RawSyntax> {
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+      ++m_stats.numMisses;
+      return nullptr;
+   };
+   // entries are not null terminated, which allows the buffer to be mapped
+   auto bufferOrError = llvm::MemoryBuffer::getFile(getEntryPath(contentHash, sourceText.size()),
+                                                    /*FileSize=*/-1,
+                                                    /*RequiresNullTerminator=*/false);
+   if (!bufferOrError) {
+      return countMiss();
+   }
+   StringRef entry = bufferOrError.get()->getBuffer();
+   if (entry.size() < ENTRY_HEADER_SIZE ||
+       std::memcmp(entry.data(), ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0 ||
+       endian::read32le(entry.data() + 4) != ENTRY_VERSION ||
+       endian::read64le(entry.data() + 8) != contentHash ||
+       endian::read64le(entry.data() + 16) != sourceText.size()) {
+      return countMiss();
+   }
+   std::uint64_t parseNanoseconds = endian::read64le(entry.data() + 24);
+   StringRef treeData = entry.drop_front(ENTRY_HEADER_SIZE);
+   RefCountPtr<RawSyntax> syntaxTree;
+   if (arena) {
+      // one copy of the whole entry instead of one string per token, the
+      // nodes keep the arena and therefore their text alive
+      char *copy = static_cast<char *>(arena->allocate(treeData.size(), alignof(std::uint64_t)));
+      std::memcpy(copy, treeData.data(), treeData.size());
+      SyntaxBinaryReader reader(StringRef(copy, treeData.size()), arena, /*referenceData=*/true);
+      syntaxTree = reader.isValid() ? reader.materializeRoot() : nullptr;
+   } else {
+      SyntaxBinaryReader reader(treeData);
+      syntaxTree = reader.isValid() ? reader.materializeRoot() : nullptr;
+   }
+   // a damaged entry which still decodes can not describe this source
+   if (!syntaxTree || syntaxTree->getTextLength() != sourceText.size()) {
+      return countMiss();
+   }
+   std::chrono::duration<double> loadDuration = Clock::now() - startTime;
+   std::lock_guard<std::mutex> lock(m_statsMutex);
+   ++m_stats.numHits;
+   m_stats.loadSeconds += loadDuration.count();
+   m_stats.parseSecondsOfHits += parseNanoseconds / 1e9;
+   return syntaxTree;
+}
+
+bool PersistentParseCache::store(StringRef sourceText, const RefCountPtr<RawSyntax> &syntaxTree,
+                                 Clock::duration parseDuration)
+{
+   auto countStore = [this](bool succeeded) {
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+      if (succeeded) {
+         ++m_stats.numStores;
+      } else {
+         ++m_stats.numStoreFailures;
+      }
+      return succeeded;
+   };
+   if (!syntaxTree) {
+      return countStore(false);
+   }
+   if (llvm::sys::fs::create_directories(m_entryDir)) {
+      return countStore(false);
+   }
+   std::uint64_t contentHash = llvm::xxHash64(sourceText);
+   std::uint64_t parseNanoseconds =
+         std::chrono::duration_cast<std::chrono::nanoseconds>(parseDuration).count();
+   std::error_code errorCode = atomically_writing_to_file(
+            getEntryPath(contentHash, sourceText.size()), [&](llvm::raw_pwrite_stream &out) {
+      char header[ENTRY_HEADER_SIZE];
+      std::memcpy(header, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+      endian::write32le(header + 4, ENTRY_VERSION);
+      endian::write64le(header + 8, contentHash);
+      endian::write64le(header + 16, sourceText.size());
+      endian::write64le(header + 24, parseNanoseconds);
+      out.write(header, sizeof(header));
+      write_syntax_binary(out, syntaxTree);
+   });
+   return countStore(!errorCode);
+}
+
+PersistentParseCacheStats PersistentParseCache::getStats() const
+{
+   std::lock_guard<std::mutex> lock(m_statsMutex);
+   return m_stats;
+}
+
+} // polar::parser
@@ -23,6 +23,8 @@
 #include "polarphp/parser/SyntaxParsingCache.h"
 #include "polarphp/syntax/SyntaxNodeVisitor.h"
 
+#include <algorithm>
+
 namespace polar::parser {
 
 using polar::syntax::SyntaxNodeVisitor;
@@ -132,14 +134,77 @@ std::optional<Syntax> SyntaxParsingCache::lookUp(size_t newPosition,
       return std::nullopt;
    }
    auto node = lookUpFrom(m_oldSyntaxTree, /*nodeStart=*/0, *oldPosition, kind);
-   if (node.has_value()) {
-      m_reusedNodeIds.insert(node->getId());
+   if (!node.has_value()) {
+      return std::nullopt;
+   }
+   if (m_newSourceText.has_value() && !nodeSpellsNewSource(*node, newPosition)) {
+      return std::nullopt;
    }
+   m_reusedNodeIds.insert(node->getId());
+   m_reusedBytes += node->getTextLength();
    return node;
 }
 
+void SyntaxParsingCache::setOldStmtRanges(std::vector<StmtSourceRange> ranges,
+                                          StringRef oldSourceText)
+{
+   std::stable_sort(ranges.begin(), ranges.end(),
+                    [](const StmtSourceRange &lhs, const StmtSourceRange &rhs) {
+      return lhs.start < rhs.start;
+   });
+   m_oldStmtRanges = std::move(ranges);
+   m_oldSourceText = oldSourceText;
+}
+
+RefCountPtr<RawSyntax> SyntaxParsingCache::lookUpStmt(size_t newPosition, SyntaxKind kind,
+                                                      size_t &sourceLength)
+{
+   std::optional<size_t> oldPosition = translateToPreEditPosition(newPosition, m_edits);
+   if (!oldPosition.has_value()) {
+      return nullptr;
+   }
+   auto iter = std::lower_bound(m_oldStmtRanges.begin(), m_oldStmtRanges.end(), *oldPosition,
+                                [](const StmtSourceRange &range, size_t position) {
+      return range.start < position;
+   });
+   for (auto end = m_oldStmtRanges.end(); iter != end && iter->start == *oldPosition; ++iter) {
+      if (iter->stmt->getKind() != kind) {
+         continue;
+      }
+      for (auto edit : m_edits) {
+         if (edit.intersectsOrTouchesRange(iter->start, iter->followingEnd)) {
+            return nullptr;
+         }
+      }
+      size_t length = iter->end - iter->start;
+      if (m_newSourceText.has_value() &&
+          (newPosition + length > m_newSourceText->size() ||
+           m_oldSourceText->substr(iter->start, length) != m_newSourceText->substr(newPosition, length))) {
+         return nullptr;
+      }
+      m_reusedNodeIds.insert(iter->stmt->getId());
+      m_reusedBytes += length;
+      sourceLength = length;
+      return iter->stmt;
+   }
+   return nullptr;
+}
+
+bool SyntaxParsingCache::nodeSpellsNewSource(const Syntax &node, size_t newPosition) const
+{
+   size_t length = node.getTextLength();
+   if (newPosition + length > m_newSourceText->size()) {
+      return false;
+   }
+   std::string text;
+   text.reserve(length);
+   llvm::raw_string_ostream outStream(text);
+   node.print(outStream);
+   return outStream.str() == m_newSourceText->substr(newPosition, length);
+}
+
 std::vector<SyntaxReuseRegion>
-SyntaxParsingCache::getReusedRegions(const SourceFileSyntax &SyntaxTree) const
+SyntaxParsingCache::getReusedRegions(const Syntax &SyntaxTree) const
 {
    /// Determines the reused source regions from reused syntax node IDs
    class ReusedRegionsCollector : public SyntaxNodeVisitor
@@ -180,7 +245,7 @@ SyntaxParsingCache::getReusedRegions(const SourceFileSyntax &SyntaxTree) const
          }
       }
 
-      void collectReusedRegions(SourceFileSyntax node)
+      void collectReusedRegions(Syntax node)
       {
          assert(m_reusedRegions.empty() &&
                 "ReusedRegionsCollector cannot be reused");
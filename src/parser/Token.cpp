@@ -10,6 +10,7 @@
 // Created by polarboy on 2019/07/09.
 
 #include "polarphp/parser/Token.h"
+#include "polarphp/parser/internal/YYLexerExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "polarphp/syntax/TokenKinds.h"
 
@@ -17,6 +18,35 @@ namespace polar::parser {
 
 using namespace polar::syntax;
 
+void IndentedStringRef::appendTo(std::string &result) const
+{
+   result.reserve(result.size() + text.size());
+   bool stripLine = stripFirstLine;
+   size_t lineStart = 0;
+   while (true) {
+      size_t newline = text.find('\n', lineStart);
+      size_t lineEnd = newline == StringRef::npos ? text.size() : newline + 1;
+      if (stripLine) {
+         // whitespace only lines may be shorter than the indentation
+         for (size_t skip = 0; skip < indentation && lineStart < lineEnd &&
+              (text[lineStart] == ' ' || text[lineStart] == '\t'); ++skip) {
+            ++lineStart;
+         }
+      }
+      result.append(text.data() + lineStart, lineEnd - lineStart);
+      if (newline == StringRef::npos) {
+         return;
+      }
+      lineStart = lineEnd;
+      stripLine = true;
+   }
+}
+
+void EscapedStringRef::appendTo(std::string &result) const
+{
+   internal::decode_double_quote_str_escape_sequences(text, quoteType, result);
+}
+
 void Token::dump() const
 {
    dump(llvm::errs());
@@ -41,7 +71,7 @@ void Token::dump(raw_ostream &outStream) const
          if (m_kind == TokenKindType::T_VARIABLE){
             outStream << '$';
          }
-         outStream << getValue<std::string>() << "\n";
+         outStream << getStringValue() << "\n";
       } else if (m_kind == TokenKindType::T_LNUMBER) {
          outStream << "value: ";
          outStream << getValue<std::int64_t>() << "\n";
@@ -50,12 +80,12 @@ void Token::dump(raw_ostream &outStream) const
          outStream << getValue<double>() << "\n";
       } else if (m_kind == TokenKindType::T_CONSTANT_ENCAPSED_STRING ||
                  m_kind == TokenKindType::T_ENCAPSED_AND_WHITESPACE) {
-         const std::string &text = getValue<std::string>();
+         StringRef text = getStringValue();
          outStream << "length: " << text.size() << "\n";
          outStream << "value: " << text << "\n";
       } else if (m_kind == TokenKindType::T_ERROR && hasValue()) {
          outStream << "error: ";
-         outStream << getValue<std::string>() << "\n";
+         outStream << getStringValue() << "\n";
       }
    } else {
       outStream << "value: invalid lex value" << "\n";
@@ -0,0 +1,245 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/05.
+
+#include "polarphp/parser/internal/KeywordTable.h"
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace polar::parser::internal {
+
+namespace {
+
+struct KeywordEntry
+{
+   std::string_view text;
+   TokenKindType kind;
+};
+
+/// Keep in sync with KeywordDfaRules.l, the texts are lower case.
+constexpr KeywordEntry sg_keywords[] = {
+   {"true", TokenKindType::T_TRUE},
+   {"false", TokenKindType::T_FALSE},
+   {"exit", TokenKindType::T_EXIT},
+   {"die", TokenKindType::T_EXIT},
+   {"fn", TokenKindType::T_FN},
+   {"function", TokenKindType::T_FUNCTION},
+   {"const", TokenKindType::T_CONST},
+   {"return", TokenKindType::T_RETURN},
+   {"await", TokenKindType::T_AWAIT},
+   {"yield", TokenKindType::T_YIELD},
+   {"try", TokenKindType::T_TRY},
+   {"catch", TokenKindType::T_CATCH},
+   {"finally", TokenKindType::T_FINALLY},
+   {"throw", TokenKindType::T_THROW},
+   {"if", TokenKindType::T_IF},
+   {"elseif", TokenKindType::T_ELSEIF},
+   {"else", TokenKindType::T_ELSE},
+   {"while", TokenKindType::T_WHILE},
+   {"do", TokenKindType::T_DO},
+   {"for", TokenKindType::T_FOR},
+   {"foreach", TokenKindType::T_FOREACH},
+   {"declare", TokenKindType::T_DECLARE},
+   {"instanceof", TokenKindType::T_INSTANCEOF},
+   {"as", TokenKindType::T_AS},
+   {"switch", TokenKindType::T_SWITCH},
+   {"case", TokenKindType::T_CASE},
+   {"default", TokenKindType::T_DEFAULT},
+   {"break", TokenKindType::T_BREAK},
+   {"continue", TokenKindType::T_CONTINUE},
+   {"goto", TokenKindType::T_GOTO},
+   {"fallthrough", TokenKindType::T_FALLTHROUGH},
+   {"echo", TokenKindType::T_ECHO},
+   {"print", TokenKindType::T_PRINT},
+   {"class", TokenKindType::T_CLASS},
+   {"interface", TokenKindType::T_INTERFACE},
+   {"trait", TokenKindType::T_TRAIT},
+   {"extends", TokenKindType::T_EXTENDS},
+   {"implements", TokenKindType::T_IMPLEMENTS},
+   {"new", TokenKindType::T_NEW},
+   {"null", TokenKindType::T_NULL},
+   {"clone", TokenKindType::T_CLONE},
+   {"var", TokenKindType::T_VAR},
+   {"eval", TokenKindType::T_EVAL},
+   {"include", TokenKindType::T_INCLUDE},
+   {"include_once", TokenKindType::T_INCLUDE_ONCE},
+   {"require", TokenKindType::T_REQUIRE},
+   {"require_once", TokenKindType::T_REQUIRE_ONCE},
+   {"namespace", TokenKindType::T_NAMESPACE},
+   {"use", TokenKindType::T_USE},
+   {"insteadof", TokenKindType::T_INSTEADOF},
+   {"global", TokenKindType::T_GLOBAL},
+   {"isset", TokenKindType::T_ISSET},
+   {"empty", TokenKindType::T_EMPTY},
+   {"__halt_compiler", TokenKindType::T_HALT_COMPILER},
+   {"static", TokenKindType::T_STATIC},
+   {"abstract", TokenKindType::T_ABSTRACT},
+   {"final", TokenKindType::T_FINAL},
+   {"private", TokenKindType::T_PRIVATE},
+   {"protected", TokenKindType::T_PROTECTED},
+   {"public", TokenKindType::T_PUBLIC},
+   {"this", TokenKindType::T_OBJ_REF},
+   {"self", TokenKindType::T_CLASS_REF_SELF},
+   {"parent", TokenKindType::T_CLASS_REF_PARENT},
+   {"unset", TokenKindType::T_UNSET},
+   {"list", TokenKindType::T_LIST},
+   {"array", TokenKindType::T_ARRAY},
+   {"callable", TokenKindType::T_CALLABLE},
+   {"thread_local", TokenKindType::T_THREAD_LOCAL},
+   {"module", TokenKindType::T_MODULE},
+   {"package", TokenKindType::T_PACKAGE},
+   {"async", TokenKindType::T_ASYNC},
+   {"export", TokenKindType::T_EXPORT},
+   {"defer", TokenKindType::T_DEFER},
+   {"__class__", TokenKindType::T_CLASS_CONST},
+   {"__trait__", TokenKindType::T_TRAIT_CONST},
+   {"__function__", TokenKindType::T_FUNC_CONST},
+   {"__method__", TokenKindType::T_METHOD_CONST},
+   {"__line__", TokenKindType::T_LINE},
+   {"__file__", TokenKindType::T_FILE},
+   {"__dir__", TokenKindType::T_DIR},
+   {"__namespace__", TokenKindType::T_NS_CONST},
+   {"or", TokenKindType::T_LOGICAL_OR},
+   {"and", TokenKindType::T_LOGICAL_AND},
+   {"xor", TokenKindType::T_LOGICAL_XOR}
+};
+
+constexpr KeywordEntry sg_castTypes[] = {
+   {"int", TokenKindType::T_INT_CAST},
+   {"integer", TokenKindType::T_INT_CAST},
+   {"double", TokenKindType::T_DOUBLE_CAST},
+   {"float", TokenKindType::T_DOUBLE_CAST},
+   {"string", TokenKindType::T_STRING_CAST},
+   {"binary", TokenKindType::T_STRING_CAST},
+   {"array", TokenKindType::T_ARRAY_CAST},
+   {"object", TokenKindType::T_OBJECT_CAST},
+   {"bool", TokenKindType::T_BOOL_CAST},
+   {"boolean", TokenKindType::T_BOOL_CAST},
+   {"unset", TokenKindType::T_UNSET_CAST}
+};
+
+/// Labels are ASCII letters, digits, '_' and bytes above 0x7f, setting the
+/// 0x20 bit maps both letter cases to the same byte and keeps the others
+/// apart.
+constexpr std::uint8_t fold_case(char c)
+{
+   return static_cast<std::uint8_t>(c) | 0x20;
+}
+
+/// FNV-1a over the case folded bytes.
+constexpr std::uint32_t hash_label(const char *text, size_t length, std::uint32_t seed)
+{
+   std::uint32_t hash = 2166136261u ^ seed;
+   for (size_t i = 0; i < length; ++i) {
+      hash = (hash ^ fold_case(text[i])) * 16777619u;
+   }
+   return hash ^ (hash >> 16);
+}
+
+/// A collision free hash table over \p NumKeywords keywords. The constructor
+/// tries seeds of the hash function until no two keywords share a slot, it
+/// runs at compile time, so the search costs nothing when lexing. A slot
+/// holds the index of its keyword plus one, 0 for an empty slot.
+template <size_t NumKeywords, size_t TableSize>
+class PerfectHashTable
+{
+   static_assert((TableSize & (TableSize - 1)) == 0, "the table size must be a power of two");
+   static_assert(NumKeywords < 255, "the slots hold 8 bit indexes");
+
+public:
+   constexpr PerfectHashTable(const KeywordEntry (&keywords)[NumKeywords])
+   {
+      for (size_t i = 0; i < NumKeywords; ++i) {
+         m_keywords[i] = keywords[i];
+         if (keywords[i].text.size() > m_maxLength) {
+            m_maxLength = keywords[i].text.size();
+         }
+      }
+      for (std::uint32_t seed = 1; seed < 4096; ++seed) {
+         if (tryFill(seed)) {
+            m_seed = seed;
+            return;
+         }
+      }
+   }
+
+   constexpr bool isPerfect() const
+   {
+      return m_seed != 0;
+   }
+
+   TokenKindType lookup(StringRef label, TokenKindType notFound) const
+   {
+      if (label.size() > m_maxLength) {
+         return notFound;
+      }
+      std::uint8_t index = m_slots[getSlot(label.data(), label.size(), m_seed)];
+      if (index == 0) {
+         return notFound;
+      }
+      const KeywordEntry &entry = m_keywords[index - 1];
+      if (entry.text.size() != label.size() ||
+          !label.equals_lower(StringRef(entry.text.data(), entry.text.size()))) {
+         return notFound;
+      }
+      return entry.kind;
+   }
+
+private:
+   static constexpr size_t getSlot(const char *text, size_t length, std::uint32_t seed)
+   {
+      return hash_label(text, length, seed) & (TableSize - 1);
+   }
+
+   constexpr bool tryFill(std::uint32_t seed)
+   {
+      for (std::uint8_t &slot : m_slots) {
+         slot = 0;
+      }
+      for (size_t i = 0; i < NumKeywords; ++i) {
+         std::uint8_t &slot = m_slots[getSlot(m_keywords[i].text.data(), m_keywords[i].text.size(), seed)];
+         if (slot != 0) {
+            return false;
+         }
+         slot = static_cast<std::uint8_t>(i + 1);
+      }
+      return true;
+   }
+
+private:
+   std::array<KeywordEntry, NumKeywords> m_keywords{};
+   std::array<std::uint8_t, TableSize> m_slots{};
+   size_t m_maxLength = 0;
+   std::uint32_t m_seed = 0;
+};
+
+/// the slots are one byte, the keyword table takes 16 cache lines
+constexpr PerfectHashTable<std::size(sg_keywords), 1024> sg_keywordTable(sg_keywords);
+constexpr PerfectHashTable<std::size(sg_castTypes), 64> sg_castTypeTable(sg_castTypes);
+
+static_assert(sg_keywordTable.isPerfect(), "no collision free seed for the keyword table");
+static_assert(sg_castTypeTable.isPerfect(), "no collision free seed for the cast type table");
+
+} // anonymous namespace
+
+TokenKindType lookup_keyword(StringRef label)
+{
+   return sg_keywordTable.lookup(label, TokenKindType::T_IDENTIFIER_STRING);
+}
+
+TokenKindType lookup_cast_type(StringRef typeName)
+{
+   return sg_castTypeTable.lookup(typeName, TokenKindType::T_UNKNOWN_MARK);
+}
+
+} // polar::parser::internal
@@ -0,0 +1,264 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/07/02.
+
+#include "polarphp/parser/internal/TriviaScanner.h"
+#include "polarphp/utils/MathExtras.h"
+#include "llvm/Support/Host.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define POLAR_TRIVIA_SCANNER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POLAR_TRIVIA_SCANNER_SSE2
+#else
+#define POLAR_TRIVIA_SCANNER_SWAR
+#endif
+
+namespace polar::parser::internal {
+
+using polar::utils::count_trailing_zeros;
+using polar::utils::count_leading_zeros;
+using polar::utils::ZB_Undefined;
+
+namespace {
+
+inline bool is_whitespace_char(unsigned char c)
+{
+   // '\t' '\n' '\v' '\f' '\r' are 9 ~ 13
+   return static_cast<unsigned char>(c - '\t') <= 4 || c == ' ';
+}
+
+inline bool is_newline_char(unsigned char c)
+{
+   return c == '\n' || c == '\r';
+}
+
+// A block is the unit loaded by one iteration, a mask has one bit (SIMD) or
+// one byte high bit (SWAR) per byte of the block.
+#if defined(POLAR_TRIVIA_SCANNER_AVX2)
+
+using Block = __m256i;
+using BlockMask = std::uint32_t;
+constexpr size_t BLOCK_SIZE = 32;
+
+inline Block load_block(const unsigned char *ptr)
+{
+   return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+}
+
+inline BlockMask equal_mask(Block block, unsigned char c)
+{
+   return static_cast<BlockMask>(_mm256_movemask_epi8(
+                                    _mm256_cmpeq_epi8(block, _mm256_set1_epi8(static_cast<char>(c)))));
+}
+
+inline BlockMask whitespace_mask(Block block)
+{
+   // unsigned (c - '\t') <= 4, min_epu8 stands in for the missing unsigned compare
+   __m256i shifted = _mm256_sub_epi8(block, _mm256_set1_epi8('\t'));
+   __m256i inRange = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+   __m256i space = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '));
+   return static_cast<BlockMask>(_mm256_movemask_epi8(_mm256_or_si256(inRange, space)));
+}
+
+constexpr BlockMask FULL_BLOCK_MASK = 0xFFFFFFFFu;
+
+#elif defined(POLAR_TRIVIA_SCANNER_SSE2)
+
+using Block = __m128i;
+using BlockMask = std::uint32_t;
+constexpr size_t BLOCK_SIZE = 16;
+
+inline Block load_block(const unsigned char *ptr)
+{
+   return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+}
+
+inline BlockMask equal_mask(Block block, unsigned char c)
+{
+   return static_cast<BlockMask>(_mm_movemask_epi8(
+                                    _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(c)))));
+}
+
+inline BlockMask whitespace_mask(Block block)
+{
+   // unsigned (c - '\t') <= 4, min_epu8 stands in for the missing unsigned compare
+   __m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8('\t'));
+   __m128i inRange = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+   __m128i space = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+   return static_cast<BlockMask>(_mm_movemask_epi8(_mm_or_si128(inRange, space)));
+}
+
+constexpr BlockMask FULL_BLOCK_MASK = 0xFFFFu;
+
+#else
+
+using Block = std::uint64_t;
+using BlockMask = std::uint64_t;
+constexpr size_t BLOCK_SIZE = 8;
+constexpr std::uint64_t SWAR_LOW_BITS = 0x0101010101010101ULL;
+constexpr std::uint64_t SWAR_HIGH_BITS = 0x8080808080808080ULL;
+constexpr std::uint64_t SWAR_LOW_SEVEN_BITS = 0x7F7F7F7F7F7F7F7FULL;
+
+inline Block load_block(const unsigned char *ptr)
+{
+   Block block;
+   std::memcpy(&block, ptr, sizeof(block));
+   return block;
+}
+
+/// Exact per byte zero test, no borrow crosses byte boundaries.
+inline BlockMask zero_byte_mask(Block block)
+{
+   return ~(((block & SWAR_LOW_SEVEN_BITS) + SWAR_LOW_SEVEN_BITS) | block) & SWAR_HIGH_BITS;
+}
+
+inline BlockMask equal_mask(Block block, unsigned char c)
+{
+   return zero_byte_mask(block ^ (SWAR_LOW_BITS * c));
+}
+
+inline BlockMask whitespace_mask(Block block)
+{
+   BlockMask ascii = ~block & SWAR_HIGH_BITS;
+   BlockMask low = block & SWAR_LOW_SEVEN_BITS;
+   BlockMask geTab = ((low | SWAR_HIGH_BITS) - SWAR_LOW_BITS * '\t') & SWAR_HIGH_BITS;
+   BlockMask leCarriageReturn = ((SWAR_LOW_BITS * (0x80 + '\r')) - low) & SWAR_HIGH_BITS;
+   return ascii & ((geTab & leCarriageReturn) | equal_mask(block, ' '));
+}
+
+constexpr BlockMask FULL_BLOCK_MASK = SWAR_HIGH_BITS;
+
+#endif
+
+/// Index of the first byte selected by a non zero \p mask.
+inline size_t first_byte_index(BlockMask mask)
+{
+#if defined(POLAR_TRIVIA_SCANNER_SWAR)
+   if (llvm::sys::IsLittleEndianHost) {
+      return count_trailing_zeros(mask, ZB_Undefined) / 8;
+   }
+   return count_leading_zeros(mask, ZB_Undefined) / 8;
+#else
+   return count_trailing_zeros(mask, ZB_Undefined);
+#endif
+}
+
+/// Mask of the bytes in front of byte \p index.
+inline BlockMask bytes_before(size_t index)
+{
+#if defined(POLAR_TRIVIA_SCANNER_SWAR)
+   if (index == 0) {
+      return 0;
+   }
+   if (llvm::sys::IsLittleEndianHost) {
+      return ~BlockMask(0) >> (64 - index * 8);
+   }
+   return ~BlockMask(0) << (64 - index * 8);
+#else
+   return (BlockMask(1) << index) - 1;
+#endif
+}
+
+template <typename... Chars>
+inline bool is_one_of(unsigned char c, Chars... chars)
+{
+   return ((c == chars) || ...);
+}
+
+template <typename... Chars>
+const unsigned char *find_first_of(const unsigned char *ptr, const unsigned char *end, Chars... chars)
+{
+   while (static_cast<size_t>(end - ptr) >= BLOCK_SIZE) {
+      Block block = load_block(ptr);
+      BlockMask mask = (equal_mask(block, chars) | ...);
+      if (mask != 0) {
+         return ptr + first_byte_index(mask);
+      }
+      ptr += BLOCK_SIZE;
+   }
+   while (ptr < end && !is_one_of(*ptr, chars...)) {
+      ++ptr;
+   }
+   return ptr;
+}
+
+} // anonymous namespace
+
+const unsigned char *skip_whitespace_run(const unsigned char *ptr, const unsigned char *end,
+                                         bool &sawNewline)
+{
+   // most runs are a single space or a newline plus indentation, check the
+   // first byte before paying for a block load
+   if (ptr < end && !is_whitespace_char(*ptr)) {
+      return ptr;
+   }
+   while (static_cast<size_t>(end - ptr) >= BLOCK_SIZE) {
+      Block block = load_block(ptr);
+      BlockMask stopMask = ~whitespace_mask(block) & FULL_BLOCK_MASK;
+      BlockMask newlineMask = equal_mask(block, '\n') | equal_mask(block, '\r');
+      if (stopMask != 0) {
+         size_t index = first_byte_index(stopMask);
+         if (newlineMask & bytes_before(index)) {
+            sawNewline = true;
+         }
+         return ptr + index;
+      }
+      if (newlineMask != 0) {
+         sawNewline = true;
+      }
+      ptr += BLOCK_SIZE;
+   }
+   while (ptr < end && is_whitespace_char(*ptr)) {
+      if (is_newline_char(*ptr)) {
+         sawNewline = true;
+      }
+      ++ptr;
+   }
+   return ptr;
+}
+
+const unsigned char *find_line_end(const unsigned char *ptr, const unsigned char *end)
+{
+   return find_first_of(ptr, end, '\n', '\r', '\0');
+}
+
+const unsigned char *find_block_comment_delimiter(const unsigned char *ptr, const unsigned char *end)
+{
+   return find_first_of(ptr, end, '*', '/', '\n', '\r', '\0');
+}
+
+const unsigned char *find_newline(const unsigned char *ptr, const unsigned char *end)
+{
+   return find_first_of(ptr, end, '\n', '\r');
+}
+
+const unsigned char *find_heredoc_delimiter(const unsigned char *ptr, const unsigned char *end)
+{
+   return find_first_of(ptr, end, '\n', '\r', '$', '{', '\\');
+}
+
+const char *get_trivia_scanner_name()
+{
+#if defined(POLAR_TRIVIA_SCANNER_AVX2)
+   return "avx2";
+#elif defined(POLAR_TRIVIA_SCANNER_SSE2)
+   return "sse2";
+#else
+   return "swar";
+#endif
+}
+
+} // polar::parser::internal
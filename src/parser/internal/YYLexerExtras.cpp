@@ -11,12 +11,16 @@
 
 #include "polarphp/parser/internal/YYLexerExtras.h"
 #include "polarphp/parser/internal/YYLexerDefs.h"
+#include "polarphp/parser/internal/TriviaScanner.h"
 #include "clang/Basic/CharInfo.h"
 #include "polarphp/parser/Token.h"
 #include "polarphp/parser/Lexer.h"
 #include "polarphp/parser/Parser.h"
 #include "polarphp/utils/MathExtras.h"
+#include "llvm/ADT/StringExtras.h"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 namespace polar::parser::internal {
@@ -27,6 +31,18 @@ using namespace polar;
 
 int token_lex_wrapper(ParserSemantic *value, YYLocation *loc, Lexer *lexer, Parser *parser)
 {
+   size_t tokenStart = lexer->getCurrentOffset();
+   if (parser->isReusingSyntax()) {
+      SyntaxKind reusedKind;
+      if (RefCountPtr<RawSyntax> reusedStmt = parser->consumeReusableStmt(reusedKind)) {
+         value->emplace<RefCountPtr<RawSyntax>>(reusedStmt);
+         parser->recordToken(nullptr, *loc);
+         parser->recordTokenRange(tokenStart, lexer->getCurrentOffset());
+         return reusedKind == SyntaxKind::TopStmt
+               ? YYParser::token::T_REUSED_TOP_STMT
+               : YYParser::token::T_REUSED_INNER_STMT;
+      }
+   }
    Token token;
    lexer->setSemanticValueContainer(value);
    lexer->lex(token);
@@ -40,6 +56,11 @@ int token_lex_wrapper(ParserSemantic *value, YYLocation *loc, Lexer *lexer, Pars
       value->emplace<std::string>(token.getValue<std::string>());
    }
    parser->m_token = token;
+   parser->recordToken(&token, *loc);
+   parser->recordTokenRange(tokenStart, lexer->getCurrentOffset());
+   if (parser->isReusingSyntax()) {
+      parser->trackStmtBoundary(token.getKind());
+   }
    return token.getKind();
 }
 
@@ -93,6 +114,10 @@ void diagnose_embedded_null(DiagnosticEngine *diags, const unsigned char *ptr)
 bool advance_to_end_of_line(const unsigned char *&m_yyCursor, const unsigned char *bufferEnd,
                             const unsigned char *codeCompletionPtr, DiagnosticEngine *diags) {
    while (1) {
+      if (!diags) {
+         // no UTF-8 validation wanted, jump to the next byte the switch cares about
+         m_yyCursor = find_line_end(m_yyCursor, bufferEnd);
+      }
       switch (*m_yyCursor++) {
       case '\n':
       case '\r':
@@ -140,6 +165,10 @@ bool skip_to_end_of_slash_star_comment(const unsigned char *&m_yyCursor, const u
    bool isMultiline = false;
 
    while (1) {
+      if (!diags) {
+         // no UTF-8 validation wanted, jump to the next byte the switch cares about
+         m_yyCursor = find_block_comment_delimiter(m_yyCursor, bufferEnd);
+      }
       switch (*m_yyCursor++) {
       case '*':
          // Check for a '*/'
@@ -218,53 +247,23 @@ bool advance_if(const unsigned char *&ptr, const unsigned char *end,
    return false;
 }
 
-const char *next_newline(const char *str, const char *end, size_t &newlineLen)
-{
-   for (; str < end; ++str) {
-      if (*str == '\r') {
-         newlineLen = str + 1 < end && *(str + 1) == '\n' ? 2 : 1;
-      } else if (*str == '\n') {
-         newlineLen = 1;
-         return str;
-      }
-   }
-   newlineLen = 0;
-   return nullptr;
-}
-
-bool strip_multiline_string_indentation(Lexer &lexer, std::string &str, int indentation, bool usingSpaces,
+bool check_multiline_string_indentation(Lexer &lexer, StringRef str, int indentation, bool usingSpaces,
                                         bool newlineAtStart, bool newlineAtEnd)
 {
-   const char *cursor = str.data();
-   const char *end = cursor + str.size();
-   char *copy = str.data();
-   int newLineCount = 0;
-   size_t newlineLen;
-   const char *newLine;
+   const char *cursor = str.begin();
+   const char *end = str.end();
    if (!newlineAtStart) {
-      newLine = next_newline(cursor, end, newlineLen);
-      if (nullptr == newLine) {
+      const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+      if (nullptr == newline) {
          return true;
       }
-      cursor = newLine + newlineLen;
-      copy = const_cast<char *>(newLine) + newlineLen;
-      ++newLineCount;
-   } else {
-      newLine = cursor;
-   }
-   // intentional
-   while (cursor <= end && newLine) {
-      int skip;
-      newLine = next_newline(cursor, end, newlineLen);
-      if (nullptr == newLine && newlineAtEnd) {
-         newLine = end;
-      }
-      // Try to skip indentation
-      for (skip = 0; skip < indentation; skip++, cursor++) {
-         if (cursor == newLine) {
-            // Don't require full indentation on whitespace-only lines
-            break;
-         }
+      cursor = newline + 1;
+   }
+   while (true) {
+      const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+      const char *lineEnd = newline ? newline : (newlineAtEnd ? end : nullptr);
+      for (int skip = 0; skip < indentation && cursor != lineEnd; ++skip, ++cursor) {
+         // Don't require full indentation on whitespace-only lines
          if (cursor == end || (*cursor != ' ' && *cursor != '\t')) {
             lexer.notifyLexicalException(0, "Invalid body indentation level (expecting an indentation level of at least %d)",
                                          indentation);
@@ -275,17 +274,11 @@ bool strip_multiline_string_indentation(Lexer &lexer, std::string &str, int inde
             return false;
          }
       }
-      if (cursor == end) {
-         break;
+      if (nullptr == newline) {
+         return true;
       }
-      size_t len = newLine ? (newLine - cursor + newlineLen) : (end - cursor);
-      std::memmove(copy, cursor, len);
-      cursor += len;
-      copy += len;
-      ++newLineCount;
+      cursor = newline + 1;
    }
-   str.resize(copy - str.data());
-   return true;
 }
 
 void strip_underscores(std::string &str, size_t &len)
@@ -401,188 +394,198 @@ long convert_single_quote_str_escape_sequences(std::string::iterator iter, std::
    }
    std::string::iterator targetIter = iter;
    while (iter != endMark) {
-      if (*iter == '\\') {
+      // only \\ and \' are escapes, other backslashes are kept as is
+      if (*iter == '\\' && iter + 1 != endMark && (iter[1] == '\\' || iter[1] == '\'')) {
          ++iter;
-         if (*iter == '\\' || *iter == '\'') {
-            *targetIter = *iter;
-         } else {
-            *targetIter++ = '\\';
-            *targetIter++ = *iter;
-         }
-      } else {
-         *targetIter++ = *iter;
       }
-      ++targetIter;
+      *targetIter++ = *iter++;
    }
    return targetIter - origIter;
 }
 
-bool convert_double_quote_str_escape_sequences(std::string &filteredStr, char quoteType, std::string::iterator iter,
-                                               std::string::iterator endMark, Lexer &lexer)
+namespace {
+
+/// Parse the hex digits of a \u{...} escape that starts at \p iter, which
+/// points behind the 'u'. Returns the position behind the '}', or null for an
+/// invalid sequence, a code point beyond 21 bits is reported as
+/// \p codePoint 0x110000.
+const char *parse_unicode_escape(const char *iter, const char *end, std::uint32_t &codePoint)
 {
-   size_t origLength = endMark - iter;
-   if (origLength <= 1) {
-      return true;
+   if (iter == end || *iter != '{') {
+      return nullptr;
+   }
+   const char *digitStart = ++iter;
+   codePoint = 0;
+   while (iter != end && is_hex_digit(*iter)) {
+      if (codePoint <= 0x10FFFF) {
+         codePoint = codePoint * 16 + llvm::hexDigitValue(*iter);
+      }
+      ++iter;
+   }
+   /// \u{} is invalid
+   if (iter == end || *iter != '}' || iter == digitStart) {
+      return nullptr;
    }
-   /// convert escape sequences
-   auto fiter = filteredStr.begin();
-   auto fendMark = filteredStr.end();
-   /// find first '\'
+   codePoint = std::min<std::uint32_t>(codePoint, 0x110000);
+   return iter + 1;
+}
+
+/// Returns the number of octal digits of the escape that starts at \p iter,
+/// at most three.
+size_t count_octal_escape_digits(const char *iter, const char *end)
+{
+   size_t count = 0;
+   while (count < 3 && iter + count != end && POLAR_IS_OCT(iter[count])) {
+      ++count;
+   }
+   return count;
+}
+
+} // anonymous namespace
+
+bool check_double_quote_str_escape_sequences(Lexer &lexer, StringRef str)
+{
+   const char *iter = str.begin();
+   const char *end = str.end();
    while (true) {
-      if (*fiter == '\\') {
-         break;
-      }
-      ++fiter;
-      if (fiter == fendMark) {
+      iter = static_cast<const char *>(std::memchr(iter, '\\', end - iter));
+      if (!iter || ++iter == end) {
          return true;
       }
+      if (*iter == 'u' && iter + 1 != end && iter[1] == '{') {
+         /// a bare \u is let through to avoid breaking code with JSON in
+         /// string literals (e.g. "\"\u202e\""), but an invalid \u{blah} errors
+         std::uint32_t codePoint;
+         const char *next = parse_unicode_escape(iter + 1, end, codePoint);
+         if (!next) {
+            lexer.notifyLexicalException("Invalid UTF-8 codepoint escape sequence", 0);
+            return false;
+         }
+         /// per RFC 3629, UTF-8 can only represent 21 bits
+         if (codePoint > 0x10FFFF) {
+            lexer.notifyLexicalException("Invalid UTF-8 codepoint escape sequence: Codepoint too large", 0);
+            return false;
+         }
+         iter = next;
+         continue;
+      }
+      size_t octalDigits = count_octal_escape_digits(iter, end);
+      if (octalDigits == 3 && *iter > '3') {
+         char octalBuf[4] = { iter[0], iter[1], iter[2], 0 };
+         lexer.notifyLexicalException(0, "Octal escape sequence overflow \\%s is greater than \\377", octalBuf);
+      }
+      /// the escaped character is never the start of another escape
+      iter += std::max<size_t>(octalDigits, 1);
    }
-   auto targetIter = fiter;
-   while (fiter != fendMark) {
-      if (*fiter == '\\') {
-         ++fiter;
-         if (fiter == fendMark) {
-            *targetIter++ = '\\';
+}
+
+void decode_double_quote_str_escape_sequences(StringRef str, char quoteType, std::string &result)
+{
+   result.reserve(result.size() + str.size());
+   const char *iter = str.begin();
+   const char *end = str.end();
+   while (true) {
+      /// most of the text is copied verbatim, copy the runs between the
+      /// backslashes at once instead of byte by byte
+      const char *backslash = static_cast<const char *>(std::memchr(iter, '\\', end - iter));
+      if (!backslash) {
+         result.append(iter, end);
+         return;
+      }
+      result.append(iter, backslash);
+      iter = backslash + 1;
+      if (iter == end) {
+         result += '\\';
+         return;
+      }
+      char escaped = *iter++;
+      switch (escaped) {
+      case 'n':
+         result += '\n';
+         break;
+      case 'r':
+         result += '\r';
+         break;
+      case 't':
+         result += '\t';
+         break;
+      case 'f':
+         result += '\f';
+         break;
+      case 'v':
+         result += '\v';
+         break;
+      case '"':
+      case '`':
+         if (escaped != quoteType) {
+            result += '\\';
+            result += escaped;
             break;
          }
-         switch (*fiter) {
-         case 'n':
-            *targetIter++ = '\n';
-            break;
-         case 'r':
-            *targetIter++ = '\r';
-            break;
-         case 't':
-            *targetIter++ = '\t';
-            break;
-         case 'f':
-            *targetIter++ = '\f';
-            break;
-         case 'v':
-            *targetIter++ = '\v';
-            break;
-            //         case 'e':
-            //            *targetIter++ = '\e';
-            //            break;
-         case '"':
-         case '`':
-            if (*fiter != quoteType) {
-               *targetIter++ = '\\';
-               *targetIter++ = *fiter;
-               break;
-            }
-            [[fallthrough]];
-         case '\\':
-         case '$':
-            *targetIter++ = *fiter;
-            break;
-         case 'x':
-         case 'X':
-            if (is_hex_digit(*(fiter + 1))) {
-               char hexBuf[3] = { 0, 0, 0 };
-               hexBuf[0] = *(++fiter);
-               if (is_hex_digit(*(fiter + 1))) {
-                  hexBuf[1] = *(++fiter);
-               }
-               *targetIter++ = static_cast<char>(std::strtol(hexBuf, nullptr, 16));
-            } else {
-               *targetIter++ = '\\';
-               *targetIter++ = *fiter;
-            }
-            break;
-            /* UTF-8 codepoint escape, format: /\\u\{\x+\}/ */
-         case 'u':
-         {
-            /// cache where we started so we can parse after validating
-            auto start = fiter + 1;
-            size_t length = 0;
-            bool valid = true;
-            unsigned long codePoint;
-            if (*start != '{') {
-               /// we silently let this pass to avoid breaking code
-               /// with JSON in string literals (e.g. "\"\u202e\""
-               *targetIter++ = '\\';
-               *targetIter++ = 'u';
-               break;
-            } else {
-               /// on the other hand, invalid \u{blah} errors
-               fiter += 2;
-               ++length;
-               while (*fiter != '}') {
-                  if (!is_hex_digit(*fiter)) {
-                     valid = false;
-                     break;
-                  } else {
-                     ++length;
-                  }
-               }
-               if (*fiter == '}') {
-                  valid = true;
-                  ++length;
-               }
-            }
-            /* \u{} is invalid */
-            if (length <= 2) {
-               valid = false;
-            }
-            if (!valid) {
-               lexer.notifyLexicalException("Invalid UTF-8 codepoint escape sequence", 0);
-               return false;
-            }
-            errno = 0;
-            StringRef codePointStr(filteredStr.data() + (start - filteredStr.begin()), fiter - start);
-            codePoint = strtoul(codePointStr.data(), nullptr, 16);
-            /// per RFC 3629, UTF-8 can only represent 21 bits
-            if (codePoint > 0x10FFFF || errno) {
-               lexer.notifyLexicalException("Invalid UTF-8 codepoint escape sequence: Codepoint too large", 0);
-               return false;
-            }
-            /// based on https://en.wikipedia.org/wiki/UTF-8#Sample_code
-            if (codePoint < 0x80) {
-               *targetIter++ = static_cast<std::string::value_type>(codePoint);
-            } else if (codePoint <= 0x7FF) {
-               *targetIter++ = static_cast<std::string::value_type>((codePoint >> 6) + 0xC0);
-               *targetIter++ = static_cast<std::string::value_type>((codePoint & 0x3F) + 0x80);
-            } else if (codePoint <= 0xFFFF) {
-               *targetIter++ = static_cast<std::string::value_type>((codePoint >> 12) + 0xE0);
-               *targetIter++ = static_cast<std::string::value_type>(((codePoint >> 6) & 0x3F) + 0x80);
-               *targetIter++ = static_cast<std::string::value_type>((codePoint & 0x3F) + 0x80);
-            } else if (codePoint <= 0x10FFFF) {
-               *targetIter++ = static_cast<std::string::value_type>((codePoint >> 18) + 0xF0);
-               *targetIter++ = static_cast<std::string::value_type>(((codePoint >> 12) & 0x3F) + 0x80);
-               *targetIter++ = static_cast<std::string::value_type>(((codePoint >> 6) & 0x3F) + 0x80);
-               *targetIter++ = static_cast<std::string::value_type>((codePoint & 0x3F) + 0x80);
+         [[fallthrough]];
+      case '\\':
+      case '$':
+         result += escaped;
+         break;
+      case 'x':
+      case 'X':
+         if (iter != end && is_hex_digit(*iter)) {
+            unsigned value = llvm::hexDigitValue(*iter++);
+            if (iter != end && is_hex_digit(*iter)) {
+               value = value * 16 + llvm::hexDigitValue(*iter++);
             }
+            result += static_cast<char>(value);
+         } else {
+            result += '\\';
+            result += escaped;
          }
+         break;
+      case 'u':
+      {
+         /// UTF-8 codepoint escape, format: /\\u\{\x+\}/
+         std::uint32_t codePoint;
+         const char *next = parse_unicode_escape(iter, end, codePoint);
+         /// the lexer rejects invalid sequences, they are kept as is when
+         /// it did not check them
+         if (!next || codePoint > 0x10FFFF) {
+            result += '\\';
+            result += escaped;
             break;
-         default:
-            /// check for an octal
-            if (POLAR_IS_OCT(*fiter)) {
-               char octalBuf[4] = { 0, 0, 0, 0 };
-               octalBuf[0] = *fiter;
-               if (POLAR_IS_OCT(*(fiter + 1))) {
-                  octalBuf[1] = *(++fiter);
-                  if (POLAR_IS_OCT(*(fiter + 1))) {
-                     octalBuf[2] = *(++fiter);
-                  }
-               }
-               if (octalBuf[2] && (octalBuf[0] > '3')) {
-                  lexer.notifyLexicalException(0, "Octal escape sequence overflow \\%s is greater than \\377", octalBuf);
-               }
-               *targetIter++ = static_cast<char>(std::strtol(octalBuf, nullptr, 8));
-            } else {
-               *targetIter++ = '\\';
-               *targetIter++ = *fiter;
+         }
+         iter = next;
+         /// based on https://en.wikipedia.org/wiki/UTF-8#Sample_code
+         if (codePoint < 0x80) {
+            result += static_cast<char>(codePoint);
+         } else if (codePoint <= 0x7FF) {
+            result += static_cast<char>((codePoint >> 6) + 0xC0);
+            result += static_cast<char>((codePoint & 0x3F) + 0x80);
+         } else if (codePoint <= 0xFFFF) {
+            result += static_cast<char>((codePoint >> 12) + 0xE0);
+            result += static_cast<char>(((codePoint >> 6) & 0x3F) + 0x80);
+            result += static_cast<char>((codePoint & 0x3F) + 0x80);
+         } else {
+            result += static_cast<char>((codePoint >> 18) + 0xF0);
+            result += static_cast<char>(((codePoint >> 12) & 0x3F) + 0x80);
+            result += static_cast<char>(((codePoint >> 6) & 0x3F) + 0x80);
+            result += static_cast<char>((codePoint & 0x3F) + 0x80);
+         }
+         break;
+      }
+      default:
+         if (POLAR_IS_OCT(escaped)) {
+            /// an overflowing \4xx to \7xx keeps the low eight bits
+            unsigned value = 0;
+            for (size_t count = count_octal_escape_digits(--iter, end); count > 0; --count) {
+               value = value * 8 + (*iter++ - '0');
             }
-            break;
+            result += static_cast<char>(value);
+         } else {
+            result += '\\';
+            result += escaped;
          }
-      } else {
-         *targetIter++ = *fiter;
+         break;
       }
-      ++fiter;
    }
-   filteredStr.resize(targetIter - filteredStr.begin());
-   return true;
 }
 
 namespace {
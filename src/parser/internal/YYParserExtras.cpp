@@ -10,13 +10,21 @@
 // Created by polarboy on 2019/06/06.
 
 #include "polarphp/parser/internal/YYParserDefs.h"
+#include "polarphp/parser/Parser.h"
 #include <iostream>
 
 namespace polar::parser::internal {
 
 void YYParser::error(const location_type &loc, const std::string &msg)
 {
-   std::cout << msg << std::endl;
+   if (parser->isReusingSyntax()) {
+      // the parser starts over without reusing syntax, report the error then
+      return;
+   }
+   parser->m_parseErrors.push_back({parser->m_token.getLoc(), msg});
+   if (!parser->isErrorRecoveryEnabled()) {
+      std::cout << msg << std::endl;
+   }
 }
 
 } // polar::parser::internal
@@ -0,0 +1,129 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/21.
+
+#include "polarphp/parser/serialization/TokenBinarySerialization.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+namespace polar::parser {
+
+namespace endian = llvm::support::endian;
+using ValueType = Token::ValueType;
+
+namespace {
+/// kind, offset, length, flags and value type
+constexpr size_t TOKEN_RECORD_FIXED_SIZE = 2 + 4 + 4 + 1 + 1;
+} // anonymous namespace
+
+void write_token_binary_header(raw_ostream &out)
+{
+   out.write(TOKEN_BINARY_MAGIC, sizeof(TOKEN_BINARY_MAGIC));
+   endian::Writer(out, llvm::support::little).write<std::uint16_t>(TOKEN_BINARY_VERSION);
+}
+
+void write_token_binary_record(raw_ostream &out, const Token &token, unsigned offset)
+{
+   endian::Writer writer(out, llvm::support::little);
+   ValueType valueType = token.isInvalidLexValue() || !token.hasValue()
+         ? ValueType::Unknown
+         : token.getValueType();
+   writer.write<std::uint16_t>(static_cast<std::uint16_t>(token.getKind()));
+   writer.write<std::uint32_t>(offset);
+   writer.write<std::uint32_t>(static_cast<std::uint32_t>(token.getLexicalLength()));
+   writer.write<std::uint8_t>(token.getFlags().getOpaqueValue());
+   writer.write<std::uint8_t>(static_cast<std::uint8_t>(valueType));
+   if (valueType == ValueType::LongLong) {
+      writer.write<std::int64_t>(token.getValue<std::int64_t>());
+   } else if (valueType == ValueType::Double) {
+      double value = token.getValue<double>();
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      writer.write<std::uint64_t>(bits);
+   } else if (valueType == ValueType::String) {
+      StringRef value = token.getStringValue();
+      writer.write<std::uint32_t>(static_cast<std::uint32_t>(value.size()));
+      out << value;
+   }
+}
+
+TokenBinaryReader::TokenBinaryReader(StringRef data)
+   : m_data(data)
+{
+   constexpr size_t headerSize = sizeof(TOKEN_BINARY_MAGIC) + sizeof(std::uint16_t);
+   if (!canRead(headerSize) ||
+       std::memcmp(m_data.data(), TOKEN_BINARY_MAGIC, sizeof(TOKEN_BINARY_MAGIC)) != 0 ||
+       endian::read16le(m_data.data() + sizeof(TOKEN_BINARY_MAGIC)) != TOKEN_BINARY_VERSION) {
+      return;
+   }
+   m_position = headerSize;
+   m_valid = true;
+}
+
+bool TokenBinaryReader::next(TokenRecord &record)
+{
+   if (!m_valid || m_error || m_position == m_data.size()) {
+      return false;
+   }
+   if (!canRead(TOKEN_RECORD_FIXED_SIZE)) {
+      m_error = true;
+      return false;
+   }
+   const char *ptr = m_data.data() + m_position;
+   record.kind = static_cast<TokenKindType>(endian::read16le(ptr));
+   record.offset = endian::read32le(ptr + 2);
+   record.length = endian::read32le(ptr + 6);
+   record.flags = TokenFlags(static_cast<std::uint8_t>(ptr[10]));
+   record.valueType = static_cast<ValueType>(static_cast<std::uint8_t>(ptr[11]));
+   record.stringValue = StringRef();
+   m_position += TOKEN_RECORD_FIXED_SIZE;
+   ptr += TOKEN_RECORD_FIXED_SIZE;
+   switch (record.valueType) {
+   case ValueType::LongLong:
+   case ValueType::Double:
+   {
+      if (!canRead(8)) {
+         m_error = true;
+         return false;
+      }
+      std::uint64_t bits = endian::read64le(ptr);
+      if (record.valueType == ValueType::LongLong) {
+         record.intValue = static_cast<std::int64_t>(bits);
+      } else {
+         std::memcpy(&record.doubleValue, &bits, sizeof(bits));
+      }
+      m_position += 8;
+      break;
+   }
+   case ValueType::String:
+   {
+      if (!canRead(4)) {
+         m_error = true;
+         return false;
+      }
+      std::uint32_t size = endian::read32le(ptr);
+      if (!canRead(4 + size)) {
+         m_error = true;
+         return false;
+      }
+      record.stringValue = StringRef(ptr + 4, size);
+      m_position += 4 + size;
+      break;
+   }
+   default:
+      break;
+   }
+   return true;
+}
+
+} // polar::parser
@@ -68,7 +68,7 @@ void to_json(json &jsonObject, const Token &token)
       ValueType valueType = token.getValueType();
       TokenKindType kind = token.getKind();
       if (valueType == ValueType::String) {
-         std::string value = token.getValue<std::string>();
+         std::string value = token.getStringValue().str();
          if (kind == TokenKindType::T_VARIABLE) {
             value = '$' + value;
          }
@@ -1108,6 +1108,7 @@ bool ConstraintSystem::solve(Expr *&expr,
                              listener,
                              solutions,
                              allowFreeTypeVariables);
+   getAstContext().noteSolvedExprArenaBytes(expr, Allocator.getBytesAllocated());
 
    // The constraint system has failed
    if (solution == SolutionKind::Error)
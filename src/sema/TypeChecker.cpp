@@ -345,6 +345,7 @@ TypeCheckSourceFileRequest::evaluate(Evaluator &eval,
          .buildEnoughOfTreeForTopLevelExpressionsButDontRequestGenericsOrExtendedNominals();
 
    BufferIndirectlyCausingDiagnosticRAII cpr(*SF);
+   ArenaAccountingRAII arenaScope(Ctx, "type-check", SF);
 
    // Make sure we have a type checker.
    TypeChecker &TC = createTypeChecker(Ctx);
@@ -48,9 +48,45 @@ void print_syntax_kind(SyntaxKind kind, raw_ostream &outStream,
    outStream << ">";
 }
 
+/// Number of node ids a thread reserves from the global counter at once.
+constexpr SyntaxNodeId NODE_ID_RANGE_SIZE = 4096;
+
+/// The node id range currently owned by a thread, [next, end).
+struct NodeIdRange
+{
+   SyntaxNodeId next = 0;
+   SyntaxNodeId end = 0;
+};
+
+thread_local NodeIdRange sg_nodeIdRange;
+
 } // anonymous namespace
 
-unsigned RawSyntax::sm_nextFreeNodeId = 1;
+std::atomic<SyntaxNodeId> RawSyntax::sm_nextFreeNodeId{1};
+
+SyntaxNodeId RawSyntax::allocateNodeId()
+{
+   NodeIdRange &range = sg_nodeIdRange;
+   if (range.next == range.end) {
+      range.next = sm_nextFreeNodeId.fetch_add(NODE_ID_RANGE_SIZE, std::memory_order_relaxed);
+      range.end = range.next + NODE_ID_RANGE_SIZE;
+   }
+   return range.next++;
+}
+
+void RawSyntax::reserveNodeId(SyntaxNodeId nodeId)
+{
+   // the range of this thread was taken from the counter before, skip the
+   // id in it; the ranges of other threads can not be fixed from here
+   NodeIdRange &range = sg_nodeIdRange;
+   if (nodeId >= range.next && nodeId < range.end) {
+      range.next = nodeId + 1;
+   }
+   SyntaxNodeId current = sm_nextFreeNodeId.load(std::memory_order_relaxed);
+   while (current <= nodeId &&
+          !sm_nextFreeNodeId.compare_exchange_weak(current, nodeId + 1, std::memory_order_relaxed)) {
+   }
+}
 
 RawSyntax::RawSyntax(SyntaxKind kind, ArrayRef<RefCountPtr<RawSyntax>> layout,
                      SourcePresence presence, const RefCountPtr<SyntaxArena> &arena,
@@ -63,9 +99,9 @@ RawSyntax::RawSyntax(SyntaxKind kind, ArrayRef<RefCountPtr<RawSyntax>> layout,
 
    if (nodeId.has_value()) {
       this->m_nodeId = nodeId.value();
-      sm_nextFreeNodeId = std::max(this->m_nodeId + 1, sm_nextFreeNodeId);
+      reserveNodeId(this->m_nodeId);
    } else {
-      this->m_nodeId = sm_nextFreeNodeId++;
+      this->m_nodeId = allocateNodeId();
    }
    m_bits.common.kind = unsigned(kind);
    m_bits.common.presence = unsigned(presence);
@@ -89,9 +125,9 @@ RawSyntax::RawSyntax(TokenKindType tokenKind, OwnedString text,
 
    if (nodeId.has_value()) {
       this->m_nodeId = nodeId.value();
-      sm_nextFreeNodeId = std::max(this->m_nodeId + 1, sm_nextFreeNodeId);
+      reserveNodeId(this->m_nodeId);
    } else {
-      this->m_nodeId = sm_nextFreeNodeId++;
+      this->m_nodeId = allocateNodeId();
    }
    m_bits.common.kind = unsigned(SyntaxKind::Token);
    m_bits.common.presence = unsigned(presence);
@@ -167,13 +203,27 @@ RefCountPtr<RawSyntax> RawSyntax::make(TokenKindType tokenKind, OwnedString text
                                        const RefCountPtr<SyntaxArena> &arena,
                                        std::optional<unsigned> nodeId)
 {
+   FoldingSetNodeID id;
+   void *insertPos = nullptr;
+   bool uniqued = arena && arena->isTokenUniquingEnabled() && !nodeId.has_value();
+   if (uniqued) {
+      profile(id, tokenKind, text, leadingTrivia, trailingTrivia);
+      id.AddInteger(unsigned(presence));
+      if (RawSyntax *token = arena->lookUpUniquedToken(id, insertPos)) {
+         return RefCountPtr<RawSyntax>(token);
+      }
+   }
    auto size = totalSizeToAlloc<RefCountPtr<RawSyntax>, OwnedString, std::int64_t, double, TriviaPiece>(
             0, 1, 0, 0, leadingTrivia.size() + trailingTrivia.size());
    void *data = arena ? arena->allocate(size, alignof(RawSyntax))
                       : ::operator new(size);
-   return RefCountPtr<RawSyntax>(new (data) RawSyntax(tokenKind, text, leadingTrivia,
-                                                      trailingTrivia, presence,
-                                                      arena, nodeId));
+   RefCountPtr<RawSyntax> token(new (data) RawSyntax(tokenKind, text, leadingTrivia,
+                                                     trailingTrivia, presence,
+                                                     arena, nodeId));
+   if (uniqued) {
+      arena->addUniquedToken(token.get(), id, insertPos);
+   }
+   return token;
 }
 
 RefCountPtr<RawSyntax> RawSyntax::make(TokenKindType tokenKind, OwnedString text,
@@ -218,7 +268,7 @@ RefCountPtr<RawSyntax> RawSyntax::append(RefCountPtr<RawSyntax> newLayoutElement
    newLayout.reserve(layout.size() + 1);
    std::copy(layout.begin(), layout.end(), std::back_inserter(newLayout));
    newLayout.push_back(newLayoutElement);
-   return RawSyntax::make(getKind(), newLayout, SourcePresence::Present);
+   return RawSyntax::make(getKind(), newLayout, SourcePresence::Present, arena);
 }
 
 RefCountPtr<RawSyntax> RawSyntax::replaceChild(CursorIndex index,
@@ -236,7 +286,7 @@ RefCountPtr<RawSyntax> RawSyntax::replaceChild(CursorIndex index,
    std::copy(layout.begin() + index + 1, layout.end(),
              std::back_inserter(newLayout));
 
-   return RawSyntax::make(getKind(), newLayout, getPresence());
+   return RawSyntax::make(getKind(), newLayout, getPresence(), arena);
 }
 
 std::optional<AbsolutePosition>
@@ -396,6 +446,9 @@ void RawSyntax::profile(FoldingSetNodeID &id, TokenKindType tokenKind,
        id.AddString(text.str());
        break;
      }
+   // without the count a piece could move between leading and trailing
+   // trivia without changing the profile
+   id.AddInteger(leadingTrivia.size());
    for (auto &piece : leadingTrivia) {
       piece.profile(id);
    }
@@ -0,0 +1,92 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/03.
+
+#include "polarphp/syntax/RawSyntaxWalker.h"
+#include "polarphp/syntax/SyntaxData.h"
+#include "polarphp/basic/Defer.h"
+#include "polarphp/global/CompilerFeature.h"
+#include "llvm/Support/ErrorHandling.h"
+
+namespace polar::syntax {
+
+RawSyntaxWalker::~RawSyntaxWalker()
+{}
+
+bool RawSyntaxWalker::walk(const RefCountPtr<RawSyntax> &root)
+{
+   assert(m_stack.empty() && "the walk is not reentrant");
+   assert(root && "can not walk an empty tree");
+   m_root = root;
+   POLAR_DEFER {
+      m_stack.clear();
+      m_root = nullptr;
+   };
+   if (!enterNode(root.get(), 0)) {
+      return false;
+   }
+   while (!m_stack.empty()) {
+      Frame &top = m_stack.back();
+      const RawSyntax *node = top.node;
+      std::uint32_t numChildren = node->getNumChildren();
+      if (top.nextChild >= numChildren) {
+         bool stopped = walkPost(*node) == Action::Stop;
+         m_stack.pop_back();
+         if (stopped) {
+            return false;
+         }
+         continue;
+      }
+      std::uint32_t childIndex = top.nextChild++;
+      const RawSyntax *child = node->getChild(childIndex).get();
+      // the header of the next sibling is read as soon as the subtree of
+      // this child is done, fetch it while the subtree is walked
+      if (childIndex + 1 < numChildren) {
+         POLAR_PREFETCH(node->getChild(childIndex + 1).get(), 0, 1);
+      }
+      if (child && !enterNode(child, childIndex)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool RawSyntaxWalker::enterNode(const RawSyntax *node, std::uint32_t indexInParent)
+{
+   m_stack.push_back({node, indexInParent, 0, nullptr});
+   switch (walkPre(*node)) {
+   case Action::Continue:
+      return true;
+   case Action::SkipChildren:
+      m_stack.back().nextChild = UINT32_MAX;
+      return true;
+   case Action::Stop:
+      return false;
+   }
+   llvm_unreachable("unknown walk action");
+}
+
+Syntax RawSyntaxWalker::getCurrentSyntax()
+{
+   assert(!m_stack.empty() && "not walking");
+   // the realized frames form a prefix of the stack
+   size_t first = m_stack.size();
+   while (first > 0 && !m_stack[first - 1].data) {
+      --first;
+   }
+   for (size_t i = first; i < m_stack.size(); ++i) {
+      m_stack[i].data = i == 0
+            ? SyntaxData::make(m_root)
+            : m_stack[i - 1].data->getChild(static_cast<size_t>(m_stack[i].indexInParent));
+   }
+   return Syntax(m_stack.front().data, m_stack.back().data.get());
+}
+
+} // polar::syntax
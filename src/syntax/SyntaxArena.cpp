@@ -0,0 +1,98 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/29.
+
+#include "polarphp/syntax/SyntaxArena.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "llvm/ADT/FoldingSet.h"
+
+namespace polar::syntax {
+
+namespace {
+
+/// Entry of the uniqued token table, carved from the arena allocator like
+/// the tokens themselves.
+class UniquedToken : public llvm::FoldingSetNode
+{
+public:
+   UniquedToken(llvm::FoldingSetNodeIDRef id, RawSyntax *token)
+      : m_id(id),
+        m_token(token)
+   {}
+
+   void Profile(FoldingSetNodeID &id) const
+   {
+      id.AddNodeID(FoldingSetNodeID(m_id));
+   }
+
+   RawSyntax *getToken() const
+   {
+      return m_token;
+   }
+
+private:
+   llvm::FoldingSetNodeIDRef m_id;
+   RawSyntax *m_token;
+};
+
+} // anonymous namespace
+
+class SyntaxArena::UniquedTokenTable : public llvm::FoldingSet<UniquedToken>
+{};
+
+SyntaxArena::SyntaxArena()
+{}
+
+SyntaxArena::~SyntaxArena()
+{
+   assert((!m_uniquedTokens || m_uniquedTokens->empty()) &&
+          "the uniqued tokens retain the arena, it can not die before they are released");
+}
+
+RawSyntax *SyntaxArena::lookUpUniquedToken(const FoldingSetNodeID &id, void *&insertPos)
+{
+   if (!m_uniquedTokens) {
+      m_uniquedTokens = std::make_unique<UniquedTokenTable>();
+   }
+   UniquedToken *entry = m_uniquedTokens->FindNodeOrInsertPos(id, insertPos);
+   if (!entry) {
+      return nullptr;
+   }
+   ++m_numUniquedTokenHits;
+   return entry->getToken();
+}
+
+void SyntaxArena::addUniquedToken(RawSyntax *token, const FoldingSetNodeID &id, void *insertPos)
+{
+   assert(m_uniquedTokens && "look the token up first");
+   token->retain();
+   void *data = m_allocator.Allocate(sizeof(UniquedToken), alignof(UniquedToken));
+   m_uniquedTokens->InsertNode(new (data) UniquedToken(id.Intern(m_allocator), token), insertPos);
+}
+
+void SyntaxArena::clearUniquedTokens()
+{
+   if (!m_uniquedTokens) {
+      return;
+   }
+   // the entries live in the allocator, only the tokens need to be released;
+   // releasing the last token may destroy this arena, so empty the table first
+   std::vector<RawSyntax *> tokens;
+   tokens.reserve(m_uniquedTokens->size());
+   for (const UniquedToken &entry : *m_uniquedTokens) {
+      tokens.push_back(entry.getToken());
+   }
+   m_uniquedTokens->clear();
+   for (RawSyntax *token : tokens) {
+      token->release();
+   }
+}
+
+} // polar::syntax
@@ -0,0 +1,170 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/02.
+
+#include "polarphp/syntax/SyntaxPositionIndex.h"
+#include "polarphp/syntax/SyntaxData.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+namespace polar::syntax {
+
+namespace {
+
+constexpr std::uint32_t UNKNOWN_OFFSET = UINT32_MAX;
+
+/// A layout node whose children are being indexed.
+struct OpenNode
+{
+   SyntaxPositionIndex::NodeIndex node;
+   size_t nextChild;
+};
+
+size_t get_num_layout_children(const RawSyntax *raw)
+{
+   return raw->isToken() ? 0 : raw->getLayout().size();
+}
+
+} // anonymous namespace
+
+SyntaxPositionIndex::SyntaxPositionIndex(const RefCountPtr<RawSyntax> &root)
+   : m_root(root)
+{
+   assert(root && "can not index an empty tree");
+   m_lineStarts.push_back(0);
+   SmallString<64> triviaText;
+   auto addTrivia = [&](ArrayRef<TriviaPiece> pieces) {
+      for (const TriviaPiece &piece : pieces) {
+         triviaText.clear();
+         llvm::raw_svector_ostream stream(triviaText);
+         piece.print(stream);
+         addText(triviaText.str());
+      }
+   };
+   auto addNode = [&](const RawSyntax *raw, NodeIndex parent) -> NodeIndex {
+      NodeIndex index = m_nodes.size();
+      std::uint32_t firstChildSlot = m_childSlots.size();
+      m_childSlots.resize(firstChildSlot + get_num_layout_children(raw), INVALID_NODE);
+      m_nodes.push_back({raw, parent, firstChildSlot, m_currentOffset, 0, UNKNOWN_OFFSET});
+      if (!raw->isToken() || raw->isMissing()) {
+         return index;
+      }
+      addTrivia(raw->getLeadingTrivia());
+      std::uint32_t contentOffset = m_currentOffset;
+      addText(raw->getTokenText());
+      addTrivia(raw->getTrailingTrivia());
+      Node &node = m_nodes[index];
+      node.length = m_currentOffset - node.offset;
+      if (node.length > 0) {
+         m_tokens.push_back(index);
+      }
+      // the first present token decides the content offset of all the nodes
+      // it starts, every node is updated once
+      for (NodeIndex current = index;
+           current != INVALID_NODE && m_nodes[current].contentOffset == UNKNOWN_OFFSET;
+           current = m_nodes[current].parent) {
+         m_nodes[current].contentOffset = contentOffset;
+      }
+      return index;
+   };
+
+   std::vector<OpenNode> openNodes;
+   addNode(root.get(), INVALID_NODE);
+   if (!root->isToken()) {
+      openNodes.push_back({0, 0});
+   }
+   while (!openNodes.empty()) {
+      OpenNode &top = openNodes.back();
+      NodeIndex parent = top.node;
+      const RawSyntax *parentRaw = m_nodes[parent].raw;
+      if (top.nextChild == get_num_layout_children(parentRaw)) {
+         m_nodes[parent].length = m_currentOffset - m_nodes[parent].offset;
+         openNodes.pop_back();
+         continue;
+      }
+      size_t childIndex = top.nextChild++;
+      const RawSyntax *childRaw = parentRaw->getChild(childIndex).get();
+      if (!childRaw) {
+         continue;
+      }
+      NodeIndex child = addNode(childRaw, parent);
+      m_childSlots[m_nodes[parent].firstChildSlot + childIndex] = child;
+      if (!childRaw->isToken()) {
+         // invalidates top
+         openNodes.push_back({child, 0});
+      }
+   }
+   // nodes without present tokens start and end at the same offset
+   for (Node &node : m_nodes) {
+      if (node.contentOffset == UNKNOWN_OFFSET) {
+         node.contentOffset = node.offset;
+      }
+   }
+}
+
+void SyntaxPositionIndex::addText(StringRef text)
+{
+   std::uint32_t base = m_currentOffset;
+   for (size_t pos = 0; (pos = text.find_first_of("\r\n", pos)) != StringRef::npos; ++pos) {
+      bool endsCarriageReturn = text[pos] == '\n' &&
+            (pos > 0 ? text[pos - 1] == '\r' : m_pendingCarriageReturn);
+      if (endsCarriageReturn) {
+         // "\r\n" is one newline, the line starts behind the '\n'
+         m_lineStarts.back() = base + pos + 1;
+      } else {
+         m_lineStarts.push_back(base + pos + 1);
+      }
+   }
+   if (!text.empty()) {
+      m_pendingCarriageReturn = text.back() == '\r';
+   }
+   m_currentOffset += text.size();
+}
+
+SyntaxPositionIndex::NodeIndex SyntaxPositionIndex::findNode(const SyntaxData &data) const
+{
+   SmallVector<size_t, 32> path;
+   for (const SyntaxData *current = &data; current->hasParent(); current = current->getParent()) {
+      path.push_back(current->getIndexInParent());
+   }
+   NodeIndex node = getRoot();
+   for (auto iter = path.rbegin(), end = path.rend(); iter != end && node != INVALID_NODE; ++iter) {
+      node = getChild(node, *iter);
+   }
+   return node;
+}
+
+SyntaxPositionIndex::NodeIndex SyntaxPositionIndex::findDeepestNode(std::uint32_t offset) const
+{
+   if (offset >= getTextLength()) {
+      return INVALID_NODE;
+   }
+   // the present tokens cover the text without gaps, the last one starting
+   // at or before offset covers it
+   auto iter = std::upper_bound(m_tokens.begin(), m_tokens.end(), offset,
+                                [this](std::uint32_t value, NodeIndex token) {
+      return value < m_nodes[token].offset;
+   });
+   assert(iter != m_tokens.begin() && "the first token starts at offset 0");
+   return *(iter - 1);
+}
+
+std::pair<std::uint32_t, std::uint32_t>
+SyntaxPositionIndex::getLineAndColumn(std::uint32_t offset) const
+{
+   auto iter = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), offset);
+   std::uint32_t line = iter - m_lineStarts.begin();
+   return {line, offset - *(iter - 1) + 1};
+}
+
+} // polar::syntax
@@ -0,0 +1,316 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/22.
+
+#include "polarphp/syntax/serialization/SyntaxBinarySerialization.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Endian.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace polar::syntax {
+
+namespace endian = llvm::support::endian;
+
+namespace {
+
+constexpr std::uint32_t HEADER_SIZE = 24;
+constexpr std::uint8_t LAYOUT_RECORD_TAG = 0;
+constexpr std::uint8_t TOKEN_RECORD_TAG = 1;
+constexpr std::uint32_t LAYOUT_RECORD_HEADER_SIZE = 8;
+constexpr std::uint32_t TOKEN_RECORD_HEADER_SIZE = 16;
+constexpr std::uint32_t TRIVIA_PIECE_SIZE = 12;
+
+void append_u8(std::string &buffer, std::uint8_t value)
+{
+   buffer.push_back(static_cast<char>(value));
+}
+
+void append_u16(std::string &buffer, std::uint16_t value)
+{
+   char bytes[2];
+   endian::write16le(bytes, value);
+   buffer.append(bytes, sizeof(bytes));
+}
+
+void append_u32(std::string &buffer, std::uint32_t value)
+{
+   char bytes[4];
+   endian::write32le(bytes, value);
+   buffer.append(bytes, sizeof(bytes));
+}
+
+class SyntaxBinaryWriter
+{
+public:
+   /// Write the records of the subtree rooted at \p node, children first, and
+   /// return the offset of the record of \p node.
+   std::uint32_t writeNode(const RawSyntax &node)
+   {
+      std::uint32_t offset;
+      if (node.isToken()) {
+         offset = writeToken(node);
+      } else {
+         llvm::SmallVector<std::uint32_t, 8> childOffsets;
+         for (const RefCountPtr<RawSyntax> &child : node.getLayout()) {
+            childOffsets.push_back(child ? writeNode(*child) : SYNTAX_BINARY_NULL_OFFSET);
+         }
+         offset = getNextOffset();
+         append_u8(m_nodes, LAYOUT_RECORD_TAG);
+         append_u8(m_nodes, static_cast<std::uint8_t>(node.getPresence()));
+         append_u16(m_nodes, static_cast<std::uint16_t>(node.getKind()));
+         append_u32(m_nodes, static_cast<std::uint32_t>(childOffsets.size()));
+         for (std::uint32_t childOffset : childOffsets) {
+            append_u32(m_nodes, childOffset);
+         }
+      }
+      ++m_numNodes;
+      return offset;
+   }
+
+   void finish(raw_ostream &out, std::uint32_t rootOffset)
+   {
+      std::string header;
+      header.append(SYNTAX_BINARY_MAGIC, sizeof(SYNTAX_BINARY_MAGIC));
+      append_u16(header, SYNTAX_BINARY_VERSION);
+      append_u16(header, 0);
+      append_u32(header, m_numNodes);
+      append_u32(header, rootOffset);
+      append_u32(header, getNextOffset());
+      append_u32(header, static_cast<std::uint32_t>(m_strings.size()));
+      assert(header.size() == HEADER_SIZE);
+      out << header << m_nodes << m_strings;
+   }
+
+private:
+   std::uint32_t getNextOffset() const
+   {
+      return HEADER_SIZE + static_cast<std::uint32_t>(m_nodes.size());
+   }
+
+   std::uint32_t writeToken(const RawSyntax &token)
+   {
+      ArrayRef<TriviaPiece> leadingTrivia = token.getLeadingTrivia();
+      ArrayRef<TriviaPiece> trailingTrivia = token.getTrailingTrivia();
+      StringRef text = token.getTokenText();
+      std::uint32_t offset = getNextOffset();
+      append_u8(m_nodes, TOKEN_RECORD_TAG);
+      append_u8(m_nodes, static_cast<std::uint8_t>(token.getPresence()));
+      append_u16(m_nodes, static_cast<std::uint16_t>(token.getTokenKind()));
+      append_u32(m_nodes, internString(text));
+      append_u32(m_nodes, static_cast<std::uint32_t>(text.size()));
+      append_u16(m_nodes, static_cast<std::uint16_t>(leadingTrivia.size()));
+      append_u16(m_nodes, static_cast<std::uint16_t>(trailingTrivia.size()));
+      writeTrivia(leadingTrivia);
+      writeTrivia(trailingTrivia);
+      return offset;
+   }
+
+   void writeTrivia(ArrayRef<TriviaPiece> pieces)
+   {
+      for (const TriviaPiece &piece : pieces) {
+         // spaces and newlines have no text of their own, the printed form
+         // is what TriviaPiece::fromText() expects back
+         m_triviaText.clear();
+         llvm::raw_string_ostream stream(m_triviaText);
+         piece.print(stream);
+         stream.flush();
+         append_u8(m_nodes, static_cast<std::uint8_t>(piece.getKind()));
+         append_u8(m_nodes, 0);
+         append_u16(m_nodes, 0);
+         append_u32(m_nodes, internString(m_triviaText));
+         append_u32(m_nodes, static_cast<std::uint32_t>(m_triviaText.size()));
+      }
+   }
+
+   /// Returns the offset of \p text in the string table, each distinct text is
+   /// only stored once.
+   std::uint32_t internString(StringRef text)
+   {
+      auto result = m_stringOffsets.try_emplace(text, static_cast<std::uint32_t>(m_strings.size()));
+      if (result.second) {
+         m_strings.append(text.data(), text.size());
+      }
+      return result.first->second;
+   }
+
+private:
+   std::string m_nodes;
+   std::string m_strings;
+   std::string m_triviaText;
+   llvm::StringMap<std::uint32_t> m_stringOffsets;
+   std::uint32_t m_numNodes = 0;
+};
+
+} // anonymous namespace
+
+void write_syntax_binary(raw_ostream &out, const RefCountPtr<RawSyntax> &root)
+{
+   assert(root && "can not serialize an empty tree");
+   SyntaxBinaryWriter writer;
+   std::uint32_t rootOffset = writer.writeNode(*root);
+   writer.finish(out, rootOffset);
+}
+
+SyntaxBinaryReader::SyntaxBinaryReader(StringRef data, const RefCountPtr<SyntaxArena> &arena,
+                                       bool referenceData)
+   : m_data(data),
+     m_arena(arena),
+     m_referenceData(referenceData)
+{
+   if (!isRecordInRange(0, HEADER_SIZE) ||
+       std::memcmp(data.data(), SYNTAX_BINARY_MAGIC, sizeof(SYNTAX_BINARY_MAGIC)) != 0 ||
+       endian::read16le(data.data() + 4) != SYNTAX_BINARY_VERSION) {
+      return;
+   }
+   m_numNodes = endian::read32le(data.data() + 8);
+   m_rootOffset = endian::read32le(data.data() + 12);
+   m_stringTableOffset = endian::read32le(data.data() + 16);
+   m_stringTableSize = endian::read32le(data.data() + 20);
+   if (!isRecordInRange(m_stringTableOffset, m_stringTableSize) ||
+       m_rootOffset < HEADER_SIZE || m_rootOffset >= m_stringTableOffset) {
+      return;
+   }
+   m_valid = true;
+}
+
+bool SyntaxBinaryReader::isToken(std::uint32_t offset) const
+{
+   assert(isRecordInRange(offset, 1));
+   return static_cast<std::uint8_t>(m_data[offset]) == TOKEN_RECORD_TAG;
+}
+
+SyntaxKind SyntaxBinaryReader::getKind(std::uint32_t offset) const
+{
+   if (isToken(offset)) {
+      return SyntaxKind::Token;
+   }
+   return static_cast<SyntaxKind>(endian::read16le(m_data.data() + offset + 2));
+}
+
+unsigned SyntaxBinaryReader::getNumChildren(std::uint32_t offset) const
+{
+   if (isToken(offset)) {
+      return 0;
+   }
+   return endian::read32le(m_data.data() + offset + 4);
+}
+
+std::uint32_t SyntaxBinaryReader::getChildOffset(std::uint32_t offset, unsigned index) const
+{
+   assert(index < getNumChildren(offset));
+   return endian::read32le(m_data.data() + offset + LAYOUT_RECORD_HEADER_SIZE + index * 4);
+}
+
+RefCountPtr<RawSyntax> SyntaxBinaryReader::materialize(std::uint32_t offset) const
+{
+   if (!m_valid || offset < HEADER_SIZE || offset >= m_stringTableOffset) {
+      return nullptr;
+   }
+   if (isToken(offset)) {
+      return materializeToken(offset);
+   }
+   return materializeLayout(offset);
+}
+
+bool SyntaxBinaryReader::readString(std::uint32_t offset, std::uint32_t length, StringRef &result) const
+{
+   if (offset > m_stringTableSize || m_stringTableSize - offset < length) {
+      return false;
+   }
+   result = m_data.substr(m_stringTableOffset + offset, length);
+   return true;
+}
+
+bool SyntaxBinaryReader::readTrivia(const char *ptr, unsigned count,
+                                    std::vector<TriviaPiece> &pieces) const
+{
+   for (unsigned i = 0; i < count; ++i, ptr += TRIVIA_PIECE_SIZE) {
+      StringRef text;
+      if (!readString(endian::read32le(ptr + 4), endian::read32le(ptr + 8), text)) {
+         return false;
+      }
+      auto kind = static_cast<TriviaKind>(static_cast<std::uint8_t>(ptr[0]));
+      pieces.push_back(TriviaPiece::fromText(kind, text));
+   }
+   return true;
+}
+
+RefCountPtr<RawSyntax> SyntaxBinaryReader::materializeToken(std::uint32_t offset) const
+{
+   if (!isRecordInRange(offset, TOKEN_RECORD_HEADER_SIZE) ||
+       offset + TOKEN_RECORD_HEADER_SIZE > m_stringTableOffset) {
+      return nullptr;
+   }
+   const char *ptr = m_data.data() + offset;
+   unsigned numLeadingTrivia = endian::read16le(ptr + 12);
+   unsigned numTrailingTrivia = endian::read16le(ptr + 14);
+   std::uint32_t recordSize = TOKEN_RECORD_HEADER_SIZE +
+         (numLeadingTrivia + numTrailingTrivia) * TRIVIA_PIECE_SIZE;
+   if (!isRecordInRange(offset, recordSize) || offset + recordSize > m_stringTableOffset) {
+      return nullptr;
+   }
+   StringRef text;
+   if (!readString(endian::read32le(ptr + 4), endian::read32le(ptr + 8), text)) {
+      return nullptr;
+   }
+   std::vector<TriviaPiece> trivia;
+   trivia.reserve(numLeadingTrivia + numTrailingTrivia);
+   if (!readTrivia(ptr + TOKEN_RECORD_HEADER_SIZE, numLeadingTrivia + numTrailingTrivia, trivia)) {
+      return nullptr;
+   }
+   ArrayRef<TriviaPiece> triviaRef(trivia);
+   auto presence = static_cast<SourcePresence>(static_cast<std::uint8_t>(ptr[1]));
+   auto tokenKind = static_cast<TokenKindType>(endian::read16le(ptr + 2));
+   OwnedString ownedText = m_referenceData ? OwnedString::makeUnowned(text)
+                                           : OwnedString::makeRefCounted(text);
+   return RawSyntax::make(tokenKind, ownedText, triviaRef.take_front(numLeadingTrivia),
+                          triviaRef.drop_front(numLeadingTrivia), presence, m_arena);
+}
+
+RefCountPtr<RawSyntax> SyntaxBinaryReader::materializeLayout(std::uint32_t offset) const
+{
+   if (!isRecordInRange(offset, LAYOUT_RECORD_HEADER_SIZE) ||
+       offset + LAYOUT_RECORD_HEADER_SIZE > m_stringTableOffset) {
+      return nullptr;
+   }
+   const char *ptr = m_data.data() + offset;
+   std::uint32_t numChildren = endian::read32le(ptr + 4);
+   if ((m_stringTableOffset - offset - LAYOUT_RECORD_HEADER_SIZE) / 4 < numChildren) {
+      return nullptr;
+   }
+   std::vector<RefCountPtr<RawSyntax>> layout;
+   layout.reserve(numChildren);
+   for (std::uint32_t i = 0; i < numChildren; ++i) {
+      std::uint32_t childOffset = endian::read32le(ptr + LAYOUT_RECORD_HEADER_SIZE + i * 4);
+      if (childOffset == SYNTAX_BINARY_NULL_OFFSET) {
+         layout.push_back(nullptr);
+         continue;
+      }
+      // children are always written before their parent, anything else is
+      // corrupted data and could loop forever
+      if (childOffset >= offset) {
+         return nullptr;
+      }
+      RefCountPtr<RawSyntax> child = materialize(childOffset);
+      if (!child) {
+         return nullptr;
+      }
+      layout.push_back(std::move(child));
+   }
+   auto presence = static_cast<SourcePresence>(static_cast<std::uint8_t>(ptr[1]));
+   auto kind = static_cast<SyntaxKind>(endian::read16le(ptr + 2));
+   return RawSyntax::make(kind, layout, presence, m_arena);
+}
+
+} // polar::syntax
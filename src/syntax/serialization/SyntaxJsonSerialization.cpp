@@ -10,6 +10,7 @@
 // Created by polarboy on 2019/11/19.
 
 #include "polarphp/syntax/serialization/SyntaxJsonSerialization.h"
+#include "polarphp/syntax/serialization/TokenKindTypeSerialization.h"
 #include "polarphp/syntax/Syntax.h"
 
 namespace polar::syntax {
@@ -21,5 +22,53 @@ void to_json(json &jsonObject, const Syntax &syntax)
    jsonObject["childCount"] = syntax.getNumChildren();
 }
 
+namespace {
+json trivia_to_json(ArrayRef<TriviaPiece> pieces)
+{
+   json triviaArray = json::array();
+   std::string text;
+   for (const TriviaPiece &piece : pieces) {
+      text.clear();
+      llvm::raw_string_ostream stream(text);
+      piece.print(stream);
+      stream.flush();
+      triviaArray.push_back({{"kind", static_cast<unsigned>(piece.getKind())}, {"text", text}});
+   }
+   return triviaArray;
+}
+
+/// Unlike the SyntaxKind enum serializer this also names Token and Unknown,
+/// write_syntax_json() writes the same names.
+std::string get_syntax_kind_name(SyntaxKind kind)
+{
+   std::string name;
+   llvm::raw_string_ostream stream(name);
+   dump_syntax_kind(stream, kind);
+   return stream.str();
+}
+} // anonymous namespace
+
+void to_json(json &jsonObject, const RawSyntax &raw)
+{
+   jsonObject["kind"] = get_syntax_kind_name(raw.getKind());
+   jsonObject["presence"] = raw.getPresence();
+   if (raw.isToken()) {
+      jsonObject["tokenKind"] = raw.getTokenKind();
+      jsonObject["text"] = raw.getTokenText().str();
+      jsonObject["leadingTrivia"] = trivia_to_json(raw.getLeadingTrivia());
+      jsonObject["trailingTrivia"] = trivia_to_json(raw.getTrailingTrivia());
+      return;
+   }
+   json children = json::array();
+   for (const RefCountPtr<RawSyntax> &child : raw.getLayout()) {
+      if (child) {
+         children.push_back(*child);
+      } else {
+         children.push_back(nullptr);
+      }
+   }
+   jsonObject["children"] = std::move(children);
+}
+
 } // polar::syntax
 
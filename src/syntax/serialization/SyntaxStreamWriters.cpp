@@ -0,0 +1,227 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/27.
+
+#include "polarphp/syntax/serialization/SyntaxStreamWriters.h"
+#include "polarphp/syntax/SyntaxKind.h"
+#include "polarphp/syntax/TokenKinds.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+namespace polar::syntax {
+
+namespace {
+
+/// A layout node whose children are being written.
+struct OpenNode
+{
+   const RawSyntax *node;
+   unsigned nextChild;
+};
+
+void write_json_string(raw_ostream &out, StringRef text)
+{
+   static const char hexDigits[] = "0123456789abcdef";
+   out << '"';
+   const char *runStart = text.begin();
+   for (const char *iter = text.begin(), *end = text.end(); iter != end; ++iter) {
+      unsigned char c = static_cast<unsigned char>(*iter);
+      if (c >= 0x20 && c != '"' && c != '\\') {
+         continue;
+      }
+      out.write(runStart, iter - runStart);
+      runStart = iter + 1;
+      switch (c) {
+      case '"':
+         out << "\\\"";
+         break;
+      case '\\':
+         out << "\\\\";
+         break;
+      case '\n':
+         out << "\\n";
+         break;
+      case '\r':
+         out << "\\r";
+         break;
+      case '\t':
+         out << "\\t";
+         break;
+      case '\b':
+         out << "\\b";
+         break;
+      case '\f':
+         out << "\\f";
+         break;
+      default:
+         out << "\\u00" << hexDigits[c >> 4] << hexDigits[c & 0xF];
+         break;
+      }
+   }
+   out.write(runStart, text.end() - runStart);
+   out << '"';
+}
+
+const char *get_presence_name(SourcePresence presence)
+{
+   return presence == SourcePresence::Present ? "Present" : "Missing";
+}
+
+/// Text of a trivia piece, \p buffer is reused across pieces.
+StringRef get_trivia_text(const TriviaPiece &piece, SmallString<64> &buffer)
+{
+   buffer.clear();
+   llvm::raw_svector_ostream stream(buffer);
+   piece.print(stream);
+   return buffer.str();
+}
+
+void write_json_trivia(raw_ostream &out, ArrayRef<TriviaPiece> pieces, SmallString<64> &buffer)
+{
+   out << '[';
+   for (size_t i = 0; i < pieces.size(); ++i) {
+      if (i > 0) {
+         out << ',';
+      }
+      out << "{\"kind\":" << static_cast<unsigned>(pieces[i].getKind()) << ",\"text\":";
+      write_json_string(out, get_trivia_text(pieces[i], buffer));
+      out << '}';
+   }
+   out << ']';
+}
+
+void write_json_kind(raw_ostream &out, SyntaxKind kind, SmallString<64> &buffer)
+{
+   buffer.clear();
+   llvm::raw_svector_ostream stream(buffer);
+   dump_syntax_kind(stream, kind);
+   write_json_string(out, buffer.str());
+}
+
+/// Write \p node if it is a token, otherwise write the head of its object
+/// and return true, the children and the tail are written by the caller.
+bool write_json_node_head(raw_ostream &out, const RawSyntax &node, SmallString<64> &buffer)
+{
+   out << "{\"kind\":";
+   write_json_kind(out, node.getKind(), buffer);
+   out << ",\"presence\":\"" << get_presence_name(node.getPresence()) << '"';
+   if (!node.isToken()) {
+      out << ",\"children\":[";
+      return true;
+   }
+   out << ",\"tokenKind\":\"" << get_token_kind_str(node.getTokenKind()) << "\",\"text\":";
+   write_json_string(out, node.getTokenText());
+   out << ",\"leadingTrivia\":";
+   write_json_trivia(out, node.getLeadingTrivia(), buffer);
+   out << ",\"trailingTrivia\":";
+   write_json_trivia(out, node.getTrailingTrivia(), buffer);
+   out << '}';
+   return false;
+}
+
+void write_sexpr_trivia(raw_ostream &out, const char *label, ArrayRef<TriviaPiece> pieces,
+                        SmallString<64> &buffer)
+{
+   if (pieces.empty()) {
+      return;
+   }
+   SmallString<64> pieceBuffer;
+   buffer.clear();
+   for (const TriviaPiece &piece : pieces) {
+      buffer += get_trivia_text(piece, pieceBuffer);
+   }
+   out << ' ' << label << " \"";
+   out.write_escaped(buffer.str(), /*UseHexEscapes=*/true);
+   out << '"';
+}
+
+/// Same protocol as write_json_node_head().
+bool write_sexpr_node_head(raw_ostream &out, const RawSyntax &node, SmallString<64> &buffer)
+{
+   out << '(';
+   if (node.isToken()) {
+      dump_token_kind(out, node.getTokenKind());
+   } else {
+      dump_syntax_kind(out, node.getKind());
+   }
+   if (node.isMissing()) {
+      out << " [missing]";
+   }
+   if (!node.isToken()) {
+      return true;
+   }
+   out << " \"";
+   out.write_escaped(node.getTokenText(), /*UseHexEscapes=*/true);
+   out << '"';
+   write_sexpr_trivia(out, ":leading", node.getLeadingTrivia(), buffer);
+   write_sexpr_trivia(out, ":trailing", node.getTrailingTrivia(), buffer);
+   out << ')';
+   return false;
+}
+
+} // anonymous namespace
+
+void write_syntax_json(raw_ostream &out, const RawSyntax &root)
+{
+   SmallString<64> buffer;
+   std::vector<OpenNode> openNodes;
+   if (write_json_node_head(out, root, buffer)) {
+      openNodes.push_back({&root, 0});
+   }
+   while (!openNodes.empty()) {
+      OpenNode &top = openNodes.back();
+      auto layout = top.node->getLayout();
+      if (top.nextChild == layout.size()) {
+         out << "]}";
+         openNodes.pop_back();
+         continue;
+      }
+      if (top.nextChild > 0) {
+         out << ',';
+      }
+      const RawSyntax *child = layout[top.nextChild++].get();
+      if (!child) {
+         out << "null";
+      } else if (write_json_node_head(out, *child, buffer)) {
+         // top is invalidated by the push
+         openNodes.push_back({child, 0});
+      }
+   }
+}
+
+void write_syntax_sexpr(raw_ostream &out, const RawSyntax &root)
+{
+   SmallString<64> buffer;
+   std::vector<OpenNode> openNodes;
+   if (write_sexpr_node_head(out, root, buffer)) {
+      openNodes.push_back({&root, 0});
+   }
+   while (!openNodes.empty()) {
+      OpenNode &top = openNodes.back();
+      auto layout = top.node->getLayout();
+      if (top.nextChild == layout.size()) {
+         out << ')';
+         openNodes.pop_back();
+         continue;
+      }
+      const RawSyntax *child = layout[top.nextChild++].get();
+      if (!child) {
+         continue;
+      }
+      out << ' ';
+      if (write_sexpr_node_head(out, *child, buffer)) {
+         openNodes.push_back({child, 0});
+      }
+   }
+}
+
+} // polar::syntax
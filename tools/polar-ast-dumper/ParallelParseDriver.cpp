@@ -0,0 +1,238 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2020 polarphp software foundation
+// Copyright (c) 2017 - 2020 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2020/03/02.
+
+#include "ParallelParseDriver.h"
+#include "llvm/Support/ErrorOr.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "polarphp/parser/Parser.h"
+#include "polarphp/parser/PersistentParseCache.h"
+#include "polarphp/syntax/RawSyntax.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace polar::astdumper {
+
+using llvm::ErrorOr;
+using polar::SourceManager;
+using polar::parser::Parser;
+using polar::syntax::SyntaxArena;
+
+WorkStealingThreadPool::WorkStealingThreadPool(unsigned numThreads)
+{
+   numThreads = std::max(numThreads, 1u);
+   m_queues.reserve(numThreads);
+   for (unsigned i = 0; i < numThreads; ++i) {
+      m_queues.push_back(std::make_unique<WorkerQueue>());
+   }
+   m_workers.reserve(numThreads);
+   for (unsigned i = 0; i < numThreads; ++i) {
+      m_workers.emplace_back([this, i] { runWorker(i); });
+   }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_stateMutex);
+      m_stopped = true;
+   }
+   m_wakeupCond.notify_all();
+   for (std::thread &worker : m_workers) {
+      worker.join();
+   }
+}
+
+void WorkStealingThreadPool::async(TaskType task)
+{
+   unsigned index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+   {
+      // bump the counters under the state lock before the task becomes
+      // visible, so they never underflow and a worker which just found every
+      // queue empty can not miss the wakeup
+      std::lock_guard<std::mutex> lock(m_stateMutex);
+      m_pendingTasks.fetch_add(1, std::memory_order_release);
+      m_queuedTasks.fetch_add(1, std::memory_order_release);
+   }
+   {
+      std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+      m_queues[index]->tasks.push_back(std::move(task));
+   }
+   m_wakeupCond.notify_one();
+}
+
+void WorkStealingThreadPool::wait()
+{
+   std::unique_lock<std::mutex> lock(m_stateMutex);
+   m_doneCond.wait(lock, [this] {
+      return m_pendingTasks.load(std::memory_order_acquire) == 0;
+   });
+}
+
+bool WorkStealingThreadPool::popLocalTask(unsigned index, TaskType &task)
+{
+   WorkerQueue &queue = *m_queues[index];
+   std::lock_guard<std::mutex> lock(queue.mutex);
+   if (queue.tasks.empty()) {
+      return false;
+   }
+   task = std::move(queue.tasks.back());
+   queue.tasks.pop_back();
+   m_queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+   return true;
+}
+
+bool WorkStealingThreadPool::stealTask(unsigned index, TaskType &task)
+{
+   unsigned numQueues = m_queues.size();
+   for (unsigned offset = 1; offset < numQueues; ++offset) {
+      WorkerQueue &victim = *m_queues[(index + offset) % numQueues];
+      std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+      if (!lock.owns_lock() || victim.tasks.empty()) {
+         continue;
+      }
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      m_queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+      return true;
+   }
+   return false;
+}
+
+void WorkStealingThreadPool::runWorker(unsigned index)
+{
+   while (true) {
+      TaskType task;
+      if (popLocalTask(index, task) || stealTask(index, task)) {
+         task();
+         if (m_pendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            m_doneCond.notify_all();
+         }
+         continue;
+      }
+      std::unique_lock<std::mutex> lock(m_stateMutex);
+      m_wakeupCond.wait(lock, [this] {
+         return m_stopped || m_queuedTasks.load(std::memory_order_acquire) > 0;
+      });
+      if (m_stopped && m_queuedTasks.load(std::memory_order_acquire) == 0) {
+         return;
+      }
+   }
+}
+
+ParallelParseDriver::ParallelParseDriver(const LangOptions &langOpts, unsigned numThreads)
+   : m_langOpts(langOpts),
+     m_numThreads(std::max(numThreads, 1u))
+{}
+
+ParseJobResult ParallelParseDriver::parseFile(const std::string &filePath,
+                                              RefCountPtr<RawSyntax> &syntaxTree) const
+{
+   ParseJobResult result;
+   result.filePath = filePath;
+   // every job has its own source manager, lexer and parser, the workers do
+   // not share any front end state
+   SourceManager sourceMgr;
+   ErrorOr<unsigned> mappedBufferId = sourceMgr.addMappedSourceFile(filePath);
+   if (!mappedBufferId) {
+      result.errorMsg = mappedBufferId.getError().message();
+      return result;
+   }
+   unsigned bufferId = mappedBufferId.get();
+   result.byteSize = sourceMgr.getRangeForBuffer(bufferId).getByteLength();
+   Parser parser(m_langOpts, bufferId, sourceMgr, nullptr);
+   if (!m_useArena) {
+      parser.setArena(nullptr);
+   } else if (m_uniqueTokens) {
+      parser.getArena()->setTokenUniquing(true);
+   }
+   parser.setPersistentParseCache(m_persistentParseCache);
+   bool failed = parser.parse();
+   if (const RefCountPtr<SyntaxArena> &arena = parser.getArena()) {
+      result.numNodeAllocations = arena->getNumAllocations();
+      result.numArenaSlabs = arena->getNumSlabs();
+      result.arenaBytes = arena->getBytesAllocated();
+      result.numUniquedTokenHits = arena->getNumUniquedTokenHits();
+   }
+   if (failed) {
+      result.errorMsg = "syntax error";
+      return result;
+   }
+   syntaxTree = parser.getSyntaxTree();
+   result.success = true;
+   return result;
+}
+
+BatchParseStats ParallelParseDriver::parseFiles(ArrayRef<std::string> filePaths,
+                                                ResultCallback callback)
+{
+   BatchParseStats stats;
+   stats.numThreads = m_numThreads;
+   stats.numFiles = filePaths.size();
+   std::atomic<size_t> totalBytes{0};
+   std::atomic<size_t> numFailedFiles{0};
+   std::atomic<size_t> numNodeAllocations{0};
+   std::atomic<size_t> numArenaSlabs{0};
+   std::atomic<size_t> arenaBytes{0};
+   std::atomic<size_t> numUniquedTokenHits{0};
+   auto startTime = std::chrono::steady_clock::now();
+   {
+      WorkStealingThreadPool pool(m_numThreads);
+      for (const std::string &filePath : filePaths) {
+         pool.async([&, filePath] {
+            RefCountPtr<RawSyntax> syntaxTree;
+            ParseJobResult result = parseFile(filePath, syntaxTree);
+            totalBytes.fetch_add(result.byteSize, std::memory_order_relaxed);
+            numNodeAllocations.fetch_add(result.numNodeAllocations, std::memory_order_relaxed);
+            numArenaSlabs.fetch_add(result.numArenaSlabs, std::memory_order_relaxed);
+            arenaBytes.fetch_add(result.arenaBytes, std::memory_order_relaxed);
+            numUniquedTokenHits.fetch_add(result.numUniquedTokenHits, std::memory_order_relaxed);
+            if (!result.success) {
+               numFailedFiles.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (callback) {
+               callback(result, syntaxTree);
+            }
+         });
+      }
+      pool.wait();
+   }
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+   stats.elapsedSeconds = elapsed.count();
+   stats.totalBytes = totalBytes.load();
+   stats.numFailedFiles = numFailedFiles.load();
+   stats.numNodeAllocations = numNodeAllocations.load();
+   stats.numArenaSlabs = numArenaSlabs.load();
+   stats.arenaBytes = arenaBytes.load();
+   stats.numUniquedTokenHits = numUniquedTokenHits.load();
+   return stats;
+}
+
+std::vector<BatchParseStats>
+ParallelParseDriver::measureScaling(const LangOptions &langOpts, ArrayRef<std::string> filePaths,
+                                    unsigned maxThreads)
+{
+   std::vector<BatchParseStats> results;
+   maxThreads = std::max(maxThreads, 1u);
+   for (unsigned numThreads = 1; ; numThreads *= 2) {
+      numThreads = std::min(numThreads, maxThreads);
+      ParallelParseDriver driver(langOpts, numThreads);
+      results.push_back(driver.parseFiles(filePaths));
+      if (numThreads == maxThreads) {
+         break;
+      }
+   }
+   return results;
+}
+
+} // polar::astdumper
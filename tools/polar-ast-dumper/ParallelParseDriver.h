@@ -0,0 +1,200 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2020 polarphp software foundation
+// Copyright (c) 2017 - 2020 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2020/03/02.
+
+#ifndef POLARPHP_TOOLS_AST_DUMPER_PARALLEL_PARSE_DRIVER_H
+#define POLARPHP_TOOLS_AST_DUMPER_PARALLEL_PARSE_DRIVER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "polarphp/syntax/References.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace polar {
+class LangOptions;
+} // polar
+
+namespace polar::parser {
+class PersistentParseCache;
+} // polar::parser
+
+namespace polar::syntax {
+class RawSyntax;
+} // polar::syntax
+
+namespace polar::astdumper {
+
+using llvm::ArrayRef;
+using polar::LangOptions;
+using polar::parser::PersistentParseCache;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+
+/// A fixed size thread pool, every worker owns a task deque. A worker pops
+/// tasks from the back of its own deque and steals from the front of the
+/// other workers' deques when it runs dry, so a few huge files do not leave
+/// the rest of the workers idle.
+class WorkStealingThreadPool
+{
+public:
+   using TaskType = std::function<void()>;
+
+   explicit WorkStealingThreadPool(unsigned numThreads);
+   ~WorkStealingThreadPool();
+
+   /// Queue a task, tasks are distributed over the workers round robin.
+   void async(TaskType task);
+
+   /// Block until all queued tasks are finished.
+   void wait();
+
+   unsigned getThreadCount() const
+   {
+      return m_queues.size();
+   }
+
+private:
+   WorkStealingThreadPool(const WorkStealingThreadPool &) = delete;
+   WorkStealingThreadPool &operator=(const WorkStealingThreadPool &) = delete;
+
+   struct WorkerQueue
+   {
+      std::mutex mutex;
+      std::deque<TaskType> tasks;
+   };
+
+   bool popLocalTask(unsigned index, TaskType &task);
+   bool stealTask(unsigned index, TaskType &task);
+   void runWorker(unsigned index);
+
+private:
+   std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+   std::vector<std::thread> m_workers;
+   std::atomic<unsigned> m_nextQueue{0};
+   /// Tasks which are queued or running, \c wait() blocks on it.
+   std::atomic<size_t> m_pendingTasks{0};
+   /// Tasks which are queued but not picked up by any worker yet.
+   std::atomic<size_t> m_queuedTasks{0};
+   std::mutex m_stateMutex;
+   std::condition_variable m_wakeupCond;
+   std::condition_variable m_doneCond;
+   bool m_stopped = false;
+};
+
+/// The outcome of parsing one file of a batch.
+struct ParseJobResult
+{
+   std::string filePath;
+   size_t byteSize = 0;
+   /// Syntax nodes carved from the parser arena, every one of them is a heap
+   /// allocation when the arena is disabled.
+   size_t numNodeAllocations = 0;
+   /// Heap allocations made by the parser arena.
+   size_t numArenaSlabs = 0;
+   size_t arenaBytes = 0;
+   /// Tokens shared with an equal token instead of being allocated.
+   size_t numUniquedTokenHits = 0;
+   bool success = false;
+   std::string errorMsg;
+};
+
+/// Aggregated figures of one batch run.
+struct BatchParseStats
+{
+   unsigned numThreads = 0;
+   size_t numFiles = 0;
+   size_t numFailedFiles = 0;
+   size_t totalBytes = 0;
+   size_t numNodeAllocations = 0;
+   size_t numArenaSlabs = 0;
+   size_t arenaBytes = 0;
+   size_t numUniquedTokenHits = 0;
+   double elapsedSeconds = 0;
+
+   double getFilesPerSecond() const
+   {
+      return elapsedSeconds > 0 ? numFiles / elapsedSeconds : 0;
+   }
+
+   double getBytesPerSecond() const
+   {
+      return elapsedSeconds > 0 ? totalBytes / elapsedSeconds : 0;
+   }
+};
+
+/// Parse a list of files on a \c WorkStealingThreadPool.
+///
+/// Every job owns its \c SourceManager, \c Lexer and \c Parser, nothing
+/// except the syntax node id counter is shared between the workers. The
+/// callback runs on the worker thread which parsed the file, it must be
+/// thread safe.
+class ParallelParseDriver
+{
+public:
+   using ResultCallback = std::function<void(const ParseJobResult &result,
+                                             RefCountPtr<RawSyntax> syntaxTree)>;
+
+   ParallelParseDriver(const LangOptions &langOpts, unsigned numThreads);
+
+   /// Whether the parsers allocate the syntax trees in a \c SyntaxArena,
+   /// enabled by default.
+   void setUseArena(bool useArena)
+   {
+      m_useArena = useArena;
+   }
+
+   /// Whether equal tokens of a file share one node, see
+   /// \c SyntaxArena::setTokenUniquing(). Disabled by default, has no effect
+   /// without arena.
+   void setUniqueTokens(bool uniqueTokens)
+   {
+      m_uniqueTokens = uniqueTokens;
+   }
+
+   /// Look every file up in \p cache before parsing it and store the trees
+   /// of the parsed files, \c nullptr disables the cache.
+   void setPersistentParseCache(PersistentParseCache *cache)
+   {
+      m_persistentParseCache = cache;
+   }
+
+   BatchParseStats parseFiles(ArrayRef<std::string> filePaths,
+                              ResultCallback callback = nullptr);
+
+   /// Run the batch once for every thread count in 1, 2, 4 ... \p maxThreads
+   /// (\p maxThreads itself is always included), used to measure how the
+   /// throughput scales with the number of cores.
+   static std::vector<BatchParseStats>
+   measureScaling(const LangOptions &langOpts, ArrayRef<std::string> filePaths,
+                  unsigned maxThreads);
+
+private:
+   ParseJobResult parseFile(const std::string &filePath,
+                            RefCountPtr<RawSyntax> &syntaxTree) const;
+
+private:
+   const LangOptions &m_langOpts;
+   unsigned m_numThreads;
+   bool m_useArena = true;
+   bool m_uniqueTokens = false;
+   PersistentParseCache *m_persistentParseCache = nullptr;
+};
+
+} // polar::astdumper
+
+#endif // POLARPHP_TOOLS_AST_DUMPER_PARALLEL_PARSE_DRIVER_H
@@ -13,37 +13,537 @@
 #include "polarphp/global/Global.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_os_ostream.h"
 #include "polarphp/parser/Lexer.h"
 #include "polarphp/parser/Token.h"
-#include "polarphp/kernel/LangOptions.h"
+#include "polarphp/basic/LangOptions.h"
 #include "polarphp/basic/SourceMgr.h"
 #include "polarphp/parser/Parser.h"
+#include "polarphp/parser/PersistentParseCache.h"
+#include "polarphp/parser/SyntaxParsingCache.h"
+#include "polarphp/syntax/serialization/SyntaxBinarySerialization.h"
+#include "polarphp/syntax/serialization/SyntaxJsonSerialization.h"
+#include "polarphp/syntax/serialization/SyntaxStreamWriters.h"
+#include "polarphp/syntax/SyntaxData.h"
+#include "polarphp/syntax/SyntaxPositionIndex.h"
+#include "nlohmann/json.hpp"
+#include "ParallelParseDriver.h"
+#include "HeapAllocationCounter.h"
 
 #include <memory>
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <iomanip>
+#include <chrono>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
 #define READ_STDIN_ERROR 1
 #define OPEN_SOURCE_FILE_ERROR 2
 #define OPEN_OUTPUT_FILE_ERROR 3
+#define OPEN_FILE_LIST_ERROR 4
+#define BATCH_PARSE_ERROR 5
+#define OPEN_OLD_SOURCE_FILE_ERROR 6
+#define PARSE_SOURCE_FILE_ERROR 7
+#define UNKNOWN_OUTPUT_FORMAT_ERROR 8
 
 using llvm::MemoryBuffer;
 using llvm::ErrorOr;
-using polar::kernel::LangOptions;
+using llvm::StringRef;
+using llvm::ArrayRef;
+using polar::LangOptions;
 using polar::basic::SourceManager;
 using polar::parser::Parser;
+using polar::parser::SourceEdit;
+using polar::parser::SyntaxParsingCache;
+using polar::parser::SyntaxReuseStats;
+using polar::parser::PersistentParseCache;
+using polar::parser::PersistentParseCacheStats;
+using polar::syntax::Syntax;
 using polar::syntax::RefCountPtr;
+using polar::syntax::RawSyntax;
+using polar::syntax::SyntaxBinaryReader;
+using polar::syntax::write_syntax_binary;
+using polar::syntax::write_syntax_json;
+using polar::syntax::write_syntax_sexpr;
+using polar::syntax::SyntaxData;
+using polar::syntax::SyntaxPositionIndex;
+using nlohmann::json;
+using polar::astdumper::ParallelParseDriver;
+using polar::astdumper::BatchParseStats;
+using polar::benchmark::get_heap_allocation_count;
+
+namespace {
+
+void print_batch_stats(std::ostream &output, const BatchParseStats &stats)
+{
+   output << "threads: " << stats.numThreads
+          << ", files: " << stats.numFiles
+          << ", failed: " << stats.numFailedFiles
+          << ", seconds: " << std::fixed << std::setprecision(3) << stats.elapsedSeconds
+          << ", files/sec: " << std::setprecision(1) << stats.getFilesPerSecond()
+          << ", MB/sec: " << std::setprecision(2) << stats.getBytesPerSecond() / (1024 * 1024)
+          << std::endl;
+}
+
+/// The heap allocations of a batch run, counted by the replaced global
+/// allocation functions.
+struct ArenaComparisonRun
+{
+   BatchParseStats stats;
+   size_t numHeapAllocations = 0;
+};
+
+ArenaComparisonRun run_arena_comparison_batch(ParallelParseDriver &driver,
+                                              ArrayRef<std::string> filePaths)
+{
+   ArenaComparisonRun run;
+   size_t startAllocations = get_heap_allocation_count();
+   run.stats = driver.parseFiles(filePaths);
+   run.numHeapAllocations = get_heap_allocation_count() - startAllocations;
+   return run;
+}
+
+void print_arena_comparison(std::ostream &output, const ArenaComparisonRun &arenaRun,
+                            const ArenaComparisonRun &heapRun)
+{
+   output << "syntax nodes: " << arenaRun.stats.numNodeAllocations
+          << ", arena bytes: " << arenaRun.stats.arenaBytes
+          << std::endl
+          << "heap allocations: " << arenaRun.numHeapAllocations << " with arena, "
+          << heapRun.numHeapAllocations << " without arena"
+          << std::endl
+          << "parse seconds: " << std::fixed << std::setprecision(3) << arenaRun.stats.elapsedSeconds
+          << " with arena, " << heapRun.stats.elapsedSeconds << " without arena, delta "
+          << heapRun.stats.elapsedSeconds - arenaRun.stats.elapsedSeconds
+          << std::endl;
+}
+
+void print_parse_cache_stats(std::ostream &output, const PersistentParseCacheStats &stats)
+{
+   output << "parse cache hits: " << stats.numHits
+          << ", misses: " << stats.numMisses
+          << ", hit rate: " << std::fixed << std::setprecision(1) << stats.getHitRate() * 100 << "%"
+          << ", stored: " << stats.numStores
+          << ", store failures: " << stats.numStoreFailures
+          << std::endl
+          << "parse cache load seconds: " << std::setprecision(3) << stats.loadSeconds
+          << ", parse seconds of hits: " << stats.parseSecondsOfHits
+          << ", saved seconds: " << stats.getSavedSeconds()
+          << std::endl;
+}
+
+/// Peak resident set size of the process, 0 where unknown.
+size_t get_peak_resident_bytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+      return usage.ru_maxrss;
+#else
+      return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+   }
+#endif
+   return 0;
+}
+
+/// Parse the batch with and without token uniquing, keeping all trees of a
+/// run alive to measure the heap they occupy.
+void run_token_uniquing_comparison(const LangOptions &langOpts, unsigned jobs,
+                                   ArrayRef<std::string> filePaths, std::ostream &output)
+{
+   output << std::left << std::setw(16) << "token uniquing"
+          << std::right << std::setw(14) << "syntax nodes"
+          << std::setw(14) << "shared tokens"
+          << std::setw(14) << "arena bytes"
+          << std::setw(16) << "heap bytes held"
+          << std::setw(10) << "seconds" << std::endl;
+   for (bool uniqueTokens : {false, true}) {
+      std::mutex treesMutex;
+      std::vector<RefCountPtr<RawSyntax>> syntaxTrees;
+      ParallelParseDriver driver(langOpts, jobs);
+      driver.setUniqueTokens(uniqueTokens);
+      size_t heapBefore = llvm::sys::Process::GetMallocUsage();
+      BatchParseStats stats = driver.parseFiles(filePaths, [&](const polar::astdumper::ParseJobResult &,
+                                                RefCountPtr<RawSyntax> syntaxTree) {
+         std::lock_guard<std::mutex> lock(treesMutex);
+         syntaxTrees.push_back(std::move(syntaxTree));
+      });
+      size_t heapAfter = llvm::sys::Process::GetMallocUsage();
+      output << std::left << std::setw(16) << (uniqueTokens ? "on" : "off")
+             << std::right << std::setw(14) << stats.numNodeAllocations
+             << std::setw(14) << stats.numUniquedTokenHits
+             << std::setw(14) << stats.arenaBytes
+             << std::setw(16) << (heapAfter > heapBefore ? heapAfter - heapBefore : 0)
+             << std::setw(10) << std::fixed << std::setprecision(3) << stats.elapsedSeconds
+             << std::endl;
+   }
+   output << "peak RSS MB: " << std::setprecision(2)
+          << get_peak_resident_bytes() / (1024.0 * 1024.0)
+          << " (process wide, run once with and once without --unique-tokens to compare)"
+          << std::endl;
+}
+
+int run_batch_mode(const std::string &fileListPath, unsigned jobs, bool reportScaling,
+                   bool compareArena, bool uniqueTokens, bool compareTokenUniquing,
+                   const std::string &parseCacheDir, std::ostream &output)
+{
+   std::ifstream fileList(fileListPath);
+   if (fileList.fail()) {
+      std::cerr << "open file list error: " << strerror(errno) << std::endl;
+      return OPEN_FILE_LIST_ERROR;
+   }
+   std::vector<std::string> filePaths;
+   std::string line;
+   while (std::getline(fileList, line)) {
+      if (!line.empty()) {
+         filePaths.push_back(line);
+      }
+   }
+   if (jobs == 0) {
+      jobs = std::max(std::thread::hardware_concurrency(), 1u);
+   }
+   LangOptions langOpts{};
+   if (reportScaling) {
+      std::vector<BatchParseStats> results =
+            ParallelParseDriver::measureScaling(langOpts, filePaths, jobs);
+      for (const BatchParseStats &stats : results) {
+         print_batch_stats(output, stats);
+      }
+      double baseline = results.front().getFilesPerSecond();
+      if (baseline > 0) {
+         output << "speedup at " << results.back().numThreads << " threads: "
+                << std::setprecision(2) << results.back().getFilesPerSecond() / baseline
+                << "x" << std::endl;
+      }
+      return results.back().numFailedFiles == 0 ? 0 : BATCH_PARSE_ERROR;
+   }
+   if (compareArena) {
+      ParallelParseDriver driver(langOpts, jobs);
+      ArenaComparisonRun arenaRun = run_arena_comparison_batch(driver, filePaths);
+      driver.setUseArena(false);
+      ArenaComparisonRun heapRun = run_arena_comparison_batch(driver, filePaths);
+      print_arena_comparison(output, arenaRun, heapRun);
+      return arenaRun.stats.numFailedFiles == 0 ? 0 : BATCH_PARSE_ERROR;
+   }
+   if (compareTokenUniquing) {
+      run_token_uniquing_comparison(langOpts, jobs, filePaths, output);
+      return 0;
+   }
+   std::mutex outputMutex;
+   ParallelParseDriver driver(langOpts, jobs);
+   driver.setUniqueTokens(uniqueTokens);
+   std::unique_ptr<PersistentParseCache> parseCache;
+   if (!parseCacheDir.empty()) {
+      parseCache = std::make_unique<PersistentParseCache>(parseCacheDir, langOpts);
+      driver.setPersistentParseCache(parseCache.get());
+   }
+   BatchParseStats stats = driver.parseFiles(filePaths, [&](const polar::astdumper::ParseJobResult &result,
+                                             RefCountPtr<RawSyntax>) {
+      if (!result.success) {
+         std::lock_guard<std::mutex> lock(outputMutex);
+         std::cerr << result.filePath << ": " << result.errorMsg << std::endl;
+      }
+   });
+   print_batch_stats(output, stats);
+   output << "syntax nodes: " << stats.numNodeAllocations
+          << ", shared tokens: " << stats.numUniquedTokenHits
+          << ", peak RSS MB: " << std::fixed << std::setprecision(2)
+          << get_peak_resident_bytes() / (1024.0 * 1024.0)
+          << std::endl;
+   if (parseCache) {
+      print_parse_cache_stats(output, parseCache->getStats());
+   }
+   return stats.numFailedFiles == 0 ? 0 : BATCH_PARSE_ERROR;
+}
+
+/// Describe the change from \p oldText to \p newText as one edit spanning
+/// everything between their common prefix and common suffix.
+SourceEdit compute_source_edit(StringRef oldText, StringRef newText)
+{
+   size_t prefixLength = 0;
+   size_t maxPrefixLength = std::min(oldText.size(), newText.size());
+   while (prefixLength < maxPrefixLength && oldText[prefixLength] == newText[prefixLength]) {
+      ++prefixLength;
+   }
+   size_t suffixLength = 0;
+   size_t maxSuffixLength = maxPrefixLength - prefixLength;
+   while (suffixLength < maxSuffixLength &&
+          oldText[oldText.size() - suffixLength - 1] == newText[newText.size() - suffixLength - 1]) {
+      ++suffixLength;
+   }
+   return SourceEdit(prefixLength, oldText.size() - suffixLength,
+                     newText.size() - suffixLength - prefixLength);
+}
+
+/// Parse \p oldSourceBuffer, then parse the new source incrementally on top
+/// of it and report how much of the old tree was reused.
+int run_incremental_parse(std::unique_ptr<MemoryBuffer> oldSourceBuffer,
+                          std::unique_ptr<MemoryBuffer> sourceBuffer,
+                          std::ostream &output)
+{
+   LangOptions langOpts{};
+   SourceManager sourceMgr;
+   SourceEdit edit = compute_source_edit(oldSourceBuffer->getBuffer(), sourceBuffer->getBuffer());
+   unsigned oldBufferId = sourceMgr.addNewSourceBuffer(std::move(oldSourceBuffer));
+   unsigned bufferId = sourceMgr.addNewSourceBuffer(std::move(sourceBuffer));
+   Parser oldParser(langOpts, oldBufferId, sourceMgr, nullptr);
+   oldParser.setRecordingStmtRanges(true);
+   auto startTime = std::chrono::steady_clock::now();
+   if (oldParser.parse()) {
+      std::cerr << "parse old source file error" << std::endl;
+      return BATCH_PARSE_ERROR;
+   }
+   std::chrono::duration<double> fullParseTime = std::chrono::steady_clock::now() - startTime;
+   SyntaxParsingCache cache(polar::syntax::make<Syntax>(oldParser.getSyntaxTree()));
+   cache.setOldStmtRanges(oldParser.getStmtRanges(),
+                          sourceMgr.extractText(sourceMgr.getRangeForBuffer(oldBufferId)));
+   cache.addEdit(edit.start, edit.end, edit.replacementLength);
+   Parser parser(langOpts, bufferId, sourceMgr, nullptr);
+   parser.setSyntaxParsingCache(&cache);
+   startTime = std::chrono::steady_clock::now();
+   bool failed = parser.parse();
+   std::chrono::duration<double> incrementalParseTime = std::chrono::steady_clock::now() - startTime;
+   SyntaxReuseStats stats = cache.getReuseStats();
+   output << "edit: [" << edit.start << ", " << edit.end << ") replaced by "
+          << edit.replacementLength << " bytes" << std::endl
+          << "reused nodes: " << stats.numReusedNodes
+          << ", reused bytes: " << stats.numReusedBytes << "/" << stats.sourceLength
+          << ", reuse ratio: " << std::fixed << std::setprecision(2)
+          << stats.getReuseRatio() * 100 << "%" << std::endl
+          << "full parse seconds: " << std::setprecision(6) << fullParseTime.count()
+          << ", incremental parse seconds: " << incrementalParseTime.count() << std::endl;
+   if (!failed) {
+      Syntax syntaxTree = polar::syntax::make<Syntax>(parser.getSyntaxTree());
+      for (const polar::parser::SyntaxReuseRegion &region : cache.getReusedRegions(syntaxTree)) {
+         output << "reused region: [" << region.start.getOffset() << ", "
+                << region.end.getOffset() << ")" << std::endl;
+      }
+   }
+   return failed ? BATCH_PARSE_ERROR : 0;
+}
+
+/// Serialize the tree of \p sourceBuffer as JSON and in the binary format,
+/// read both back and report size and time of every step.
+int run_serialization_comparison(std::unique_ptr<MemoryBuffer> sourceBuffer, std::ostream &output)
+{
+   using Clock = std::chrono::steady_clock;
+   using Seconds = std::chrono::duration<double>;
+   LangOptions langOpts{};
+   SourceManager sourceMgr;
+   unsigned bufferId = sourceMgr.addNewSourceBuffer(std::move(sourceBuffer));
+   Parser parser(langOpts, bufferId, sourceMgr, nullptr);
+   if (parser.parse()) {
+      std::cerr << "parse source file error" << std::endl;
+      return BATCH_PARSE_ERROR;
+   }
+   RefCountPtr<RawSyntax> syntaxTree = parser.getSyntaxTree();
+
+   auto startTime = Clock::now();
+   std::string jsonText = json(*syntaxTree).dump();
+   Seconds jsonWriteTime = Clock::now() - startTime;
+   startTime = Clock::now();
+   json parsedJson = json::parse(jsonText);
+   Seconds jsonReadTime = Clock::now() - startTime;
+
+   std::string binaryData;
+   startTime = Clock::now();
+   {
+      llvm::raw_string_ostream binaryStream(binaryData);
+      write_syntax_binary(binaryStream, syntaxTree);
+   }
+   Seconds binaryWriteTime = Clock::now() - startTime;
+   startTime = Clock::now();
+   SyntaxBinaryReader reader(binaryData, parser.getArena());
+   RefCountPtr<RawSyntax> binaryTree = reader.materializeRoot();
+   Seconds binaryReadTime = Clock::now() - startTime;
+   if (!binaryTree) {
+      std::cerr << "read binary syntax tree error" << std::endl;
+      return BATCH_PARSE_ERROR;
+   }
+   output << std::left << std::setw(10) << "format"
+          << std::right << std::setw(14) << "bytes"
+          << std::setw(16) << "write seconds"
+          << std::setw(16) << "read seconds" << std::endl
+          << std::fixed << std::setprecision(6)
+          << std::left << std::setw(10) << "json"
+          << std::right << std::setw(14) << jsonText.size()
+          << std::setw(16) << jsonWriteTime.count()
+          << std::setw(16) << jsonReadTime.count() << std::endl
+          << std::left << std::setw(10) << "binary"
+          << std::right << std::setw(14) << binaryData.size()
+          << std::setw(16) << binaryWriteTime.count()
+          << std::setw(16) << binaryReadTime.count() << std::endl
+          << "nodes: " << reader.getNumNodes()
+          << ", json read only parses the text, binary read materialises the whole tree"
+          << std::endl;
+   return 0;
+}
+
+/// Compare the position lookup of SyntaxData with SyntaxPositionIndex on
+/// the tree of \p sourceBuffer, meant to be run on large (50k lines) files.
+int run_position_benchmark(std::unique_ptr<MemoryBuffer> sourceBuffer, unsigned numQueries,
+                           std::ostream &output)
+{
+   using Clock = std::chrono::steady_clock;
+   using Seconds = std::chrono::duration<double>;
+   LangOptions langOpts{};
+   SourceManager sourceMgr;
+   unsigned bufferId = sourceMgr.addNewSourceBuffer(std::move(sourceBuffer));
+   Parser parser(langOpts, bufferId, sourceMgr, nullptr);
+   if (parser.parse()) {
+      std::cerr << "parse source file error" << std::endl;
+      return PARSE_SOURCE_FILE_ERROR;
+   }
+   RefCountPtr<RawSyntax> syntaxTree = parser.getSyntaxTree();
+
+   auto startTime = Clock::now();
+   SyntaxPositionIndex index(syntaxTree);
+   Seconds buildTime = Clock::now() - startTime;
+
+   // realize the present tokens in document order
+   std::vector<RefCountPtr<SyntaxData>> tokens;
+   std::vector<RefCountPtr<SyntaxData>> pending{SyntaxData::make(syntaxTree)};
+   while (!pending.empty()) {
+      RefCountPtr<SyntaxData> data = std::move(pending.back());
+      pending.pop_back();
+      if (data->getRaw()->isToken()) {
+         if (data->getRaw()->isPresent()) {
+            tokens.push_back(data);
+         }
+         continue;
+      }
+      for (size_t i = data->getNumChildren(); i > 0; --i) {
+         if (RefCountPtr<SyntaxData> child = data->getChild(i - 1)) {
+            pending.push_back(std::move(child));
+         }
+      }
+   }
+   if (tokens.empty() || index.getTextLength() == 0) {
+      return 0;
+   }
+   // SyntaxData recurses over every previous node without cached position,
+   // a cold lookup near the end of a large file exhausts the stack, so it
+   // is measured in document order where each lookup hits the cache of the
+   // previous token, its best case
+   startTime = Clock::now();
+   size_t checksum = 0;
+   for (const RefCountPtr<SyntaxData> &token : tokens) {
+      checksum += token->getAbsolutePosition().getLine();
+   }
+   Seconds syntaxDataTime = Clock::now() - startTime;
+
+   std::mt19937 random(20191202);
+   std::vector<const SyntaxData *> sampledTokens;
+   std::vector<std::uint32_t> sampledOffsets;
+   std::uniform_int_distribution<size_t> tokenDist(0, tokens.size() - 1);
+   std::uniform_int_distribution<std::uint32_t> offsetDist(0, index.getTextLength() - 1);
+   for (unsigned i = 0; i < numQueries; ++i) {
+      sampledTokens.push_back(tokens[tokenDist(random)].get());
+      sampledOffsets.push_back(offsetDist(random));
+   }
+   startTime = Clock::now();
+   for (const SyntaxData *token : sampledTokens) {
+      checksum += index.getLineAndColumn(index.getContentOffset(index.findNode(*token))).first;
+   }
+   Seconds nodeToPositionTime = Clock::now() - startTime;
+   startTime = Clock::now();
+   for (std::uint32_t offset : sampledOffsets) {
+      checksum += index.findDeepestNode(offset);
+   }
+   Seconds offsetToNodeTime = Clock::now() - startTime;
+   startTime = Clock::now();
+   for (std::uint32_t offset : sampledOffsets) {
+      checksum += index.getLineAndColumn(offset).second;
+   }
+   Seconds offsetToLineTime = Clock::now() - startTime;
+
+   auto perQuery = [](Seconds time, size_t count) {
+      return count > 0 ? time.count() * 1e9 / count : 0;
+   };
+   output << "lines: " << index.getNumLines()
+          << ", nodes: " << index.getNumNodes()
+          << ", tokens: " << tokens.size()
+          << std::endl << std::fixed << std::setprecision(1)
+          << "index build ms: " << buildTime.count() * 1e3
+          << std::endl
+          << "SyntaxData position, document order, ns/query: "
+          << perQuery(syntaxDataTime, tokens.size())
+          << std::endl
+          << "index node->line:column, random order, ns/query: "
+          << perQuery(nodeToPositionTime, sampledTokens.size())
+          << std::endl
+          << "index offset->deepest node, ns/query: "
+          << perQuery(offsetToNodeTime, sampledOffsets.size())
+          << std::endl
+          << "index offset->line:column, ns/query: "
+          << perQuery(offsetToLineTime, sampledOffsets.size())
+          << std::endl
+          << "checksum: " << checksum << std::endl;
+   return 0;
+}
+
+} // anonymous namespace
 
 int main(int argc, char * argv[])
 {
    CLI::App parserApp;
    std::string filePath;
    std::string outputFilePath;
+   std::string fileListPath;
+   unsigned jobs = 0;
+   bool reportScaling = false;
+   bool compareArena = false;
+   std::string oldFilePath;
+   bool compareSerialization = false;
+   std::string parseCacheDir;
+   std::string outputFormat = "json";
+   bool uniqueTokens = false;
+   bool compareTokenUniquing = false;
+   unsigned positionQueries = 0;
    parserApp.name("polar-ast-dumper");
    parserApp.footer("\nCopyright (c) 2019-2020 polar software foundation");
    parserApp.add_option("sourceFilepath", filePath, "path of file to be parser, use stdin if not specified");
    parserApp.add_option("-o,--output", outputFilePath, "process result write into file path");
+   parserApp.add_option("--file-list", fileListPath, "parse every file listed in this file (one path per line) in parallel");
+   parserApp.add_option("-j,--jobs", jobs, "number of parser threads used by --file-list, default is the number of cores");
+   parserApp.add_flag("--report-scaling", reportScaling, "parse the --file-list with 1, 2, 4 ... jobs threads and report files/sec of each run");
+   parserApp.add_flag("--compare-arena", compareArena, "parse the --file-list with and without syntax arena, report allocation count and parse time of both");
+   parserApp.add_option("--old-source", oldFilePath, "parse this previous version of the source first, then parse the source incrementally and report the reused regions");
+   parserApp.add_flag("--compare-serialization", compareSerialization, "serialize the syntax tree as json and binary, report size and write/read time of both");
+   parserApp.add_option("--parse-cache-dir", parseCacheDir, "reuse the syntax trees of unchanged files stored in this directory and store the trees of parsed files, report the hit rate and time saved");
+   parserApp.add_flag("--unique-tokens", uniqueTokens, "share one syntax node between equal tokens (kind, text and trivia) of a file");
+   parserApp.add_flag("--compare-token-uniquing", compareTokenUniquing, "parse the --file-list with and without token uniquing, report syntax nodes and heap held by the trees of both");
+   parserApp.add_option("--benchmark-positions", positionQueries, "run this many random position lookups against SyntaxData and the position index of the source tree");
+   parserApp.add_option("--format", outputFormat, "format of the dumped syntax tree: json (default), sexpr or none");
    POLAR_CLI11_PARSE(parserApp, argc, argv);
+   if (outputFormat != "json" && outputFormat != "sexpr" && outputFormat != "none") {
+      std::cerr << "unknown output format: " << outputFormat << std::endl;
+      return UNKNOWN_OUTPUT_FORMAT_ERROR;
+   }
+   if (!fileListPath.empty()) {
+      std::ostream *output = &std::cout;
+      std::unique_ptr<std::ofstream> foutstream;
+      if (!outputFilePath.empty()) {
+         foutstream = std::make_unique<std::ofstream>(outputFilePath, std::ios_base::out | std::ios_base::trunc);
+         if (foutstream->fail()) {
+            std::cerr << "open output file error: " << strerror(errno) << std::endl;
+            return OPEN_OUTPUT_FILE_ERROR;
+         }
+         output = foutstream.get();
+      }
+      return run_batch_mode(fileListPath, jobs, reportScaling, compareArena, uniqueTokens,
+                            compareTokenUniquing, parseCacheDir, *output);
+   }
    std::unique_ptr<MemoryBuffer> sourceBuffer;
    if (filePath.empty()) {
       ErrorOr<std::unique_ptr<MemoryBuffer>> tempBuffer = MemoryBuffer::getSTDIN();
@@ -75,11 +575,58 @@ int main(int argc, char * argv[])
       }
       output = foutstream.get();
    }
+   if (!oldFilePath.empty()) {
+      ErrorOr<std::unique_ptr<MemoryBuffer>> oldSourceBuffer = MemoryBuffer::getFile(oldFilePath);
+      if (!oldSourceBuffer) {
+         std::cerr << "read old source file error: " << oldSourceBuffer.getError() << std::endl;
+         return OPEN_OLD_SOURCE_FILE_ERROR;
+      }
+      return run_incremental_parse(std::move(oldSourceBuffer.get()), std::move(sourceBuffer), *output);
+   }
+   if (compareSerialization) {
+      return run_serialization_comparison(std::move(sourceBuffer), *output);
+   }
+   if (positionQueries > 0) {
+      return run_position_benchmark(std::move(sourceBuffer), positionQueries, *output);
+   }
    LangOptions langOpts{};
    SourceManager sourceMgr;
    unsigned bufferId = sourceMgr.addNewSourceBuffer(std::move(sourceBuffer));
    Parser parser(langOpts, bufferId, sourceMgr, nullptr);
-   parser.parse();
+   parser.getArena()->setTokenUniquing(uniqueTokens);
+   std::unique_ptr<PersistentParseCache> parseCache;
+   if (!parseCacheDir.empty()) {
+      parseCache = std::make_unique<PersistentParseCache>(parseCacheDir, langOpts);
+      parser.setPersistentParseCache(parseCache.get());
+   }
+   using Clock = std::chrono::steady_clock;
+   using Seconds = std::chrono::duration<double>;
+   auto startTime = Clock::now();
+   if (parser.parse()) {
+      std::cerr << "parse source file error" << std::endl;
+      return PARSE_SOURCE_FILE_ERROR;
+   }
    RefCountPtr<RawSyntax> syntaxTree = parser.getSyntaxTree();
+   Seconds parseTime = Clock::now() - startTime;
+   startTime = Clock::now();
+   if (syntaxTree && outputFormat != "none") {
+      // the writers stream the tree node by node, the dump never holds more
+      // than the path from the root to the current node
+      llvm::raw_os_ostream treeOutput(*output);
+      if (outputFormat == "json") {
+         write_syntax_json(treeOutput, *syntaxTree);
+      } else {
+         write_syntax_sexpr(treeOutput, *syntaxTree);
+      }
+      treeOutput << '\n';
+   }
+   output->flush();
+   Seconds dumpTime = Clock::now() - startTime;
+   // the tree goes to the output, the figures to stderr
+   std::cerr << "parse seconds: " << std::fixed << std::setprecision(6) << parseTime.count()
+             << ", dump seconds: " << dumpTime.count() << std::endl;
+   if (parseCache) {
+      print_parse_cache_stats(std::cerr, parseCache->getStats());
+   }
    return 0;
 }
@@ -20,11 +20,17 @@
 #include "polarphp/syntax/TokenKinds.h"
 #include "polarphp/syntax/serialization/TokenKindTypeSerialization.h"
 #include "polarphp/parser/serialization/TokenJsonSerialization.h"
+#include "polarphp/parser/serialization/TokenBinarySerialization.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include "polarphp/parser/internal/TriviaScanner.h"
 #include "nlohmann/json.hpp"
+#include "HeapAllocationCounter.h"
 
 #include <memory>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <iomanip>
 
 using llvm::MemoryBuffer;
 using llvm::ErrorOr;
@@ -33,37 +39,157 @@ using polar::basic::SourceManager;
 using polar::parser::Lexer;
 using polar::parser::Token;
 using polar::parser::TokenKindType;
+using polar::parser::CommentRetentionMode;
+using polar::parser::TriviaRetentionMode;
+using polar::parser::internal::get_trivia_scanner_name;
+using polar::benchmark::get_heap_allocation_count;
+using polar::parser::write_token_binary_header;
+using polar::parser::write_token_binary_record;
 using nlohmann::json;
 
 #define READ_STDIN_ERROR 1
 #define OPEN_SOURCE_FILE_ERROR 2
 #define OPEN_OUTPUT_FILE_ERROR 3
+#define UNKNOWN_OUTPUT_FORMAT_ERROR 4
+
+namespace {
+
+struct LexBenchmarkResult
+{
+   size_t numTokens = 0;
+   size_t numAllocations = 0;
+   double seconds = 0;
+};
+
+LexBenchmarkResult lex_source_repeatedly(const LangOptions &langOpts, const SourceManager &sourceMgr,
+                                         unsigned bufferId, TriviaRetentionMode triviaRetention,
+                                         unsigned iterations)
+{
+   LexBenchmarkResult result;
+   size_t startAllocations = get_heap_allocation_count();
+   auto startTime = std::chrono::steady_clock::now();
+   for (unsigned i = 0; i < iterations; ++i) {
+      Lexer lexer(langOpts, sourceMgr, bufferId, nullptr, CommentRetentionMode::None, triviaRetention);
+      Token currentToken;
+      do {
+         lexer.lex(currentToken);
+         ++result.numTokens;
+      } while (currentToken.isNot(TokenKindType::END));
+   }
+   result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+   result.numAllocations = get_heap_allocation_count() - startAllocations;
+   return result;
+}
+
+void print_benchmark_row(std::ostream &out, const char *mode, const LexBenchmarkResult &result,
+                         size_t bufferSize, unsigned iterations)
+{
+   double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+   out << std::left << std::setw(16) << mode
+       << std::right << std::setw(14) << result.numTokens
+       << std::setw(12) << std::fixed << std::setprecision(4) << result.seconds
+       << std::setw(16) << std::setprecision(0) << result.numTokens / seconds
+       << std::setw(12) << std::setprecision(2)
+       << double(bufferSize) * iterations / seconds / (1024 * 1024)
+       << std::setw(16) << std::setprecision(3)
+       << (result.numTokens ? double(result.numAllocations) / result.numTokens : 0.0)
+       << std::endl;
+}
+
+/// Lex the whole buffer \p iterations times with trivia retained and in the
+/// trivia free mode, and report the throughput and heap allocations per
+/// token of both.
+void run_lex_benchmark(const LangOptions &langOpts, const SourceManager &sourceMgr,
+                       unsigned bufferId, unsigned iterations, std::ostream &out)
+{
+   size_t bufferSize = sourceMgr.getRangeForBuffer(bufferId).getByteLength();
+   // warm up caches and the allocator, results are discarded
+   lex_source_repeatedly(langOpts, sourceMgr, bufferId, TriviaRetentionMode::WithoutTrivia, 1);
+   LexBenchmarkResult withTrivia = lex_source_repeatedly(langOpts, sourceMgr, bufferId,
+                                                         TriviaRetentionMode::WithTrivia, iterations);
+   LexBenchmarkResult triviaFree = lex_source_repeatedly(langOpts, sourceMgr, bufferId,
+                                                         TriviaRetentionMode::WithoutTrivia, iterations);
+   out << "trivia scanner: " << get_trivia_scanner_name() << ", "
+       << bufferSize << " bytes x " << iterations << " iterations" << std::endl;
+   out << std::left << std::setw(16) << "mode"
+       << std::right << std::setw(14) << "tokens"
+       << std::setw(12) << "seconds"
+       << std::setw(16) << "tokens/s"
+       << std::setw(12) << "MB/s"
+       << std::setw(16) << "allocs/token" << std::endl;
+   print_benchmark_row(out, "with-trivia", withTrivia, bufferSize, iterations);
+   print_benchmark_row(out, "trivia-free", triviaFree, bufferSize, iterations);
+   if (triviaFree.seconds > 0) {
+      out << "speedup: " << std::setprecision(2) << withTrivia.seconds / triviaFree.seconds << "x" << std::endl;
+   }
+}
+
+/// Write one compact JSON object per line as soon as each token is lexed,
+/// memory use does not depend on the size of the source.
+void write_ndjson_tokens(Lexer &lexer, std::ostream &out)
+{
+   Token currentToken;
+   do {
+      lexer.lex(currentToken);
+      out << json(currentToken).dump() << '\n';
+   } while (currentToken.isNot(TokenKindType::END));
+}
+
+/// Write the binary token stream described in TokenBinarySerialization.h.
+void write_binary_tokens(Lexer &lexer, const SourceManager &sourceMgr, unsigned bufferId,
+                         std::ostream &out)
+{
+   llvm::raw_os_ostream rawOut(out);
+   write_token_binary_header(rawOut);
+   Token currentToken;
+   do {
+      lexer.lex(currentToken);
+      write_token_binary_record(rawOut, currentToken,
+                                sourceMgr.getLocOffsetInBuffer(currentToken.getLoc(), bufferId));
+   } while (currentToken.isNot(TokenKindType::END));
+   rawOut.flush();
+}
+
+} // anonymous namespace
 
 int main(int argc, char * argv[])
 {
    CLI::App tokenizer;
    std::string filePath;
    std::string outputFilePath;
+   std::string outputFormat = "json";
+   unsigned benchmarkIterations = 0;
    tokenizer.name("polar-tokenizer");
    tokenizer.footer("\nCopyright (c) 2019-2020 polar software foundation");
    tokenizer.add_option("sourceFilepath", filePath, "path of file to be tokenized, use stdin if not specified");
    tokenizer.add_option("-o,--output", outputFilePath, "process result write into file path");
+   tokenizer.add_option("--format", outputFormat,
+                        "output format: json (default, one array), ndjson (one token per line, streamed) "
+                        "or binary (streamed token records)");
+   tokenizer.add_option("--benchmark", benchmarkIterations,
+                        "lex the source N times with and without trivia and report tokens per second instead of dumping tokens");
    POLAR_CLI11_PARSE(tokenizer, argc, argv);
-   std::unique_ptr<MemoryBuffer> sourceBuffer;
+   if (outputFormat != "json" && outputFormat != "ndjson" && outputFormat != "binary") {
+      std::cerr << "unknown output format: " << outputFormat << std::endl;
+      return UNKNOWN_OUTPUT_FORMAT_ERROR;
+   }
+   SourceManager sourceMgr;
+   unsigned bufferId;
    if (filePath.empty()) {
       ErrorOr<std::unique_ptr<MemoryBuffer>> tempBuffer = MemoryBuffer::getSTDIN();
       if (tempBuffer) {
-         sourceBuffer = std::move(tempBuffer.get());
+         bufferId = sourceMgr.addNewSourceBuffer(std::move(tempBuffer.get()));
       } else {
          std::cerr << "read stdin error: " << tempBuffer.getError() << std::endl;
          return READ_STDIN_ERROR;
       }
    } else {
-      ErrorOr<std::unique_ptr<MemoryBuffer>> tempBuffer = MemoryBuffer::getFile(filePath);
-      if (tempBuffer) {
-         sourceBuffer = std::move(tempBuffer.get());
+      // mapped read only, the pages are not copied
+      ErrorOr<unsigned> mappedBufferId = sourceMgr.addMappedSourceFile(filePath);
+      if (mappedBufferId) {
+         bufferId = mappedBufferId.get();
       } else {
-         std::cerr << "read source file error: " << tempBuffer.getError() << std::endl;
+         std::cerr << "read source file error: " << mappedBufferId.getError() << std::endl;
          return OPEN_SOURCE_FILE_ERROR;
       }
    }
@@ -73,7 +199,11 @@ int main(int argc, char * argv[])
    if (outputFilePath.empty()) {
       output = &std::cout;
    } else {
-      foutstream = std::make_unique<std::ofstream>(outputFilePath, std::ios_base::out | std::ios_base::trunc);
+      std::ios_base::openmode mode = std::ios_base::out | std::ios_base::trunc;
+      if (outputFormat == "binary") {
+         mode |= std::ios_base::binary;
+      }
+      foutstream = std::make_unique<std::ofstream>(outputFilePath, mode);
       if (foutstream->fail()) {
          std::cerr << "open output file error: " << strerror(errno) << std::endl;
          return OPEN_OUTPUT_FILE_ERROR;
@@ -81,9 +211,22 @@ int main(int argc, char * argv[])
       output = foutstream.get();
    }
    LangOptions langOpts{};
-   SourceManager sourceMgr;
-   unsigned bufferId = sourceMgr.addNewSourceBuffer(std::move(sourceBuffer));
+   if (benchmarkIterations > 0) {
+      run_lex_benchmark(langOpts, sourceMgr, bufferId, benchmarkIterations, *output);
+      output->flush();
+      return 0;
+   }
    Lexer lexer(langOpts, sourceMgr, bufferId, nullptr);
+   if (outputFormat == "ndjson") {
+      write_ndjson_tokens(lexer, *output);
+      output->flush();
+      return 0;
+   }
+   if (outputFormat == "binary") {
+      write_binary_tokens(lexer, sourceMgr, bufferId, *output);
+      output->flush();
+      return 0;
+   }
    Token currentToken;
    json tokenJsonArray = json::array();
    do {
@@ -0,0 +1,180 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/ast/AstContext.h"
+#include "polarphp/ast/DiagnosticEngine.h"
+#include "polarphp/ast/SearchPathOptions.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using polar::AllocationArena;
+using polar::ArenaAccountingRAII;
+using polar::AstContext;
+using polar::ConstraintCheckerArenaRAII;
+using polar::DiagnosticEngine;
+using polar::LangOptions;
+using polar::SearchPathOptions;
+using polar::SourceManager;
+using polar::TypeCheckerOptions;
+using llvm::StringRef;
+
+namespace {
+
+/// The numbers of a row of the arena statistics: permanent bytes, solver
+/// bytes, solver arenas and solver peak.
+struct ArenaRow
+{
+   std::string file;
+   std::vector<std::uint64_t> numbers;
+};
+
+/// The rows of the first table printed by printArenaStatistics() by phase,
+/// and the phases in the order they were printed.
+struct ArenaTable
+{
+   std::map<std::string, ArenaRow> rows;
+   std::vector<std::string> phases;
+};
+
+ArenaTable parse_arena_table(StringRef output)
+{
+   ArenaTable table;
+   llvm::SmallVector<StringRef, 16> lines;
+   output.split(lines, '\n');
+   // skip the title and the column headers
+   for (size_t i = 2; i < lines.size() && !lines[i].empty(); ++i) {
+      llvm::SmallVector<StringRef, 8> fields;
+      lines[i].split(fields, ' ', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+      ArenaRow &row = table.rows[fields.front().str()];
+      table.phases.push_back(fields.front().str());
+      size_t firstNumber = fields.size() - 4;
+      if (firstNumber == 2) {
+         row.file = fields[1].str();
+      }
+      for (size_t j = firstNumber; j < fields.size(); ++j) {
+         std::uint64_t number = 0;
+         EXPECT_FALSE(fields[j].getAsInteger(10, number));
+         row.numbers.push_back(number);
+      }
+   }
+   return table;
+}
+
+class ArenaAccountingTest : public ::testing::Test
+{
+protected:
+   ArenaAccountingTest()
+      : m_diags(m_sourceMgr),
+        m_context(AstContext::get(m_langOpts, m_typeCheckerOpts, m_searchPathOpts,
+                                  m_sourceMgr, m_diags))
+   {}
+
+   std::string printStatistics()
+   {
+      std::string output;
+      llvm::raw_string_ostream stream(output);
+      m_context->printArenaStatistics(stream);
+      return stream.str();
+   }
+
+   LangOptions m_langOpts;
+   TypeCheckerOptions m_typeCheckerOpts;
+   SearchPathOptions m_searchPathOpts;
+   SourceManager m_sourceMgr;
+   DiagnosticEngine m_diags;
+   std::unique_ptr<AstContext> m_context;
+};
+
+} // anonymous namespace
+
+TEST_F(ArenaAccountingTest, testNothingIsPrintedUnlessEnabled)
+{
+   {
+      ArenaAccountingRAII scope(*m_context, "parse");
+      m_context->Allocate(100, 8);
+   }
+   ASSERT_FALSE(m_context->isArenaAccountingEnabled());
+   ASSERT_EQ(printStatistics(), "");
+}
+
+TEST_F(ArenaAccountingTest, testBytesGoToTheInnermostScope)
+{
+   AstContext &context = *m_context;
+   context.enableArenaAccounting(/*trackSolvedExprs=*/false);
+   ASSERT_TRUE(context.isArenaAccountingEnabled());
+   context.Allocate(10, 8);
+   {
+      ArenaAccountingRAII parseScope(context, "parse");
+      context.Allocate(100, 8);
+      {
+         ArenaAccountingRAII typeCheckScope(context, "type-check");
+         context.Allocate(1000, 8);
+         llvm::BumpPtrAllocator first;
+         {
+            ConstraintCheckerArenaRAII solverArena(context, first);
+            context.Allocate(64, 8, AllocationArena::ConstraintSolver);
+         }
+         llvm::BumpPtrAllocator second;
+         {
+            ConstraintCheckerArenaRAII solverArena(context, second);
+            context.Allocate(32, 8, AllocationArena::ConstraintSolver);
+         }
+      }
+      // leaving the inner scope goes back to this one
+      context.Allocate(100, 8);
+   }
+   {
+      // entering a phase again adds to its row
+      ArenaAccountingRAII parseScope(context, "parse");
+      context.Allocate(50, 8);
+   }
+   context.Allocate(10, 8);
+
+   std::string output = printStatistics();
+   ASSERT_TRUE(StringRef(output).startswith("*** AST arena statistics (bytes) ***\n"));
+   ArenaTable table = parse_arena_table(output);
+   ASSERT_EQ(table.phases, (std::vector<std::string>{"setup", "frontend", "parse",
+                                                     "type-check", "total"}));
+   ASSERT_EQ(table.rows["frontend"].file, "-");
+   ASSERT_EQ(table.rows["frontend"].numbers, (std::vector<std::uint64_t>{20, 0, 0, 0}));
+   ASSERT_EQ(table.rows["parse"].numbers, (std::vector<std::uint64_t>{250, 0, 0, 0}));
+   ASSERT_EQ(table.rows["type-check"].numbers, (std::vector<std::uint64_t>{1000, 96, 2, 64}));
+   std::uint64_t setupBytes = table.rows["setup"].numbers[0];
+   ASSERT_EQ(table.rows["total"].numbers,
+             (std::vector<std::uint64_t>{setupBytes + 1270, 96, 2, 64}));
+   // without tracking there is no table of solved expressions
+   ASSERT_EQ(output.find("by solved expression"), std::string::npos);
+}
+
+TEST_F(ArenaAccountingTest, testPrintingCountsTheOpenScope)
+{
+   AstContext &context = *m_context;
+   context.enableArenaAccounting(/*trackSolvedExprs=*/true);
+   ArenaAccountingRAII parseScope(context, "parse");
+   context.Allocate(100, 8);
+   ASSERT_EQ(parse_arena_table(printStatistics()).rows["parse"].numbers[0], 100u);
+   // printing does not leave the scope
+   context.Allocate(100, 8);
+   std::string output = printStatistics();
+   ASSERT_EQ(parse_arena_table(output).rows["parse"].numbers[0], 200u);
+   ASSERT_NE(output.find("\n*** constraint solver arena by solved expression (bytes) ***\n"),
+             std::string::npos);
+}
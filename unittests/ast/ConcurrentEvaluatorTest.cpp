@@ -0,0 +1,103 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "EvaluatorTestRequests.h"
+#include "polarphp/ast/DiagnosticEngine.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+using polar::CyclicRequest;
+using polar::DiagnosticEngine;
+using polar::Evaluator;
+using polar::RacingRequest;
+using polar::SourceManager;
+using polar::evaluateOrDefault;
+using polar::register_evaluator_test_request_functions;
+using polar::sg_evaluatorTestState;
+
+namespace {
+
+class ConcurrentEvaluatorTest : public ::testing::Test
+{
+protected:
+   ConcurrentEvaluatorTest()
+      : m_diags(m_sourceMgr),
+        m_evaluator(m_diags)
+   {
+      register_evaluator_test_request_functions(m_evaluator);
+      m_evaluator.enableConcurrentEvaluation(4);
+   }
+
+   /// evaluate \p request on \p numThreads threads at once, the results
+   /// are the ones of each thread
+   template <typename Request>
+   std::vector<unsigned> evaluateOnThreads(const Request &request, unsigned numThreads)
+   {
+      sg_evaluatorTestState.reset(numThreads);
+      std::vector<unsigned> results(numThreads);
+      std::vector<std::thread> workers;
+      for (unsigned i = 0; i < numThreads; ++i) {
+         workers.emplace_back([&, i]() {
+            results[i] = evaluateOrDefault(m_evaluator, request, 0u);
+         });
+      }
+      for (std::thread &worker : workers) {
+         worker.join();
+      }
+      return results;
+   }
+
+   SourceManager m_sourceMgr;
+   DiagnosticEngine m_diags;
+   Evaluator m_evaluator;
+};
+
+} // anonymous namespace
+
+TEST_F(ConcurrentEvaluatorTest, testEveryThreadDetectsTheCycleOnItsStack)
+{
+   constexpr unsigned numThreads = 4;
+   std::vector<unsigned> results = evaluateOnThreads(CyclicRequest(0), numThreads);
+   // all threads are in the cycle at once, each one runs into the first
+   // request again on its own stack only
+   ASSERT_EQ(sg_evaluatorTestState.numCycles, numThreads);
+   for (unsigned result : results) {
+      ASSERT_EQ(result, CyclicRequest::CYCLE_LENGTH);
+   }
+   ASSERT_FALSE(m_evaluator.hasActiveRequest(CyclicRequest(0)));
+}
+
+TEST_F(ConcurrentEvaluatorTest, testRequestActiveOnAnotherThreadIsNoCycle)
+{
+   constexpr unsigned numThreads = 4;
+   std::vector<unsigned> results = evaluateOnThreads(RacingRequest(1), numThreads);
+   ASSERT_EQ(sg_evaluatorTestState.numCycles, 0u);
+   ASSERT_EQ(sg_evaluatorTestState.numEvaluations, numThreads);
+   for (unsigned result : results) {
+      ASSERT_NE(result, 0u);
+   }
+}
+
+TEST_F(ConcurrentEvaluatorTest, testFirstStoredResultWins)
+{
+   constexpr unsigned numThreads = 4;
+   std::vector<unsigned> results = evaluateOnThreads(RacingRequest(2), numThreads);
+   // every thread computed a result, the ones stored later were dropped
+   ASSERT_EQ(sg_evaluatorTestState.numEvaluations, numThreads);
+   for (unsigned result : results) {
+      ASSERT_EQ(result, results.front());
+   }
+   ASSERT_EQ(evaluateOrDefault(m_evaluator, RacingRequest(2), 0u), results.front());
+   ASSERT_EQ(sg_evaluatorTestState.numEvaluations, numThreads);
+}
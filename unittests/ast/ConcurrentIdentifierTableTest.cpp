@@ -0,0 +1,101 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/ast/ConcurrentIdentifierTable.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using polar::ConcurrentIdentifierTable;
+
+namespace {
+
+std::vector<std::string> make_names(unsigned numNames)
+{
+   std::vector<std::string> names;
+   names.reserve(numNames);
+   for (unsigned i = 0; i < numNames; ++i) {
+      names.push_back("name" + std::to_string(i));
+   }
+   return names;
+}
+
+/// Interns all \p names on \p numThreads threads at once, each thread
+/// starting at another name. Returns the pointers each thread got.
+std::vector<std::vector<const char *>> intern_on_threads(ConcurrentIdentifierTable &table,
+                                                         const std::vector<std::string> &names,
+                                                         unsigned numThreads)
+{
+   std::vector<std::vector<const char *>> interned(numThreads);
+   std::atomic<unsigned> numReady{0};
+   std::vector<std::thread> workers;
+   for (unsigned i = 0; i < numThreads; ++i) {
+      workers.emplace_back([&, i]() {
+         std::vector<const char *> &pointers = interned[i];
+         pointers.assign(names.size(), nullptr);
+         ++numReady;
+         while (numReady.load() < numThreads) {
+            std::this_thread::yield();
+         }
+         size_t start = names.size() * i / numThreads;
+         for (size_t j = 0; j < names.size(); ++j) {
+            size_t index = (start + j) % names.size();
+            pointers[index] = table.intern(names[index]);
+         }
+      });
+   }
+   for (std::thread &worker : workers) {
+      worker.join();
+   }
+   return interned;
+}
+
+} // anonymous namespace
+
+TEST(ConcurrentIdentifierTableTest, testInternReturnsUniquedCopy)
+{
+   ConcurrentIdentifierTable table;
+   std::string name = "getName";
+   const char *interned = table.intern(name);
+   ASSERT_NE(interned, name.data());
+   ASSERT_STREQ(interned, "getName");
+   ASSERT_EQ(table.intern("getName"), interned);
+   ASSERT_NE(table.intern("getNames"), interned);
+   ASSERT_STREQ(table.intern(""), "");
+   ASSERT_EQ(table.size(), 3u);
+}
+
+TEST(ConcurrentIdentifierTableTest, testThreadsGetSamePointersWhileTableIsMoved)
+{
+   // the table starts with 4096 slots and is moved into a larger one when it
+   // is three quarters full, so these names move it five times while the
+   // threads intern them
+   constexpr unsigned numNames = 50000;
+   constexpr unsigned numThreads = 8;
+   std::vector<std::string> names = make_names(numNames);
+   ConcurrentIdentifierTable table;
+   std::vector<std::vector<const char *>> interned = intern_on_threads(table, names, numThreads);
+   ASSERT_EQ(table.size(), numNames);
+   for (unsigned i = 0; i < numThreads; ++i) {
+      for (unsigned j = 0; j < numNames; ++j) {
+         ASSERT_EQ(interned[i][j], interned[0][j]);
+      }
+   }
+   for (unsigned j = 0; j < numNames; ++j) {
+      ASSERT_EQ(names[j], interned[0][j]);
+      // the entries moved into the last table are the same
+      ASSERT_EQ(table.intern(names[j]), interned[0][j]);
+   }
+   ASSERT_EQ(table.size(), numNames);
+}
@@ -0,0 +1,111 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "EvaluatorTestRequests.h"
+#include "polarphp/ast/DiagnosticEngine.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using polar::DependencyRecording;
+using polar::DiagnosticEngine;
+using polar::Evaluator;
+using polar::SourceManager;
+using polar::TreeRequest;
+using polar::VariableRequest;
+using polar::evaluateOrDefault;
+using polar::register_evaluator_test_request_functions;
+using polar::sg_evaluatorTestState;
+
+namespace {
+
+/// What the evaluator knows about the dependencies, the trees of the
+/// dependencies of the tree and the variable request and the graph of all
+/// requests.
+struct DependencySnapshot
+{
+   unsigned result;
+   std::string treeDependencies;
+   std::string variableDependencies;
+   std::string graph;
+};
+
+template <typename Request>
+std::string print_dependencies(const Evaluator &evaluator, const Request &request)
+{
+   std::string text;
+   llvm::raw_string_ostream out(text);
+   evaluator.printDependencies(request, out);
+   return out.str();
+}
+
+/// Evaluates the same requests recording the dependencies with
+/// \p recording. The variable request is evaluated again with more and then
+/// with fewer dependencies than the first time.
+std::vector<DependencySnapshot> record_dependencies(DependencyRecording recording)
+{
+   SourceManager sourceMgr;
+   DiagnosticEngine diags(sourceMgr);
+   Evaluator evaluator(diags);
+   register_evaluator_test_request_functions(evaluator);
+   evaluator.setDependencyRecording(recording);
+   sg_evaluatorTestState.reset(1);
+   std::vector<DependencySnapshot> snapshots;
+   auto evaluate = [&](auto request, unsigned numVariableDependencies) {
+      sg_evaluatorTestState.numVariableDependencies = numVariableDependencies;
+      DependencySnapshot snapshot;
+      snapshot.result = evaluateOrDefault(evaluator, request, 0u);
+      snapshot.treeDependencies = print_dependencies(evaluator, TreeRequest(6));
+      snapshot.variableDependencies = print_dependencies(evaluator, VariableRequest(6));
+      llvm::raw_string_ostream out(snapshot.graph);
+      evaluator.printDependenciesGraphviz(out);
+      out.flush();
+      snapshots.push_back(snapshot);
+   };
+   evaluate(TreeRequest(6), 2);
+   evaluate(VariableRequest(6), 4);
+   evaluate(VariableRequest(6), 1);
+   return snapshots;
+}
+
+} // anonymous namespace
+
+TEST(EvaluatorDependencyRecordingTest, testCompactAndFullGraphsHaveTheSameEdges)
+{
+   std::vector<DependencySnapshot> compact = record_dependencies(DependencyRecording::Compact);
+   std::vector<DependencySnapshot> full = record_dependencies(DependencyRecording::Full);
+   ASSERT_EQ(compact.size(), full.size());
+   for (size_t i = 0; i < compact.size(); ++i) {
+      ASSERT_EQ(compact[i].result, full[i].result);
+      ASSERT_EQ(compact[i].treeDependencies, full[i].treeDependencies);
+      ASSERT_EQ(compact[i].variableDependencies, full[i].variableDependencies);
+      ASSERT_EQ(compact[i].graph, full[i].graph);
+   }
+}
+
+TEST(EvaluatorDependencyRecordingTest, testUncachedRequestKeepsItsLastDependencies)
+{
+   for (DependencyRecording recording : {DependencyRecording::Compact, DependencyRecording::Full}) {
+      std::vector<DependencySnapshot> snapshots = record_dependencies(recording);
+      ASSERT_EQ(snapshots.size(), 3u);
+      ASSERT_EQ(snapshots[0].variableDependencies.find("LeafRequest(8)"), std::string::npos);
+      ASSERT_NE(snapshots[1].variableDependencies.find("LeafRequest(9)"), std::string::npos);
+      ASSERT_NE(snapshots[2].variableDependencies.find("LeafRequest(6)"), std::string::npos);
+      ASSERT_EQ(snapshots[2].variableDependencies.find("LeafRequest(7)"), std::string::npos);
+      // only the variable request of the tree depends on the leaf after
+      // the last one of the variable requests it depends on
+      ASSERT_NE(snapshots[0].treeDependencies.find("LeafRequest(7)"), std::string::npos);
+      ASSERT_EQ(snapshots[2].treeDependencies.find("LeafRequest(7)"), std::string::npos);
+   }
+}
@@ -0,0 +1,119 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "EvaluatorTestRequests.h"
+
+#include <thread>
+
+namespace polar {
+
+#define POLAR_TYPEID_ZONE ArithmeticEvaluator
+#define POLAR_TYPEID_HEADER "EvaluatorTestRequestsTypeIdZone.def"
+#include "polarphp/basic/ImplementTypeIdZone.h"
+#undef POLAR_TYPEID_ZONE
+#undef POLAR_TYPEID_HEADER
+
+EvaluatorTestState sg_evaluatorTestState;
+
+void EvaluatorTestState::reset(unsigned numThreads)
+{
+   this->numThreads = numThreads;
+   numWaiting = 0;
+   numEvaluations = 0;
+   numCycles = 0;
+   numVariableDependencies = 1;
+}
+
+void EvaluatorTestState::waitForAllThreads()
+{
+   ++numWaiting;
+   while (numWaiting.load() < numThreads) {
+      std::this_thread::yield();
+   }
+}
+
+llvm::Expected<unsigned>
+RacingRequest::evaluate(Evaluator &evaluator, unsigned value) const
+{
+   (void)evaluator;
+   (void)value;
+   unsigned evaluation = ++sg_evaluatorTestState.numEvaluations;
+   sg_evaluatorTestState.waitForAllThreads();
+   return evaluation;
+}
+
+void CyclicRequest::diagnoseCycle(DiagnosticEngine &diags) const
+{
+   (void)diags;
+   ++sg_evaluatorTestState.numCycles;
+}
+
+void CyclicRequest::noteCycleStep(DiagnosticEngine &diags) const
+{
+   (void)diags;
+}
+
+llvm::Expected<unsigned>
+CyclicRequest::evaluate(Evaluator &evaluator, unsigned index) const
+{
+   if (index == 0) {
+      sg_evaluatorTestState.waitForAllThreads();
+   }
+   CyclicRequest next((index + 1) % CYCLE_LENGTH);
+   return evaluateOrDefault(evaluator, next, 0u) + 1;
+}
+
+llvm::Expected<unsigned>
+LeafRequest::evaluate(Evaluator &evaluator, unsigned value) const
+{
+   (void)evaluator;
+   return value;
+}
+
+llvm::Expected<unsigned>
+VariableRequest::evaluate(Evaluator &evaluator, unsigned value) const
+{
+   unsigned result = 0;
+   for (unsigned i = 0; i < sg_evaluatorTestState.numVariableDependencies; ++i) {
+      result += evaluateOrDefault(evaluator, LeafRequest(value + i), 0u);
+   }
+   return result;
+}
+
+llvm::Expected<unsigned>
+TreeRequest::evaluate(Evaluator &evaluator, unsigned value) const
+{
+   unsigned result = evaluateOrDefault(evaluator, VariableRequest(value), 0u);
+   if (value > 0) {
+      result += evaluateOrDefault(evaluator, TreeRequest(value - 1), 0u);
+      result += evaluateOrDefault(evaluator, TreeRequest(value / 2), 0u);
+   }
+   return result;
+}
+
+namespace {
+
+AbstractRequestFunction *sg_evaluatorTestRequestFunctions[] = {
+#define POLAR_REQUEST(Zone, Name, Sig, Caching, LocOptions)                    \
+  reinterpret_cast<AbstractRequestFunction *>(&Name::evaluateRequest),
+#include "EvaluatorTestRequestsTypeIdZone.def"
+#undef POLAR_REQUEST
+};
+
+} // anonymous namespace
+
+void register_evaluator_test_request_functions(Evaluator &evaluator)
+{
+   evaluator.registerRequestFunctions(Zone::ArithmeticEvaluator,
+                                      sg_evaluatorTestRequestFunctions);
+}
+
+} // polar
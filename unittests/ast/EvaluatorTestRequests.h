@@ -0,0 +1,159 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#ifndef POLARPHP_UNITTEST_AST_EVALUATOR_TEST_REQUESTS_H
+#define POLARPHP_UNITTEST_AST_EVALUATOR_TEST_REQUESTS_H
+
+#include "polarphp/ast/Evaluator.h"
+#include "polarphp/ast/SimpleRequest.h"
+
+#include <atomic>
+
+namespace polar {
+
+/// What the evaluations of the test requests saw, reset before each run.
+struct EvaluatorTestState
+{
+   /// the threads which wait for each other in an evaluation
+   unsigned numThreads = 1;
+   std::atomic<unsigned> numWaiting{0};
+   std::atomic<unsigned> numEvaluations{0};
+   std::atomic<unsigned> numCycles{0};
+   /// the leaves a \c VariableRequest depends on
+   unsigned numVariableDependencies = 1;
+
+   void reset(unsigned numThreads);
+
+   /// Returns once \c numThreads threads called it.
+   void waitForAllThreads();
+};
+
+extern EvaluatorTestState sg_evaluatorTestState;
+
+/// Returns the number of its evaluation. An evaluation waits until every
+/// thread evaluates the request, so each thread computes a result of its
+/// own and all of them try to store it.
+class RacingRequest :
+      public SimpleRequest<RacingRequest,
+                           unsigned(unsigned),
+                           CacheKind::Cached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned> evaluate(Evaluator &evaluator, unsigned value) const;
+
+public:
+   bool isCached() const { return true; }
+};
+
+/// Depends on the next request of a cycle of \c CYCLE_LENGTH requests and
+/// returns the number of requests it evaluated until the cycle was
+/// detected. The first request of the cycle waits until every thread
+/// evaluates it.
+class CyclicRequest :
+      public SimpleRequest<CyclicRequest,
+                           unsigned(unsigned),
+                           CacheKind::Uncached>
+{
+public:
+   static constexpr unsigned CYCLE_LENGTH = 3;
+
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+   /// Counts the cycle instead of diagnosing it.
+   void diagnoseCycle(DiagnosticEngine &diags) const;
+   void noteCycleStep(DiagnosticEngine &diags) const;
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned> evaluate(Evaluator &evaluator, unsigned index) const;
+};
+
+/// Returns its value.
+class LeafRequest :
+      public SimpleRequest<LeafRequest,
+                           unsigned(unsigned),
+                           CacheKind::Cached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned> evaluate(Evaluator &evaluator, unsigned value) const;
+
+public:
+   bool isCached() const { return true; }
+};
+
+/// Sums the \c numVariableDependencies leaves starting at its value, so
+/// evaluating it again may change its dependencies.
+class VariableRequest :
+      public SimpleRequest<VariableRequest,
+                           unsigned(unsigned),
+                           CacheKind::Uncached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned> evaluate(Evaluator &evaluator, unsigned value) const;
+};
+
+/// Depends on the variable request of its value and on the tree requests
+/// of \c value - 1 and \c value / 2, which share most of their
+/// dependencies.
+class TreeRequest :
+      public SimpleRequest<TreeRequest,
+                           unsigned(unsigned),
+                           CacheKind::Cached>
+{
+public:
+   using SimpleRequest::SimpleRequest;
+
+   SourceLoc getNearestLoc() const { return SourceLoc(); }
+
+private:
+   friend SimpleRequest;
+
+   llvm::Expected<unsigned> evaluate(Evaluator &evaluator, unsigned value) const;
+
+public:
+   bool isCached() const { return true; }
+};
+
+#define POLAR_TYPEID_ZONE ArithmeticEvaluator
+#define POLAR_TYPEID_HEADER "EvaluatorTestRequestsTypeIdZone.def"
+#include "polarphp/basic/DefineTypeIdZone.h"
+#undef POLAR_TYPEID_ZONE
+#undef POLAR_TYPEID_HEADER
+
+void register_evaluator_test_request_functions(Evaluator &evaluator);
+
+} // polar
+
+#endif // POLARPHP_UNITTEST_AST_EVALUATOR_TEST_REQUESTS_H
@@ -0,0 +1,189 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/ast/PersistentRequestCache.h"
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using polar::LangOptions;
+using polar::PersistentRequestCache;
+using polar::PersistentRequestKey;
+using polar::SourceManager;
+using llvm::SmallString;
+using llvm::StringRef;
+
+namespace {
+
+class PersistentRequestCacheTest : public ::testing::Test
+{
+protected:
+   void SetUp() override
+   {
+      m_cachePath = createPath("requests", "requestcache");
+   }
+
+   void TearDown() override
+   {
+      for (const std::string &path : m_paths) {
+         llvm::sys::fs::remove(path);
+      }
+   }
+
+   std::string createPath(StringRef prefix, StringRef suffix)
+   {
+      SmallString<128> path;
+      EXPECT_FALSE(llvm::sys::fs::createTemporaryFile(prefix, suffix, path));
+      m_paths.push_back(path.str().str());
+      return m_paths.back();
+   }
+
+   static void writeFile(StringRef path, StringRef contents)
+   {
+      std::error_code error;
+      llvm::raw_fd_ostream out(path, error);
+      EXPECT_FALSE(error);
+      out << contents;
+   }
+
+   /// a buffer of \p sourceMgr for the file \p path, which has \p source
+   static unsigned addSource(SourceManager &sourceMgr, StringRef path, StringRef source)
+   {
+      writeFile(path, source);
+      return sourceMgr.addMemBufferCopy(source, path);
+   }
+
+   /// saves a result of two requests on the file \p path with \p source
+   void saveResults(StringRef path, StringRef source)
+   {
+      SourceManager sourceMgr;
+      unsigned bufferId = addSource(sourceMgr, path, source);
+      PersistentRequestCache cache(sourceMgr, m_langOpts);
+      cache.insert(cache.getKey("IsFinalRequest", bufferId, 42), 1);
+      cache.insert(cache.getKey("SelfAccessKindRequest", bufferId, 42), 3);
+      ASSERT_FALSE(cache.save(m_cachePath));
+   }
+
+   LangOptions m_langOpts;
+   std::string m_cachePath;
+   std::vector<std::string> m_paths;
+};
+
+} // anonymous namespace
+
+TEST_F(PersistentRequestCacheTest, testRoundTrip)
+{
+   std::string path = createPath("source", "php");
+   saveResults(path, "<?php\nfinal class A {}\n");
+   SourceManager sourceMgr;
+   unsigned bufferId = addSource(sourceMgr, path, "<?php\nfinal class A {}\n");
+   PersistentRequestCache cache(sourceMgr, m_langOpts);
+   ASSERT_TRUE(cache.load(m_cachePath));
+   ASSERT_EQ(cache.getNumResults(), 2u);
+   ASSERT_EQ(cache.lookUp(cache.getKey("IsFinalRequest", bufferId, 42)), llvm::Optional<uint64_t>(1));
+   ASSERT_EQ(cache.lookUp(cache.getKey("SelfAccessKindRequest", bufferId, 42)), llvm::Optional<uint64_t>(3));
+   ASSERT_FALSE(cache.lookUp(cache.getKey("IsFinalRequest", bufferId, 43)));
+   ASSERT_FALSE(cache.lookUp(cache.getKey("IsStaticRequest", bufferId, 42)));
+}
+
+TEST_F(PersistentRequestCacheTest, testMissingFileIsIgnored)
+{
+   llvm::sys::fs::remove(m_cachePath);
+   SourceManager sourceMgr;
+   PersistentRequestCache cache(sourceMgr, m_langOpts);
+   ASSERT_FALSE(cache.load(m_cachePath));
+   ASSERT_EQ(cache.getNumResults(), 0u);
+}
+
+TEST_F(PersistentRequestCacheTest, testTruncatedFileIsIgnored)
+{
+   saveResults(createPath("source", "php"), "<?php\nfinal class A {}\n");
+   auto buffer = llvm::MemoryBuffer::getFile(m_cachePath);
+   ASSERT_TRUE(bool(buffer));
+   std::string contents = buffer.get()->getBuffer().str();
+   // cut in the header, in the path of the file and in the last result
+   for (size_t size : {size_t(2), size_t(30), contents.size() - 1}) {
+      writeFile(m_cachePath, StringRef(contents).take_front(size));
+      SourceManager sourceMgr;
+      PersistentRequestCache cache(sourceMgr, m_langOpts);
+      ASSERT_FALSE(cache.load(m_cachePath));
+      ASSERT_EQ(cache.getNumResults(), 0u);
+   }
+   // trailing bytes are damage too
+   writeFile(m_cachePath, contents + "x");
+   SourceManager sourceMgr;
+   PersistentRequestCache cache(sourceMgr, m_langOpts);
+   ASSERT_FALSE(cache.load(m_cachePath));
+   ASSERT_EQ(cache.getNumResults(), 0u);
+}
+
+TEST_F(PersistentRequestCacheTest, testFingerprintMismatchIsIgnored)
+{
+   saveResults(createPath("source", "php"), "<?php\nfinal class A {}\n");
+   LangOptions otherLangOpts;
+   otherLangOpts.EffectiveLanguageVersion = polar::version::Version{1};
+   SourceManager sourceMgr;
+   PersistentRequestCache cache(sourceMgr, otherLangOpts);
+   ASSERT_FALSE(cache.load(m_cachePath));
+   ASSERT_EQ(cache.getNumResults(), 0u);
+   PersistentRequestCache sameCache(sourceMgr, m_langOpts);
+   ASSERT_TRUE(sameCache.load(m_cachePath));
+}
+
+TEST_F(PersistentRequestCacheTest, testChangedFileDropsItsResults)
+{
+   std::string changedPath = createPath("changed", "php");
+   std::string samePath = createPath("same", "php");
+   saveResults(changedPath, "<?php\nfinal class A {}\n");
+   {
+      // one cache file with the results of both files
+      SourceManager sourceMgr;
+      unsigned changedId = addSource(sourceMgr, changedPath, "<?php\nfinal class A {}\n");
+      unsigned sameId = addSource(sourceMgr, samePath, "<?php\nclass B {}\n");
+      PersistentRequestCache cache(sourceMgr, m_langOpts);
+      ASSERT_TRUE(cache.load(m_cachePath));
+      ASSERT_TRUE(cache.lookUp(cache.getKey("IsFinalRequest", changedId, 42)));
+      cache.insert(cache.getKey("IsFinalRequest", sameId, 7), 0);
+      ASSERT_FALSE(cache.save(m_cachePath));
+   }
+   SourceManager sourceMgr;
+   // same size, other contents
+   unsigned changedId = addSource(sourceMgr, changedPath, "<?php\nfinal class Z {}\n");
+   unsigned sameId = addSource(sourceMgr, samePath, "<?php\nclass B {}\n");
+   PersistentRequestCache cache(sourceMgr, m_langOpts);
+   ASSERT_TRUE(cache.load(m_cachePath));
+   ASSERT_EQ(cache.getNumResults(), 3u);
+   ASSERT_FALSE(cache.lookUp(cache.getKey("IsFinalRequest", changedId, 42)));
+   ASSERT_EQ(cache.getNumResults(), 1u);
+   ASSERT_EQ(cache.lookUp(cache.getKey("IsFinalRequest", sameId, 7)), llvm::Optional<uint64_t>(0));
+}
+
+TEST_F(PersistentRequestCacheTest, testRemovedFileIsNotSaved)
+{
+   std::string path = createPath("source", "php");
+   saveResults(path, "<?php\nfinal class A {}\n");
+   SourceManager sourceMgr;
+   PersistentRequestCache cache(sourceMgr, m_langOpts);
+   ASSERT_TRUE(cache.load(m_cachePath));
+   llvm::sys::fs::remove(path);
+   ASSERT_FALSE(cache.save(m_cachePath));
+   PersistentRequestCache savedCache(sourceMgr, m_langOpts);
+   ASSERT_TRUE(savedCache.load(m_cachePath));
+   ASSERT_EQ(savedCache.getNumResults(), 0u);
+}
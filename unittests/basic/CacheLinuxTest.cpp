@@ -0,0 +1,175 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/basic/Cache.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+using polar::sys::CacheImpl;
+using polar::sys::CacheStatistics;
+
+namespace {
+
+/// What the cache did with the keys and values handed to it.
+struct CallBackLog
+{
+   std::map<void *, unsigned> retains;
+   std::map<void *, unsigned> releases;
+   unsigned numDestroyedKeys = 0;
+};
+
+/// The keys are the addresses of integers, equal integers are equal keys.
+uintptr_t key_hash(void *key, void *)
+{
+   return *static_cast<uintptr_t *>(key);
+}
+
+bool key_is_equal(void *lhs, void *rhs, void *)
+{
+   return *static_cast<uintptr_t *>(lhs) == *static_cast<uintptr_t *>(rhs);
+}
+
+void key_destroy(void *, void *userData)
+{
+   ++static_cast<CallBackLog *>(userData)->numDestroyedKeys;
+}
+
+void value_retain(void *value, void *userData)
+{
+   ++static_cast<CallBackLog *>(userData)->retains[value];
+}
+
+void value_release(void *value, void *userData)
+{
+   ++static_cast<CallBackLog *>(userData)->releases[value];
+}
+
+/// Uses the cache without the Cache template, which releases every value
+/// right away, so a test can keep values retained.
+class TestCache : public CacheImpl
+{
+public:
+   explicit TestCache(CallBackLog &log)
+   {
+      CallBacks callbacks = {
+         &log,
+         key_hash,
+         key_is_equal,
+         key_destroy,
+         value_retain,
+         value_release,
+      };
+      impl = create("test", callbacks);
+   }
+
+   ~TestCache()
+   {
+      destroy();
+   }
+
+   using CacheImpl::setAndRetain;
+   using CacheImpl::getAndRetain;
+   using CacheImpl::releaseValue;
+   using CacheImpl::remove;
+   using CacheImpl::setCostLimit;
+   using CacheImpl::getStatistics;
+};
+
+} // anonymous namespace
+
+TEST(CacheLinuxTest, testEvictionUnderCostLimit)
+{
+   constexpr unsigned numEntries = 1000;
+   constexpr size_t cost = 4;
+   constexpr size_t costLimit = 16 * 10;
+   CallBackLog log;
+   std::vector<uintptr_t> keys(numEntries);
+   std::vector<int> values(numEntries);
+   {
+      TestCache cache(log);
+      cache.setCostLimit(costLimit);
+      for (unsigned i = 0; i < numEntries; ++i) {
+         keys[i] = i;
+         cache.setAndRetain(&keys[i], &values[i], cost);
+         cache.releaseValue(&values[i]);
+         ASSERT_LE(cache.getStatistics().totalCost, costLimit);
+      }
+      CacheStatistics stats = cache.getStatistics();
+      ASSERT_GT(stats.evictions, 0u);
+      ASSERT_EQ(stats.entries + stats.evictions, numEntries);
+      ASSERT_EQ(stats.totalCost, stats.entries * cost);
+      // the evicted values were released once, the others not yet
+      ASSERT_EQ(log.releases.size(), stats.evictions);
+      ASSERT_EQ(log.numDestroyedKeys, stats.evictions);
+      // the entry set last is the most recently used one of its segment
+      uintptr_t lastKey = numEntries - 1;
+      void *value = nullptr;
+      ASSERT_TRUE(cache.getAndRetain(&lastKey, &value));
+      ASSERT_EQ(value, &values.back());
+      cache.releaseValue(value);
+      // lowering the limit evicts right away
+      cache.setCostLimit(0);
+      ASSERT_LE(cache.getStatistics().entries, 16u);
+   }
+   for (int &value : values) {
+      ASSERT_EQ(log.retains[&value], 1u);
+      ASSERT_EQ(log.releases[&value], 1u);
+   }
+   ASSERT_EQ(log.numDestroyedKeys, numEntries);
+}
+
+TEST(CacheLinuxTest, testPinnedValueIsReleasedByItsLastUser)
+{
+   CallBackLog log;
+   uintptr_t key = 1;
+   int value = 0;
+   TestCache cache(log);
+   // the setter keeps the value retained
+   cache.setAndRetain(&key, &value, 1);
+   void *found = nullptr;
+   ASSERT_TRUE(cache.getAndRetain(&key, &found));
+   ASSERT_EQ(found, &value);
+   ASSERT_TRUE(cache.remove(&key));
+   ASSERT_EQ(log.numDestroyedKeys, 1u);
+   ASSERT_FALSE(cache.getAndRetain(&key, &found));
+   // the entry is gone but two users still hold the value
+   ASSERT_EQ(log.releases[&value], 0u);
+   cache.releaseValue(&value);
+   ASSERT_EQ(log.releases[&value], 0u);
+   cache.releaseValue(&value);
+   ASSERT_EQ(log.releases[&value], 1u);
+}
+
+TEST(CacheLinuxTest, testReplacedPinnedValueIsReleasedByItsLastUser)
+{
+   CallBackLog log;
+   uintptr_t key = 1;
+   uintptr_t sameKey = 1;
+   int first = 0;
+   int second = 0;
+   TestCache cache(log);
+   cache.setAndRetain(&key, &first, 1);
+   // replacing the entry destroys the old key right away
+   cache.setAndRetain(&sameKey, &second, 1);
+   cache.releaseValue(&second);
+   ASSERT_EQ(log.numDestroyedKeys, 1u);
+   ASSERT_EQ(log.releases[&first], 0u);
+   void *found = nullptr;
+   ASSERT_TRUE(cache.getAndRetain(&key, &found));
+   ASSERT_EQ(found, &second);
+   cache.releaseValue(found);
+   cache.releaseValue(&first);
+   ASSERT_EQ(log.releases[&first], 1u);
+   ASSERT_EQ(log.releases[&second], 0u);
+}
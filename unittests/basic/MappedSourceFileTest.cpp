@@ -0,0 +1,93 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/basic/SourceMgr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using polar::SourceLoc;
+using polar::SourceManager;
+using llvm::SmallString;
+using llvm::StringRef;
+
+namespace {
+
+class MappedSourceFileTest : public ::testing::Test
+{
+protected:
+   void TearDown() override
+   {
+      for (const std::string &path : m_paths) {
+         llvm::sys::fs::remove(path);
+      }
+   }
+
+   std::string writeSource(StringRef source)
+   {
+      SmallString<128> path;
+      int fd;
+      EXPECT_FALSE(llvm::sys::fs::createTemporaryFile("mapped", "php", fd, path));
+      llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+      out << source;
+      m_paths.push_back(path.str().str());
+      return m_paths.back();
+   }
+
+   SourceManager m_sourceMgr;
+   std::vector<std::string> m_paths;
+};
+
+} // anonymous namespace
+
+TEST_F(MappedSourceFileTest, testMissingFile)
+{
+   ASSERT_FALSE(m_sourceMgr.addMappedSourceFile("/nonexistent/polarphp/source.php"));
+}
+
+TEST_F(MappedSourceFileTest, testResidentFilesAreBounded)
+{
+   m_sourceMgr.setMaxResidentMappedFiles(2);
+   std::vector<unsigned> bufferIds;
+   for (unsigned i = 0; i < 5; ++i) {
+      llvm::ErrorOr<unsigned> bufferId = m_sourceMgr.addMappedSourceFile(
+               writeSource("$a" + std::to_string(i) + " = " + std::to_string(i) + ";\n"));
+      ASSERT_TRUE(bool(bufferId));
+      bufferIds.push_back(bufferId.get());
+      ASSERT_LE(m_sourceMgr.getNumResidentMappedFiles(), 2u);
+   }
+   ASSERT_EQ(m_sourceMgr.getEntireTextForBuffer(bufferIds.front()), "$a0 = 0;\n");
+   ASSERT_EQ(m_sourceMgr.getNumResidentMappedFiles(), 2u);
+}
+
+TEST_F(MappedSourceFileTest, testLocationsResolveAfterEviction)
+{
+   m_sourceMgr.setMaxResidentMappedFiles(1);
+   unsigned firstId = m_sourceMgr.addMappedSourceFile(writeSource("\n$first = 1;\n")).get();
+   SourceLoc loc = m_sourceMgr.getLocForOffset(firstId, 1);
+   // the first file is unmapped when the second one is read
+   unsigned secondId = m_sourceMgr.addMappedSourceFile(writeSource("$second = 2;\n")).get();
+   ASSERT_EQ(m_sourceMgr.getEntireTextForBuffer(secondId), "$second = 2;\n");
+   ASSERT_EQ(m_sourceMgr.findBufferContainingLoc(loc), firstId);
+   ASSERT_EQ(m_sourceMgr.getLineAndColumn(loc), std::make_pair(2u, 1u));
+   ASSERT_EQ(m_sourceMgr.extractText({loc, 6}), "$first");
+}
+
+TEST_F(MappedSourceFileTest, testEmptyFile)
+{
+   unsigned bufferId = m_sourceMgr.addMappedSourceFile(writeSource("")).get();
+   ASSERT_EQ(m_sourceMgr.getEntireTextForBuffer(bufferId), "");
+   ASSERT_EQ(m_sourceMgr.getRangeForBuffer(bufferId).getByteLength(), 0u);
+}
@@ -0,0 +1,82 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/basic/SourceMgr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using polar::SourceLoc;
+using polar::SourceManager;
+using llvm::MemoryBuffer;
+using llvm::StringRef;
+
+TEST(SourceManagerBufferLookupTest, testManyBuffers)
+{
+   SourceManager sourceMgr;
+   std::vector<unsigned> bufferIds;
+   for (unsigned i = 0; i < 1000; ++i) {
+      bufferIds.push_back(sourceMgr.addMemBufferCopy("$a" + std::to_string(i) + ";\n"));
+   }
+   for (unsigned bufferId : bufferIds) {
+      SourceLoc start = sourceMgr.getLocForBufferStart(bufferId);
+      ASSERT_EQ(sourceMgr.findBufferContainingLoc(start), bufferId);
+      ASSERT_EQ(sourceMgr.findBufferContainingLoc(start.getAdvancedLoc(2)), bufferId);
+      // the null at the end is part of the buffer
+      SourceLoc end = sourceMgr.getRangeForBuffer(bufferId).getEnd();
+      ASSERT_EQ(sourceMgr.findBufferContainingLoc(end), bufferId);
+   }
+}
+
+TEST(SourceManagerBufferLookupTest, testLaterAliasBufferWins)
+{
+   SourceManager sourceMgr;
+   std::string text = "$first;\n$second;\n";
+   unsigned wholeId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(text, "whole", /*RequiresNullTerminator=*/false));
+   unsigned aliasId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(text, "alias", /*RequiresNullTerminator=*/false));
+   SourceLoc loc = sourceMgr.getLocForOffset(wholeId, 3);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(loc), aliasId);
+}
+
+TEST(SourceManagerBufferLookupTest, testSharedBoundary)
+{
+   SourceManager sourceMgr;
+   std::string text = "$first;\n$second;\n";
+   StringRef data(text);
+   unsigned secondId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(data.substr(8), "second", /*RequiresNullTerminator=*/false));
+   unsigned firstId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(data.substr(0, 8), "first", /*RequiresNullTerminator=*/false));
+   SourceLoc boundary = sourceMgr.getLocForBufferStart(secondId);
+   // like the back-to-front scan the later buffer wins at the boundary
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(boundary), firstId);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(boundary.getAdvancedLoc(1)), secondId);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(sourceMgr.getLocForBufferStart(firstId)), firstId);
+}
+
+TEST(SourceManagerBufferLookupTest, testNestedBuffer)
+{
+   SourceManager sourceMgr;
+   std::string text = "$first;\n$second;\n";
+   StringRef data(text);
+   unsigned wholeId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(data, "whole", /*RequiresNullTerminator=*/false));
+   unsigned innerId = sourceMgr.addNewSourceBuffer(
+            MemoryBuffer::getMemBuffer(data.substr(8, 4), "inner", /*RequiresNullTerminator=*/false));
+   SourceLoc start = sourceMgr.getLocForBufferStart(wholeId);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(start), wholeId);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(start.getAdvancedLoc(9)), innerId);
+   ASSERT_EQ(sourceMgr.findBufferContainingLoc(start.getAdvancedLoc(14)), wholeId);
+}
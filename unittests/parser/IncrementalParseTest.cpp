@@ -0,0 +1,137 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "polarphp/parser/Parser.h"
+#include "polarphp/parser/SyntaxParsingCache.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+
+using polar::LangOptions;
+using polar::SourceManager;
+using polar::parser::Parser;
+using polar::parser::SourceEdit;
+using polar::parser::SyntaxParsingCache;
+using polar::parser::SyntaxReuseStats;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::Syntax;
+using llvm::StringRef;
+
+namespace {
+
+/// the texts of the tokens of \p node separated by spaces
+std::string join_token_texts(const RawSyntax *node)
+{
+   if (node->isToken()) {
+      return node->getTokenText().str();
+   }
+   std::string text;
+   for (const RefCountPtr<RawSyntax> &child : node->getLayout()) {
+      if (!child) {
+         continue;
+      }
+      if (!text.empty()) {
+         text += ' ';
+      }
+      text += join_token_texts(child.get());
+   }
+   return text;
+}
+
+class IncrementalParseTest : public ::testing::Test
+{
+protected:
+   RefCountPtr<RawSyntax> parseSource(StringRef source)
+   {
+      unsigned bufferId = m_sourceMgr.addMemBufferCopy(source);
+      Parser parser(m_langOpts, bufferId, m_sourceMgr, nullptr);
+      EXPECT_FALSE(parser.parse());
+      return parser.getSyntaxTree();
+   }
+
+   /// parse \p oldSource, then \p newSource, which differs from it by
+   /// \p edit, on top of it
+   RefCountPtr<RawSyntax> parseIncrementally(StringRef oldSource, StringRef newSource,
+                                             SourceEdit edit)
+   {
+      unsigned oldBufferId = m_sourceMgr.addMemBufferCopy(oldSource);
+      Parser oldParser(m_langOpts, oldBufferId, m_sourceMgr, nullptr);
+      oldParser.setRecordingStmtRanges(true);
+      EXPECT_FALSE(oldParser.parse());
+      m_oldTree = oldParser.getSyntaxTree();
+      m_cache = std::make_unique<SyntaxParsingCache>(polar::syntax::make<Syntax>(m_oldTree));
+      m_cache->setOldStmtRanges(oldParser.getStmtRanges(),
+                                m_sourceMgr.extractText(m_sourceMgr.getRangeForBuffer(oldBufferId)));
+      m_cache->addEdit(edit.start, edit.end, edit.replacementLength);
+      unsigned bufferId = m_sourceMgr.addMemBufferCopy(newSource);
+      Parser parser(m_langOpts, bufferId, m_sourceMgr, nullptr);
+      parser.setSyntaxParsingCache(m_cache.get());
+      EXPECT_FALSE(parser.parse());
+      return parser.getSyntaxTree();
+   }
+
+   LangOptions m_langOpts;
+   SourceManager m_sourceMgr;
+   RefCountPtr<RawSyntax> m_oldTree;
+   std::unique_ptr<SyntaxParsingCache> m_cache;
+};
+
+} // anonymous namespace
+
+TEST_F(IncrementalParseTest, testUneditedTopStatementsAreReused)
+{
+   StringRef oldSource = "<?php\n$a = 1;\n$b = 2;\n\n   $c = 3;\n$d = 4;\n";
+   StringRef newSource = "<?php\n$a = 1;\n$b = 2;\n\n   $c = 30;\n$d = 4;\n";
+   size_t editStart = oldSource.find("3;") + 1;
+   RefCountPtr<RawSyntax> tree = parseIncrementally(oldSource, newSource,
+                                                    SourceEdit(editStart, editStart, 1));
+   SyntaxReuseStats stats = m_cache->getReuseStats();
+   // the first statement starts before the open tag is lexed, the edited
+   // one is parsed again
+   ASSERT_EQ(stats.numReusedNodes, 2u);
+   ASSERT_EQ(stats.sourceLength, newSource.size());
+   ASSERT_EQ(stats.numReusedBytes, StringRef("\n$b = 2;").size() + StringRef("\n$d = 4;").size());
+   ASSERT_EQ(tree->getNumChildren(), 4u);
+   ASSERT_EQ(tree->getChild(1)->getId(), m_oldTree->getChild(1)->getId());
+   ASSERT_NE(tree->getChild(2)->getId(), m_oldTree->getChild(2)->getId());
+   ASSERT_EQ(tree->getChild(3)->getId(), m_oldTree->getChild(3)->getId());
+   ASSERT_EQ(join_token_texts(tree.get()), join_token_texts(parseSource(newSource).get()));
+}
+
+TEST_F(IncrementalParseTest, testUneditedInnerStatementsAreReused)
+{
+   StringRef oldSource = "<?php\n{\n   $a = 1;\n   $b = 2;\n   $c = 3;\n}\n";
+   StringRef newSource = "<?php\n{\n   $a = 1;\n   $b = 20;\n   $c = 3;\n}\n";
+   size_t editStart = oldSource.find("2;") + 1;
+   RefCountPtr<RawSyntax> tree = parseIncrementally(oldSource, newSource,
+                                                    SourceEdit(editStart, editStart, 1));
+   ASSERT_EQ(m_cache->getReuseStats().numReusedNodes, 2u);
+   ASSERT_EQ(join_token_texts(tree.get()), join_token_texts(parseSource(newSource).get()));
+}
+
+TEST_F(IncrementalParseTest, testStatementBeforeEditedNextTokenIsParsedAgain)
+{
+   // "$c" is the token following the second statement, renaming it may
+   // change how the statement before it parses
+   StringRef oldSource = "<?php\n$a = 1;\n$b = 2;\n$c = 3;\n$d = 4;\n";
+   StringRef newSource = "<?php\n$a = 1;\n$b = 2;\n$cc = 3;\n$d = 4;\n";
+   size_t editStart = oldSource.find("$c") + 2;
+   RefCountPtr<RawSyntax> tree = parseIncrementally(oldSource, newSource,
+                                                    SourceEdit(editStart, editStart, 1));
+   ASSERT_EQ(m_cache->getReuseStats().numReusedNodes, 1u);
+   ASSERT_NE(tree->getChild(1)->getId(), m_oldTree->getChild(1)->getId());
+   ASSERT_EQ(tree->getChild(3)->getId(), m_oldTree->getChild(3)->getId());
+}
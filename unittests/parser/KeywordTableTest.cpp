@@ -0,0 +1,52 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/05.
+
+#include "polarphp/parser/internal/KeywordTable.h"
+#include "gtest/gtest.h"
+
+using polar::parser::internal::lookup_cast_type;
+using polar::parser::internal::lookup_keyword;
+using polar::syntax::internal::TokenKindType;
+
+TEST(KeywordTableTest, testLookupKeyword)
+{
+   ASSERT_EQ(lookup_keyword("function"), TokenKindType::T_FUNCTION);
+   ASSERT_EQ(lookup_keyword("die"), TokenKindType::T_EXIT);
+   ASSERT_EQ(lookup_keyword("__halt_compiler"), TokenKindType::T_HALT_COMPILER);
+   ASSERT_EQ(lookup_keyword("this"), TokenKindType::T_OBJ_REF);
+   /// keywords are case insensitive
+   ASSERT_EQ(lookup_keyword("FUNCTION"), TokenKindType::T_FUNCTION);
+   ASSERT_EQ(lookup_keyword("Return"), TokenKindType::T_RETURN);
+   ASSERT_EQ(lookup_keyword("__CLASS__"), TokenKindType::T_CLASS_CONST);
+   ASSERT_EQ(lookup_keyword("Or"), TokenKindType::T_LOGICAL_OR);
+   ASSERT_EQ(lookup_keyword("xor"), TokenKindType::T_LOGICAL_XOR);
+
+   ASSERT_EQ(lookup_keyword("functions"), TokenKindType::T_IDENTIFIER_STRING);
+   ASSERT_EQ(lookup_keyword("fun"), TokenKindType::T_IDENTIFIER_STRING);
+   ASSERT_EQ(lookup_keyword("__class"), TokenKindType::T_IDENTIFIER_STRING);
+   ASSERT_EQ(lookup_keyword("_"), TokenKindType::T_IDENTIFIER_STRING);
+   ASSERT_EQ(lookup_keyword("int"), TokenKindType::T_IDENTIFIER_STRING);
+   /// '_' and DEL fold to the same hash input, the comparison tells them apart
+   ASSERT_EQ(lookup_keyword("\x7f\x7f" "class" "\x7f\x7f"), TokenKindType::T_IDENTIFIER_STRING);
+   ASSERT_EQ(lookup_keyword("an_identifier_longer_than_any_keyword"), TokenKindType::T_IDENTIFIER_STRING);
+}
+
+TEST(KeywordTableTest, testLookupCastType)
+{
+   ASSERT_EQ(lookup_cast_type("int"), TokenKindType::T_INT_CAST);
+   ASSERT_EQ(lookup_cast_type("Integer"), TokenKindType::T_INT_CAST);
+   ASSERT_EQ(lookup_cast_type("float"), TokenKindType::T_DOUBLE_CAST);
+   ASSERT_EQ(lookup_cast_type("binary"), TokenKindType::T_STRING_CAST);
+   ASSERT_EQ(lookup_cast_type("BOOLEAN"), TokenKindType::T_BOOL_CAST);
+   ASSERT_EQ(lookup_cast_type("unset"), TokenKindType::T_UNSET_CAST);
+   ASSERT_EQ(lookup_cast_type("real"), TokenKindType::T_UNKNOWN_MARK);
+   ASSERT_EQ(lookup_cast_type("function"), TokenKindType::T_UNKNOWN_MARK);
+}
@@ -143,6 +143,42 @@ TEST_F(LexerTest, testSimpleToken)
    checkLex(source, expectedTokens, /*KeepComments=*/false);
 }
 
+TEST_F(LexerTest, testTriviaFreeModeSkipsSameTrivia)
+{
+   /// whitespace runs longer than one scanner block, nested and unterminated
+   /// comments, CRLF and an embedded nul must leave the same tokens behind
+   /// whether trivia is collected or skipped
+   std::string longIndent(70, ' ');
+   std::string longComment(100, 'x');
+   std::vector<std::string> sources{
+      "+ -\t*\v/\f%",
+      longIndent + "+\n" + longIndent + "\t-\r\n*",
+      "+ // line comment " + longComment + "\r\n-// last line",
+      "+ /* block " + longComment + " */ - /* multi\nline */ *",
+      "+ /* outer /* inner " + longComment + " */ still comment */ -",
+      "+ /** doc */\n/// doc line\n-",
+      std::string("+ \0 -", 5),
+      "+ /* unterminated " + longComment,
+   };
+   for (const std::string &source : sources) {
+      unsigned bufferId = sourceMgr.addMemBufferCopy(source);
+      Lexer triviaLexer(langOpts, sourceMgr, bufferId, nullptr,
+                        CommentRetentionMode::None, TriviaRetentionMode::WithTrivia);
+      Lexer triviaFreeLexer(langOpts, sourceMgr, bufferId, nullptr);
+      ASSERT_TRUE(triviaFreeLexer.isTriviaFree());
+      Token expected;
+      Token actual;
+      do {
+         triviaLexer.lex(expected);
+         triviaFreeLexer.lex(actual);
+         ASSERT_EQ(expected.getKind(), actual.getKind()) << "source = " << source;
+         ASSERT_EQ(expected.getLoc(), actual.getLoc()) << "source = " << source;
+         ASSERT_EQ(expected.getLexicalLength(), actual.getLexicalLength()) << "source = " << source;
+         ASSERT_EQ(expected.isAtStartOfLine(), actual.isAtStartOfLine()) << "source = " << source;
+      } while (expected.isNot(TokenKindType::END));
+   }
+}
+
 TEST_F(LexerTest, testSimpleKeyword)
 {
    const char *source =
@@ -339,6 +375,56 @@ TEST_F(LexerTest, testLexLabelString)
    }
 }
 
+TEST_F(LexerTest, testStringValuesReferenceSourceBuffer)
+{
+   const char *source = "$name foo 'plain text' 'it\\'s'";
+   std::vector<TokenKindType> expectedTokens{
+      TokenKindType::T_VARIABLE, TokenKindType::T_IDENTIFIER_STRING,
+            TokenKindType::T_CONSTANT_ENCAPSED_STRING, TokenKindType::T_CONSTANT_ENCAPSED_STRING
+   };
+   std::vector<Token> tokens = checkLex(source, expectedTokens, /*KeepComments=*/false);
+   /// identifiers, variables and strings without escapes are not copied
+   for (size_t i = 0; i < 3; ++i) {
+      const Token &token = tokens.at(i);
+      ASSERT_EQ(token.getValueType(), Token::ValueType::String);
+      ASSERT_FALSE(token.isStringValueOwned()) << "i = " << i;
+      StringRef text = token.getLexicalText();
+      StringRef value = token.getStringValue();
+      ASSERT_TRUE(value.begin() >= text.begin() && value.end() <= text.end()) << "i = " << i;
+   }
+   ASSERT_EQ(tokens.at(0).getStringValue(), "name");
+   ASSERT_EQ(tokens.at(1).getStringValue(), "foo");
+   ASSERT_EQ(tokens.at(2).getStringValue(), "plain text");
+   /// escape processing changes the bytes, so the value is owned
+   ASSERT_TRUE(tokens.at(3).isStringValueOwned());
+   ASSERT_EQ(tokens.at(3).getValue<std::string>(), "it's");
+}
+
+TEST_F(LexerTest, testDoubleQuoteStringEscapesDecodedOnDemand)
+{
+   const char *source = R"("plain text" "tab\tand \u{1F418} \x41\101\q")";
+   std::vector<TokenKindType> expectedTokens{
+      TokenKindType::T_DOUBLE_QUOTE, TokenKindType::T_CONSTANT_ENCAPSED_STRING, TokenKindType::T_DOUBLE_QUOTE,
+            TokenKindType::T_DOUBLE_QUOTE, TokenKindType::T_CONSTANT_ENCAPSED_STRING, TokenKindType::T_DOUBLE_QUOTE
+   };
+   std::vector<Token> tokens = checkLex(source, expectedTokens, /*KeepComments=*/false);
+   const Token &plain = tokens.at(1);
+   ASSERT_FALSE(plain.hasEscapes());
+   ASSERT_FALSE(plain.isStringValueOwned());
+   ASSERT_EQ(plain.getStringValue().begin(), plain.getLexicalText().begin());
+   ASSERT_EQ(plain.getStringValue(), "plain text");
+
+   /// the escapes are decoded when the value is read, not by the lexer
+   const Token &escaped = tokens.at(4);
+   std::string expected = "tab\tand \xF0\x9F\x90\x98 AA\\q";
+   ASSERT_TRUE(escaped.hasEscapes());
+   ASSERT_FALSE(escaped.isStringValueOwned());
+   ASSERT_EQ(escaped.getValue<std::string>(), expected);
+   ASSERT_FALSE(escaped.isStringValueOwned());
+   ASSERT_EQ(escaped.getStringValue(), expected);
+   ASSERT_TRUE(escaped.isStringValueOwned());
+}
+
 TEST_F(LexerTest, testLexLNumber)
 {
    {
@@ -1486,3 +1572,32 @@ TEST_F(LexerTest, testLexHereDoc)
       ASSERT_EQ(token5.getValue<std::string>(), "");
    }
 }
+
+TEST_F(LexerTest, testHereDocValuesReferenceSourceBuffer)
+{
+   const char *source =
+         "<<<'EOT'\n    line one\n      line two\n    EOT;\n"
+         "<<<EOT\n    plain\n     text\n    EOT;\n"
+         "<<<EOT\n    tab\\tbed\n    EOT;\n";
+   std::vector<TokenKindType> expectedTokens;
+   for (int i = 0; i < 3; ++i) {
+      expectedTokens.insert(expectedTokens.end(), {
+                               TokenKindType::T_START_HEREDOC, TokenKindType::T_ENCAPSED_AND_WHITESPACE,
+                               TokenKindType::T_END_HEREDOC, TokenKindType::T_SEMICOLON
+                            });
+   }
+   std::vector<Token> tokens = checkLex(source, expectedTokens, /*KeepComments=*/false);
+   ASSERT_TRUE(m_exceptionMsgs.empty());
+   /// the indentation is removed when the value is read, not while lexing
+   ASSERT_FALSE(tokens.at(1).isStringValueOwned());
+   ASSERT_EQ(tokens.at(1).getValue<std::string>(), "line one\n  line two");
+   Token &heredoc = tokens.at(5);
+   ASSERT_FALSE(heredoc.isStringValueOwned());
+   ASSERT_EQ(heredoc.getValue<std::string>(), "plain\n text");
+   ASSERT_FALSE(heredoc.isStringValueOwned());
+   ASSERT_EQ(heredoc.getStringValue(), "plain\n text");
+   ASSERT_TRUE(heredoc.isStringValueOwned());
+   /// escape sequences need a copy
+   ASSERT_TRUE(tokens.at(9).isStringValueOwned());
+   ASSERT_EQ(tokens.at(9).getValue<std::string>(), "tab\tbed");
+}
@@ -0,0 +1,185 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/basic/SourceMgr.h"
+#include "polarphp/parser/Parser.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using polar::LangOptions;
+using polar::SourceManager;
+using polar::parser::Parser;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxKind;
+using llvm::StringRef;
+
+namespace {
+
+/// the texts of the tokens of \p node separated by spaces
+std::string join_token_texts(const RawSyntax *node)
+{
+   if (node->isToken()) {
+      return node->getTokenText().str();
+   }
+   std::string text;
+   for (const RefCountPtr<RawSyntax> &child : node->getLayout()) {
+      if (!child) {
+         continue;
+      }
+      if (!text.empty()) {
+         text += ' ';
+      }
+      text += join_token_texts(child.get());
+   }
+   return text;
+}
+
+/// the first node of kind \p kind in \p node, searched depth first
+const RawSyntax *find_first_of_kind(const RawSyntax *node, SyntaxKind kind)
+{
+   if (node->getKind() == kind) {
+      return node;
+   }
+   for (const RefCountPtr<RawSyntax> &child : node->getLayout()) {
+      if (!child) {
+         continue;
+      }
+      if (const RawSyntax *found = find_first_of_kind(child.get(), kind)) {
+         return found;
+      }
+   }
+   return nullptr;
+}
+
+class ParserErrorRecoveryTest : public ::testing::Test
+{
+protected:
+   RefCountPtr<RawSyntax> parseSource(StringRef source, bool recover, size_t &errorCount)
+   {
+      unsigned bufferId = m_sourceMgr.addMemBufferCopy(source);
+      Parser parser(m_langOpts, bufferId, m_sourceMgr, nullptr);
+      parser.setErrorRecovery(recover);
+      m_failed = parser.parse();
+      errorCount = parser.getParseErrors().size();
+      return recover ? parser.getSyntaxTree() : nullptr;
+   }
+
+   LangOptions m_langOpts;
+   SourceManager m_sourceMgr;
+   bool m_failed = false;
+};
+
+} // anonymous namespace
+
+TEST_F(ParserErrorRecoveryTest, testStopAtFirstErrorByDefault)
+{
+   size_t errorCount = 0;
+   parseSource("$a = ;\n$b = ;\n", false, errorCount);
+   ASSERT_TRUE(m_failed);
+   ASSERT_EQ(errorCount, 1u);
+}
+
+TEST_F(ParserErrorRecoveryTest, testBrokenTopStatements)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("$a = 1;\n$b = ;\n$c = 2;\n$d = ) ) );\n$e = 3;\n",
+                                             true, errorCount);
+   ASSERT_TRUE(m_failed);
+   ASSERT_EQ(errorCount, 2u);
+   ASSERT_EQ(tree->getKind(), SyntaxKind::TopStmtList);
+   ASSERT_EQ(tree->getNumChildren(), 5u);
+   const RawSyntax *broken = tree->getChild(1)->getChild(0).get();
+   ASSERT_EQ(broken->getKind(), SyntaxKind::UnknownStmt);
+   ASSERT_EQ(join_token_texts(broken), "$b = ;");
+   // the tokens the grammar discards one by one end up in one region
+   broken = tree->getChild(3)->getChild(0).get();
+   ASSERT_EQ(broken->getKind(), SyntaxKind::UnknownStmt);
+   ASSERT_EQ(join_token_texts(broken), "$d = ) ) ) ;");
+   ASSERT_FALSE(tree->getChild(4)->getChild(0)->isUnknown());
+}
+
+TEST_F(ParserErrorRecoveryTest, testBrokenInnerStatement)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("function f()\n{\n   $a = 1\n}\n$b = 2;\n",
+                                             true, errorCount);
+   ASSERT_TRUE(m_failed);
+   ASSERT_EQ(errorCount, 1u);
+   ASSERT_EQ(tree->getNumChildren(), 2u);
+   ASSERT_FALSE(tree->getChild(0)->getChild(0)->isUnknown());
+   ASSERT_FALSE(tree->getChild(1)->getChild(0)->isUnknown());
+}
+
+TEST_F(ParserErrorRecoveryTest, testBrokenClassMember)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("class A\n{\n   public $a = ;\n   public $b = 1;\n}\n",
+                                             true, errorCount);
+   ASSERT_TRUE(m_failed);
+   ASSERT_EQ(errorCount, 1u);
+   ASSERT_EQ(tree->getNumChildren(), 1u);
+   ASSERT_FALSE(tree->getChild(0)->getChild(0)->isUnknown());
+   const RawSyntax *members = find_first_of_kind(tree.get(), SyntaxKind::MemberDeclList);
+   ASSERT_NE(members, nullptr);
+   ASSERT_EQ(members->getNumChildren(), 2u);
+   const RawSyntax *broken = members->getChild(0)->getChild(0).get();
+   ASSERT_EQ(broken->getKind(), SyntaxKind::UnknownDecl);
+   ASSERT_EQ(join_token_texts(broken), "public $a = ;");
+   const RawSyntax *member = members->getChild(1)->getChild(0).get();
+   ASSERT_EQ(member->getKind(), SyntaxKind::ClassPropertyDecl);
+   ASSERT_TRUE(StringRef(join_token_texts(members->getChild(1).get())).startswith("public $b = "));
+}
+
+TEST_F(ParserErrorRecoveryTest, testValidClassMembersAreKept)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("class A\n{\n   public $a = 1;\n   public $b = 2;\n}\n",
+                                             true, errorCount);
+   ASSERT_FALSE(m_failed);
+   ASSERT_EQ(errorCount, 0u);
+   const RawSyntax *members = find_first_of_kind(tree.get(), SyntaxKind::MemberDeclList);
+   ASSERT_NE(members, nullptr);
+   ASSERT_EQ(members->getNumChildren(), 2u);
+   for (unsigned i = 0; i < 2; ++i) {
+      const RawSyntax *member = members->getChild(i)->getChild(0).get();
+      ASSERT_EQ(member->getKind(), SyntaxKind::ClassPropertyDecl);
+   }
+   ASSERT_TRUE(StringRef(join_token_texts(members->getChild(0).get())).startswith("public $a = "));
+   ASSERT_TRUE(StringRef(join_token_texts(members->getChild(1).get())).startswith("public $b = "));
+}
+
+TEST_F(ParserErrorRecoveryTest, testUnexpectedEndOfFile)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("$a = 1;\nfunction f()\n{\n   $b = 2;\n",
+                                             true, errorCount);
+   ASSERT_TRUE(m_failed);
+   ASSERT_EQ(errorCount, 1u);
+   ASSERT_EQ(tree->getKind(), SyntaxKind::TopStmtList);
+   ASSERT_EQ(tree->getNumChildren(), 2u);
+   ASSERT_FALSE(tree->getChild(0)->getChild(0)->isUnknown());
+   const RawSyntax *broken = tree->getChild(1)->getChild(0).get();
+   ASSERT_EQ(broken->getKind(), SyntaxKind::UnknownStmt);
+   ASSERT_EQ(join_token_texts(broken), "function f ( ) { $b = 2 ;");
+}
+
+TEST_F(ParserErrorRecoveryTest, testValidSourceHasNoErrors)
+{
+   size_t errorCount = 0;
+   RefCountPtr<RawSyntax> tree = parseSource("$a = 1;\n$b = $a + 2;\n", true, errorCount);
+   ASSERT_FALSE(m_failed);
+   ASSERT_EQ(errorCount, 0u);
+   ASSERT_EQ(tree->getNumChildren(), 2u);
+}
@@ -0,0 +1,127 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/25.
+
+#include "polarphp/basic/LangOptions.h"
+#include "polarphp/parser/PersistentParseCache.h"
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/Trivia.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using polar::LangOptions;
+using polar::parser::PersistentParseCache;
+using polar::parser::PersistentParseCacheStats;
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxArena;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SourcePresence;
+using polar::syntax::SyntaxPrintOptions;
+using polar::syntax::Trivia;
+using llvm::SmallString;
+using llvm::StringRef;
+
+namespace {
+
+const StringRef sg_sourceText = "$a ;";
+
+/// Unknown [ $a, ; ], the tree of sg_sourceText
+RefCountPtr<RawSyntax> make_sample_tree()
+{
+   RefCountPtr<RawSyntax> variable = RawSyntax::make(TokenKindType::T_VARIABLE, "$a", {},
+                                                     Trivia::getSpaces(1).pieces, SourcePresence::Present);
+   RefCountPtr<RawSyntax> semicolon = RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {}, {},
+                                                      SourcePresence::Present);
+   return RawSyntax::make(SyntaxKind::Unknown, {variable, semicolon}, SourcePresence::Present);
+}
+
+std::string print_tree(const RefCountPtr<RawSyntax> &root)
+{
+   std::string text;
+   llvm::raw_string_ostream out(text);
+   root->print(out, SyntaxPrintOptions());
+   out.flush();
+   return text;
+}
+
+class PersistentParseCacheTest : public ::testing::Test
+{
+protected:
+   void SetUp() override
+   {
+      ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("polar-parse-cache", m_cacheDir));
+   }
+
+   void TearDown() override
+   {
+      llvm::sys::fs::remove_directories(m_cacheDir);
+   }
+
+   SmallString<128> m_cacheDir;
+   LangOptions m_langOpts;
+};
+
+} // anonymous namespace
+
+TEST_F(PersistentParseCacheTest, testStoreAndLookUp)
+{
+   PersistentParseCache cache(m_cacheDir, m_langOpts);
+   RefCountPtr<SyntaxArena> arena(new SyntaxArena);
+   ASSERT_FALSE(cache.lookUp(sg_sourceText, arena));
+   ASSERT_TRUE(cache.store(sg_sourceText, make_sample_tree(), std::chrono::milliseconds(2)));
+
+   // a fresh cache on the same directory sees the entry of the previous run
+   PersistentParseCache nextRun(m_cacheDir, m_langOpts);
+   RefCountPtr<RawSyntax> tree = nextRun.lookUp(sg_sourceText, arena);
+   ASSERT_TRUE(tree);
+   ASSERT_EQ(print_tree(tree), sg_sourceText.str());
+   ASSERT_EQ(tree->getArena(), arena);
+   RefCountPtr<RawSyntax> heapTree = nextRun.lookUp(sg_sourceText, nullptr);
+   ASSERT_TRUE(heapTree);
+   ASSERT_EQ(print_tree(heapTree), sg_sourceText.str());
+
+   PersistentParseCacheStats stats = cache.getStats();
+   ASSERT_EQ(stats.numHits, 0);
+   ASSERT_EQ(stats.numMisses, 1);
+   ASSERT_EQ(stats.numStores, 1);
+   stats = nextRun.getStats();
+   ASSERT_EQ(stats.numHits, 2);
+   ASSERT_EQ(stats.numMisses, 0);
+   ASSERT_DOUBLE_EQ(stats.getHitRate(), 1.0);
+   ASSERT_DOUBLE_EQ(stats.parseSecondsOfHits, 0.004);
+}
+
+TEST_F(PersistentParseCacheTest, testChangedSourceMisses)
+{
+   PersistentParseCache cache(m_cacheDir, m_langOpts);
+   ASSERT_TRUE(cache.store(sg_sourceText, make_sample_tree(), std::chrono::milliseconds(1)));
+   ASSERT_FALSE(cache.lookUp("$b ;", nullptr));
+   ASSERT_FALSE(cache.lookUp("$a  ;", nullptr));
+   ASSERT_EQ(cache.getStats().numMisses, 2);
+}
+
+TEST_F(PersistentParseCacheTest, testLangOptionsSeparateEntries)
+{
+   LangOptions otherLangOpts;
+   otherLangOpts.AttachCommentsToDecls = !m_langOpts.AttachCommentsToDecls;
+   ASSERT_NE(PersistentParseCache::computeFingerprint(m_langOpts),
+             PersistentParseCache::computeFingerprint(otherLangOpts));
+   PersistentParseCache cache(m_cacheDir, m_langOpts);
+   ASSERT_TRUE(cache.store(sg_sourceText, make_sample_tree(), std::chrono::milliseconds(1)));
+   PersistentParseCache otherCache(m_cacheDir, otherLangOpts);
+   ASSERT_NE(cache.getEntryDir(), otherCache.getEntryDir());
+   ASSERT_FALSE(otherCache.lookUp(sg_sourceText, nullptr));
+}
@@ -0,0 +1,113 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/21.
+
+#include "polarphp/parser/serialization/TokenBinarySerialization.h"
+#include "polarphp/parser/Token.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using polar::parser::Token;
+using polar::parser::TokenFlags;
+using polar::parser::TokenRecord;
+using polar::parser::TokenBinaryReader;
+using polar::parser::write_token_binary_header;
+using polar::parser::write_token_binary_record;
+using polar::syntax::TokenKindType;
+using llvm::StringRef;
+
+using ValueType = polar::parser::Token::ValueType;
+
+namespace {
+
+std::string write_tokens()
+{
+   std::string data;
+   llvm::raw_string_ostream out(data);
+   write_token_binary_header(out);
+   Token variable(TokenKindType::T_VARIABLE, "$name");
+   variable.setValueRef(StringRef("$name").drop_front());
+   write_token_binary_record(out, variable, 6);
+
+   Token lnumber(TokenKindType::T_LNUMBER, "42");
+   lnumber.setValue(42);
+   write_token_binary_record(out, lnumber, 14);
+
+   Token dnumber(TokenKindType::T_DNUMBER, "1.5");
+   dnumber.setValue(1.5);
+   write_token_binary_record(out, dnumber, 18);
+
+   Token semicolon(TokenKindType::T_SEMICOLON, ";");
+   semicolon.setAtStartOfLine(true);
+   write_token_binary_record(out, semicolon, 22);
+   out.flush();
+   return data;
+}
+
+TEST(TokenBinarySerializationTest, testRoundTrip)
+{
+   std::string data = write_tokens();
+   TokenBinaryReader reader(data);
+   ASSERT_TRUE(reader.isValid());
+   TokenRecord record;
+
+   ASSERT_TRUE(reader.next(record));
+   ASSERT_EQ(record.kind, TokenKindType::T_VARIABLE);
+   ASSERT_EQ(record.offset, 6u);
+   ASSERT_EQ(record.length, 5u);
+   ASSERT_EQ(record.valueType, ValueType::String);
+   ASSERT_EQ(record.stringValue, "name");
+
+   ASSERT_TRUE(reader.next(record));
+   ASSERT_EQ(record.kind, TokenKindType::T_LNUMBER);
+   ASSERT_EQ(record.offset, 14u);
+   ASSERT_EQ(record.length, 2u);
+   ASSERT_EQ(record.valueType, ValueType::LongLong);
+   ASSERT_EQ(record.intValue, 42);
+
+   ASSERT_TRUE(reader.next(record));
+   ASSERT_EQ(record.kind, TokenKindType::T_DNUMBER);
+   ASSERT_EQ(record.valueType, ValueType::Double);
+   ASSERT_EQ(record.doubleValue, 1.5);
+
+   ASSERT_TRUE(reader.next(record));
+   ASSERT_EQ(record.kind, TokenKindType::T_SEMICOLON);
+   ASSERT_EQ(record.offset, 22u);
+   ASSERT_EQ(record.length, 1u);
+   ASSERT_TRUE(record.flags.isAtStartOfLine());
+   ASSERT_EQ(record.valueType, ValueType::Unknown);
+   ASSERT_TRUE(record.stringValue.empty());
+
+   ASSERT_FALSE(reader.next(record));
+   ASSERT_FALSE(reader.hasError());
+}
+
+TEST(TokenBinarySerializationTest, testMalformedData)
+{
+   {
+      TokenBinaryReader reader(StringRef("JSON[]"));
+      ASSERT_FALSE(reader.isValid());
+      TokenRecord record;
+      ASSERT_FALSE(reader.next(record));
+   }
+   {
+      std::string data = write_tokens();
+      /// cut the string value of the first record
+      TokenBinaryReader reader(StringRef(data).take_front(6 + 12 + 4 + 2));
+      ASSERT_TRUE(reader.isValid());
+      TokenRecord record;
+      ASSERT_FALSE(reader.next(record));
+      ASSERT_TRUE(reader.hasError());
+   }
+}
+
+} // anonymous namespace
@@ -0,0 +1,59 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/06.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "gtest/gtest.h"
+
+#include <set>
+#include <thread>
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SourcePresence;
+using polar::syntax::SyntaxNodeId;
+
+namespace {
+
+RefCountPtr<RawSyntax> make_semicolon(std::optional<SyntaxNodeId> nodeId = std::nullopt)
+{
+   return RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {}, {},
+                          SourcePresence::Present, nodeId);
+}
+
+} // anonymous namespace
+
+TEST(RawSyntaxNodeIdTest, testExplicitIdInOwnRangeIsNotHandedOutAgain)
+{
+   SyntaxNodeId first = make_semicolon()->getId();
+   // the next ids of this thread come from the range first was taken from
+   SyntaxNodeId reserved = first + 2;
+   ASSERT_EQ(make_semicolon(reserved)->getId(), reserved);
+   std::set<SyntaxNodeId> ids;
+   for (int i = 0; i < 16; ++i) {
+      SyntaxNodeId id = make_semicolon()->getId();
+      ASSERT_NE(id, reserved);
+      ASSERT_TRUE(ids.insert(id).second);
+   }
+}
+
+TEST(RawSyntaxNodeIdTest, testExplicitIdAheadOfCounterIsSkippedByNewRanges)
+{
+   SyntaxNodeId reserved = make_semicolon()->getId() + 100000;
+   ASSERT_EQ(make_semicolon(reserved)->getId(), reserved);
+   // a thread started afterwards takes a range past the reserved id
+   SyntaxNodeId otherThreadId = 0;
+   std::thread([&otherThreadId]() {
+      otherThreadId = make_semicolon()->getId();
+   }).join();
+   ASSERT_GT(otherThreadId, reserved);
+}
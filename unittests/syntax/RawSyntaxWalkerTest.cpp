@@ -0,0 +1,196 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/03.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/RawSyntaxWalker.h"
+#include "polarphp/syntax/Trivia.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RawSyntaxWalker;
+using polar::syntax::RefCountPtr;
+using polar::syntax::Syntax;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SourcePresence;
+using polar::syntax::Trivia;
+
+namespace {
+
+RefCountPtr<RawSyntax> make_token(TokenKindType kind, const char *text)
+{
+   return RawSyntax::make(kind, text, {}, Trivia::getSpaces(1).pieces, SourcePresence::Present);
+}
+
+/// Spells out the tokens and records the order of the callbacks.
+class RecordingWalker : public RawSyntaxWalker
+{
+public:
+   Action walkPre(const RawSyntax &node) override
+   {
+      events.push_back("pre:" + std::to_string(getDepth()));
+      if (node.isToken()) {
+         llvm::raw_string_ostream stream(text);
+         node.print(stream, {});
+      }
+      if (&node == skipNode) {
+         return Action::SkipChildren;
+      }
+      return &node == stopNode ? Action::Stop : Action::Continue;
+   }
+
+   Action walkPost(const RawSyntax &node) override
+   {
+      events.push_back("post:" + std::to_string(getDepth()));
+      return Action::Continue;
+   }
+
+   std::vector<std::string> events;
+   std::string text;
+   const RawSyntax *skipNode = nullptr;
+   const RawSyntax *stopNode = nullptr;
+};
+
+} // anonymous namespace
+
+TEST(RawSyntaxWalkerTest, testWalkOrder)
+{
+   RefCountPtr<RawSyntax> inner = RawSyntax::make(SyntaxKind::Unknown, {
+      make_token(TokenKindType::T_VARIABLE, "$a"),
+      RawSyntax::missing(TokenKindType::T_EQUAL, "="),
+   }, SourcePresence::Present);
+   RefCountPtr<RawSyntax> root = RawSyntax::make(SyntaxKind::Unknown, {
+      inner, nullptr, make_token(TokenKindType::T_SEMICOLON, ";")
+   }, SourcePresence::Present);
+
+   RecordingWalker walker;
+   ASSERT_TRUE(walker.walk(root));
+   std::vector<std::string> expected{
+      "pre:0", "pre:1", "pre:2", "post:2", "pre:2", "post:2", "post:1", "pre:1", "post:1", "post:0"
+   };
+   ASSERT_EQ(walker.events, expected);
+   ASSERT_EQ(walker.text, "$a ; ");
+
+   RecordingWalker skipWalker;
+   skipWalker.skipNode = inner.get();
+   ASSERT_TRUE(skipWalker.walk(root));
+   expected = {"pre:0", "pre:1", "post:1", "pre:1", "post:1", "post:0"};
+   ASSERT_EQ(skipWalker.events, expected);
+   ASSERT_EQ(skipWalker.text, "; ");
+
+   RecordingWalker stopWalker;
+   stopWalker.stopNode = inner->getChild(0).get();
+   ASSERT_FALSE(stopWalker.walk(root));
+   expected = {"pre:0", "pre:1", "pre:2"};
+   ASSERT_EQ(stopWalker.events, expected);
+   // the walker can be reused after a stopped walk
+   stopWalker.events.clear();
+   stopWalker.stopNode = nullptr;
+   ASSERT_TRUE(stopWalker.walk(root));
+   ASSERT_EQ(stopWalker.events.size(), 10);
+}
+
+TEST(RawSyntaxWalkerTest, testSyntaxIsRealizedOnDemand)
+{
+   RefCountPtr<RawSyntax> semicolon = make_token(TokenKindType::T_SEMICOLON, ";");
+   RefCountPtr<RawSyntax> root = RawSyntax::make(SyntaxKind::Unknown, {
+      RawSyntax::make(SyntaxKind::Unknown, {
+         make_token(TokenKindType::T_VARIABLE, "$a"), semicolon
+      }, SourcePresence::Present)
+   }, SourcePresence::Present);
+
+   class SemicolonWalker : public RawSyntaxWalker
+   {
+   public:
+      Action walkPre(const RawSyntax &node) override
+      {
+         if (node.isToken() && node.getTokenKind() == TokenKindType::T_SEMICOLON) {
+            Syntax syntax = getCurrentSyntax();
+            raw = syntax.getRaw().get();
+            indexInParent = syntax.getIndexInParent();
+            offset = syntax.getAbsolutePosition().getOffset();
+            parentKind = syntax.getParent()->getKind();
+         }
+         return Action::Continue;
+      }
+
+      const RawSyntax *raw = nullptr;
+      size_t indexInParent = 0;
+      std::uint32_t offset = 0;
+      SyntaxKind parentKind = SyntaxKind::Token;
+   };
+
+   SemicolonWalker walker;
+   ASSERT_TRUE(walker.walk(root));
+   ASSERT_EQ(walker.raw, semicolon.get());
+   ASSERT_EQ(walker.indexInParent, 1);
+   ASSERT_EQ(walker.offset, 3);
+   ASSERT_EQ(walker.parentKind, SyntaxKind::Unknown);
+}
+
+TEST(RawSyntaxWalkerTest, testDeepNesting)
+{
+   // deep enough to exhaust the native stack of a recursive walk
+   constexpr unsigned depth = 200000;
+   std::vector<RefCountPtr<RawSyntax>> levels;
+   levels.reserve(depth + 1);
+   levels.push_back(make_token(TokenKindType::T_LNUMBER, "1"));
+   for (unsigned i = 0; i < depth; ++i) {
+      levels.push_back(RawSyntax::make(SyntaxKind::Unknown, {
+         RawSyntax::missing(TokenKindType::T_LEFT_PAREN, "("), levels.back(), nullptr
+      }, SourcePresence::Present));
+   }
+
+   class CountingWalker : public RawSyntaxWalker
+   {
+   public:
+      Action walkPre(const RawSyntax &node) override
+      {
+         ++numPre;
+         maxDepth = std::max(maxDepth, getDepth());
+         if (node.isToken() && node.isPresent()) {
+            deepestTokenDepth = getDepth();
+         }
+         return Action::Continue;
+      }
+
+      Action walkPost(const RawSyntax &node) override
+      {
+         ++numPost;
+         return Action::Continue;
+      }
+
+      size_t numPre = 0;
+      size_t numPost = 0;
+      unsigned maxDepth = 0;
+      unsigned deepestTokenDepth = 0;
+   };
+
+   CountingWalker walker;
+   ASSERT_TRUE(walker.walk(levels.back()));
+   // every level has a layout node and a missing token
+   ASSERT_EQ(walker.numPre, 2 * depth + 1);
+   ASSERT_EQ(walker.numPost, walker.numPre);
+   ASSERT_EQ(walker.maxDepth, depth);
+   ASSERT_EQ(walker.deepestTokenDepth, depth);
+
+   // release the tree from the root down, releasing it at once recurses
+   // once per level
+   for (auto iter = levels.rbegin(), end = levels.rend(); iter != end; ++iter) {
+      *iter = nullptr;
+   }
+}
@@ -0,0 +1,78 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/29.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/SyntaxArena.h"
+#include "polarphp/syntax/Trivia.h"
+#include "gtest/gtest.h"
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxArena;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SourcePresence;
+using polar::syntax::Trivia;
+
+namespace {
+
+RefCountPtr<RawSyntax> make_semicolon(const RefCountPtr<SyntaxArena> &arena,
+                                      const Trivia &leading = Trivia(),
+                                      const Trivia &trailing = Trivia())
+{
+   return RawSyntax::make(TokenKindType::T_SEMICOLON, ";", leading.pieces, trailing.pieces,
+                          SourcePresence::Present, arena);
+}
+
+} // anonymous namespace
+
+TEST(SyntaxArenaTest, testTokenUniquingIsOptIn)
+{
+   RefCountPtr<SyntaxArena> arena(new SyntaxArena);
+   ASSERT_NE(make_semicolon(arena), make_semicolon(arena));
+   ASSERT_EQ(arena->getNumUniquedTokenHits(), 0);
+   ASSERT_EQ(arena->getNumAllocations(), 2);
+}
+
+TEST(SyntaxArenaTest, testEqualTokensShareOneNode)
+{
+   RefCountPtr<SyntaxArena> arena(new SyntaxArena);
+   arena->setTokenUniquing(true);
+   RefCountPtr<RawSyntax> first = make_semicolon(arena, Trivia(), Trivia::getSpaces(1));
+   RefCountPtr<RawSyntax> second = make_semicolon(arena, Trivia(), Trivia::getSpaces(1));
+   ASSERT_EQ(first, second);
+   ASSERT_EQ(arena->getNumUniquedTokenHits(), 1);
+
+   // every part of the key tells tokens apart
+   ASSERT_NE(first, make_semicolon(arena, Trivia::getSpaces(1), Trivia()));
+   ASSERT_NE(first, make_semicolon(arena, Trivia(), Trivia::getSpaces(2)));
+   ASSERT_NE(first, RawSyntax::make(TokenKindType::T_COMMA, ";", {}, Trivia::getSpaces(1).pieces,
+                                    SourcePresence::Present, arena));
+   ASSERT_NE(first, RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {}, Trivia::getSpaces(1).pieces,
+                                    SourcePresence::Missing, arena));
+   ASSERT_EQ(arena->getNumUniquedTokenHits(), 1);
+
+   // tokens of another arena are never shared
+   RefCountPtr<SyntaxArena> otherArena(new SyntaxArena);
+   otherArena->setTokenUniquing(true);
+   ASSERT_NE(first, make_semicolon(otherArena, Trivia(), Trivia::getSpaces(1)));
+   otherArena->clearUniquedTokens();
+
+   // a layout node may hold the same token several times
+   RefCountPtr<RawSyntax> layout = RawSyntax::make(SyntaxKind::Unknown, {first, second, first},
+                                                   SourcePresence::Present, arena);
+   ASSERT_EQ(layout->getTextLength(), 6);
+   // after clearing the table starts over
+   arena->clearUniquedTokens();
+   ASSERT_NE(first, make_semicolon(arena, Trivia(), Trivia::getSpaces(1)));
+   arena->clearUniquedTokens();
+}
@@ -0,0 +1,154 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/22.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/serialization/SyntaxBinarySerialization.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/SyntaxArena.h"
+#include "polarphp/syntax/Trivia.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxArena;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SourcePresence;
+using polar::syntax::SyntaxPrintOptions;
+using polar::syntax::Trivia;
+using polar::syntax::SyntaxBinaryReader;
+using polar::syntax::write_syntax_binary;
+using polar::syntax::SYNTAX_BINARY_NULL_OFFSET;
+using llvm::StringRef;
+
+namespace {
+
+/// Unknown [ $a, <null>, missing ;, EmptyStmt [ ; ] ]
+RefCountPtr<RawSyntax> make_sample_tree()
+{
+   Trivia leading = Trivia::getNewlines(1) + Trivia::getLineComment("// note") +
+         Trivia::getNewlines(1) + Trivia::getSpaces(3);
+   RefCountPtr<RawSyntax> variable = RawSyntax::make(TokenKindType::T_VARIABLE, "$a", leading.pieces,
+                                                     Trivia::getSpaces(1).pieces, SourcePresence::Present);
+   RefCountPtr<RawSyntax> missingSemicolon = RawSyntax::missing(TokenKindType::T_SEMICOLON, ";");
+   RefCountPtr<RawSyntax> semicolon = RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {},
+                                                      Trivia::getTabs(2).pieces, SourcePresence::Present);
+   RefCountPtr<RawSyntax> emptyStmt = RawSyntax::make(SyntaxKind::EmptyStmt, {semicolon},
+                                                      SourcePresence::Present);
+   return RawSyntax::make(SyntaxKind::Unknown, {variable, nullptr, missingSemicolon, emptyStmt},
+                          SourcePresence::Present);
+}
+
+std::string serialize(const RefCountPtr<RawSyntax> &root)
+{
+   std::string data;
+   llvm::raw_string_ostream out(data);
+   write_syntax_binary(out, root);
+   out.flush();
+   return data;
+}
+
+std::string print_tree(const RefCountPtr<RawSyntax> &root)
+{
+   std::string text;
+   llvm::raw_string_ostream out(text);
+   root->print(out, SyntaxPrintOptions());
+   out.flush();
+   return text;
+}
+
+void expect_same_tree(const RefCountPtr<RawSyntax> &expected, const RefCountPtr<RawSyntax> &actual)
+{
+   ASSERT_EQ(bool(expected), bool(actual));
+   if (!expected) {
+      return;
+   }
+   ASSERT_EQ(expected->getKind(), actual->getKind());
+   ASSERT_EQ(expected->getPresence(), actual->getPresence());
+   if (expected->isToken()) {
+      ASSERT_EQ(expected->getTokenKind(), actual->getTokenKind());
+      ASSERT_EQ(expected->getTokenText(), actual->getTokenText());
+      ASSERT_TRUE(expected->getLeadingTrivia() == actual->getLeadingTrivia());
+      ASSERT_TRUE(expected->getTrailingTrivia() == actual->getTrailingTrivia());
+      return;
+   }
+   ASSERT_EQ(expected->getNumChildren(), actual->getNumChildren());
+   for (size_t i = 0; i < expected->getNumChildren(); ++i) {
+      expect_same_tree(expected->getChild(i), actual->getChild(i));
+   }
+}
+
+TEST(SyntaxBinarySerializationTest, testRoundTrip)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   std::string data = serialize(root);
+   {
+      SyntaxBinaryReader reader(data);
+      ASSERT_TRUE(reader.isValid());
+      ASSERT_EQ(reader.getNumNodes(), 5u);
+      RefCountPtr<RawSyntax> copy = reader.materializeRoot();
+      expect_same_tree(root, copy);
+      ASSERT_EQ(print_tree(root), print_tree(copy));
+      ASSERT_EQ(print_tree(copy), "\n// note\n   $a ;\t\t");
+   }
+   {
+      /// materialise into an arena with text referencing the data
+      RefCountPtr<SyntaxArena> arena(new SyntaxArena);
+      SyntaxBinaryReader reader(data, arena, /*referenceData=*/true);
+      RefCountPtr<RawSyntax> copy = reader.materializeRoot();
+      expect_same_tree(root, copy);
+      ASSERT_EQ(copy->getArena(), arena);
+      StringRef text = copy->getChild(0)->getTokenText();
+      ASSERT_TRUE(text.begin() >= data.data() && text.end() <= data.data() + data.size());
+   }
+}
+
+TEST(SyntaxBinarySerializationTest, testLazySubtree)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   std::string data = serialize(root);
+   SyntaxBinaryReader reader(data);
+   std::uint32_t rootOffset = reader.getRootOffset();
+   ASSERT_EQ(reader.getKind(rootOffset), SyntaxKind::Unknown);
+   ASSERT_EQ(reader.getNumChildren(rootOffset), 4u);
+   ASSERT_EQ(reader.getChildOffset(rootOffset, 1), SYNTAX_BINARY_NULL_OFFSET);
+   std::uint32_t emptyStmtOffset = reader.getChildOffset(rootOffset, 3);
+   ASSERT_EQ(reader.getKind(emptyStmtOffset), SyntaxKind::EmptyStmt);
+   ASSERT_TRUE(reader.isToken(reader.getChildOffset(emptyStmtOffset, 0)));
+   RefCountPtr<RawSyntax> emptyStmt = reader.materialize(emptyStmtOffset);
+   expect_same_tree(root->getChild(3), emptyStmt);
+}
+
+TEST(SyntaxBinarySerializationTest, testMalformedData)
+{
+   std::string data = serialize(make_sample_tree());
+   {
+      SyntaxBinaryReader reader(StringRef(data).take_front(10));
+      ASSERT_FALSE(reader.isValid());
+      ASSERT_FALSE(reader.materializeRoot());
+   }
+   {
+      std::string corrupted = data;
+      corrupted[0] = 'X';
+      SyntaxBinaryReader reader(corrupted);
+      ASSERT_FALSE(reader.isValid());
+   }
+   {
+      /// the string table is cut, token text can not be read any more
+      SyntaxBinaryReader reader(StringRef(data).drop_back(4));
+      ASSERT_FALSE(reader.isValid());
+   }
+}
+
+} // anonymous namespace
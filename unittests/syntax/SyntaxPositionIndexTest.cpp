@@ -0,0 +1,120 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/12/02.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/SyntaxData.h"
+#include "polarphp/syntax/SyntaxPositionIndex.h"
+#include "polarphp/syntax/Trivia.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::AbsolutePosition;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxData;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SyntaxPositionIndex;
+using polar::syntax::SourcePresence;
+using polar::syntax::Trivia;
+using polar::syntax::TriviaPiece;
+
+namespace {
+
+RefCountPtr<RawSyntax> make_token(TokenKindType kind, const char *text, Trivia leading,
+                                  Trivia trailing)
+{
+   return RawSyntax::make(kind, text, leading.pieces, trailing.pieces, SourcePresence::Present);
+}
+
+/// "\n$a =\r\n1 /* \n */\r;\n", with a missing token and an empty slot
+RefCountPtr<RawSyntax> make_sample_tree()
+{
+   RefCountPtr<RawSyntax> assignment = RawSyntax::make(SyntaxKind::Unknown, {
+      make_token(TokenKindType::T_VARIABLE, "$a", Trivia::getNewlines(1), Trivia::getSpaces(1)),
+      make_token(TokenKindType::T_EQUAL, "=", Trivia(), Trivia())
+   }, SourcePresence::Present);
+   RefCountPtr<RawSyntax> number = RawSyntax::make(
+            TokenKindType::T_LNUMBER, "1", {TriviaPiece::getCarriageReturnLineFeeds(1)},
+            {TriviaPiece::getSpaces(1), TriviaPiece::getBlockComment("/* \n */")},
+            SourcePresence::Present);
+   RefCountPtr<RawSyntax> terminator = RawSyntax::make(SyntaxKind::Unknown, {
+      make_token(TokenKindType::T_SEMICOLON, ";", Trivia::getCarriageReturns(1), Trivia::getNewlines(1))
+   }, SourcePresence::Present);
+   return RawSyntax::make(SyntaxKind::Unknown, {
+      assignment, RawSyntax::missing(TokenKindType::T_SEMICOLON, ";"), nullptr, number, terminator
+   }, SourcePresence::Present);
+}
+
+/// Realize every node of the tree.
+void collect_nodes(const RefCountPtr<SyntaxData> &data, std::vector<RefCountPtr<SyntaxData>> &nodes)
+{
+   nodes.push_back(data);
+   for (size_t i = 0; i < data->getNumChildren(); ++i) {
+      if (RefCountPtr<SyntaxData> child = data->getChild(i)) {
+         collect_nodes(child, nodes);
+      }
+   }
+}
+
+} // anonymous namespace
+
+TEST(SyntaxPositionIndexTest, testNodeOffsetsMatchSyntaxData)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   SyntaxPositionIndex index(root);
+   std::vector<RefCountPtr<SyntaxData>> nodes;
+   collect_nodes(SyntaxData::make(root), nodes);
+   ASSERT_EQ(index.getNumNodes(), nodes.size());
+   ASSERT_EQ(index.getTextLength(), root->getTextLength());
+   for (const RefCountPtr<SyntaxData> &data : nodes) {
+      SyntaxPositionIndex::NodeIndex node = index.findNode(*data);
+      ASSERT_NE(node, SyntaxPositionIndex::INVALID_NODE);
+      ASSERT_EQ(index.getRaw(node), data->getRaw().get());
+      if (data->getRaw()->isMissing()) {
+         continue;
+      }
+      ASSERT_EQ(index.getOffset(node), data->getAbsolutePositionBeforeLeadingTrivia().getOffset());
+      AbsolutePosition position = data->getAbsolutePosition();
+      ASSERT_EQ(index.getContentOffset(node), position.getOffset());
+      ASSERT_EQ(index.getLineAndColumn(index.getContentOffset(node)), position.getLineAndColumn());
+      ASSERT_EQ(index.getEndOffset(node), data->getAbsoluteEndPositionAfterTrailingTrivia().getOffset());
+   }
+}
+
+TEST(SyntaxPositionIndexTest, testDeepestNodeAndLines)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   SyntaxPositionIndex index(root);
+   for (std::uint32_t offset = 0; offset < index.getTextLength(); ++offset) {
+      SyntaxPositionIndex::NodeIndex node = index.findDeepestNode(offset);
+      ASSERT_NE(node, SyntaxPositionIndex::INVALID_NODE);
+      ASSERT_TRUE(index.getRaw(node)->isToken());
+      ASSERT_LE(index.getOffset(node), offset);
+      ASSERT_LT(offset, index.getEndOffset(node));
+   }
+   ASSERT_EQ(index.findDeepestNode(index.getTextLength()), SyntaxPositionIndex::INVALID_NODE);
+   // "\n" "\r\n" "\n" (comment) "\r" "\n"
+   ASSERT_EQ(index.getNumLines(), 6);
+   ASSERT_EQ(index.getLineAndColumn(0), std::make_pair(1u, 1u));
+   ASSERT_EQ(index.getLineAndColumn(1), std::make_pair(2u, 1u));
+   ASSERT_EQ(index.getLineAndColumn(4), std::make_pair(2u, 4u));
+   ASSERT_EQ(index.getLineAndColumn(7), std::make_pair(3u, 1u));
+   ASSERT_EQ(index.getLineAndColumn(index.getTextLength()), std::make_pair(6u, 1u));
+   // the parent chain of a token leads back to the root
+   SyntaxPositionIndex::NodeIndex node = index.findDeepestNode(2);
+   ASSERT_EQ(index.getRaw(node)->getTokenText(), "$a");
+   node = index.getParent(node);
+   ASSERT_EQ(index.getChild(node, 0), index.findDeepestNode(1));
+   ASSERT_EQ(index.getParent(node), index.getRoot());
+}
@@ -0,0 +1,105 @@
+// This source file is part of the polarphp.org open source project
+//
+// Copyright (c) 2017 - 2019 polarphp software foundation
+// Copyright (c) 2017 - 2019 zzu_softboy <zzu_softboy@163.com>
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://polarphp.org/LICENSE.txt for license information
+// See https://polarphp.org/CONTRIBUTORS.txt for the list of polarphp project authors
+//
+// Created by polarboy on 2019/11/27.
+
+#include "polarphp/syntax/internal/TokenEnumDefs.h"
+#include "polarphp/syntax/serialization/SyntaxJsonSerialization.h"
+#include "polarphp/syntax/serialization/SyntaxStreamWriters.h"
+#include "polarphp/syntax/RawSyntax.h"
+#include "polarphp/syntax/Trivia.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+
+using polar::syntax::internal::TokenKindType;
+using polar::syntax::RawSyntax;
+using polar::syntax::RefCountPtr;
+using polar::syntax::SyntaxKind;
+using polar::syntax::SourcePresence;
+using polar::syntax::Trivia;
+using polar::syntax::write_syntax_json;
+using polar::syntax::write_syntax_sexpr;
+using nlohmann::json;
+using llvm::StringRef;
+
+namespace {
+
+/// Unknown [ $a, <null>, missing ;, EmptyStmt [ ; ] ]
+RefCountPtr<RawSyntax> make_sample_tree()
+{
+   Trivia leading = Trivia::getNewlines(1) + Trivia::getLineComment("// \"note\"") +
+         Trivia::getNewlines(1);
+   RefCountPtr<RawSyntax> variable = RawSyntax::make(TokenKindType::T_VARIABLE, "$a", leading.pieces,
+                                                     Trivia::getSpaces(1).pieces, SourcePresence::Present);
+   RefCountPtr<RawSyntax> missingSemicolon = RawSyntax::missing(TokenKindType::T_SEMICOLON, ";");
+   RefCountPtr<RawSyntax> semicolon = RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {},
+                                                      Trivia::getTabs(1).pieces, SourcePresence::Present);
+   RefCountPtr<RawSyntax> emptyStmt = RawSyntax::make(SyntaxKind::EmptyStmt, {semicolon},
+                                                      SourcePresence::Present);
+   return RawSyntax::make(SyntaxKind::Unknown, {variable, nullptr, missingSemicolon, emptyStmt},
+                          SourcePresence::Present);
+}
+
+std::string dump_json(const RawSyntax &root)
+{
+   std::string text;
+   llvm::raw_string_ostream out(text);
+   write_syntax_json(out, root);
+   return out.str();
+}
+
+std::string dump_sexpr(const RawSyntax &root)
+{
+   std::string text;
+   llvm::raw_string_ostream out(text);
+   write_syntax_sexpr(out, root);
+   return out.str();
+}
+
+} // anonymous namespace
+
+TEST(SyntaxStreamWritersTest, testJsonMatchesDocument)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   json streamed = json::parse(dump_json(*root));
+   json document = *root;
+   ASSERT_EQ(streamed, document);
+   ASSERT_TRUE(streamed["children"][1].is_null());
+   ASSERT_EQ(streamed["children"][0]["leadingTrivia"][1]["text"], "// \"note\"");
+}
+
+TEST(SyntaxStreamWritersTest, testSexpr)
+{
+   RefCountPtr<RawSyntax> root = make_sample_tree();
+   ASSERT_EQ(dump_sexpr(*root),
+             "(Unknown (T_VARIABLE \"$a\" :leading \"\\n// \\\"note\\\"\\n\" :trailing \" \")"
+             " (T_SEMICOLON [missing] \";\") (EmptyStmt (T_SEMICOLON \";\" :trailing \"\\t\")))");
+}
+
+TEST(SyntaxStreamWritersTest, testDeepTree)
+{
+   // the writers must not recurse, deep nesting has to be handled by their
+   // own stack
+   RefCountPtr<RawSyntax> node = RawSyntax::make(TokenKindType::T_SEMICOLON, ";", {}, {},
+                                                 SourcePresence::Present);
+   const unsigned depth = 10000;
+   for (unsigned i = 0; i < depth; ++i) {
+      node = RawSyntax::make(SyntaxKind::Unknown, {node}, SourcePresence::Present);
+   }
+   std::string sexpr = dump_sexpr(*node);
+   ASSERT_EQ(sexpr.size(), depth * std::string("(Unknown ").size() + std::string("(T_SEMICOLON \";\")").size() + depth);
+   std::string jsonText = dump_json(*node);
+   std::string closing;
+   for (unsigned i = 0; i < depth; ++i) {
+      closing += "]}";
+   }
+   ASSERT_TRUE(StringRef(jsonText).endswith("\"trailingTrivia\":[]}" + closing));
+}